@@ -1,15 +1,21 @@
+#include <algorithm>
+#include <array>
 #include <bits/chrono.h>
 #include <chrono>
-#include <fmt/base.h>
+#include <cstdint>
 #include <fmt/color.h>
-#include <mutex>
-#include <sys/socket.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "bot-state.hh"
 #include "bot.hh"
 #include "game.hh"
+#include "log.hh"
 #include "map.hh"
 #include "messages.hh"
+#include "session.hh"
+#include "snapshot.hh"
 
 namespace dfs
 {
@@ -19,9 +25,147 @@ namespace dfs
         : Data(game_data) {
     }
 
-    BotDescriptor::BotDescriptor(BotState &state, int server_sock)
+    static void save_actor(SnapshotWriter &writer, const GenericActor &actor) {
+        writer.Write(actor.Id);
+        writer.Write(actor.CurrentCell);
+        writer.Write(actor.TargetCell);
+        writer.Write(actor.Moving);
+        writer.Write(actor.ArrivalTime);
+    }
+
+    static bool restore_actor(SnapshotReader &reader, GenericActor &actor) {
+        return reader.Read(actor.Id) && reader.Read(actor.CurrentCell) && reader.Read(actor.TargetCell) &&
+               reader.Read(actor.Moving) && reader.Read(actor.ArrivalTime);
+    }
+
+    static void save_player(SnapshotWriter &writer, const Player &player) {
+        save_actor(writer, player);
+        writer.WriteString(player.Name);
+        writer.Write(player.Collecting);
+        writer.Write(player.CollectingId);
+    }
+
+    static bool restore_player(SnapshotReader &reader, Player &player) {
+        return restore_actor(reader, player) && reader.ReadString(player.Name) && reader.Read(player.Collecting) &&
+               reader.Read(player.CollectingId);
+    }
+
+    static void save_monster(SnapshotWriter &writer, const Monster &monster) {
+        save_actor(writer, monster);
+        writer.Write(monster.EnnemyCount);
+        writer.Write(monster.TotalLevel);
+    }
+
+    static bool restore_monster(SnapshotReader &reader, Monster &monster) {
+        return restore_actor(reader, monster) && reader.Read(monster.EnnemyCount) && reader.Read(monster.TotalLevel);
+    }
+
+    static void save_skills(SnapshotWriter &writer, const std::vector<InteractiveElementSkill> &skills) {
+        writer.Write<uint64_t>(skills.size());
+        for (const auto &skill : skills)
+            writer.Write(skill);
+    }
+
+    static bool restore_skills(SnapshotReader &reader, std::vector<InteractiveElementSkill> &skills) {
+        uint64_t count;
+        if (!reader.Read(count))
+            return false;
+
+        skills.clear();
+        for (uint64_t i = 0; i < count; i++) {
+            InteractiveElementSkill skill;
+            if (!reader.Read(skill))
+                return false;
+
+            skills.push_back(skill);
+        }
+
+        return true;
+    }
+
+    static void save_collectible(SnapshotWriter &writer, const Collectible &collectible) {
+        writer.Write(collectible.Id);
+        writer.Write(collectible.ElementTypeId);
+        writer.Write(collectible.CellId);
+        writer.Write(collectible.State);
+        save_skills(writer, collectible.EnabledSkills);
+        save_skills(writer, collectible.DisabledSkills);
+    }
+
+    static bool restore_collectible(SnapshotReader &reader, Collectible &collectible) {
+        return reader.Read(collectible.Id) && reader.Read(collectible.ElementTypeId) &&
+               reader.Read(collectible.CellId) && reader.Read(collectible.State) &&
+               restore_skills(reader, collectible.EnabledSkills) && restore_skills(reader, collectible.DisabledSkills);
+    }
+
+    template <typename T, typename F>
+    static void save_map(SnapshotWriter &writer, const std::unordered_map<int64_t, T> &entries, F save) {
+        writer.Write<uint64_t>(entries.size());
+
+        for (const auto &[id, entry] : entries) {
+            writer.Write(id);
+            save(writer, entry);
+        }
+    }
+
+    template <typename T, typename F>
+    static bool restore_map(SnapshotReader &reader, std::unordered_map<int64_t, T> &entries, F restore) {
+        uint64_t count;
+        if (!reader.Read(count))
+            return false;
+
+        entries.clear();
+        for (uint64_t i = 0; i < count; i++) {
+            int64_t id;
+            T entry;
+
+            if (!reader.Read(id) || !restore(reader, entry))
+                return false;
+
+            entries.emplace(id, std::move(entry));
+        }
+
+        return true;
+    }
+
+    void BotState::Save(SnapshotWriter &writer) const {
+        writer.Write(Active);
+        save_player(writer, CurrentPlayer);
+
+        // The map itself comes from the game data
+        writer.Write<int32_t>(CurrentMap != nullptr ? CurrentMap->GetId() : -1);
+
+        writer.Write(InCombat);
+        writer.Write(ChangingMaps);
+
+        save_map(writer, OtherPlayers, save_player);
+        save_map(writer, Monsters, save_monster);
+        save_map(writer, NPCs, save_actor);
+        save_map(writer, Actors, save_actor);
+        save_map(writer, Collectibles, save_collectible);
+
+        writer.Write(Clock);
+    }
+
+    bool BotState::Restore(SnapshotReader &reader) {
+        int32_t map_id;
+
+        if (!reader.Read(Active) || !restore_player(reader, CurrentPlayer) || !reader.Read(map_id) ||
+            !reader.Read(InCombat) || !reader.Read(ChangingMaps))
+            return false;
+
+        CurrentMap = map_id >= 0 ? Data.GetMap(map_id) : nullptr;
+
+        return restore_map(reader, OtherPlayers, restore_player) && restore_map(reader, Monsters, restore_monster) &&
+               restore_map(reader, NPCs, restore_actor) && restore_map(reader, Actors, restore_actor) &&
+               restore_map(reader, Collectibles, restore_collectible) && reader.Read(Clock);
+    }
+
+    BotDescriptor::BotDescriptor(BotState &state, Endpoint &server)
         : m_State(state)
-        , m_ServerSock(server_sock) {
+        , m_Server(server)
+        , m_Updated(false)
+        , m_UpdatedAt() {
     }
 
     void BotDescriptor::MarkUpdated(const now_t &wake_at) {
@@ -53,17 +197,20 @@ namespace dfs
             m_Timers.push_back(wake_at);
             m_Timers.sort();
 
-            fmt::println("Next update is in {}ms", (m_Timers.front() - now) / std::chrono::milliseconds(1));
+            Log::Debug("Next update is in {}ms", (m_Timers.front() - now) / std::chrono::milliseconds(1));
         }
 
-        m_Condvar.notify_one();
+        if (!m_Updated)
+            m_UpdatedAt = now;
+
+        m_Updated = true;
     }
 
     void BotDescriptor::MoveTo(int cell_id) {
         if (m_State.CurrentMap == nullptr)
             return;
 
-        fmt::println("Moving to {}", cell_id);
+        Log::Debug("Moving to {}", cell_id);
 
         // Get the current cell of the player
         auto current_cell = m_State.CurrentPlayer.CurrentCell;
@@ -72,7 +219,15 @@ namespace dfs
         auto path = m_State.CurrentMap->GetShortestPath(current_cell, cell_id, !m_State.InCombat);
 
         if (path.size() == 0) {
-            fmt::println("Invalid path: length is 0. Skipping.");
+            Log::Debug("Invalid path: length is 0. Skipping.");
+            return;
+        }
+
+        // Forge the map movement request message
+        std::array<uint8_t, Messages::MAX_FORGED_FRAME_SIZE> frame;
+        auto length = Messages::ForgeMapMovementRequest(path, m_State.CurrentMap->GetId(), false, frame);
+        if (length == 0) {
+            Log::Error("Path of {} cells too long to forge a move request", path.size());
             return;
         }
 
@@ -83,77 +238,96 @@ namespace dfs
         // MovementConfirmRequest directly.
         m_State.CurrentPlayer.ArrivalTime = MAX_TIME;
 
-        // Forge the map movement request message
-        auto message = Messages::ForgeMapMovementRequest(path, m_State.CurrentMap->GetId(), false);
-
         // Send the forged movement request to the server
-        send(m_ServerSock, message.data(), message.size(), 0);
+        m_Server.Queue(frame.data(), length);
 
-        fmt::print(fmt::fg(fmt::color::purple), " === SENT FORGED: Move Request ===\n");
+        Log::Debug(fmt::fg(fmt::color::purple), " === SENT FORGED: Move Request ===");
     }
 
     void BotDescriptor::Interact(int element_id, int skill_instance_uid) {
+        // Forge the interact request message
+        std::array<uint8_t, Messages::MAX_FORGED_FRAME_SIZE> frame;
+        auto length = Messages::ForgeInteractiveUseRequest(element_id, skill_instance_uid, frame);
+        if (length == 0) {
+            Log::Error("Failed to forge an interact request for element {}", element_id);
+            return;
+        }
+
         // Set the state of the bot
         m_State.CurrentPlayer.Collecting = true;
         m_State.CurrentPlayer.CollectingId = element_id;
 
-        // Forge the interact request message
-        auto message = Messages::ForgeInteractiveUseRequest(element_id, skill_instance_uid);
-
         // Send the forged request to the server
-        send(m_ServerSock, message.data(), message.size(), 0);
+        m_Server.Queue(frame.data(), length);
 
-        fmt::print(fmt::fg(fmt::color::purple), " === SENT FORGED: Interact Request ===\n");
+        Log::Debug(fmt::fg(fmt::color::purple), " === SENT FORGED: Interact Request ===");
     }
 
     void BotDescriptor::ChangeMap(int map_id) {
         if (m_State.CurrentMap == nullptr)
             return;
 
-        fmt::println("Changing maps to {}", map_id);
+        Log::Debug("Changing maps to {}", map_id);
+
+        // Forge the map change request message
+        std::array<uint8_t, Messages::MAX_FORGED_FRAME_SIZE> frame;
+        auto length = Messages::ForgeMapChangeRequest(map_id, false, frame);
+        if (length == 0) {
+            Log::Error("Failed to forge a map change request to {}", map_id);
+            return;
+        }
 
         // Set the state of the bot
         m_State.ChangingMaps = true;
 
-        // Forge the map change request message
-        auto message = Messages::ForgeMapChangeRequest(map_id, false);
-
         // Send the forged request to the server
-        send(m_ServerSock, message.data(), message.size(), 0);
+        m_Server.Queue(frame.data(), length);
 
-        fmt::print(fmt::fg(fmt::color::purple), " === SENT FORGED: Map Change Request ===\n");
+        Log::Debug(fmt::fg(fmt::color::purple), " === SENT FORGED: Map Change Request ===");
     }
 
-    std::unique_lock<std::mutex> BotDescriptor::WaitForStateUpdate() {
-        // Wait until we receive a message from the server or for the end of the timer we set.
-        std::unique_lock<std::mutex> lock(m_Mutex);
+    bool BotDescriptor::PollStateUpdate(const now_t &now, std::chrono::nanoseconds &waited) {
+        bool updated = m_Updated;
+        m_Updated = false;
 
-        const auto now = std::chrono::high_resolution_clock::now();
-        auto max_time = MAX_TIME;
-        for (auto it = m_Timers.begin(); it != m_Timers.end(); it++) {
-            // Remove timer if it is already passed
-            if (*it < now)
-                m_Timers.erase(it);
-
-            max_time = *it;
-            break;
+        auto since = updated ? m_UpdatedAt : now;
+
+        // Consume the timers that expired, the first one is the oldest
+        if (!m_Timers.empty() && m_Timers.front() <= now)
+            since = std::min(since, m_Timers.front());
+
+        waited = now - since;
+
+        while (!m_Timers.empty() && m_Timers.front() <= now) {
+            m_Timers.pop_front();
+            updated = true;
         }
 
-        m_Condvar.wait_until(lock, max_time);
+        if (!updated)
+            return false;
 
         // If we are in socket mode, we need to check if the current player
         // has finished his move.
-        if (m_State.Active && m_State.CurrentPlayer.Moving && m_State.CurrentPlayer.ArrivalTime <= now) {
-            // Forge the map change request message
-            auto message = Messages::ForgeMapMovementConfirmRequest();
+        // The confirmation is sent ahead, to reach the server as we arrive
+        const auto &player = m_State.CurrentPlayer;
+        if (m_State.Active && player.Moving && m_State.Clock.GetSendTime(player.ArrivalTime) <= now) {
+            // The confirmation is always the same frame
+            auto frame = Messages::ForgeMapMovementConfirmRequest();
 
             // Send the forged request to the server
-            send(m_ServerSock, message.data(), message.size(), 0);
+            m_Server.Queue(frame.data(), frame.size());
 
-            fmt::print(fmt::fg(fmt::color::purple), " === SENT FORGED: Map Movement Confirm Request ===\n");
+            Log::Debug(fmt::fg(fmt::color::purple), " === SENT FORGED: Map Movement Confirm Request ===");
         }
 
-        return lock;
+        return true;
+    }
+
+    now_t BotDescriptor::NextWakeup() const {
+        if (m_Timers.empty())
+            return MAX_TIME;
+
+        return m_Timers.front();
     }
 
     void BotDescriptor::ClearState() {
@@ -169,9 +343,32 @@ namespace dfs
         m_Timers.clear();
     }
 
-    std::unique_lock<std::mutex> BotDescriptor::Lock() {
-        std::unique_lock<std::mutex> lock(m_Mutex);
-        return lock;
+    void BotDescriptor::Save(SnapshotWriter &writer) const {
+        writer.Write(m_Updated);
+        writer.Write<uint64_t>(m_Timers.size());
+
+        for (const auto &timer : m_Timers)
+            writer.Write(timer);
+    }
+
+    bool BotDescriptor::Restore(SnapshotReader &reader) {
+        uint64_t count;
+        if (!reader.Read(m_Updated) || !reader.Read(count))
+            return false;
+
+        // Waiting since the handover
+        m_UpdatedAt = std::chrono::high_resolution_clock::now();
+
+        m_Timers.clear();
+        for (uint64_t i = 0; i < count; i++) {
+            now_t timer;
+            if (!reader.Read(timer))
+                return false;
+
+            m_Timers.push_back(timer);
+        }
+
+        return true;
     }
 
     void GenericActor::UpdateState(const now_t &now) {
@@ -0,0 +1,244 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/base.h>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "capture.hh"
+#include "log.hh"
+
+namespace dfs
+{
+    static size_t align_up(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static bool is_valid_header(const CaptureHeader &header) {
+        return header.Magic == CAPTURE_MAGIC && header.Version == CAPTURE_VERSION &&
+               header.BlockSize == CAPTURE_BLOCK_SIZE;
+    }
+
+    CaptureWriter::CaptureWriter(int fd)
+        : m_Fd(fd)
+        , m_Process(static_cast<uint64_t>(getpid()) << 32)
+        , m_Block(std::make_unique<uint8_t[]>(CAPTURE_BLOCK_SIZE))
+        , m_Used(0)
+        , m_BlockStarted(0) {
+    }
+
+    CaptureWriter::~CaptureWriter() {
+        Flush();
+
+        if (m_Fd >= 0)
+            close(m_Fd);
+    }
+
+    bool CaptureWriter::Create(const std::string &path, bool connected) {
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            perror("Failed to open the capture file");
+            return false;
+        }
+
+        struct stat st{};
+        bool valid = fstat(fd, &st) == 0;
+
+        if (valid && st.st_size == 0) {
+            // Written once, before any writer appends
+            auto page = std::make_unique<uint8_t[]>(CAPTURE_HEADER_SIZE);
+            CaptureHeader header{CAPTURE_MAGIC, CAPTURE_VERSION, CAPTURE_BLOCK_SIZE, connected};
+            memcpy(page.get(), &header, sizeof(header));
+
+            valid = write(fd, page.get(), CAPTURE_HEADER_SIZE) == static_cast<ssize_t>(CAPTURE_HEADER_SIZE);
+        } else if (valid) {
+            // Another process (the previous one of a hot restart for example) left it there: keep appending
+            CaptureHeader header{};
+            valid = static_cast<size_t>(st.st_size) >= CAPTURE_HEADER_SIZE &&
+                    (st.st_size - CAPTURE_HEADER_SIZE) % CAPTURE_BLOCK_SIZE == 0 &&
+                    pread(fd, &header, sizeof(header), 0) == sizeof(header) && is_valid_header(header);
+        }
+
+        close(fd);
+
+        if (!valid)
+            fmt::println(stderr, "{} is not a capture file that can be appended to", path);
+
+        return valid;
+    }
+
+    std::unique_ptr<CaptureWriter> CaptureWriter::Open(const std::string &path) {
+        int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd < 0) {
+            perror("Failed to open the capture file");
+            return nullptr;
+        }
+
+        return std::unique_ptr<CaptureWriter>(new CaptureWriter(fd));
+    }
+
+    void CaptureWriter::Record(uint64_t session_id, CaptureDirection direction, int64_t timestamp,
+                               std::span<const uint8_t> frame) {
+        if (m_Fd < 0)
+            return;
+
+        CaptureRecord record{};
+        record.Length = static_cast<uint32_t>(frame.size());
+        record.Direction = direction;
+        record.SessionId = m_Process | session_id;
+        record.Timestamp = timestamp;
+
+        auto size = align_up(sizeof(record) + frame.size(), alignof(CaptureRecord));
+
+        if (size > CAPTURE_BLOCK_SIZE - m_Used)
+            Flush();
+
+        if (size > CAPTURE_BLOCK_SIZE) {
+            // A run of blocks of its own, still a single write
+            std::vector<uint8_t> run(align_up(size, CAPTURE_BLOCK_SIZE));
+            memcpy(run.data(), &record, sizeof(record));
+            memcpy(run.data() + sizeof(record), frame.data(), frame.size());
+
+            Write(run.data(), run.size());
+            return;
+        }
+
+        if (m_Used == 0)
+            m_BlockStarted = timestamp;
+
+        memcpy(m_Block.get() + m_Used, &record, sizeof(record));
+        memcpy(m_Block.get() + m_Used + sizeof(record), frame.data(), frame.size());
+        m_Used += size;
+
+        FlushExpired(timestamp);
+    }
+
+    void CaptureWriter::FlushExpired(int64_t now) {
+        if (now >= GetFlushDeadline())
+            Flush();
+    }
+
+    void CaptureWriter::Flush() {
+        if (m_Used == 0 || m_Fd < 0)
+            return;
+
+        memset(m_Block.get() + m_Used, 0, CAPTURE_BLOCK_SIZE - m_Used);
+        Write(m_Block.get(), CAPTURE_BLOCK_SIZE);
+        m_Used = 0;
+    }
+
+    void CaptureWriter::Write(const uint8_t *data, size_t length) {
+        // A short write would leave a partial block for the other writers to append after: stop capturing
+        if (write(m_Fd, data, length) != static_cast<ssize_t>(length)) {
+            Log::Error("Failed to write to the capture file, capture stopped: {}", strerror(errno));
+            close(m_Fd);
+            m_Fd = -1;
+        }
+    }
+
+    CaptureReader::CaptureReader(const uint8_t *data, size_t size)
+        : m_Data(data)
+        , m_Size(size)
+        , m_Offset(CAPTURE_HEADER_SIZE)
+        , m_BlockEnd(CAPTURE_HEADER_SIZE)
+        , m_Truncated(false) {
+    }
+
+    CaptureReader::~CaptureReader() {
+        munmap(const_cast<uint8_t *>(m_Data), m_Size);
+    }
+
+    std::unique_ptr<CaptureReader> CaptureReader::Open(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            perror("Failed to open the capture file");
+            return nullptr;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < CAPTURE_HEADER_SIZE) {
+            fmt::println(stderr, "{} is not a capture file", path);
+            close(fd);
+            return nullptr;
+        }
+
+        auto size = static_cast<size_t>(st.st_size);
+        void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (data == MAP_FAILED) {
+            perror("Failed to map the capture file");
+            return nullptr;
+        }
+
+        // Read once, front to back
+        madvise(data, size, MADV_SEQUENTIAL);
+
+        auto reader = std::unique_ptr<CaptureReader>(new CaptureReader(static_cast<const uint8_t *>(data), size));
+
+        if (!is_valid_header(reader->GetHeader())) {
+            fmt::println(stderr, "{} is not a capture file, or of another version", path);
+            return nullptr;
+        }
+
+        return reader;
+    }
+
+    std::optional<CaptureReader::Entry> CaptureReader::Next() {
+        while (true) {
+            if (m_Offset + sizeof(CaptureRecord) > m_BlockEnd) {
+                // Padding, or the end of the previous block: on to the next one
+                m_Offset = m_BlockEnd;
+                m_BlockEnd += CAPTURE_BLOCK_SIZE;
+            }
+
+            if (m_Offset + sizeof(CaptureRecord) > m_Size)
+                return std::nullopt;
+
+            CaptureRecord record;
+            memcpy(&record, m_Data + m_Offset, sizeof(record));
+
+            if (record.Length == 0) {
+                m_Offset = m_BlockEnd;
+                continue;
+            }
+
+            auto start = m_Offset;
+            auto end = start + sizeof(record) + record.Length;
+
+            if (end > m_BlockEnd) {
+                // Only frames too large for a block span several, starting at the first one
+                if (start != m_BlockEnd - CAPTURE_BLOCK_SIZE) {
+                    m_Truncated = true;
+                    return std::nullopt;
+                }
+
+                m_BlockEnd = start + align_up(end - start, CAPTURE_BLOCK_SIZE);
+            }
+
+            if (end > m_Size) {
+                m_Truncated = true;
+                return std::nullopt;
+            }
+
+            m_Offset = align_up(end, alignof(CaptureRecord));
+
+            return Entry{reinterpret_cast<const CaptureRecord *>(m_Data + start),
+                         std::span<const uint8_t>(m_Data + start + sizeof(record), record.Length)};
+        }
+    }
+
+    void CaptureReader::Rewind() {
+        m_Offset = CAPTURE_HEADER_SIZE;
+        m_BlockEnd = CAPTURE_HEADER_SIZE;
+        m_Truncated = false;
+    }
+} // namespace dfs
@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "clock-sync.hh"
+
+namespace dfs
+{
+    void ClockSync::OnPingSent(const now_t &now) {
+        if (m_PingCount == MAX_PINGS) {
+            std::copy(m_Pings.begin() + 1, m_Pings.end(), m_Pings.begin());
+            m_PingCount--;
+        }
+
+        m_Pings[m_PingCount++] = now.time_since_epoch().count();
+    }
+
+    void ClockSync::OnPong(const now_t &now) {
+        if (m_PingCount == 0)
+            return;
+
+        auto round_trip = now.time_since_epoch().count() - m_Pings[0];
+
+        std::copy(m_Pings.begin() + 1, m_Pings.begin() + m_PingCount, m_Pings.begin());
+        m_PingCount--;
+
+        // The clock went back
+        if (round_trip < 0)
+            return;
+
+        m_RoundTrips[m_RoundTripCount++ % WINDOW] = round_trip;
+    }
+
+    void ClockSync::OnServerTime(int64_t timestamp, const now_t &now) {
+        auto sent_at = GetSentAt(now).time_since_epoch();
+        auto server = std::chrono::milliseconds(timestamp);
+
+        m_Offsets[m_OffsetCount++ % WINDOW] = std::chrono::nanoseconds(server - sent_at).count();
+    }
+
+    std::chrono::nanoseconds ClockSync::GetOneWayDelay() const {
+        if (m_RoundTripCount == 0)
+            return std::chrono::nanoseconds(0);
+
+        auto samples = std::min(m_RoundTripCount, WINDOW);
+        return std::chrono::nanoseconds(*std::min_element(m_RoundTrips.begin(), m_RoundTrips.begin() + samples) / 2);
+    }
+
+    std::chrono::nanoseconds ClockSync::GetOffset() const {
+        if (m_OffsetCount == 0)
+            return std::chrono::nanoseconds(0);
+
+        auto samples = std::min(m_OffsetCount, WINDOW);
+        return std::chrono::nanoseconds(*std::max_element(m_Offsets.begin(), m_Offsets.begin() + samples));
+    }
+} // namespace dfs
@@ -0,0 +1,417 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "epoll-reactor.hh"
+#include "log.hh"
+#include "session.hh"
+
+namespace dfs
+{
+    EpollReactor::EpollReactor(int listen_sock, const GameData &game_data, const Messages &messages, bool splice)
+        : Reactor(listen_sock, game_data, messages)
+        , m_Epoll(epoll_create1(EPOLL_CLOEXEC))
+        , m_Splice(splice) {
+        // The listening sockets are tagged with a null pointer, the wake fd with its own address. Everything else
+        // points to an `Endpoint`.
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = &m_WakeFd;
+        if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_WakeFd, &ev) < 0)
+            Log::Error("Failed to watch the wake fd: {}", strerror(errno));
+    }
+
+    EpollReactor::~EpollReactor() {
+        ClosePassthroughs(true);
+        close(m_Epoll);
+    }
+
+    void EpollReactor::Watch(Endpoint &endpoint, bool add) {
+        epoll_event ev{};
+        ev.data.ptr = &endpoint;
+
+        if (endpoint.WantsRead)
+            ev.events |= EPOLLIN;
+        if (endpoint.WantsWrite)
+            ev.events |= EPOLLOUT;
+
+        if (epoll_ctl(m_Epoll, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, endpoint.Fd, &ev) < 0)
+            Log::Error("epoll_ctl: {}", strerror(errno));
+    }
+
+    void EpollReactor::Accept() {
+        // Listening sockets share the same tag, there are only a couple of them
+        for (int listen_sock : m_Listeners)
+            Accept(listen_sock);
+    }
+
+    void EpollReactor::Accept(int listen_sock) {
+        while (true) {
+            int client_sock = accept4(listen_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (client_sock < 0) {
+                // Another reactor may have taken it first on a shared socket
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    Log::Error("Accept failed");
+
+                return;
+            }
+
+            Log::Info("Accepted connection");
+
+            auto &session = AddSession(client_sock);
+
+            // Not fatal, the session simply goes through user space
+            if (m_Splice && !OpenPassthrough(session))
+                Log::Error("Failed to create the passthrough pipes: {}", strerror(errno));
+
+            Watch(session.GetClient(), true);
+        }
+    }
+
+    bool EpollReactor::OpenPassthrough(Session &session) {
+        Passthrough pipes;
+
+        if (pipe2(pipes.Relay, O_NONBLOCK | O_CLOEXEC) < 0)
+            return false;
+
+        if (pipe2(pipes.Tap, O_NONBLOCK | O_CLOEXEC) < 0) {
+            close(pipes.Relay[0]);
+            close(pipes.Relay[1]);
+            return false;
+        }
+
+        // Both pipes must have the same capacity for the tee to always copy everything that was spliced
+        fcntl(pipes.Relay[1], F_SETPIPE_SZ, PIPE_SIZE);
+        fcntl(pipes.Tap[1], F_SETPIPE_SZ, PIPE_SIZE);
+
+        m_Passthroughs.emplace(&session, pipes);
+        return true;
+    }
+
+    EpollReactor::Passthrough *EpollReactor::FindPassthrough(Session &session) {
+        if (m_Passthroughs.empty())
+            return nullptr;
+
+        auto it = m_Passthroughs.find(&session);
+        return it != m_Passthroughs.end() ? &it->second : nullptr;
+    }
+
+    bool EpollReactor::TapPassthrough(Endpoint &server, Passthrough &pipes, size_t length) {
+        // The relay pipe was empty before this splice, so the tee duplicates exactly the new bytes
+        if (tee(pipes.Relay[0], pipes.Tap[1], length, SPLICE_F_NONBLOCK) != static_cast<ssize_t>(length)) {
+            Log::Error("tee: {}", strerror(errno));
+            return false;
+        }
+
+        pipes.Pending = length;
+
+        auto room = server.Inbound.Prepare(length);
+        if (room.size() != length) {
+            Log::Warning("Server frame larger than {} bytes", server.Inbound.GetCapacity());
+            return false;
+        }
+
+        size_t offset = 0;
+        while (offset < length) {
+            ssize_t bytes_read = read(pipes.Tap[0], room.data() + offset, length - offset);
+
+            if (bytes_read <= 0) {
+                if (bytes_read < 0 && errno == EINTR)
+                    continue;
+
+                Log::Error("Failed to read the tapped bytes: {}", strerror(errno));
+                return false;
+            }
+
+            offset += bytes_read;
+        }
+
+        server.Inbound.Commit(length);
+        server.Owner.OnServerDataRelayed(length);
+        return true;
+    }
+
+    bool EpollReactor::DrainPassthrough(Endpoint &client, Passthrough &pipes) {
+        while (pipes.Pending > 0) {
+            ssize_t spliced =
+                splice(pipes.Relay[0], nullptr, client.Fd, nullptr, pipes.Pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+            if (spliced < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                // The client socket is full, we will be called again once it is writable
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return true;
+
+                return false;
+            }
+
+            pipes.Pending -= spliced;
+        }
+
+        return true;
+    }
+
+    bool EpollReactor::ReclaimPassthrough(Endpoint &client, Passthrough &pipes) {
+        // The pipe never holds more than one read buffer
+        while (pipes.Pending > 0) {
+            ssize_t bytes_read = read(pipes.Relay[0], m_ReadBuffer.data(), pipes.Pending);
+
+            if (bytes_read <= 0) {
+                if (bytes_read < 0 && errno == EINTR)
+                    continue;
+
+                Log::Error("Failed to read the relayed bytes: {}", strerror(errno));
+                return false;
+            }
+
+            client.Queue(m_ReadBuffer.data(), bytes_read);
+            pipes.Pending -= bytes_read;
+        }
+
+        return true;
+    }
+
+    void EpollReactor::ClosePassthroughs(bool all) {
+        std::erase_if(m_Passthroughs, [all](const auto &entry) {
+            const auto &[session, pipes] = entry;
+
+            if (!all && session->GetState() != Session::State::Closed)
+                return false;
+
+            for (int fd : {pipes.Relay[0], pipes.Relay[1], pipes.Tap[0], pipes.Tap[1]})
+                close(fd);
+
+            return true;
+        });
+    }
+
+    void EpollReactor::Read(Endpoint &endpoint, uint32_t events) {
+        auto &session = endpoint.Owner;
+        auto pipes = endpoint.IsServer ? FindPassthrough(session) : nullptr;
+
+        ssize_t bytes_read;
+        if (pipes != nullptr) {
+            if (pipes->Pending > 0) {
+                // Wait for the client to take what is already in the pipe
+                if (!(events & (EPOLLERR | EPOLLHUP)))
+                    return;
+
+                // Errors and hang ups are level-triggered and reported whatever we watch, so the server cannot wait
+                // for the client: hand the rest of the pipe to the client queue and close like on a regular EOF
+                Log::Info("Server: connection closed");
+
+                if (ReclaimPassthrough(session.GetClient(), *pipes))
+                    Flush(session);
+
+                session.Close();
+                return;
+            }
+
+            bytes_read = splice(endpoint.Fd, nullptr, pipes->Relay[1], nullptr, PIPE_SIZE,
+                                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        } else {
+            bytes_read = recv(endpoint.Fd, m_ReadBuffer.data(), m_ReadBuffer.size(), 0);
+        }
+
+        if (bytes_read < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return;
+
+            Log::Warning("{}: read error", endpoint.IsServer ? "Server" : "Client");
+            session.Close();
+            return;
+        } else if (bytes_read == 0) {
+            Log::Info("{}: connection closed", endpoint.IsServer ? "Server" : "Client");
+
+            // Best effort: give the last bytes a chance to reach the other side
+            Flush(session);
+            session.Close();
+            return;
+        }
+
+        if (endpoint.IsServer) {
+            if (pipes == nullptr)
+                session.OnServerData(m_ReadBuffer.data(), bytes_read);
+            else if (!TapPassthrough(endpoint, *pipes, bytes_read))
+                session.Close();
+
+            return;
+        }
+
+        session.OnClientData(m_ReadBuffer.data(), bytes_read);
+
+        if (session.GetState() == Session::State::Handshake) {
+            if (!session.Connect()) {
+                session.Close();
+                return;
+            }
+
+            // Wait for the upstream socket to become writable, which means the connection is established
+            if (session.GetState() == Session::State::Connecting) {
+                session.GetServer().WantsWrite = true;
+                Watch(session.GetServer(), true);
+            }
+        }
+    }
+
+    void EpollReactor::HandleEvent(Endpoint &endpoint, uint32_t events) {
+        auto &session = endpoint.Owner;
+
+        if (session.GetState() == Session::State::Closed)
+            return;
+
+        if (endpoint.IsServer && session.GetState() == Session::State::Connecting) {
+            if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+                return;
+
+            if (!OnConnected(session)) {
+                session.Close();
+                return;
+            }
+
+            // The write interest is refreshed when flushing the session
+            return;
+        }
+
+        if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+            Read(endpoint, events);
+    }
+
+    bool EpollReactor::Flush(Session &session) {
+        if (session.GetState() != Session::State::Relaying)
+            return true;
+
+        auto pipes = FindPassthrough(session);
+        if (pipes != nullptr && !DrainPassthrough(session.GetClient(), *pipes))
+            return false;
+
+        if (!session.GetClient().Flush() || !session.GetServer().Flush())
+            return false;
+
+        for (auto endpoint : {&session.GetClient(), &session.GetServer()}) {
+            // Only watch for writability while we have something to write. Stop reading from a side while the
+            // other one lags behind (or while the pipe is not drained in splice mode).
+            auto &destination = endpoint->IsServer ? session.GetClient() : session.GetServer();
+
+            bool wants_read = !destination.Outbound.IsCongested();
+            bool wants_write = endpoint->HasPending();
+
+            if (pipes != nullptr) {
+                if (endpoint->IsServer)
+                    wants_read &= pipes->Pending == 0;
+                else
+                    wants_write |= pipes->Pending > 0;
+            }
+
+            if (wants_read != endpoint->WantsRead || wants_write != endpoint->WantsWrite) {
+                endpoint->WantsRead = wants_read;
+                endpoint->WantsWrite = wants_write;
+                Watch(*endpoint, false);
+            }
+        }
+
+        return true;
+    }
+
+    void EpollReactor::Quiesce() {
+        for (auto &session : m_Sessions) {
+            if (session->GetState() != Session::State::Relaying)
+                continue;
+
+            // Last chance to write what is queued, the rest travels with the snapshot
+            if (!Flush(*session)) {
+                session->Close();
+                continue;
+            }
+
+            // What the client did not take yet from the pipe goes back to its queue
+            auto pipes = FindPassthrough(*session);
+            if (pipes != nullptr && !ReclaimPassthrough(session->GetClient(), *pipes))
+                session->Close();
+        }
+
+        ClosePassthroughs(true);
+    }
+
+    void EpollReactor::Adopt(Session &session) {
+        if (m_Splice && !OpenPassthrough(session))
+            Log::Error("Failed to create the passthrough pipes: {}", strerror(errno));
+
+        auto &client = session.GetClient();
+        auto &server = session.GetServer();
+
+        client.WantsWrite = client.HasPending();
+        Watch(client, true);
+
+        if (session.GetState() == Session::State::Connecting) {
+            server.WantsWrite = true;
+            Watch(server, true);
+        } else if (session.GetState() == Session::State::Relaying) {
+            server.WantsWrite = server.HasPending();
+            Watch(server, true);
+        }
+    }
+
+    void EpollReactor::Run() {
+        std::array<epoll_event, MAX_EVENTS> events;
+
+        for (int listen_sock : m_Listeners) {
+            // Only wake one of the reactors sharing a listening socket up
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+            ev.data.ptr = nullptr;
+
+            if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, listen_sock, &ev) < 0)
+                Log::Error("Failed to watch a listening socket: {}", strerror(errno));
+        }
+
+        m_Running = true;
+
+        while (m_Running) {
+            int count = epoll_wait(m_Epoll, events.data(), MAX_EVENTS, GetTimeout());
+
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                Log::Error("epoll_wait: {}", strerror(errno));
+                break;
+            }
+
+            for (int i = 0; i < count; i++) {
+                auto tag = events[i].data.ptr;
+
+                if (tag == nullptr) {
+                    Accept();
+                } else if (tag == &m_WakeFd) {
+                    uint64_t value;
+                    [[maybe_unused]] auto _ = read(m_WakeFd, &value, sizeof(value));
+                } else {
+                    HandleEvent(*static_cast<Endpoint *>(tag), events[i].events);
+                }
+            }
+
+            // Let the bots react to what happened (or to their timers), then write everything in one go
+            UpdateBots(std::chrono::high_resolution_clock::now());
+
+            for (auto &session : m_Sessions) {
+                if (!Flush(*session))
+                    session->Close();
+            }
+
+            // Closing a session closes its sockets, which also removes them from the epoll set
+            ClosePassthroughs(false);
+            RemoveClosedSessions();
+        }
+
+        Log::Info("Gracefully shutting down...");
+        PrintStats();
+    }
+} // namespace dfs
@@ -0,0 +1,366 @@
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "event-views.hh"
+#include "wire.hh"
+
+namespace dfs
+{
+    // Field numbers from gamemap.proto, interactive_element.proto and common.proto
+    static constexpr const uint32_t MAP_MOVEMENT_CELLS_FIELD = 1;
+    static constexpr const uint32_t MAP_MOVEMENT_CHARACTER_ID_FIELD = 3;
+    static constexpr const uint32_t MAP_MOVEMENT_CAUTIOUS_FIELD = 4;
+
+    static constexpr const uint32_t STATED_ELEMENT_UPDATED_ELEMENT_FIELD = 1;
+    static constexpr const uint32_t STATED_ELEMENT_ELEMENT_ID_FIELD = 1;
+    static constexpr const uint32_t STATED_ELEMENT_CELL_ID_FIELD = 2;
+    static constexpr const uint32_t STATED_ELEMENT_STATE_FIELD = 3;
+    static constexpr const uint32_t STATED_ELEMENT_ON_CURRENT_MAP_FIELD = 4;
+
+    static constexpr const uint32_t SHOW_ACTORS_ACTORS_FIELD = 1;
+    static constexpr const uint32_t ACTOR_ID_FIELD = 1;
+    static constexpr const uint32_t ACTOR_DISPOSITION_FIELD = 2;
+    static constexpr const uint32_t ACTOR_INFORMATION_FIELD = 3;
+    static constexpr const uint32_t DISPOSITION_CELL_ID_FIELD = 2;
+    static constexpr const uint32_t INFORMATION_ROLE_PLAY_ACTOR_FIELD = 2;
+    static constexpr const uint32_t INFORMATION_FIGHTER_FIELD = 3;
+    static constexpr const uint32_t ROLE_PLAY_NAMED_ACTOR_FIELD = 4;
+    static constexpr const uint32_t ROLE_PLAY_TAX_COLLECTOR_FIELD = 5;
+    static constexpr const uint32_t ROLE_PLAY_MONSTER_GROUP_FIELD = 6;
+    static constexpr const uint32_t ROLE_PLAY_NPC_FIELD = 7;
+    static constexpr const uint32_t ROLE_PLAY_TREASURE_HUNT_NPC_FIELD = 10;
+    static constexpr const uint32_t NAMED_ACTOR_NAME_FIELD = 1;
+    static constexpr const uint32_t NAMED_ACTOR_HUMANOID_FIELD = 2;
+    static constexpr const uint32_t NAMED_ACTOR_MOUNT_FIELD = 3;
+    static constexpr const uint32_t MONSTER_GROUP_IDENTIFICATION_FIELD = 1;
+    static constexpr const uint32_t GROUP_MAIN_CREATURE_FIELD = 1;
+    static constexpr const uint32_t GROUP_UNDERLINGS_FIELD = 2;
+    static constexpr const uint32_t MONSTER_LEVEL_FIELD = 3;
+
+    /// Calls `visit(field, type, varint, bytes)` for each varint or length delimited field of `message`, skipping
+    /// the others. Returns false if the message is malformed, or as soon as `visit` does.
+    template <typename Visitor>
+    static bool read_fields(std::string_view message, Visitor &&visit) {
+        WireReader reader(message);
+        uint32_t field;
+        WireReader::WireType type;
+
+        while (reader.Next(field, type)) {
+            uint64_t varint = 0;
+            std::string_view bytes;
+
+            if (type == WireReader::VARINT) {
+                if (!reader.ReadVarint(varint))
+                    break;
+            } else if (type == WireReader::LENGTH_DELIMITED) {
+                if (!reader.ReadBytes(bytes))
+                    break;
+            } else {
+                if (!reader.Skip(type))
+                    break;
+
+                continue;
+            }
+
+            if (!visit(field, type, varint, bytes))
+                return false;
+        }
+
+        return !reader.HasFailed();
+    }
+
+    /// Levels of a monster group, added up once its actor is read
+    struct MonsterGroupLevels
+    {
+        uint32_t MainCreature = 0;
+        uint32_t Underlings = 0;
+        uint16_t UnderlingCount = 0;
+    };
+
+    /// `MonsterInGroupInformation.level`
+    static bool read_monster_level(std::string_view monster, uint32_t &level) {
+        return read_fields(monster, [&](uint32_t field, WireReader::WireType type, uint64_t varint, std::string_view) {
+            if (field == MONSTER_LEVEL_FIELD && type == WireReader::VARINT)
+                level = static_cast<uint32_t>(varint);
+
+            return true;
+        });
+    }
+
+    /// `MonsterGroupActor`
+    static bool read_monster_group(std::string_view group, MonsterGroupLevels &levels) {
+        return read_fields(group, [&](uint32_t field, WireReader::WireType type, uint64_t, std::string_view bytes) {
+            if (field != MONSTER_GROUP_IDENTIFICATION_FIELD || type != WireReader::LENGTH_DELIMITED)
+                return true;
+
+            return read_fields(bytes, [&](uint32_t field, WireReader::WireType type, uint64_t, std::string_view bytes) {
+                if (type != WireReader::LENGTH_DELIMITED)
+                    return true;
+
+                if (field == GROUP_MAIN_CREATURE_FIELD)
+                    return read_monster_level(bytes, levels.MainCreature);
+
+                if (field == GROUP_UNDERLINGS_FIELD) {
+                    uint32_t level = 0;
+                    levels.UnderlingCount++;
+
+                    if (!read_monster_level(bytes, level))
+                        return false;
+
+                    levels.Underlings += level;
+                }
+
+                return true;
+            });
+        });
+    }
+
+    /// `NamedActor`: a player if it is a humanoid
+    static bool read_named_actor(std::string_view named, ActorSummary &actor) {
+        if (actor.Type != ActorSummary::Kind::Player)
+            actor.Type = ActorSummary::Kind::Other;
+
+        return read_fields(named, [&](uint32_t field, WireReader::WireType type, uint64_t, std::string_view bytes) {
+            if (type != WireReader::LENGTH_DELIMITED)
+                return true;
+
+            switch (field) {
+            case NAMED_ACTOR_NAME_FIELD:
+                actor.Name = bytes;
+                break;
+            case NAMED_ACTOR_HUMANOID_FIELD:
+                actor.Type = ActorSummary::Kind::Player;
+                break;
+            case NAMED_ACTOR_MOUNT_FIELD:
+                actor.Type = ActorSummary::Kind::Other;
+                break;
+            }
+
+            return true;
+        });
+    }
+
+    /// `ActorInformation`
+    static bool read_actor_information(std::string_view information, ActorSummary &actor, MonsterGroupLevels &levels) {
+        return read_fields(information, [&](uint32_t field, WireReader::WireType type, uint64_t,
+                                            std::string_view bytes) {
+            if (field == INFORMATION_FIGHTER_FIELD && type == WireReader::LENGTH_DELIMITED) {
+                actor.Type = ActorSummary::Kind::Other;
+                return true;
+            }
+
+            if (field != INFORMATION_ROLE_PLAY_ACTOR_FIELD || type != WireReader::LENGTH_DELIMITED)
+                return true;
+
+            // Oneof semantics: the last member wins, and a monster group only adds up with itself
+            return read_fields(bytes, [&](uint32_t field, WireReader::WireType type, uint64_t, std::string_view bytes) {
+                if (field == ROLE_PLAY_TREASURE_HUNT_NPC_FIELD && type == WireReader::VARINT) {
+                    actor.Type = ActorSummary::Kind::Other;
+                    return true;
+                }
+
+                if (type != WireReader::LENGTH_DELIMITED)
+                    return true;
+
+                if (field != ROLE_PLAY_MONSTER_GROUP_FIELD)
+                    levels = {};
+
+                switch (field) {
+                case ROLE_PLAY_NAMED_ACTOR_FIELD:
+                    return read_named_actor(bytes, actor);
+                case ROLE_PLAY_TAX_COLLECTOR_FIELD:
+                    actor.Type = ActorSummary::Kind::Monster;
+                    break;
+                case ROLE_PLAY_MONSTER_GROUP_FIELD:
+                    if (actor.Type != ActorSummary::Kind::Monster)
+                        levels = {};
+
+                    actor.Type = ActorSummary::Kind::Monster;
+                    return read_monster_group(bytes, levels);
+                case ROLE_PLAY_NPC_FIELD:
+                    actor.Type = ActorSummary::Kind::Npc;
+                    break;
+                default:
+                    // Prisms, portals
+                    actor.Type = ActorSummary::Kind::Other;
+                    break;
+                }
+
+                return true;
+            });
+        });
+    }
+
+    /// `ActorPositionInformation`
+    static bool read_actor(std::string_view message, ActorSummary &actor) {
+        MonsterGroupLevels levels;
+
+        auto read = read_fields(message, [&](uint32_t field, WireReader::WireType type, uint64_t varint,
+                                             std::string_view bytes) {
+            switch (field) {
+            case ACTOR_ID_FIELD:
+                if (type == WireReader::VARINT)
+                    actor.Id = static_cast<int64_t>(varint);
+                break;
+            case ACTOR_DISPOSITION_FIELD:
+                if (type != WireReader::LENGTH_DELIMITED)
+                    break;
+
+                return read_fields(bytes, [&](uint32_t field, WireReader::WireType type, uint64_t varint,
+                                              std::string_view) {
+                    if (field == DISPOSITION_CELL_ID_FIELD && type == WireReader::VARINT)
+                        actor.CellId = static_cast<int32_t>(varint);
+
+                    return true;
+                });
+            case ACTOR_INFORMATION_FIELD:
+                if (type != WireReader::LENGTH_DELIMITED)
+                    break;
+
+                if (actor.Type == ActorSummary::Kind::None)
+                    actor.Type = ActorSummary::Kind::Other;
+
+                return read_actor_information(bytes, actor, levels);
+            }
+
+            return true;
+        });
+
+        if (!read)
+            return false;
+
+        // Tax collectors count as a single creature of level zero
+        if (actor.Type == ActorSummary::Kind::Monster) {
+            actor.EnnemyCount = static_cast<uint16_t>(1 + levels.UnderlingCount);
+            actor.TotalLevel = static_cast<uint16_t>(levels.MainCreature + levels.Underlings);
+        }
+
+        return true;
+    }
+
+    std::optional<MapMovementEventView> MapMovementEventView::Read(std::string_view event) {
+        MapMovementEventView view;
+        bool has_cells = false;
+
+        auto read = read_fields(event, [&](uint32_t field, WireReader::WireType type, uint64_t varint,
+                                           std::string_view bytes) {
+            switch (field) {
+            case MAP_MOVEMENT_CELLS_FIELD:
+                // Unpacked or split cells are left to the full parse
+                if (type != WireReader::LENGTH_DELIMITED || has_cells)
+                    return false;
+
+                view.m_Cells = bytes;
+                has_cells = true;
+                break;
+            case MAP_MOVEMENT_CHARACTER_ID_FIELD:
+                if (type == WireReader::VARINT)
+                    view.m_CharacterId = static_cast<int64_t>(varint);
+                break;
+            case MAP_MOVEMENT_CAUTIOUS_FIELD:
+                if (type == WireReader::VARINT)
+                    view.m_Cautious = varint != 0;
+                break;
+            }
+
+            return true;
+        });
+
+        if (!read)
+            return std::nullopt;
+
+        // One cell per last byte of a varint
+        for (auto byte : view.m_Cells) {
+            if ((static_cast<uint8_t>(byte) & 0x80) == 0)
+                view.m_CellCount++;
+        }
+
+        if (!view.m_Cells.empty() && (static_cast<uint8_t>(view.m_Cells.back()) & 0x80) != 0)
+            return std::nullopt;
+
+        return view;
+    }
+
+    std::span<int32_t> MapMovementEventView::GetCells(std::span<int32_t> cells) const {
+        WireReader reader(m_Cells);
+        size_t count = 0;
+        uint64_t cell;
+
+        while (count < cells.size() && reader.ReadVarint(cell))
+            cells[count++] = static_cast<int32_t>(cell);
+
+        return cells.first(count);
+    }
+
+    std::optional<StatedElementUpdatedEventView> StatedElementUpdatedEventView::Read(std::string_view event) {
+        StatedElementUpdatedEventView view;
+
+        auto read = read_fields(event, [&](uint32_t field, WireReader::WireType type, uint64_t,
+                                           std::string_view bytes) {
+            if (field != STATED_ELEMENT_UPDATED_ELEMENT_FIELD || type != WireReader::LENGTH_DELIMITED)
+                return true;
+
+            return read_fields(bytes, [&](uint32_t field, WireReader::WireType type, uint64_t varint,
+                                          std::string_view) {
+                if (type != WireReader::VARINT)
+                    return true;
+
+                switch (field) {
+                case STATED_ELEMENT_ELEMENT_ID_FIELD:
+                    view.ElementId = static_cast<int32_t>(varint);
+                    break;
+                case STATED_ELEMENT_CELL_ID_FIELD:
+                    view.CellId = static_cast<int32_t>(varint);
+                    break;
+                case STATED_ELEMENT_STATE_FIELD:
+                    view.State = static_cast<int32_t>(varint);
+                    break;
+                case STATED_ELEMENT_ON_CURRENT_MAP_FIELD:
+                    view.OnCurrentMap = varint != 0;
+                    break;
+                }
+
+                return true;
+            });
+        });
+
+        if (!read)
+            return std::nullopt;
+
+        return view;
+    }
+
+    bool GameRolePlayShowActorsEventView::Next(ActorSummary &actor) {
+        uint32_t field;
+        WireReader::WireType type;
+
+        if (m_Failed)
+            return false;
+
+        while (m_Reader.Next(field, type)) {
+            if (field != SHOW_ACTORS_ACTORS_FIELD || type != WireReader::LENGTH_DELIMITED) {
+                if (!m_Reader.Skip(type))
+                    return false;
+
+                continue;
+            }
+
+            std::string_view bytes;
+            if (!m_Reader.ReadBytes(bytes))
+                return false;
+
+            actor = {};
+            if (!read_actor(bytes, actor)) {
+                m_Failed = true;
+                return false;
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+} // namespace dfs
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+
+#include "frame-decoder.hh"
+
+namespace dfs
+{
+    static std::tuple<uint64_t, int> decode_uvarint(const uint8_t *data, size_t length) {
+        uint64_t value = 0;
+        int shift = 0;
+        int bytes_read = 0;
+
+        for (size_t i = 0; i < length; i++) {
+            value |= (static_cast<uint64_t>(data[i] & 0x7F) << shift); // Extract 7 bits and add to value
+            bytes_read++;
+            if ((data[i] & 0x80) == 0) { // MSB = 0 indicates the end
+                return {value, bytes_read};
+            }
+
+            shift += 7;
+            if (shift >= 64) { // Overflow error
+                return {0, -2};
+            }
+        }
+
+        // If we run out of bytes before completing the value
+        return {0, -1};
+    }
+
+    FrameDecoder::FrameDecoder(size_t capacity)
+        // Left uninitialized, untouched pages are never committed
+        : m_Storage(std::make_unique_for_overwrite<uint8_t[]>(capacity))
+        , m_Capacity(capacity)
+        , m_ReadOffset(0)
+        , m_WriteOffset(0)
+        , m_Corrupted(false) {
+    }
+
+    bool FrameDecoder::Reserve(size_t length) {
+        if (m_Capacity - m_WriteOffset >= length)
+            return true;
+
+        size_t buffered = m_WriteOffset - m_ReadOffset;
+        if (m_Capacity - buffered < length)
+            return false;
+
+        memmove(m_Storage.get(), m_Storage.get() + m_ReadOffset, buffered);
+        m_ReadOffset = 0;
+        m_WriteOffset = buffered;
+
+        return true;
+    }
+
+    bool FrameDecoder::Append(const uint8_t *data, size_t length) {
+        auto room = Prepare(length);
+        if (room.size() != length)
+            return false;
+
+        memcpy(room.data(), data, length);
+        Commit(length);
+
+        return true;
+    }
+
+    std::span<uint8_t> FrameDecoder::Prepare(size_t length) {
+        if (length == 0 || !Reserve(length))
+            return {};
+
+        return {m_Storage.get() + m_WriteOffset, length};
+    }
+
+    void FrameDecoder::Commit(size_t length) {
+        m_WriteOffset += length;
+    }
+
+    std::optional<Frame> FrameDecoder::Next() {
+        const uint8_t *start = m_Storage.get() + m_ReadOffset;
+        size_t buffered = m_WriteOffset - m_ReadOffset;
+
+        if (buffered == 0 || m_Corrupted)
+            return std::nullopt;
+
+        auto [msg_length, len_offset] = decode_uvarint(start, buffered);
+
+        if (len_offset == -2) {
+            m_Corrupted = true;
+            return std::nullopt;
+        }
+
+        // We need to read some more to interpret the length of this message, or the message itself
+        if (len_offset < 0 || msg_length > buffered - len_offset)
+            return std::nullopt;
+
+        size_t frame_length = len_offset + msg_length;
+        m_ReadOffset += frame_length;
+
+        // Nothing left: the next append can start from the beginning again
+        if (m_ReadOffset == m_WriteOffset) {
+            m_ReadOffset = 0;
+            m_WriteOffset = 0;
+        }
+
+        return Frame{{start, frame_length}, static_cast<size_t>(len_offset)};
+    }
+
+    std::optional<PartialFrame> FrameDecoder::PeekPartial() const {
+        const uint8_t *start = m_Storage.get() + m_ReadOffset;
+        size_t buffered = m_WriteOffset - m_ReadOffset;
+
+        auto [msg_length, len_offset] = decode_uvarint(start, buffered);
+        if (len_offset < 0)
+            return std::nullopt;
+
+        size_t frame_length = len_offset + msg_length;
+        return PartialFrame{{start, std::min(buffered, frame_length)}, static_cast<size_t>(len_offset), frame_length};
+    }
+
+    void FrameDecoder::Consume(size_t length) {
+        m_ReadOffset += std::min(length, m_WriteOffset - m_ReadOffset);
+
+        if (m_ReadOffset == m_WriteOffset) {
+            m_ReadOffset = 0;
+            m_WriteOffset = 0;
+        }
+    }
+} // namespace dfs
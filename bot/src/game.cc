@@ -5,6 +5,7 @@
 #include <fmt/base.h>
 #include <fmt/color.h>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <rapidjson/document.h>
@@ -15,6 +16,7 @@
 
 #include "game.hh"
 #include "map.hh"
+#include "metrics.hh"
 #include "utils.hh"
 
 #define DO(ACTION_NAME, ACTION)                                                                                        \
@@ -164,10 +166,14 @@ namespace dfs
     std::unique_ptr<GameMap> GameData::GetMap(int32_t map_id) const {
         std::shared_ptr<std::vector<GameMapCell>> cells = nullptr;
 
+        std::unique_lock lock(m_MapCellsMutex);
+
         auto cells_cached = m_MapCells.find(map_id);
         if (cells_cached != m_MapCells.end()) {
             cells = cells_cached->second;
+            Metrics::Add(Counter::MapCacheHits, 1);
         } else {
+            Metrics::Add(Counter::MapCacheMisses, 1);
             cells = GetMapCells(map_id);
 
             for (auto &c : *cells) {
@@ -180,8 +186,12 @@ namespace dfs
             }
 
             m_MapCells.emplace(map_id, cells);
+            Metrics::Add(Counter::MapCacheMaps, 1);
+            Metrics::Add(Counter::MapCacheBytes, cells->capacity() * sizeof(GameMapCell));
         }
 
+        lock.unlock();
+
         auto it = m_WorldGraph.find(map_id);
         if (it == m_WorldGraph.end()) {
             fmt::println("Map {} is not in the worldgraph! Moving between maps will not be available.", map_id);
@@ -0,0 +1,372 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fmt/base.h>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "handoff.hh"
+
+namespace dfs
+{
+    // Sent by the new process when connecting. Both processes must agree on the snapshot format.
+    static constexpr const uint32_t HANDOFF_MAGIC = 0x6466736a;
+    static constexpr const uint32_t HANDOFF_VERSION = 4;
+
+    /// Sockets passed along a single record, at most (a session: client and server)
+    static constexpr const size_t MAX_RECORD_FDS = 2;
+
+    /// Neither process waits longer than this for the other one
+    static constexpr const timeval HANDOFF_TIMEOUT{10, 0};
+
+    struct Hello
+    {
+        uint32_t Magic;
+        uint32_t Version;
+    };
+
+    enum class RecordKind : uint32_t
+    {
+        Listener,
+        UnixListener,
+        ObserveListener,
+        Session,
+
+        /// Last record, its body is the process wide state
+        End,
+    };
+
+    /// Precedes the body of every record. The file descriptors are attached to it.
+    struct RecordHeader
+    {
+        RecordKind Kind;
+        uint32_t FdCount;
+        uint64_t Length;
+    };
+
+    static bool make_address(const std::string &path, sockaddr_un &address) {
+        if (path.size() >= sizeof(address.sun_path)) {
+            fmt::println(stderr, "Handoff socket path too long: {}", path);
+            return false;
+        }
+
+        address = {};
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    static bool send_all(int sock, const void *data, size_t length) {
+        auto bytes = static_cast<const uint8_t *>(data);
+
+        while (length > 0) {
+            ssize_t sent = send(sock, bytes, length, MSG_NOSIGNAL);
+
+            if (sent < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            bytes += sent;
+            length -= sent;
+        }
+
+        return true;
+    }
+
+    static bool receive_all(int sock, void *data, size_t length) {
+        auto bytes = static_cast<uint8_t *>(data);
+
+        while (length > 0) {
+            ssize_t received = recv(sock, bytes, length, MSG_WAITALL);
+
+            if (received <= 0) {
+                if (received < 0 && errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            bytes += received;
+            length -= received;
+        }
+
+        return true;
+    }
+
+    static bool send_record(int sock, RecordKind kind, const std::vector<int> &fds, const std::vector<uint8_t> &body) {
+        RecordHeader header{kind, static_cast<uint32_t>(fds.size()), body.size()};
+
+        iovec vector{&header, sizeof(header)};
+        msghdr message{};
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+
+        alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int) * MAX_RECORD_FDS)];
+
+        if (!fds.empty()) {
+            message.msg_control = control;
+            message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+            auto cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+            memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+        }
+
+        ssize_t sent;
+        do {
+            sent = sendmsg(sock, &message, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+
+        if (sent < 0)
+            return false;
+
+        // The descriptors went with the first byte, the rest of the header may follow without them
+        auto header_bytes = reinterpret_cast<const uint8_t *>(&header);
+        return send_all(sock, header_bytes + sent, sizeof(header) - sent) && send_all(sock, body.data(), body.size());
+    }
+
+    static bool receive_record(int sock, RecordHeader &header, std::vector<int> &fds, std::vector<uint8_t> &body) {
+        iovec vector{&header, sizeof(header)};
+        msghdr message{};
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+
+        alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int) * MAX_RECORD_FDS)];
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t received;
+        do {
+            received = recvmsg(sock, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+        } while (received < 0 && errno == EINTR);
+
+        if (received <= 0)
+            return false;
+
+        fds.clear();
+        for (auto cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            auto data = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+            fds.insert(fds.end(), data, data + count);
+        }
+
+        auto header_bytes = reinterpret_cast<uint8_t *>(&header);
+        bool ok = !(message.msg_flags & MSG_CTRUNC) &&
+                  receive_all(sock, header_bytes + received, sizeof(header) - received) &&
+                  fds.size() == header.FdCount;
+
+        if (ok) {
+            body.resize(header.Length);
+            ok = receive_all(sock, body.data(), body.size());
+        }
+
+        if (!ok) {
+            for (int fd : fds)
+                close(fd);
+
+            fds.clear();
+        }
+
+        return ok;
+    }
+
+    int ListenForSuccessor(const std::string &path) {
+        sockaddr_un address;
+        if (!make_address(path, address))
+            return -1;
+
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            perror("Handoff socket creation failed");
+            return -1;
+        }
+
+        // The previous process (if any) is done with it
+        unlink(path.c_str());
+
+        if (bind(sock, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(sock, 1) < 0) {
+            perror("Failed to listen on the handoff socket");
+            close(sock);
+            return -1;
+        }
+
+        return sock;
+    }
+
+    int AcceptSuccessor(int listen_sock) {
+        int sock = accept4(listen_sock, nullptr, nullptr, SOCK_CLOEXEC);
+        if (sock < 0)
+            return -1;
+
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &HANDOFF_TIMEOUT, sizeof(HANDOFF_TIMEOUT));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &HANDOFF_TIMEOUT, sizeof(HANDOFF_TIMEOUT));
+
+        Hello hello;
+        if (!receive_all(sock, &hello, sizeof(hello)) || hello.Magic != HANDOFF_MAGIC ||
+            hello.Version != HANDOFF_VERSION) {
+            fmt::println(stderr, "Incompatible process asked for a handoff, ignoring it");
+            close(sock);
+            return -1;
+        }
+
+        return sock;
+    }
+
+    int ConnectToPredecessor(const std::string &path) {
+        sockaddr_un address;
+        if (!make_address(path, address))
+            return -1;
+
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            perror("Handoff socket creation failed");
+            return -1;
+        }
+
+        // Nobody listening (or a stale socket left by a crash): there is nothing to take over
+        if (connect(sock, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            close(sock);
+            return -1;
+        }
+
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &HANDOFF_TIMEOUT, sizeof(HANDOFF_TIMEOUT));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &HANDOFF_TIMEOUT, sizeof(HANDOFF_TIMEOUT));
+
+        Hello hello{HANDOFF_MAGIC, HANDOFF_VERSION};
+        if (!send_all(sock, &hello, sizeof(hello))) {
+            close(sock);
+            return -1;
+        }
+
+        return sock;
+    }
+
+    bool SendHandoff(int sock, const Handoff &handoff) {
+        for (int listener : handoff.Listeners) {
+            if (!send_record(sock, RecordKind::Listener, {listener}, {}))
+                return false;
+        }
+
+        if (handoff.UnixListener >= 0 && !send_record(sock, RecordKind::UnixListener, {handoff.UnixListener}, {}))
+            return false;
+
+        if (handoff.ObserveListener >= 0 &&
+            !send_record(sock, RecordKind::ObserveListener, {handoff.ObserveListener}, {}))
+            return false;
+
+        for (const auto &session : handoff.Sessions) {
+            std::vector<int> fds{session.ClientFd};
+            if (session.ServerFd >= 0)
+                fds.push_back(session.ServerFd);
+
+            if (!send_record(sock, RecordKind::Session, fds, session.State))
+                return false;
+        }
+
+        SnapshotWriter writer;
+        writer.Write(handoff.Connected);
+
+        return send_record(sock, RecordKind::End, {}, writer.GetData());
+    }
+
+    std::optional<Handoff> ReceiveHandoff(int sock) {
+        Handoff handoff;
+
+        RecordHeader header;
+        std::vector<int> fds;
+        std::vector<uint8_t> body;
+
+        while (receive_record(sock, header, fds, body)) {
+            switch (header.Kind) {
+            case RecordKind::Listener:
+                if (fds.size() == 1) {
+                    handoff.Listeners.push_back(fds[0]);
+                    continue;
+                }
+
+                break;
+            case RecordKind::UnixListener:
+                if (fds.size() == 1 && handoff.UnixListener < 0) {
+                    handoff.UnixListener = fds[0];
+                    continue;
+                }
+
+                break;
+            case RecordKind::ObserveListener:
+                if (fds.size() == 1 && handoff.ObserveListener < 0) {
+                    handoff.ObserveListener = fds[0];
+                    continue;
+                }
+
+                break;
+            case RecordKind::Session:
+                if (fds.size() == 1 || fds.size() == 2) {
+                    SessionSnapshot session;
+                    session.ClientFd = fds[0];
+                    session.ServerFd = fds.size() == 2 ? fds[1] : -1;
+                    session.State = std::move(body);
+
+                    handoff.Sessions.push_back(std::move(session));
+                    continue;
+                }
+
+                break;
+            case RecordKind::End: {
+                SnapshotReader reader(body);
+                if (reader.Read(handoff.Connected))
+                    return handoff;
+            } break;
+            }
+
+            for (int fd : fds)
+                close(fd);
+
+            break;
+        }
+
+        fmt::println(stderr, "Handoff interrupted");
+        CloseHandoff(handoff);
+
+        return std::nullopt;
+    }
+
+    void CloseHandoff(Handoff &handoff) {
+        // Descriptors that were taken by someone else are set to -1
+        for (int listener : handoff.Listeners) {
+            if (listener >= 0)
+                close(listener);
+        }
+
+        for (int listener : {handoff.UnixListener, handoff.ObserveListener}) {
+            if (listener >= 0)
+                close(listener);
+        }
+
+        for (const auto &session : handoff.Sessions) {
+            for (int fd : {session.ClientFd, session.ServerFd}) {
+                if (fd >= 0)
+                    close(fd);
+            }
+        }
+
+        handoff.Listeners.clear();
+        handoff.UnixListener = -1;
+        handoff.ObserveListener = -1;
+        handoff.Sessions.clear();
+    }
+} // namespace dfs
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "latency-histogram.hh"
+
+namespace dfs
+{
+    size_t LatencyHistogram::IndexOf(uint64_t value) {
+        // Exact below the first power of two that gets split
+        if (value < SUB_BUCKETS)
+            return value;
+
+        unsigned exponent = std::bit_width(value) - 1;
+        if (exponent > MAX_EXPONENT)
+            return BUCKETS - 1;
+
+        auto sub_bucket = (value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+    }
+
+    uint64_t LatencyHistogram::ValueOf(size_t index) {
+        if (index < SUB_BUCKETS)
+            return index;
+
+        unsigned exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+        uint64_t width = uint64_t{1} << (exponent - SUB_BUCKET_BITS);
+        uint64_t lowest = (SUB_BUCKETS + index % SUB_BUCKETS) * width;
+
+        return lowest + width / 2;
+    }
+
+    void LatencySnapshot::Add(const LatencyHistogram &histogram) {
+        for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++) {
+            auto count = histogram.m_Counts[i].load(std::memory_order_relaxed);
+
+            m_Counts[i] += count;
+            m_Count += count;
+        }
+    }
+
+    uint64_t LatencySnapshot::GetPercentile(double quantile) const {
+        if (m_Count == 0)
+            return 0;
+
+        // Rank of the sample, starting at 1
+        auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * m_Count + 0.5));
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++) {
+            seen += m_Counts[i];
+            if (seen >= rank)
+                return LatencyHistogram::ValueOf(i);
+        }
+
+        return GetMax();
+    }
+
+    uint64_t LatencySnapshot::GetMax() const {
+        for (size_t i = LatencyHistogram::BUCKETS; i-- > 0;) {
+            if (m_Counts[i] > 0)
+                return LatencyHistogram::ValueOf(i);
+        }
+
+        return 0;
+    }
+
+    uint64_t LatencySnapshot::GetSum() const {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++)
+            sum += m_Counts[i] * LatencyHistogram::ValueOf(i);
+
+        return sum;
+    }
+
+    LatencyStats::LatencyStats(size_t kinds)
+        : m_Kinds(kinds)
+        , m_Frames(std::make_unique<LatencyHistogram[]>(STAGES * 2 * kinds))
+        , m_RoundTrips(std::make_unique<LatencyHistogram[]>(kinds))
+        , m_Unanswered(std::make_unique<std::atomic<uint64_t>[]>(kinds)) {
+    }
+} // namespace dfs
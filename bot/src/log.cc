@@ -0,0 +1,259 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fmt/base.h>
+#include <fmt/color.h>
+#include <fmt/format.h>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "log.hh"
+
+namespace dfs
+{
+    /// How long the logging thread sleeps when there is nothing to write
+    static constexpr const auto IDLE_PERIOD = std::chrono::milliseconds(2);
+
+    static std::mutex s_RingsMutex;
+    static std::vector<std::unique_ptr<LogRing>> s_Rings;
+    static std::thread s_Thread;
+
+    LogRing::LogRing()
+        : m_Storage(std::make_unique<uint8_t[]>(CAPACITY))
+        , m_Head(0)
+        , m_Tail(0)
+        , m_Reserved(0)
+        , m_Dropped(0)
+        , m_Limits{}
+        , m_Closed(false) {
+    }
+
+    uint8_t *LogRing::Reserve(size_t &size) {
+        size = (size + 7) & ~size_t{7};
+
+        auto head = m_Head.load(std::memory_order_relaxed);
+        auto offset = head % CAPACITY;
+
+        // Records never wrap around, the end of the storage is left unused instead
+        size_t padding = offset + size > CAPACITY ? CAPACITY - offset : 0;
+
+        if (size > MAX_RECORD_SIZE || head + padding + size - m_Tail.load(std::memory_order_acquire) > CAPACITY) {
+            m_Dropped.store(m_Dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        if (padding > 0) {
+            uint32_t end = 0;
+            memcpy(m_Storage.get() + offset, &end, sizeof(end));
+            offset = 0;
+        }
+
+        m_Reserved = head + padding + size;
+        return m_Storage.get() + offset;
+    }
+
+    bool LogRing::Admit(const char *call_site, int64_t now, uint32_t &suppressed) {
+        constexpr int64_t WINDOW = std::chrono::nanoseconds(std::chrono::seconds(1)).count();
+
+        auto hash = (reinterpret_cast<uintptr_t>(call_site) * 0x9E3779B97F4A7C15ull) >> 58;
+
+        for (size_t i = 0; i < RATE_LIMIT_SLOTS; i++) {
+            auto &limit = m_Limits[(hash + i) % RATE_LIMIT_SLOTS];
+
+            if (limit.CallSite == nullptr) {
+                limit.CallSite = call_site;
+                limit.WindowStart = now;
+            } else if (limit.CallSite != call_site) {
+                continue;
+            }
+
+            if (now - limit.WindowStart >= WINDOW) {
+                limit.WindowStart = now;
+                limit.Count = 0;
+            }
+
+            if (limit.Count == RATE_LIMIT) {
+                limit.Suppressed++;
+                return false;
+            }
+
+            limit.Count++;
+            suppressed = limit.Suppressed;
+            limit.Suppressed = 0;
+            return true;
+        }
+
+        // Too many call sites to keep track of
+        return true;
+    }
+
+    /// Appends a line as it is written: wall clock time, level, then the message.
+    static void format_line(fmt::memory_buffer &out, LogLevel level, int64_t timestamp, const fmt::text_style *style,
+                            std::string_view text, uint32_t suppressed) {
+        static constexpr const char LEVELS[] = {'T', 'D', 'I', 'W', 'E'};
+
+        auto seconds = static_cast<time_t>(timestamp / 1'000'000'000);
+        tm local{};
+        localtime_r(&seconds, &local);
+
+        fmt::format_to(std::back_inserter(out), "{:02}:{:02}:{:02}.{:06} {} ", local.tm_hour, local.tm_min,
+                       local.tm_sec, timestamp % 1'000'000'000 / 1000, LEVELS[static_cast<size_t>(level)]);
+
+        if (style != nullptr)
+            fmt::format_to(std::back_inserter(out), *style, "{}", text);
+        else
+            out.append(text);
+
+        if (suppressed > 0)
+            fmt::format_to(std::back_inserter(out), " ({} similar message{} suppressed)", suppressed,
+                           suppressed != 1 ? "s" : "");
+
+        out.push_back('\n');
+    }
+
+    static void write_out(fmt::memory_buffer &buffer, FILE *file) {
+        if (buffer.size() == 0)
+            return;
+
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        fflush(file);
+        buffer.clear();
+    }
+
+    LogRing &Log::GetRing() {
+        struct Owner
+        {
+            ~Owner() {
+                if (Ring != nullptr)
+                    Ring->Close();
+            }
+
+            LogRing *Ring = nullptr;
+        };
+
+        thread_local Owner owner;
+
+        if (owner.Ring == nullptr) {
+            auto ring = std::make_unique<LogRing>();
+            owner.Ring = ring.get();
+
+            std::lock_guard lock(s_RingsMutex);
+            s_Rings.push_back(std::move(ring));
+        }
+
+        return *owner.Ring;
+    }
+
+    int64_t Log::GetCoarseTime() {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+        return now.tv_sec * 1'000'000'000 + now.tv_nsec;
+    }
+
+    void Log::WriteNow(LogLevel level, const fmt::text_style *style, std::string_view text) {
+        auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+
+        fmt::memory_buffer line;
+        format_line(line, level, now, style, text, 0);
+        write_out(line, level >= LogLevel::Warning ? stderr : stdout);
+    }
+
+    bool Log::ParseLevel(std::string_view name, LogLevel &level) {
+        static constexpr const std::string_view NAMES[] = {"trace", "debug", "info", "warning", "error"};
+
+        for (size_t i = 0; i < std::size(NAMES); i++) {
+            if (name == NAMES[i]) {
+                level = static_cast<LogLevel>(i);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /// Writes what every ring holds. Returns whether there was anything.
+    static bool drain_rings() {
+        // Dropped messages already reported, per ring
+        static std::vector<uint64_t> s_Reported;
+
+        fmt::memory_buffer out;
+        fmt::memory_buffer err;
+        fmt::memory_buffer text;
+        bool any = false;
+
+        std::lock_guard lock(s_RingsMutex);
+        s_Reported.resize(s_Rings.size());
+
+        for (size_t i = 0; i < s_Rings.size(); i++) {
+            auto &ring = *s_Rings[i];
+
+            ring.Drain([&](const LogRecord &record, const uint8_t *arguments) {
+                text.clear();
+                record.Formatter(arguments, fmt::string_view(record.Format, record.FormatLength), text);
+
+                format_line(record.Level >= LogLevel::Warning ? err : out, record.Level, record.Timestamp,
+                            record.Styled ? &record.Style : nullptr, std::string_view(text.data(), text.size()),
+                            record.Suppressed);
+                any = true;
+            });
+
+            auto dropped = ring.GetDropped();
+            if (dropped > s_Reported[i]) {
+                auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+
+                auto message = fmt::format("{} log messages dropped, the logging thread could not keep up",
+                                           dropped - s_Reported[i]);
+                format_line(err, LogLevel::Warning, now, nullptr, message, 0);
+                s_Reported[i] = dropped;
+            }
+        }
+
+        // The threads of those are gone and everything they logged was written
+        for (size_t i = s_Rings.size(); i-- > 0;) {
+            if (s_Rings[i]->IsClosed() && s_Rings[i]->IsEmpty()) {
+                s_Rings.erase(s_Rings.begin() + i);
+                s_Reported.erase(s_Reported.begin() + i);
+            }
+        }
+
+        write_out(out, stdout);
+        write_out(err, stderr);
+
+        return any;
+    }
+
+    void Log::Start() {
+        if (s_Running.exchange(true))
+            return;
+
+        s_Thread = std::thread(&Log::Run);
+    }
+
+    void Log::Stop() {
+        if (!s_Running.exchange(false))
+            return;
+
+        s_Thread.join();
+    }
+
+    void Log::Run() {
+        while (s_Running.load(std::memory_order_relaxed)) {
+            if (!drain_rings())
+                std::this_thread::sleep_for(IDLE_PERIOD);
+        }
+
+        // What was logged right before stopping
+        while (drain_rings()) {
+        }
+    }
+} // namespace dfs
@@ -1,8 +1,8 @@
 #include <cmath>
 #include <cstdint>
-#include <fmt/base.h>
 #include <memory>
 
+#include "log.hh"
 #include "map.hh"
 #include "utils.hh"
 
@@ -156,8 +156,7 @@ namespace dfs
                 // This is the one
                 if (edge.Transitions.size() != 1) {
                     // What does this mean?
-                    fmt::println("Transition from {} to {} has {} steps", m_MapId, neighbor_id,
-                                 edge.Transitions.size());
+                    Log::Debug("Transition from {} to {} has {} steps", m_MapId, neighbor_id, edge.Transitions.size());
 
                     // Ignore
                     return nullptr;
@@ -0,0 +1,39 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <google/protobuf/arena.h>
+#include <memory>
+
+#include "message-arena.hh"
+
+namespace dfs
+{
+    MessageArena::MessageArena()
+        : m_BlockSize(0)
+        , m_HighWaterMark(0)
+        , m_Arena(std::make_unique<google::protobuf::Arena>()) {
+    }
+
+    MessageArena::~MessageArena() = default;
+
+    void MessageArena::Reset() {
+        // Our block counts as allocated: beyond it, the arena had to allocate more
+        auto allocated = static_cast<size_t>(m_Arena->Reset());
+        m_HighWaterMark = std::max(m_HighWaterMark, allocated);
+
+        if (allocated <= m_BlockSize || m_BlockSize == MAX_BLOCK_SIZE)
+            return;
+
+        auto size = std::clamp(std::bit_ceil(allocated), MIN_BLOCK_SIZE, MAX_BLOCK_SIZE);
+
+        m_Arena.reset();
+        m_Block = std::make_unique_for_overwrite<char[]>(size);
+        m_BlockSize = size;
+
+        google::protobuf::ArenaOptions options;
+        options.initial_block = m_Block.get();
+        options.initial_block_size = size;
+
+        m_Arena = std::make_unique<google::protobuf::Arena>(options);
+    }
+} // namespace dfs
@@ -1,30 +1,42 @@
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <connection/login_message.pb.h>
 #include <cstdint>
 #include <cstdlib>
-#include <fmt/base.h>
 #include <fmt/color.h>
-#include <fmt/core.h>
+#include <fmt/format.h>
+#include <game/basic.pb.h>
 #include <game/chat.pb.h>
 #include <game/common.pb.h>
 #include <game/game_message.pb.h>
 #include <game/gamemap.pb.h>
 #include <game/interactive_element.pb.h>
 #include <google/protobuf/any.pb.h>
+#include <google/protobuf/arena.h>
+#include <iterator>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unistd.h>
 
 #include "bot-state.hh"
 #include "bot.hh"
+#include "event-views.hh"
 #include "game.hh"
+#include "latency-histogram.hh"
+#include "log.hh"
 #include "map.hh"
 #include "messages.hh"
+#include "type-url-table.hh"
 #include "utils.hh"
+#include "wire.hh"
 
 namespace dfs
 {
-    static bool s_Connected = false;
+    // Process wide: the game connection following the login one may be handled by any worker
+    static std::atomic<bool> s_Connected = false;
 
     template <typename T>
     using ProtoVec = google::protobuf::RepeatedPtrField<T>;
@@ -33,147 +45,266 @@ namespace dfs
     using DofusInteractiveElement = com::ankama::dofus::server::game::protocol::common::InteractiveElement;
     using DofusStatedElement = com::ankama::dofus::server::game::protocol::common::StatedElement;
 
-    Messages::Messages() {
-        ReadBindings();
-    }
-
     static constexpr const auto MAP_MOVEMENT_REQUEST_TYPE_URL = "type.ankama.com/ifv";
     static constexpr const auto MAP_CHANGE_REQUEST_TYPE_URL = "type.ankama.com/iga";
     static constexpr const auto MAP_MOVEMENT_CONFIRM_REQUEST_TYPE_URL = "type.ankama.com/ifx";
     static constexpr const auto INTERACTIVE_USE_REQUEST_TYPE_URL = "type.ankama.com/hzk";
 
-    void Messages::ReadBindings() {
-        // Requests
-        m_RequestBindings.emplace(MAP_MOVEMENT_REQUEST_TYPE_URL, MapMovementRequest);
-        m_RequestBindings.emplace(MAP_MOVEMENT_CONFIRM_REQUEST_TYPE_URL, MapMovementConfirmRequest);
-        m_RequestBindings.emplace(MAP_CHANGE_REQUEST_TYPE_URL, MapChangeRequest);
-        m_RequestBindings.emplace("type.ankama.com/iyb", ChatChannelMessageRequest);
-        m_RequestBindings.emplace(INTERACTIVE_USE_REQUEST_TYPE_URL, InteractiveUseRequest);
-        m_RequestBindings.emplace("type.ankama.com/ige", MapInformationRequest);
-        m_RequestBindings.emplace("type.ankama.com/iwu", PingRequest);
-
-        // Responses
-        m_ResponseBindings.emplace("type.ankama.com/egj", MapMovementConfirmResponse);
-
-        // Events
-        m_EventBindings.emplace("type.ankama.com/igg", MapMovementEvent);
-        m_EventBindings.emplace("type.ankama.com/igh", MapChangeOrientationEvent);
-        m_EventBindings.emplace("type.ankama.com/igi", MapCurrentEvent);
-        m_EventBindings.emplace("type.ankama.com/igr", MapComplementaryInformationEvent);
-        m_EventBindings.emplace("type.ankama.com/igs", GameRolePlayShowActorsEvent);
-        m_EventBindings.emplace("type.ankama.com/iwv", PongEvent);
-        m_EventBindings.emplace("type.ankama.com/jps", TimeEvent);
-        m_EventBindings.emplace("type.ankama.com/iyp", CharacterCharacteristicsEvent);
-
-        // Chat events
-        m_EventBindings.emplace("type.ankama.com/iyc", ChatChannelMessageEvent);
-
-        m_EventBindings.emplace("type.ankama.com/hzm", TreasureHuntLegendaryEvent);
-        m_EventBindings.emplace("type.ankama.com/hem", TreasureHuntEvent);
-
-        // Collectibles events
-        m_EventBindings.emplace("type.ankama.com/hzn", InteractiveUseEndedEvent);
-        m_EventBindings.emplace("type.ankama.com/hzl", InteractiveUseErrorEvent);
-        m_EventBindings.emplace("type.ankama.com/hzq", InteractiveElementUpdatedEvent);
-        m_EventBindings.emplace("type.ankama.com/hzr", StatedElementUpdatedEvent);
+    size_t Messages::GetKind(GameMessagePeek::Kind content, std::string_view type_url) {
+        using Content = GameMessagePeek::Kind;
+
+        static constexpr const TypeUrlTable BINDINGS(
+            std::to_array<TypeUrlBinding>({
+                // Requests
+                {Content::Request, MAP_MOVEMENT_REQUEST_TYPE_URL, FIRST_REQUEST_KIND + MapMovementRequest},
+                {Content::Request, MAP_MOVEMENT_CONFIRM_REQUEST_TYPE_URL,
+                 FIRST_REQUEST_KIND + MapMovementConfirmRequest},
+                {Content::Request, MAP_CHANGE_REQUEST_TYPE_URL, FIRST_REQUEST_KIND + MapChangeRequest},
+                {Content::Request, "type.ankama.com/iyb", FIRST_REQUEST_KIND + ChatChannelMessageRequest},
+                {Content::Request, INTERACTIVE_USE_REQUEST_TYPE_URL, FIRST_REQUEST_KIND + InteractiveUseRequest},
+                {Content::Request, "type.ankama.com/ige", FIRST_REQUEST_KIND + MapInformationRequest},
+                {Content::Request, "type.ankama.com/iwu", FIRST_REQUEST_KIND + PingRequest},
+
+                // Responses
+                {Content::Response, "type.ankama.com/egj", FIRST_RESPONSE_KIND + MapMovementConfirmResponse},
+
+                // Events
+                {Content::Event, "type.ankama.com/igg", FIRST_EVENT_KIND + MapMovementEvent},
+                {Content::Event, "type.ankama.com/igh", FIRST_EVENT_KIND + MapChangeOrientationEvent},
+                {Content::Event, "type.ankama.com/igi", FIRST_EVENT_KIND + MapCurrentEvent},
+                {Content::Event, "type.ankama.com/igr", FIRST_EVENT_KIND + MapComplementaryInformationEvent},
+                {Content::Event, "type.ankama.com/igs", FIRST_EVENT_KIND + GameRolePlayShowActorsEvent},
+                {Content::Event, "type.ankama.com/iwv", FIRST_EVENT_KIND + PongEvent},
+                {Content::Event, "type.ankama.com/jps", FIRST_EVENT_KIND + TimeEvent},
+                {Content::Event, "type.ankama.com/iyp", FIRST_EVENT_KIND + CharacterCharacteristicsEvent},
+
+                // Chat events
+                {Content::Event, "type.ankama.com/iyc", FIRST_EVENT_KIND + ChatChannelMessageEvent},
+
+                {Content::Event, "type.ankama.com/hzm", FIRST_EVENT_KIND + TreasureHuntLegendaryEvent},
+                {Content::Event, "type.ankama.com/hem", FIRST_EVENT_KIND + TreasureHuntEvent},
+
+                // Collectibles events
+                {Content::Event, "type.ankama.com/hzn", FIRST_EVENT_KIND + InteractiveUseEndedEvent},
+                {Content::Event, "type.ankama.com/hzl", FIRST_EVENT_KIND + InteractiveUseErrorEvent},
+                {Content::Event, "type.ankama.com/hzq", FIRST_EVENT_KIND + InteractiveElementUpdatedEvent},
+                {Content::Event, "type.ankama.com/hzr", FIRST_EVENT_KIND + StatedElementUpdatedEvent},
+
+                // Combat events are not parsed but still disable the bot
+                {Content::Event, "type.ankama.com/jaz", COMBAT_KIND},
+            }),
+            UNBOUND_KIND);
+
+        return BINDINGS.Find(content, type_url);
     }
 
-    static std::vector<uint8_t> encode_uvarint(uint64_t value) {
-        std::vector<uint8_t> encoded;
-        encoded.reserve(sizeof(uint64_t) + value);
+    // In the order of the kinds, then of the enums
+    static constexpr const char *KIND_NAMES[] = {
+        "other",
+        "login",
+        "combat",
+        "MapMovementRequest",
+        "MapChangeRequest",
+        "ChatChannelMessageRequest",
+        "InteractiveUseRequest",
+        "MapMovementConfirmRequest",
+        "MapInformationRequest",
+        "PingRequest",
+        "MapMovementConfirmResponse",
+        "MapMovementEvent",
+        "ChatChannelMessageEvent",
+        "MapComplementaryInformationEvent",
+        "MapChangeOrientationEvent",
+        "MapCurrentEvent",
+        "GameRolePlayShowActorsEvent",
+        "InteractiveUsedEvent",
+        "InteractiveUseEndedEvent",
+        "InteractiveUseErrorEvent",
+        "StatedElementUpdatedEvent",
+        "InteractiveElementUpdatedEvent",
+        "TreasureHuntLegendaryEvent",
+        "TreasureHuntEvent",
+        "PongEvent",
+        "TimeEvent",
+        "CharacterCharacteristicsEvent",
+    };
+
+    static_assert(std::size(KIND_NAMES) == Messages::MESSAGE_KINDS);
+
+    const char *Messages::GetKindName(size_t kind) {
+        return kind < MESSAGE_KINDS ? KIND_NAMES[kind] : "?";
+    }
 
-        while (value >= 0x80) {
-            encoded.push_back(static_cast<uint8_t>(value) | 0x80);
-            value >>= 7;
-        }
+    /// Ends the stage that started with the previous lap, when tracing
+    static void lap(MessageTrace *trace, int64_t MessageTrace::*stage) {
+        if (trace == nullptr)
+            return;
+
+        auto now = monotonic_ns();
+        trace->*stage += now - trace->LapStart;
+        trace->LapStart = now;
+    }
 
-        encoded.push_back(static_cast<uint8_t>(value));
+    /// Replaces `frame` with `message` behind its length prefix.
+    static void encode_frame(const google::protobuf::MessageLite &message, std::vector<uint8_t> &frame) {
+        auto length = message.ByteSizeLong();
+        auto offset = WireWriter::VarintSize(length);
 
-        return encoded;
+        frame.resize(offset + length);
+        WireWriter(frame).WriteVarint(length);
+        message.SerializeWithCachedSizesToArray(frame.data() + offset);
     }
 
-    static bool HandleMapMovementRequest(const std::string &value, BotDescriptor *bot) {
-        using namespace com::ankama::dofus::server::game::protocol::gamemap;
+    // Field numbers from game_message.proto, google/protobuf/any.proto, gamemap.proto and interactive_element.proto
+    static constexpr const uint32_t GAME_MESSAGE_REQUEST_FIELD = 1;
+    static constexpr const uint32_t REQUEST_CONTENT_FIELD = 2;
+    static constexpr const uint32_t ANY_TYPE_URL_FIELD = 1;
+    static constexpr const uint32_t ANY_VALUE_FIELD = 2;
+    static constexpr const uint32_t MAP_MOVEMENT_REQUEST_KEY_CELLS_FIELD = 1;
+    static constexpr const uint32_t MAP_MOVEMENT_REQUEST_MAP_ID_FIELD = 2;
+    static constexpr const uint32_t MAP_MOVEMENT_REQUEST_CAUTIOUS_FIELD = 3;
+    static constexpr const uint32_t MAP_CHANGE_REQUEST_MAP_ID_FIELD = 1;
+    static constexpr const uint32_t MAP_CHANGE_REQUEST_AUTO_PILOT_FIELD = 2;
+    static constexpr const uint32_t INTERACTIVE_USE_REQUEST_ELEMENT_ID_FIELD = 1;
+    static constexpr const uint32_t INTERACTIVE_USE_REQUEST_SKILL_INSTANCE_UID_FIELD = 2;
+
+    /// Signed integers are sign extended
+    static constexpr uint64_t varint_of(int64_t value) {
+        return static_cast<uint64_t>(value);
+    }
 
-        if (bot->GetState().Active) {
-            fmt::println("Ignoring movement request. The bot is in control. Type 'stop' in the chat to regain "
-                         "control.");
-            return true;
-        }
+    /// Size of a scalar field of proto3 (not `optional`): left out when it is zero
+    static constexpr size_t scalar_field_size(uint32_t field, uint64_t value) {
+        return value != 0 ? WireWriter::VarintFieldSize(field, value) : 0;
+    }
 
-        MapMovementRequest req;
-        if (!req.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse MapMovementRequest");
-            return false;
-        }
+    static constexpr bool write_scalar_field(WireWriter &writer, uint32_t field, uint64_t value) {
+        return value == 0 || writer.WriteVarintField(field, value);
+    }
+
+    /// Length of the `Any` holding a request of type `type_url`, itself `request_length` bytes long
+    static constexpr size_t any_length(std::string_view type_url, size_t request_length) {
+        auto any = WireWriter::BytesFieldSize(ANY_TYPE_URL_FIELD, type_url.size());
+        if (request_length > 0)
+            any += WireWriter::BytesFieldSize(ANY_VALUE_FIELD, request_length);
+
+        return any;
+    }
+
+    /// Length of the frame of a `GameMessage` holding such a request (without uid)
+    static constexpr size_t request_frame_length(std::string_view type_url, size_t request_length) {
+        auto any = any_length(type_url, request_length);
+        auto request = WireWriter::BytesFieldSize(REQUEST_CONTENT_FIELD, any);
+        auto message = WireWriter::BytesFieldSize(GAME_MESSAGE_REQUEST_FIELD, request);
+
+        return WireWriter::VarintSize(message) + message;
+    }
+
+    /// Writes the frame of `request_frame_length` up to the request, whose `request_length` bytes come next.
+    static constexpr bool write_request_header(WireWriter &writer, std::string_view type_url, size_t request_length) {
+        auto any = any_length(type_url, request_length);
+        auto request = WireWriter::BytesFieldSize(REQUEST_CONTENT_FIELD, any);
 
-        fmt::println("MapMovementRequest:");
+        return writer.WriteVarint(WireWriter::BytesFieldSize(GAME_MESSAGE_REQUEST_FIELD, request)) &&
+               writer.WriteLength(GAME_MESSAGE_REQUEST_FIELD, request) &&
+               writer.WriteLength(REQUEST_CONTENT_FIELD, any) && writer.WriteBytesField(ANY_TYPE_URL_FIELD, type_url) &&
+               (request_length == 0 || writer.WriteLength(ANY_VALUE_FIELD, request_length));
+    }
+
+    /// Returns the length of the frame written by `writer`, zero if it did not fit.
+    static size_t frame_length(const WireWriter &writer) {
+        return writer.HasFailed() ? 0 : writer.GetSize();
+    }
+
+    static constexpr const auto MAP_MOVEMENT_CONFIRM_REQUEST_FRAME = [] {
+        std::array<uint8_t, request_frame_length(MAP_MOVEMENT_CONFIRM_REQUEST_TYPE_URL, 0)> frame{};
 
+        WireWriter writer(frame);
+        write_request_header(writer, MAP_MOVEMENT_CONFIRM_REQUEST_TYPE_URL, 0);
+
+        return frame;
+    }();
+
+    /// Logs the path the game asked for next to the one we find between the same cells, and whether they match.
+    static void log_path_check(const com::ankama::dofus::server::game::protocol::gamemap::MapMovementRequest &req,
+                               BotDescriptor *bot) {
         auto map = bot->GetState().CurrentMap.get();
         auto first_map_cell = PathElement::FromCompressed(req.key_cells(0));
         auto last_map_cell = PathElement::FromCompressed(req.key_cells(req.key_cells_size() - 1));
         auto path = map->GetShortestPath(first_map_cell.CellId, last_map_cell.CellId, true);
 
-        fmt::print("  key_cells:");
-        for (size_t i = 0; i < path.size(); i++) {
-            fmt::print(" {} -> {}, ", path[i].CellId, (int)path[i].Dir);
-        }
-        fmt::print("\n");
+        fmt::memory_buffer ours;
+        for (size_t i = 0; i < path.size(); i++)
+            fmt::format_to(std::back_inserter(ours), " {} -> {}, ", path[i].CellId, (int)path[i].Dir);
 
-        // Key cells
-        fmt::print("  key_cells:");
+        fmt::memory_buffer theirs;
         for (int i = 0; i < req.key_cells_size(); i++) {
             auto map_cell = PathElement::FromCompressed(req.key_cells(i));
-            fmt::print(" {} -> {}, ", map_cell.CellId, static_cast<int>(map_cell.Dir));
+            fmt::format_to(std::back_inserter(theirs), " {} -> {}, ", map_cell.CellId, static_cast<int>(map_cell.Dir));
         }
 
-        fmt::println("\n");
+        Log::Debug("  key_cells:{}", std::string_view(ours.data(), ours.size()));
+        Log::Debug("  key_cells:{}", std::string_view(theirs.data(), theirs.size()));
 
-        if ((int)path.size() != req.key_cells_size()) {
-            fmt::print(fmt::fg(fmt::color::orange_red), "==== [KO] ==== Paths don't match\n");
-        } else {
-            auto i = 0;
-            for (; i < req.key_cells_size(); i++) {
-                if (req.key_cells(i) != path[i].ToCompressed()) {
-                    break;
-                }
-            }
+        bool match = (int)path.size() == req.key_cells_size();
+        for (int i = 0; match && i < req.key_cells_size(); i++)
+            match = req.key_cells(i) == path[i].ToCompressed();
 
-            if (i != req.key_cells_size()) {
-                fmt::print(fmt::fg(fmt::color::orange_red), "==== [KO] ==== Paths don't match\n");
-            } else {
-                fmt::print(fmt::fg(fmt::color::lime_green), "==== [OK] ==== Paths match\n");
-            }
+        if (match)
+            Log::Debug(fmt::fg(fmt::color::lime_green), "==== [OK] ==== Paths match");
+        else
+            Log::Debug(fmt::fg(fmt::color::orange_red), "==== [KO] ==== Paths don't match");
+    }
+
+    static bool HandleMapMovementRequest(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
+        using namespace com::ankama::dofus::server::game::protocol::gamemap;
+
+        if (bot->GetState().Active) {
+            Log::Debug("Ignoring movement request. The bot is in control. Type 'stop' in the chat to regain "
+                       "control.");
+            return true;
+        }
+
+        auto &req = *google::protobuf::Arena::CreateMessage<MapMovementRequest>(arena);
+        if (!req.ParseFromString(value)) {
+            Log::Warning("Failed to parse MapMovementRequest");
+            return false;
         }
 
+        Log::Debug("MapMovementRequest:");
+
+        // Only worth it when someone reads the result
+        if (Log::IsEnabled(LogLevel::Debug))
+            log_path_check(req, bot);
+
         // Map id
-        fmt::println("  map_id: {}", req.map_id());
+        Log::Debug("  map_id: {}", req.map_id());
 
         // Cautious
-        fmt::println("  cautious: {}", req.cautious());
+        Log::Debug("  cautious: {}", req.cautious());
 
         return false;
     }
 
-    static bool HandleMapChangeRequest(const std::string &value, BotDescriptor *bot) {
+    static bool HandleMapChangeRequest(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::gamemap;
 
         if (bot->GetState().Active) {
-            fmt::println("Ignoring map change request.");
+            Log::Debug("Ignoring map change request.");
             return true;
         }
 
-        MapChangeRequest req;
+        auto &req = *google::protobuf::Arena::CreateMessage<MapChangeRequest>(arena);
         if (!req.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse MapChangeRequest");
+            Log::Warning("Failed to parse MapChangeRequest");
             return false;
         }
 
         bot->GetState().ChangingMaps = true;
 
-        fmt::println("MapChangeRequest:");
-        fmt::println("  map_id: {}", req.map_id());
-        fmt::println("  autopilot: {}", req.auto_pilot());
+        Log::Debug("MapChangeRequest:");
+        Log::Debug("  map_id: {}", req.map_id());
+        Log::Debug("  autopilot: {}", req.auto_pilot());
         return false;
     }
 
@@ -184,7 +315,7 @@ namespace dfs
         if (state.Active)
             return true;
 
-        fmt::println("Movement confirm request:");
+        Log::Debug("Movement confirm request:");
 
         state.CurrentPlayer.Moving = false;
         state.CurrentPlayer.CurrentCell = state.CurrentPlayer.TargetCell;
@@ -193,20 +324,21 @@ namespace dfs
         return false;
     }
 
-    static void HandleInteractiveUseRequest(const std::string &value, BotDescriptor *bot) {
+    static void HandleInteractiveUseRequest(const std::string &value, BotDescriptor *bot,
+                                            google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::interactive;
 
-        element::InteractiveUseRequest req;
+        auto &req = *google::protobuf::Arena::CreateMessage<element::InteractiveUseRequest>(arena);
         if (!req.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse InteractiveUseRequest");
+            Log::Warning("Failed to parse InteractiveUseRequest");
             return;
         }
 
-        fmt::println("InteractiveUseRequest:");
-        fmt::println("  element_id: {}", req.element_id());
-        fmt::println("  skill_instance_uid: {}", req.skill_instance_uid());
+        Log::Debug("InteractiveUseRequest:");
+        Log::Debug("  element_id: {}", req.element_id());
+        Log::Debug("  skill_instance_uid: {}", req.skill_instance_uid());
         if (req.specific_instance_id()) {
-            fmt::println("  specific_instance_id: {}", req.specific_instance_id());
+            Log::Debug("  specific_instance_id: {}", req.specific_instance_id());
         }
 
         auto &state = bot->GetState();
@@ -215,32 +347,32 @@ namespace dfs
         bot->MarkUpdated();
     }
 
-    static bool HandleChatMessageRequest(const std::string &value, BotDescriptor *bot) {
+    static bool HandleChatMessageRequest(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::chat;
 
-        ChatChannelMessageRequest req;
+        auto &req = *google::protobuf::Arena::CreateMessage<ChatChannelMessageRequest>(arena);
         if (!req.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse ChatChannelMessageRequest");
+            Log::Warning("Failed to parse ChatChannelMessageRequest");
             return false;
         }
 
-        fmt::println("Chat channel message request:");
-        fmt::println("  channel: {}", (int)req.channel());
-        fmt::println("  message: {}", req.content());
+        Log::Debug("Chat channel message request:");
+        Log::Debug("  channel: {}", (int)req.channel());
+        Log::Debug("  message: {}", req.content());
 
         auto &state = bot->GetState();
         bool updated = false;
 
         if (req.content() == "start") {
-            fmt::println("Manually starting bot");
+            Log::Debug("Manually starting bot");
             state.Active = true;
             updated = true;
         } else if (req.content() == "stop") {
-            fmt::println("Manually stopping bot");
+            Log::Debug("Manually stopping bot");
             state.Active = false;
             updated = true;
         } else if (req.content() == "skip") {
-            fmt::println("Clearing the collectible list");
+            Log::Debug("Clearing the collectible list");
             // Clear the list of collectibles to skip collecting this map
             state.Collectibles.clear();
             updated = true;
@@ -256,58 +388,59 @@ namespace dfs
         return updated;
     }
 
-    bool Messages::ParseRequest(const com::ankama::dofus::server::game::protocol::Request &request,
-                                BotDescriptor *bot) const {
+    FrameAction Messages::ParseRequest(com::ankama::dofus::server::game::protocol::Request &request,
+                                       BotDescriptor *bot, google::protobuf::Arena *arena) const {
         using namespace com::ankama::dofus::server::game::protocol;
 
-        auto req = m_RequestBindings.find(request.content().type_url());
-        if (req == m_RequestBindings.end()) {
-            fmt::println("  REQ {} ({})", request.content().type_url(), request.content().value().length());
-            return false;
+        auto kind = GetKind(GameMessagePeek::Kind::Request, request.content().type_url());
+        if (kind == UNBOUND_KIND) {
+            Log::Debug("  REQ {} ({})", request.content().type_url(), request.content().value().length());
+            return FrameAction::Forward;
         }
 
         auto cancel_request = false;
 
-        switch (req->second) {
+        switch (static_cast<Request>(kind - FIRST_REQUEST_KIND)) {
         case MapMovementRequest:
-            cancel_request = HandleMapMovementRequest(request.content().value(), bot);
+            cancel_request = HandleMapMovementRequest(request.content().value(), bot, arena);
             break;
         case MapChangeRequest:
-            cancel_request = HandleMapChangeRequest(request.content().value(), bot);
+            cancel_request = HandleMapChangeRequest(request.content().value(), bot, arena);
             break;
         case ChatChannelMessageRequest:
-            cancel_request = HandleChatMessageRequest(request.content().value(), bot);
+            cancel_request = HandleChatMessageRequest(request.content().value(), bot, arena);
             break;
         case InteractiveUseRequest:
-            HandleInteractiveUseRequest(request.content().value(), bot);
+            HandleInteractiveUseRequest(request.content().value(), bot, arena);
             break;
         case MapMovementConfirmRequest:
             cancel_request = HandleMapMovementConfirmRequest(bot);
             break;
         case MapInformationRequest:
-            fmt::println("MapInformationRequest");
+            Log::Debug("MapInformationRequest");
             break;
         case PingRequest:
-            fmt::println("Ping Request");
+            Log::Debug("Ping Request");
+            bot->GetState().Clock.OnPingSent(std::chrono::high_resolution_clock::now());
             break;
         }
 
-        return cancel_request;
+        return cancel_request ? FrameAction::Cancel : FrameAction::Forward;
     }
 
     void Messages::ParseResponse(const com::ankama::dofus::server::game::protocol::Response &response,
                                  BotDescriptor *bot) const {
         using namespace com::ankama::dofus::server::game::protocol;
 
-        auto res = m_ResponseBindings.find(response.content().type_url());
-        if (res == m_ResponseBindings.end()) {
-            fmt::println("  RES {} ({})", response.content().type_url(), response.content().value().length());
+        auto kind = GetKind(GameMessagePeek::Kind::Response, response.content().type_url());
+        if (kind == UNBOUND_KIND) {
+            Log::Debug("  RES {} ({})", response.content().type_url(), response.content().value().length());
             return;
         }
 
-        switch (res->second) {
+        switch (static_cast<Response>(kind - FIRST_RESPONSE_KIND)) {
         case MapMovementConfirmResponse: {
-            fmt::println("Position confirmed");
+            Log::Debug("Position confirmed");
 
             auto &state = bot->GetState();
             state.CurrentPlayer.Moving = false;
@@ -318,12 +451,12 @@ namespace dfs
         }
     }
 
-    static void HandleChatChannelMessageEvent(const std::string &value) {
+    static void HandleChatChannelMessageEvent(const std::string &value, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::chat;
 
-        ChatChannelMessageEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<ChatChannelMessageEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse ChatChannelMessageEvent");
+            Log::Warning("Failed to parse ChatChannelMessageEvent");
             return;
         }
 
@@ -360,195 +493,250 @@ namespace dfs
             break;
         }
 
-        fmt::println("Received chat message on channel: {}: {}", channel, evt.content());
+        Log::Debug("Received chat message on channel: {}: {}", channel, evt.content());
     }
 
-    static void HandleMapMovementEvent(const std::string &value, BotDescriptor *bot) {
-        using namespace com::ankama::dofus::server::game::protocol::gamemap;
-
-        MapMovementEvent evt;
-        if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse MapMovementEvent");
-            return;
-        }
+    /// Paths longer than that are left to the full parse
+    static constexpr const size_t MAX_PATH_CELLS = GameMap::MAP_WIDTH * GameMap::MAP_HEIGHT * 2;
 
-        if (evt.cells().size() < 2) {
+    static void MoveActor(int64_t id, std::span<const int32_t> cells, bool cautious, BotDescriptor *bot) {
+        if (cells.size() < 2) {
             // You're not moving
             return;
         }
 
-        std::vector<int32_t> cells;
-        cells.reserve(evt.cells().size());
-
-        for (auto i = 0; i < evt.cells().size(); i++)
-            cells.push_back(evt.cells(i));
-
         auto &state = bot->GetState();
 
-        auto arrival_time = std::chrono::high_resolution_clock::now();
-        arrival_time += GetMovementDuration(cells, evt.cautious());
+        // The server started the movement when it sent the event
+        auto arrival_time = state.Clock.GetSentAt(std::chrono::high_resolution_clock::now());
+        arrival_time += GetMovementDuration(cells, cautious);
 
-        if (state.CurrentPlayer.Id == evt.character_id()) {
+        if (state.CurrentPlayer.Id == id) {
             // It's us
             state.CurrentPlayer.Moving = true;
-            state.CurrentPlayer.CurrentCell = evt.cells(0);
-            state.CurrentPlayer.TargetCell = evt.cells(evt.cells().size() - 1);
+            state.CurrentPlayer.CurrentCell = cells.front();
+            state.CurrentPlayer.TargetCell = cells.back();
             state.CurrentPlayer.ArrivalTime = arrival_time;
-        } else if (state.OtherPlayers.find(evt.character_id()) != state.OtherPlayers.end()) {
+        } else if (state.OtherPlayers.find(id) != state.OtherPlayers.end()) {
             // It's some rando
-            auto other = &state.OtherPlayers.find(evt.character_id())->second;
+            auto other = &state.OtherPlayers.find(id)->second;
             other->Moving = true;
-            other->CurrentCell = evt.cells(0);
-            other->TargetCell = evt.cells(evt.cells().size() - 1);
+            other->CurrentCell = cells.front();
+            other->TargetCell = cells.back();
             other->ArrivalTime = arrival_time;
-        } else if (state.Monsters.find(evt.character_id()) != state.Monsters.end()) {
-            auto monster = &state.Monsters.find(evt.character_id())->second;
+        } else if (state.Monsters.find(id) != state.Monsters.end()) {
+            auto monster = &state.Monsters.find(id)->second;
             monster->Moving = true;
-            monster->CurrentCell = evt.cells(0);
-            monster->TargetCell = evt.cells(evt.cells().size() - 1);
+            monster->CurrentCell = cells.front();
+            monster->TargetCell = cells.back();
             monster->ArrivalTime = arrival_time;
         } else {
-            fmt::println("Character {} is not on the map?", evt.character_id());
+            Log::Debug("Character {} is not on the map?", id);
             return;
         }
 
         // Move the actor
-        if (state.Actors.find(evt.character_id()) != state.Actors.end()) {
-            auto actor = &state.Actors.find(evt.character_id())->second;
+        if (state.Actors.find(id) != state.Actors.end()) {
+            auto actor = &state.Actors.find(id)->second;
             actor->Moving = true;
-            actor->CurrentCell = evt.cells(0);
-            actor->TargetCell = evt.cells(evt.cells().size() - 1);
+            actor->CurrentCell = cells.front();
+            actor->TargetCell = cells.back();
             actor->ArrivalTime = arrival_time;
         }
 
-        bot->MarkUpdated(arrival_time);
+        // Our confirmation must reach the server right when we arrive
+        if (state.CurrentPlayer.Id == id)
+            bot->MarkUpdated(state.Clock.GetSendTime(arrival_time));
+        else
+            bot->MarkUpdated(arrival_time);
     }
 
-    static void RegisterMonster(const DofusActorPositionInformation &actor, BotState &state) {
-        Monster m{};
-        m.Id = actor.actor_id();
+    static void HandleMapMovementEvent(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
+        using namespace com::ankama::dofus::server::game::protocol::gamemap;
 
-        if (!actor.disposition().has_cell_id())
-            return; // What the hell maaaaaan?
+        auto &evt = *google::protobuf::Arena::CreateMessage<MapMovementEvent>(arena);
+        if (!evt.ParseFromString(value)) {
+            Log::Warning("Failed to parse MapMovementEvent");
+            return;
+        }
 
-        m.CurrentCell = actor.disposition().cell_id();
+        MoveActor(evt.character_id(), std::span(evt.cells().data(), evt.cells().size()), evt.cautious(), bot);
+    }
 
-        auto identification = actor.actor_information().role_play_actor().monster_group_actor().identification();
+    static bool HandleMapMovementEventView(std::string_view value, BotDescriptor *bot) {
+        auto evt = MapMovementEventView::Read(value);
+        if (!evt || evt->GetCellCount() > MAX_PATH_CELLS)
+            return false;
+
+        std::array<int32_t, MAX_PATH_CELLS> buffer;
+        auto cells = evt->GetCells(buffer);
+        if (cells.size() != evt->GetCellCount())
+            return false;
+
+        MoveActor(evt->GetCharacterId(), cells, evt->IsCautious(), bot);
+        return true;
+    }
 
-        m.EnnemyCount = 1; // The main creature
-        m.EnnemyCount += identification.underlings_size();
+    static void RegisterMonster(const ActorSummary &actor, BotState &state) {
+        Monster m{};
+        m.Id = actor.Id;
 
-        m.TotalLevel = identification.main_creature().level();
+        if (!actor.CellId)
+            return; // What the hell maaaaaan?
 
-        for (auto i = 0; i < identification.underlings_size(); i++)
-            m.TotalLevel += identification.underlings(i).level();
+        m.CurrentCell = *actor.CellId;
+        m.EnnemyCount = actor.EnnemyCount;
+        m.TotalLevel = actor.TotalLevel;
 
         state.Monsters.emplace(m.Id, m);
     }
 
-    static void RegisterGenericActor(const DofusActorPositionInformation &actor, BotState &state) {
+    static void RegisterGenericActor(const ActorSummary &actor, BotState &state) {
         GenericActor a{};
-        a.Id = actor.actor_id();
+        a.Id = actor.Id;
 
-        if (!actor.disposition().has_cell_id())
+        if (!actor.CellId)
             return; // What the hell maaaaaan?
 
-        a.CurrentCell = actor.disposition().cell_id();
+        a.CurrentCell = *actor.CellId;
 
         state.Actors.emplace(a.Id, a);
     }
 
-    static void RegisterNPC(const DofusActorPositionInformation &actor, BotState &state) {
+    static void RegisterNPC(const ActorSummary &actor, BotState &state) {
         GenericActor npc{};
-        npc.Id = actor.actor_id();
+        npc.Id = actor.Id;
 
-        if (!actor.disposition().has_cell_id())
+        if (!actor.CellId)
             return; // What the hell maaaaaan?
 
-        npc.CurrentCell = actor.disposition().cell_id();
+        npc.CurrentCell = *actor.CellId;
 
         state.NPCs.emplace(npc.Id, npc);
     }
 
-    static void RegisterPlayer(const DofusActorPositionInformation &actor, BotState &state) {
-        if (actor.actor_id() == state.CurrentPlayer.Id) {
-            state.CurrentPlayer.CurrentCell = actor.disposition().cell_id();
+    static void RegisterPlayer(const ActorSummary &actor, BotState &state) {
+        if (actor.Id == state.CurrentPlayer.Id) {
+            state.CurrentPlayer.CurrentCell = actor.CellId.value_or(0);
             return;
         }
 
         Player p{};
-        p.Id = actor.actor_id();
+        p.Id = actor.Id;
 
-        if (!actor.disposition().has_cell_id())
+        if (!actor.CellId)
             return; // What the hell maaaaaan?
 
-        p.CurrentCell = actor.disposition().cell_id();
-
-        auto named_actor = actor.actor_information().role_play_actor().named_actor();
-
-        p.Name = named_actor.name();
+        p.CurrentCell = *actor.CellId;
+        p.Name = actor.Name;
 
         state.OtherPlayers.emplace(p.Id, p);
     }
 
-    static bool RegisterActors(const ProtoVec<DofusActorPositionInformation> &actors, BotDescriptor *bot) {
-        using namespace com::ankama::dofus::server::game::protocol::common;
+    /// Returns false if the actor came without information, and was ignored.
+    static bool RegisterActor(const ActorSummary &actor, BotState &state) {
+        if (actor.Type == ActorSummary::Kind::None)
+            return false;
 
-        bool modified = false;
+        RegisterGenericActor(actor, state);
 
-        if (actors.size() == 0)
-            return modified;
+        switch (actor.Type) {
+        case ActorSummary::Kind::Player:
+            RegisterPlayer(actor, state);
+            break;
+        case ActorSummary::Kind::Monster:
+            RegisterMonster(actor, state);
+            break;
+        case ActorSummary::Kind::Npc:
+            RegisterNPC(actor, state);
+            break;
+        case ActorSummary::Kind::None:
+        case ActorSummary::Kind::Other:
+            break;
+        }
 
-        auto &state = bot->GetState();
+        return true;
+    }
 
-        if (state.CurrentMap == nullptr)
-            return modified;
+    static ActorSummary SummarizeActor(const DofusActorPositionInformation &actor) {
+        using namespace com::ankama::dofus::server::game::protocol::common;
 
-        for (auto i = 0; i < actors.size(); i++) {
-            auto actor = actors.at(i);
+        ActorSummary summary;
+        summary.Id = actor.actor_id();
 
-            if (!actor.has_actor_information())
-                continue;
+        if (actor.disposition().has_cell_id())
+            summary.CellId = actor.disposition().cell_id();
 
-            RegisterGenericActor(actor, state);
-            modified = true;
+        if (!actor.has_actor_information())
+            return summary;
 
-            // Isn't that pretty?
-            switch (actor.actor_information().information_case()) {
-            case ActorPositionInformation_ActorInformation::kRolePlayActor:
-                switch (actor.actor_information().role_play_actor().actor_case()) {
-                case ActorPositionInformation_ActorInformation_RolePlayActor::kNamedActor:
-                    switch (actor.actor_information().role_play_actor().named_actor().actor_case()) {
-                    case ActorPositionInformation_ActorInformation_RolePlayActor_NamedActor::kHumanoidInformation:
-                        RegisterPlayer(actor, state);
-                        break;
-                    case ActorPositionInformation_ActorInformation_RolePlayActor_NamedActor::kMountInformation:
-                        break;
-                    case ActorPositionInformation_ActorInformation_RolePlayActor_NamedActor::ACTOR_NOT_SET:
-                        break;
-                    }
-                    break;
-                case ActorPositionInformation_ActorInformation_RolePlayActor::kTaxCollectorActor:
-                case ActorPositionInformation_ActorInformation_RolePlayActor::kMonsterGroupActor:
-                    RegisterMonster(actor, state);
+        summary.Type = ActorSummary::Kind::Other;
+
+        // Isn't that pretty?
+        switch (actor.actor_information().information_case()) {
+        case ActorPositionInformation_ActorInformation::kRolePlayActor:
+            switch (actor.actor_information().role_play_actor().actor_case()) {
+            case ActorPositionInformation_ActorInformation_RolePlayActor::kNamedActor:
+                switch (actor.actor_information().role_play_actor().named_actor().actor_case()) {
+                case ActorPositionInformation_ActorInformation_RolePlayActor_NamedActor::kHumanoidInformation:
+                    summary.Type = ActorSummary::Kind::Player;
+                    summary.Name = actor.actor_information().role_play_actor().named_actor().name();
                     break;
-                case ActorPositionInformation_ActorInformation_RolePlayActor::kNpcActor:
-                    RegisterNPC(actor, state);
+                case ActorPositionInformation_ActorInformation_RolePlayActor_NamedActor::kMountInformation:
                     break;
-                case ActorPositionInformation_ActorInformation_RolePlayActor::kPrismActor:
-                case ActorPositionInformation_ActorInformation_RolePlayActor::kPortalActor:
-                case ActorPositionInformation_ActorInformation_RolePlayActor::kTreasureHuntNpcId:
-                case ActorPositionInformation_ActorInformation_RolePlayActor::ACTOR_NOT_SET:
+                case ActorPositionInformation_ActorInformation_RolePlayActor_NamedActor::ACTOR_NOT_SET:
                     break;
                 }
-            case ActorPositionInformation_ActorInformation::kFighter:
-                // Wtf is this? Maybe some info when we are in combat?
                 break;
-            case ActorPositionInformation_ActorInformation::INFORMATION_NOT_SET:
+            case ActorPositionInformation_ActorInformation_RolePlayActor::kTaxCollectorActor:
+            case ActorPositionInformation_ActorInformation_RolePlayActor::kMonsterGroupActor: {
+                auto &identification =
+                    actor.actor_information().role_play_actor().monster_group_actor().identification();
+
+                summary.Type = ActorSummary::Kind::Monster;
+                summary.EnnemyCount = 1; // The main creature
+                summary.EnnemyCount += identification.underlings_size();
+
+                summary.TotalLevel = identification.main_creature().level();
+
+                for (auto i = 0; i < identification.underlings_size(); i++)
+                    summary.TotalLevel += identification.underlings(i).level();
+                break;
+            }
+            case ActorPositionInformation_ActorInformation_RolePlayActor::kNpcActor:
+                summary.Type = ActorSummary::Kind::Npc;
+                break;
+            case ActorPositionInformation_ActorInformation_RolePlayActor::kPrismActor:
+            case ActorPositionInformation_ActorInformation_RolePlayActor::kPortalActor:
+            case ActorPositionInformation_ActorInformation_RolePlayActor::kTreasureHuntNpcId:
+            case ActorPositionInformation_ActorInformation_RolePlayActor::ACTOR_NOT_SET:
                 break;
             }
+            break;
+        case ActorPositionInformation_ActorInformation::kFighter:
+            // Wtf is this? Maybe some info when we are in combat?
+            break;
+        case ActorPositionInformation_ActorInformation::INFORMATION_NOT_SET:
+            break;
         }
 
+        return summary;
+    }
+
+    static bool RegisterActors(const ProtoVec<DofusActorPositionInformation> &actors, BotDescriptor *bot) {
+        bool modified = false;
+
+        if (actors.size() == 0)
+            return modified;
+
+        auto &state = bot->GetState();
+
+        if (state.CurrentMap == nullptr)
+            return modified;
+
+        for (const auto &actor : actors)
+            modified |= RegisterActor(SummarizeActor(actor), state);
+
         return modified;
     }
 
@@ -628,12 +816,13 @@ namespace dfs
         return modified;
     }
 
-    static void HandleMapComplementaryInformationEvent(const std::string &value, BotDescriptor *bot) {
+    static void HandleMapComplementaryInformationEvent(const std::string &value, BotDescriptor *bot,
+                                                       google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::gamemap;
 
-        MapComplementaryInformationEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<MapComplementaryInformationEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse map complementary info");
+            Log::Warning("Failed to parse map complementary info");
             return;
         }
 
@@ -647,25 +836,25 @@ namespace dfs
 
         if (evt.obstacles_size() > 0) {
             // We have fuking obstacles. What even is this shit?
-            fmt::println("  obstacles #: {}", evt.obstacles_size());
+            Log::Debug("  obstacles #: {}", evt.obstacles_size());
         }
 
-        fmt::println("There are {} players, {} monster groups, {} interactive elements",
-                     bot->GetState().OtherPlayers.size(), bot->GetState().Monsters.size(),
-                     bot->GetState().Collectibles.size());
+        Log::Debug("There are {} players, {} monster groups, {} interactive elements",
+                   bot->GetState().OtherPlayers.size(), bot->GetState().Monsters.size(),
+                   bot->GetState().Collectibles.size());
 
         if (modified)
             bot->MarkUpdated();
     }
 
-    void HandleMapChangeOrientationEvent(const std::string &value, BotDescriptor *bot) {
+    void HandleMapChangeOrientationEvent(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::gamemap;
 
         // Note: this happens when someone changes map
 
-        MapChangeOrientationEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<MapChangeOrientationEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse map change orientation event");
+            Log::Warning("Failed to parse map change orientation event");
             return;
         }
 
@@ -676,12 +865,12 @@ namespace dfs
         bot->MarkUpdated();
     }
 
-    void HandleMapCurrentEvent(const std::string &value, BotDescriptor *bot) {
+    void HandleMapCurrentEvent(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::gamemap;
 
-        MapCurrentEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<MapCurrentEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse map current event");
+            Log::Warning("Failed to parse map current event");
             return;
         }
 
@@ -691,17 +880,18 @@ namespace dfs
         auto &state = bot->GetState();
         state.CurrentMap = state.Data.GetMap(evt.map_id());
 
-        fmt::println(" === We are now on map {} ===", evt.map_id());
+        Log::Debug(" === We are now on map {} ===", evt.map_id());
 
         bot->MarkUpdated();
     }
 
-    void HandleGameRolePlayShowActorsEvent(const std::string &value, BotDescriptor *bot) {
+    void HandleGameRolePlayShowActorsEvent(const std::string &value, BotDescriptor *bot,
+                                           google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::gamemap;
 
-        GameRolePlayShowActorsEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<GameRolePlayShowActorsEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse GameRolePlayShowActorsEvent");
+            Log::Warning("Failed to parse GameRolePlayShowActorsEvent");
             return;
         }
 
@@ -709,12 +899,40 @@ namespace dfs
             bot->MarkUpdated();
     }
 
-    void HandleInteractiveUsedEvent(const std::string &value, BotDescriptor *bot) {
+    static bool HandleGameRolePlayShowActorsEventView(std::string_view value, BotDescriptor *bot) {
+        ActorSummary actor;
+
+        // Nothing is registered from a malformed event: read it through first
+        GameRolePlayShowActorsEventView actors(value);
+        while (actors.Next(actor)) {
+        }
+
+        if (actors.HasFailed())
+            return false;
+
+        auto &state = bot->GetState();
+
+        if (state.CurrentMap == nullptr)
+            return true;
+
+        bool modified = false;
+
+        actors = GameRolePlayShowActorsEventView(value);
+        while (actors.Next(actor))
+            modified |= RegisterActor(actor, state);
+
+        if (modified)
+            bot->MarkUpdated();
+
+        return true;
+    }
+
+    void HandleInteractiveUsedEvent(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::interactive::element;
 
-        InteractiveUsedEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<InteractiveUsedEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse interactive used event");
+            Log::Warning("Failed to parse interactive used event");
             return;
         }
 
@@ -726,25 +944,25 @@ namespace dfs
             state.CurrentPlayer.Collecting = true;
 
             // Why the fuck are the times not in milliseconds Ankama?
-            state.CurrentPlayer.ArrivalTime =
-                std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(evt.duration() * 100);
+            state.CurrentPlayer.ArrivalTime = state.Clock.GetSentAt(std::chrono::high_resolution_clock::now()) +
+                                              std::chrono::milliseconds(evt.duration() * 100);
 
             bot->MarkUpdated();
         }
     }
 
-    void HandleInteractiveUseErrorEvent(const std::string &value, BotDescriptor *bot) {
+    void HandleInteractiveUseErrorEvent(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::interactive::element;
 
-        InteractiveUseErrorEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<InteractiveUseErrorEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse interactive use error event");
+            Log::Warning("Failed to parse interactive use error event");
             return;
         }
 
         auto &state = bot->GetState();
 
-        fmt::println("Interactive use error on entity {}", evt.element_id());
+        Log::Debug("Interactive use error on entity {}", evt.element_id());
 
         auto elt = state.Collectibles.find(evt.element_id());
         if (elt != state.Collectibles.end()) {
@@ -756,23 +974,23 @@ namespace dfs
         bot->MarkUpdated();
     }
 
-    void HandleInteractiveUseEndedEvent(const std::string &value, BotDescriptor *bot) {
+    void HandleInteractiveUseEndedEvent(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::interactive::element;
 
-        InteractiveUseEndedEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<InteractiveUseEndedEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse interactive use ended event");
+            Log::Warning("Failed to parse interactive use ended event");
             return;
         }
 
         auto &state = bot->GetState();
 
-        fmt::println("Interactive use ended on entity {}", evt.element_id());
+        Log::Debug("Interactive use ended on entity {}", evt.element_id());
 
         auto now = std::chrono::high_resolution_clock::now();
 
         if (state.CurrentPlayer.ArrivalTime > now) {
-            fmt::println(
+            Log::Debug(
                 "We received a interactive use ended event but we have not finished collecting yet. Delta is {}ms",
                 (state.CurrentPlayer.ArrivalTime - now) / std::chrono::milliseconds(1));
         }
@@ -781,12 +999,13 @@ namespace dfs
         bot->MarkUpdated();
     }
 
-    void HandleInteractiveElementUpdatedEvent(const std::string &value, BotDescriptor *bot) {
+    void HandleInteractiveElementUpdatedEvent(const std::string &value, BotDescriptor *bot,
+                                              google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::interactive::element;
 
-        InteractiveElementUpdatedEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<InteractiveElementUpdatedEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse interactive element updated event");
+            Log::Warning("Failed to parse interactive element updated event");
             return;
         }
 
@@ -794,7 +1013,7 @@ namespace dfs
 
         auto collectible = state.Collectibles.find(evt.interactive_element().element_id());
         if (collectible == state.Collectibles.end()) {
-            fmt::println("Interactive element {} not found", evt.interactive_element().element_id());
+            Log::Debug("Interactive element {} not found", evt.interactive_element().element_id());
             return;
         }
 
@@ -817,157 +1036,239 @@ namespace dfs
             collectible->second.DisabledSkills.push_back(s);
         }
 
-        fmt::println("Collectible (type {}) {} updated", collectible->second.Id, collectible->second.ElementTypeId);
+        Log::Debug("Collectible (type {}) {} updated", collectible->second.Id, collectible->second.ElementTypeId);
 
         bot->MarkUpdated();
     }
 
-    void HandleStatedElementUpdatedEvent(const std::string &value, BotDescriptor *bot) {
+    static void UpdateStatedElement(int32_t element_id, int32_t cell_id, int32_t element_state, BotDescriptor *bot) {
+        auto &state = bot->GetState();
+
+        auto collectible = state.Collectibles.find(element_id);
+        if (collectible == state.Collectibles.end()) {
+            Log::Debug("Collectible {} not found", element_id);
+            return;
+        }
+
+        collectible->second.State = static_cast<CollectibleState>(element_state);
+        collectible->second.CellId = cell_id;
+
+        Log::Debug("Collectible {} (type {}) is now of state {}", collectible->second.Id,
+                   collectible->second.ElementTypeId, (int)collectible->second.State);
+
+        bot->MarkUpdated();
+    }
+
+    void HandleStatedElementUpdatedEvent(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
         using namespace com::ankama::dofus::server::game::protocol::interactive::element;
 
-        StatedElementUpdatedEvent evt;
+        auto &evt = *google::protobuf::Arena::CreateMessage<StatedElementUpdatedEvent>(arena);
         if (!evt.ParseFromString(value)) {
-            fmt::println(stderr, "Failed to parse stated element updated event");
+            Log::Warning("Failed to parse stated element updated event");
             return;
         }
 
-        auto &state = bot->GetState();
+        const auto &element = evt.stated_element();
+        UpdateStatedElement(element.element_id(), element.cell_id(), element.state(), bot);
+    }
 
-        auto collectible = state.Collectibles.find(evt.stated_element().element_id());
-        if (collectible == state.Collectibles.end()) {
-            fmt::println("Collectible {} not found", evt.stated_element().element_id());
+    static bool HandleStatedElementUpdatedEventView(std::string_view value, BotDescriptor *bot) {
+        auto evt = StatedElementUpdatedEventView::Read(value);
+        if (!evt)
+            return false;
+
+        UpdateStatedElement(evt->ElementId, evt->CellId, evt->State, bot);
+        return true;
+    }
+
+    static void HandlePongEvent(BotDescriptor *bot) {
+        auto &clock = bot->GetState().Clock;
+        clock.OnPong(std::chrono::high_resolution_clock::now());
+
+        Log::Debug("Pong event, one-way delay is {:.3f}ms", clock.GetOneWayDelay().count() / 1e6);
+    }
+
+    static void HandleTimeEvent(const std::string &value, BotDescriptor *bot, google::protobuf::Arena *arena) {
+        using namespace com::ankama::dofus::server::game::protocol::basic;
+
+        auto &evt = *google::protobuf::Arena::CreateMessage<TimeEvent>(arena);
+        if (!evt.ParseFromString(value)) {
+            Log::Warning("Failed to parse time event");
             return;
         }
 
-        collectible->second.State = static_cast<CollectibleState>(evt.stated_element().state());
-        collectible->second.CellId = evt.stated_element().cell_id();
+        auto &clock = bot->GetState().Clock;
+        clock.OnServerTime(evt.timestamp(), std::chrono::high_resolution_clock::now());
 
-        fmt::println("Collectible {} (type {}) is now of state {}", collectible->second.Id,
-                     collectible->second.ElementTypeId, (int)collectible->second.State);
-
-        bot->MarkUpdated();
+        Log::Debug("Time event, the server clock is {:.3f}ms ahead", clock.GetOffset().count() / 1e6);
     }
 
-    void Messages::ParseEvent(const com::ankama::dofus::server::game::protocol::Event &event,
-                              BotDescriptor *bot) const {
+    void Messages::ParseEvent(const com::ankama::dofus::server::game::protocol::Event &event, BotDescriptor *bot,
+                              google::protobuf::Arena *arena) const {
         using namespace com::ankama::dofus::server::game::protocol;
 
-        if (event.content().type_url().ends_with("jaz")) {
-            fmt::println("We are in combat! Disabling bot.");
+        auto kind = GetKind(GameMessagePeek::Kind::Event, event.content().type_url());
+        if (kind == COMBAT_KIND) {
+            Log::Debug("We are in combat! Disabling bot.");
             auto &state = bot->GetState();
             state.Active = false;
             bot->GetState().InCombat = true;
             return;
         }
 
-        auto req = m_EventBindings.find(event.content().type_url());
-        if (req == m_EventBindings.end()) {
-            fmt::println("  EVT {} ({})", event.content().type_url(), event.content().value().length());
+        if (kind == UNBOUND_KIND) {
+            Log::Debug("  EVT {} ({})", event.content().type_url(), event.content().value().length());
             return;
         }
 
-        switch (req->second) {
+        switch (static_cast<Event>(kind - FIRST_EVENT_KIND)) {
         case MapMovementEvent:
-            HandleMapMovementEvent(event.content().value(), bot);
+            HandleMapMovementEvent(event.content().value(), bot, arena);
             break;
         case ChatChannelMessageEvent:
-            HandleChatChannelMessageEvent(event.content().value());
+            HandleChatChannelMessageEvent(event.content().value(), arena);
             break;
         case MapComplementaryInformationEvent:
-            HandleMapComplementaryInformationEvent(event.content().value(), bot);
+            HandleMapComplementaryInformationEvent(event.content().value(), bot, arena);
             break;
         case MapChangeOrientationEvent:
-            HandleMapChangeOrientationEvent(event.content().value(), bot);
+            HandleMapChangeOrientationEvent(event.content().value(), bot, arena);
             break;
         case MapCurrentEvent:
-            HandleMapCurrentEvent(event.content().value(), bot);
+            HandleMapCurrentEvent(event.content().value(), bot, arena);
             break;
         case GameRolePlayShowActorsEvent:
-            HandleGameRolePlayShowActorsEvent(event.content().value(), bot);
+            HandleGameRolePlayShowActorsEvent(event.content().value(), bot, arena);
             break;
         case InteractiveUsedEvent:
-            HandleInteractiveUsedEvent(event.content().value(), bot);
+            HandleInteractiveUsedEvent(event.content().value(), bot, arena);
             break;
         case InteractiveUseEndedEvent:
-            HandleInteractiveUseEndedEvent(event.content().value(), bot);
+            HandleInteractiveUseEndedEvent(event.content().value(), bot, arena);
             break;
         case StatedElementUpdatedEvent:
-            HandleStatedElementUpdatedEvent(event.content().value(), bot);
+            HandleStatedElementUpdatedEvent(event.content().value(), bot, arena);
             break;
         case InteractiveElementUpdatedEvent:
-            HandleInteractiveElementUpdatedEvent(event.content().value(), bot);
+            HandleInteractiveElementUpdatedEvent(event.content().value(), bot, arena);
             break;
         case TreasureHuntLegendaryEvent:
         case TreasureHuntEvent:
             break;
         case PongEvent:
-            fmt::println("Pong event");
+            HandlePongEvent(bot);
             break;
         case TimeEvent:
-            fmt::println("Time event");
+            HandleTimeEvent(event.content().value(), bot, arena);
             break;
         case CharacterCharacteristicsEvent:
-            fmt::println("Character characteristics event received");
+            Log::Debug("Character characteristics event received");
             break;
         case InteractiveUseErrorEvent:
-            HandleInteractiveUseErrorEvent(event.content().value(), bot);
+            HandleInteractiveUseErrorEvent(event.content().value(), bot, arena);
             break;
         }
     }
 
-    std::optional<std::string> Messages::HandleGameMessage(const uint8_t *payload, size_t length, int len_offset,
-                                                           BotDescriptor *bot) const {
+    bool Messages::HandleEventView(size_t kind, std::string_view event, BotDescriptor *bot) {
+        if (kind < FIRST_EVENT_KIND)
+            return false;
+
+        switch (static_cast<Event>(kind - FIRST_EVENT_KIND)) {
+        case MapMovementEvent:
+            return HandleMapMovementEventView(event, bot);
+        case GameRolePlayShowActorsEvent:
+            return HandleGameRolePlayShowActorsEventView(event, bot);
+        case StatedElementUpdatedEvent:
+            return HandleStatedElementUpdatedEventView(event, bot);
+        default:
+            return false;
+        }
+    }
+
+    FrameAction Messages::HandleGameMessage(const uint8_t *payload, size_t length, int len_offset, BotDescriptor *bot,
+                                            google::protobuf::Arena *arena, std::vector<uint8_t> &rewritten,
+                                            bool &handled, MessageTrace *trace) const {
         using namespace com::ankama::dofus::server::game::protocol;
 
         std::string_view msg(reinterpret_cast<const char *>(payload + len_offset), length);
 
-        GameMessage m;
-        if (!m.ParseFromString(msg)) {
-            fmt::println(stderr, "Failed to parse game message!");
+        // Most messages are of no interest to us: find out from the raw bytes and forward those untouched
+        auto peek = PeekGameMessage(payload + len_offset, length);
+        auto kind = peek ? GetKind(peek->Content, peek->TypeUrl) : UNBOUND_KIND;
 
-            // Return the initial message
-            std::string initial_message;
-            initial_message.assign(reinterpret_cast<const char *>(payload), len_offset + length);
+        if (trace != nullptr) {
+            trace->Kind = kind;
+            trace->Uid = peek ? peek->Uid : 0;
+        }
+
+        if (peek && kind == UNBOUND_KIND) {
+            lap(trace, &MessageTrace::Decode);
 
-            return initial_message;
+            switch (peek->Content) {
+            case GameMessagePeek::Kind::Request:
+                Log::Debug("  REQ {} ({})", peek->TypeUrl, peek->Value.length());
+                break;
+            case GameMessagePeek::Kind::Response:
+                Log::Debug("  RES {} ({})", peek->TypeUrl, peek->Value.length());
+                break;
+            case GameMessagePeek::Kind::Event:
+                Log::Debug("  EVT {} ({})", peek->TypeUrl, peek->Value.length());
+                break;
+            case GameMessagePeek::Kind::None:
+                break;
+            }
+
+            return FrameAction::Forward;
+        }
+
+        // The busiest events are read straight from the frame, the others parsed in full
+        if (peek && peek->Content == GameMessagePeek::Kind::Event) {
+            lap(trace, &MessageTrace::Decode);
+
+            if (HandleEventView(kind, peek->Value, bot)) {
+                handled = true;
+                lap(trace, &MessageTrace::Handle);
+                return FrameAction::Forward;
+            }
         }
 
+        // Without an arena of the caller, the messages live as long as this call
+        std::optional<google::protobuf::Arena> own_arena;
+        if (arena == nullptr)
+            arena = &own_arena.emplace();
+
+        auto &m = *google::protobuf::Arena::CreateMessage<GameMessage>(arena);
+        if (!m.ParseFromString(msg)) {
+            Log::Warning("Failed to parse game message!");
+            return FrameAction::Forward;
+        }
+
+        lap(trace, &MessageTrace::Decode);
+        handled = true;
+
+        auto action = FrameAction::Forward;
+
         switch (m.content_case()) {
         case GameMessage::kRequest:
-            // ParseRequest returns true if we want to cancel the request
-            if (ParseRequest(m.request(), bot))
-                return std::nullopt;
+            action = ParseRequest(*m.mutable_request(), bot, arena);
             break;
         case GameMessage::kResponse:
             ParseResponse(m.response(), bot);
             break;
         case GameMessage::kEvent:
-            ParseEvent(m.event(), bot);
+            ParseEvent(m.event(), bot, arena);
             break;
         case GameMessage::CONTENT_NOT_SET:
             break;
         }
 
-        auto message = m.SerializeAsString();
-
-        if (message.size() != length) {
-            fmt::print(fmt::fg(fmt::color::orange_red),
-                       "[WARNING] This message's length does not match the input length!\n");
-
-            return std::string(msg);
-        }
-
-        // Compare the messages
-        for (size_t i = 0; i < length; i++) {
-            if (message[i] != msg[i]) {
-                fmt::print(fmt::fg(fmt::color::orange_red),
-                           "[WARNING] This message's does not match the input ! (position {})\n", i);
-            }
+        lap(trace, &MessageTrace::Handle);
 
-            return std::string(msg);
-        }
+        if (action == FrameAction::Rewrite)
+            encode_frame(m, rewritten);
 
-        return message;
+        return action;
     }
 
     static void HandleConnectionRequest(const com::ankama::dofus::server::connection::protocol::Request &req) {
@@ -975,25 +1276,25 @@ namespace dfs
 
         switch (req.content_case()) {
         case Request::kPing:
-            fmt::println("Connection Request: Ping");
+            Log::Debug("Connection Request: Ping");
             break;
         case Request::kIdentification:
-            fmt::println("Connection Request: Identification");
+            Log::Debug("Connection Request: Identification");
             break;
         case Request::kSelectServer:
-            fmt::println("Connection Request: SelectServer");
+            Log::Debug("Connection Request: SelectServer");
             break;
         case Request::kForceAccount:
-            fmt::println("Connection Request: ForceAccount");
+            Log::Debug("Connection Request: ForceAccount");
             break;
         case Request::kReleaseAccount:
-            fmt::println("Connection Request: ReleaseAccount");
+            Log::Debug("Connection Request: ReleaseAccount");
             break;
         case Request::kFriendListRequest:
-            fmt::println("Connection Request: FriendListRequest");
+            Log::Debug("Connection Request: FriendListRequest");
             break;
         case Request::kAcquaintanceServersRequest:
-            fmt::println("Connection Request: AcquaintanceServersRequest");
+            Log::Debug("Connection Request: AcquaintanceServersRequest");
             break;
         case Request::CONTENT_NOT_SET:
             break;
@@ -1005,71 +1306,105 @@ namespace dfs
 
         switch (res.content_case()) {
         case Response::kPong:
-            fmt::println("Connection Response: Ping");
+            Log::Debug("Connection Response: Ping");
             break;
         case Response::kIdentification:
-            fmt::println("Connection Response: Identification");
+            Log::Debug("Connection Response: Identification");
             break;
         case Response::kSelectServer:
-            fmt::println("Connection Response: SelectServer");
+            Log::Debug("Connection Response: SelectServer");
             s_Connected = true;
             break;
         case Response::kForceAccount:
-            fmt::println("Connection Response: ForceAccount");
+            Log::Debug("Connection Response: ForceAccount");
             break;
         case Response::kFriendList:
-            fmt::println("Connection Response: FriendListRequest");
+            Log::Debug("Connection Response: FriendListRequest");
             break;
         case Response::kAcquaintanceServersResponse:
-            fmt::println("Connection Response: AcquaintanceServersRequest");
+            Log::Debug("Connection Response: AcquaintanceServersRequest");
             break;
         case Response::CONTENT_NOT_SET:
             break;
         }
     }
 
-    std::vector<uint8_t> Messages::HandleMessage(const uint8_t *payload, size_t length, int len_offset,
-                                                 BotDescriptor *bot) const {
-        // Make sure we don't make progress in the bot while reading/writing to state
-        auto lock = bot->Lock();
+    FrameAction Messages::HandleMessage(const uint8_t *payload, size_t length, int len_offset, BotDescriptor *bot,
+                                        google::protobuf::Arena *arena, std::vector<uint8_t> &rewritten,
+                                        bool *handled, MessageTrace *trace) const {
+        bool parsed = false;
 
-        std::string message;
+        if (trace != nullptr)
+            trace->LapStart = monotonic_ns();
 
-        if (s_Connected) {
-            auto message_opt = HandleGameMessage(payload, length, len_offset, bot);
-            if (message_opt == std::nullopt)
-                return {};
+        auto action = FrameAction::Forward;
+        if (s_Connected)
+            action = HandleGameMessage(payload, length, len_offset, bot, arena, rewritten, parsed, trace);
+        else
+            action = HandleConnectionMessage(payload, length, len_offset, bot, parsed, trace);
 
-            message = *message_opt;
-        } else {
-            message = HandleConnectionMessage(payload, length, len_offset, bot);
-        }
+        if (handled != nullptr)
+            *handled = parsed;
+
+        if (action != FrameAction::Cancel)
+            lap(trace, &MessageTrace::Encode);
 
-        auto data = encode_uvarint(message.length());
-        data.insert(data.end(), message.begin(), message.end());
+        return action;
+    }
+
+    bool Messages::IsConnected() {
+        return s_Connected;
+    }
 
-        return data;
+    void Messages::SetConnected(bool connected) {
+        s_Connected = connected;
     }
 
-    std::string Messages::HandleConnectionMessage(const uint8_t *payload, size_t length, int len_offset,
-                                                  BotDescriptor *) const {
+    bool Messages::CanCutThrough(const uint8_t *payload, size_t available) const {
+        // Login messages are few and small
+        if (!s_Connected)
+            return false;
+
+        auto peek = PeekGameMessageHeader(payload, available);
+        if (!peek || peek->Content != GameMessagePeek::Kind::Request)
+            return false;
+
+        auto kind = GetKind(peek->Content, peek->TypeUrl);
+        if (kind == UNBOUND_KIND)
+            return true;
+
+        // Those may be cancelled by `ParseRequest`
+        switch (static_cast<Request>(kind - FIRST_REQUEST_KIND)) {
+        case MapMovementRequest:
+        case MapChangeRequest:
+        case ChatChannelMessageRequest:
+        case MapMovementConfirmRequest:
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    FrameAction Messages::HandleConnectionMessage(const uint8_t *payload, size_t length, int len_offset,
+                                                  BotDescriptor *, bool &handled, MessageTrace *trace) const {
         using namespace com::ankama::dofus::server::connection::protocol;
 
         std::string_view msg(reinterpret_cast<const char *>(payload + len_offset), length);
 
+        if (trace != nullptr)
+            trace->Kind = LOGIN_KIND;
+
         LoginMessage m;
         if (!m.ParseFromString(msg)) {
-            fmt::println(stderr, "Failed to parse game message!");
-
-            // Return the initial message
-            std::string initial_message;
-            initial_message.assign(reinterpret_cast<const char *>(payload), len_offset + length);
-
-            return initial_message;
+            Log::Warning("Failed to parse game message!");
+            return FrameAction::Forward;
         }
 
+        lap(trace, &MessageTrace::Decode);
+        handled = true;
+
         // Forwarding the message
-        fmt::println("Forwarding client connection message");
+        Log::Debug("Forwarding client connection message");
 
         switch (m.content_case()) {
         case LoginMessage::kRequest:
@@ -1079,129 +1414,70 @@ namespace dfs
             HandleConnectionResponse(m.response());
             break;
         case LoginMessage::kEvent:
-            fmt::println("Message is of type event");
+            Log::Debug("Message is of type event");
             break;
         case LoginMessage::CONTENT_NOT_SET:
             break;
         }
 
-        return m.SerializeAsString();
-    }
-
-    std::vector<uint8_t> Messages::ForgeMapMovementRequest(const std::vector<PathElement> &path, int map_id,
-                                                           bool cautious) {
-        using namespace com::ankama::dofus::server::game::protocol;
-        using namespace com::ankama::dofus::server::game::protocol::gamemap;
-        using GameRequest = com::ankama::dofus::server::game::protocol::Request;
+        lap(trace, &MessageTrace::Handle);
 
-        class MapMovementRequest req;
+        return FrameAction::Forward;
+    }
 
+    size_t Messages::ForgeMapMovementRequest(const std::vector<PathElement> &path, int map_id, bool cautious,
+                                             std::span<uint8_t> frame) {
+        // The key cells are packed
+        size_t cells_length = 0;
         for (auto step : path)
-            req.add_key_cells(step.ToCompressed());
+            cells_length += WireWriter::VarintSize(varint_of(step.ToCompressed()));
 
-        req.set_map_id(map_id);
-        req.set_cautious(cautious);
+        auto length = scalar_field_size(MAP_MOVEMENT_REQUEST_MAP_ID_FIELD, varint_of(map_id)) +
+                      scalar_field_size(MAP_MOVEMENT_REQUEST_CAUTIOUS_FIELD, cautious);
+        if (cells_length > 0)
+            length += WireWriter::BytesFieldSize(MAP_MOVEMENT_REQUEST_KEY_CELLS_FIELD, cells_length);
 
-        std::string message = req.SerializeAsString();
-        google::protobuf::Any content;
-        *content.mutable_value() = std::move(message);
-        *content.mutable_type_url() = MAP_MOVEMENT_REQUEST_TYPE_URL;
+        WireWriter writer(frame);
+        write_request_header(writer, MAP_MOVEMENT_REQUEST_TYPE_URL, length);
 
-        GameRequest request;
-        *request.mutable_content() = std::move(content);
+        if (cells_length > 0) {
+            writer.WriteLength(MAP_MOVEMENT_REQUEST_KEY_CELLS_FIELD, cells_length);
 
-        GameMessage msg;
-        *msg.mutable_request() = std::move(request);
-
-        auto payload = msg.SerializeAsString();
+            for (auto step : path)
+                writer.WriteVarint(varint_of(step.ToCompressed()));
+        }
 
-        auto data = encode_uvarint(payload.length());
-        data.insert(data.end(), payload.begin(), payload.end());
+        write_scalar_field(writer, MAP_MOVEMENT_REQUEST_MAP_ID_FIELD, varint_of(map_id));
+        write_scalar_field(writer, MAP_MOVEMENT_REQUEST_CAUTIOUS_FIELD, cautious);
 
-        return data;
+        return frame_length(writer);
     }
 
-    std::vector<uint8_t> Messages::ForgeMapChangeRequest(int map_id, bool autopilot) {
-        using namespace com::ankama::dofus::server::game::protocol;
-        using namespace com::ankama::dofus::server::game::protocol::gamemap;
-        using GameRequest = com::ankama::dofus::server::game::protocol::Request;
-
-        class MapChangeRequest req;
-
-        req.set_map_id(map_id);
-        req.set_auto_pilot(autopilot);
-
-        std::string message = req.SerializeAsString();
-        google::protobuf::Any content;
-        *content.mutable_value() = std::move(message);
-        *content.mutable_type_url() = MAP_CHANGE_REQUEST_TYPE_URL;
-
-        GameRequest request;
-        *request.mutable_content() = std::move(content);
+    size_t Messages::ForgeMapChangeRequest(int map_id, bool autopilot, std::span<uint8_t> frame) {
+        auto length = scalar_field_size(MAP_CHANGE_REQUEST_MAP_ID_FIELD, varint_of(map_id)) +
+                      scalar_field_size(MAP_CHANGE_REQUEST_AUTO_PILOT_FIELD, autopilot);
 
-        GameMessage msg;
-        *msg.mutable_request() = std::move(request);
+        WireWriter writer(frame);
+        write_request_header(writer, MAP_CHANGE_REQUEST_TYPE_URL, length);
+        write_scalar_field(writer, MAP_CHANGE_REQUEST_MAP_ID_FIELD, varint_of(map_id));
+        write_scalar_field(writer, MAP_CHANGE_REQUEST_AUTO_PILOT_FIELD, autopilot);
 
-        auto payload = msg.SerializeAsString();
-
-        auto data = encode_uvarint(payload.length());
-        data.insert(data.end(), payload.begin(), payload.end());
-
-        return data;
+        return frame_length(writer);
     }
 
-    std::vector<uint8_t> Messages::ForgeInteractiveUseRequest(int element_id, int skill_instance_uid) {
-        using namespace com::ankama::dofus::server::game::protocol;
-        using namespace com::ankama::dofus::server::game::protocol::interactive::element;
-        using GameRequest = com::ankama::dofus::server::game::protocol::Request;
+    size_t Messages::ForgeInteractiveUseRequest(int element_id, int skill_instance_uid, std::span<uint8_t> frame) {
+        auto length = scalar_field_size(INTERACTIVE_USE_REQUEST_ELEMENT_ID_FIELD, varint_of(element_id)) +
+                      scalar_field_size(INTERACTIVE_USE_REQUEST_SKILL_INSTANCE_UID_FIELD, varint_of(skill_instance_uid));
 
-        class InteractiveUseRequest req;
+        WireWriter writer(frame);
+        write_request_header(writer, INTERACTIVE_USE_REQUEST_TYPE_URL, length);
+        write_scalar_field(writer, INTERACTIVE_USE_REQUEST_ELEMENT_ID_FIELD, varint_of(element_id));
+        write_scalar_field(writer, INTERACTIVE_USE_REQUEST_SKILL_INSTANCE_UID_FIELD, varint_of(skill_instance_uid));
 
-        req.set_element_id(element_id);
-        req.set_skill_instance_uid(skill_instance_uid);
-
-        std::string message = req.SerializeAsString();
-        google::protobuf::Any content;
-        *content.mutable_value() = std::move(message);
-        *content.mutable_type_url() = INTERACTIVE_USE_REQUEST_TYPE_URL;
-
-        GameRequest request;
-        *request.mutable_content() = std::move(content);
-
-        GameMessage msg;
-        *msg.mutable_request() = std::move(request);
-
-        auto payload = msg.SerializeAsString();
-
-        auto data = encode_uvarint(payload.length());
-        data.insert(data.end(), payload.begin(), payload.end());
-
-        return data;
+        return frame_length(writer);
     }
 
-    std::vector<uint8_t> Messages::ForgeMapMovementConfirmRequest() {
-        using namespace com::ankama::dofus::server::game::protocol;
-        using namespace com::ankama::dofus::server::game::protocol::gamemap;
-        using GameRequest = com::ankama::dofus::server::game::protocol::Request;
-
-        class MapMovementConfirmRequest req;
-
-        std::string message = req.SerializeAsString();
-        google::protobuf::Any content;
-        *content.mutable_value() = std::move(message);
-        *content.mutable_type_url() = MAP_MOVEMENT_CONFIRM_REQUEST_TYPE_URL;
-
-        GameRequest request;
-        *request.mutable_content() = std::move(content);
-
-        GameMessage msg;
-        *msg.mutable_request() = std::move(request);
-
-        auto payload = msg.SerializeAsString();
-
-        auto data = encode_uvarint(payload.length());
-        data.insert(data.end(), payload.begin(), payload.end());
-
-        return data;
+    std::span<const uint8_t> Messages::ForgeMapMovementConfirmRequest() {
+        return MAP_MOVEMENT_CONFIRM_REQUEST_FRAME;
     }
 } // namespace dfs
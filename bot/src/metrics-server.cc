@@ -0,0 +1,159 @@
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fmt/format.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <string_view>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <utility>
+
+#include "log.hh"
+#include "metrics-server.hh"
+
+namespace dfs
+{
+    /// Longest request we read, headers included. Scrapers send a few hundred bytes.
+    static constexpr const size_t MAX_REQUEST_SIZE = 8192;
+
+    /// A client that does not send its request (or read the response) within that is dropped
+    static constexpr const timeval CLIENT_TIMEOUT = {1, 0};
+
+    MetricsServer::MetricsServer(Renderer render)
+        : m_Render(std::move(render))
+        , m_Listener(-1)
+        , m_WakeFd(eventfd(0, EFD_CLOEXEC)) {
+    }
+
+    MetricsServer::~MetricsServer() {
+        if (m_Listener >= 0)
+            close(m_Listener);
+
+        if (m_WakeFd >= 0)
+            close(m_WakeFd);
+    }
+
+    bool MetricsServer::Listen(uint16_t port) {
+        int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            Log::Error("Metrics socket creation failed");
+            return false;
+        }
+
+        int opt = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(sock, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(sock, 16) < 0) {
+            Log::Error("Failed to listen for metrics scrapes on port {}: {}", port, strerror(errno));
+            close(sock);
+            return false;
+        }
+
+        m_Listener = sock;
+        return true;
+    }
+
+    void MetricsServer::Run() {
+        if (m_Listener < 0 || m_WakeFd < 0)
+            return;
+
+        pollfd fds[] = {{m_Listener, POLLIN, 0}, {m_WakeFd, POLLIN, 0}};
+
+        while (true) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                perror("Failed to wait for metrics scrapes");
+                return;
+            }
+
+            if (fds[1].revents != 0)
+                return;
+
+            int client = accept4(m_Listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0)
+                continue;
+
+            Serve(client);
+            close(client);
+        }
+    }
+
+    void MetricsServer::Stop() {
+        uint64_t one = 1;
+        [[maybe_unused]] auto _ = write(m_WakeFd, &one, sizeof(one));
+    }
+
+    /// Writes the whole buffer to a blocking socket. Returns false if the client went away.
+    static bool send_all(int sock, std::string_view data) {
+        while (!data.empty()) {
+            auto sent = send(sock, data.data(), data.size(), MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+
+            if (sent <= 0)
+                return false;
+
+            data.remove_prefix(sent);
+        }
+
+        return true;
+    }
+
+    void MetricsServer::Serve(int client) {
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &CLIENT_TIMEOUT, sizeof(CLIENT_TIMEOUT));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &CLIENT_TIMEOUT, sizeof(CLIENT_TIMEOUT));
+
+        // Only the request line matters, but the headers are read so the client is not reset on close
+        std::string request;
+        char buffer[1024];
+
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+            auto received = recv(client, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+
+            if (received <= 0)
+                return;
+
+            request.append(buffer, received);
+        }
+
+        std::string_view line(request);
+        line = line.substr(0, line.find("\r\n"));
+
+        std::string_view status = "200 OK";
+        std::string body;
+
+        if (line.starts_with("GET /metrics ") || line.starts_with("GET / ")) {
+            body = m_Render();
+        } else if (line.starts_with("GET ")) {
+            status = "404 Not Found";
+            body = "Not found, try /metrics\n";
+        } else {
+            status = "405 Method Not Allowed";
+            body = "Only GET is supported\n";
+        }
+
+        auto header = fmt::format("HTTP/1.1 {}\r\n"
+                                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                  "Content-Length: {}\r\n"
+                                  "Connection: close\r\n\r\n",
+                                  status, body.size());
+
+        if (send_all(client, header))
+            send_all(client, body);
+    }
+} // namespace dfs
@@ -0,0 +1,38 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "metrics.hh"
+
+namespace dfs
+{
+    std::mutex Metrics::s_ShardsMutex;
+    std::vector<std::unique_ptr<Metrics::Shard>> Metrics::s_Shards;
+
+    uint64_t Metrics::Get(Counter counter) {
+        std::lock_guard lock(s_ShardsMutex);
+
+        uint64_t total = 0;
+        for (const auto &shard : s_Shards)
+            total += shard->Values[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+
+        return total;
+    }
+
+    Metrics::Shard &Metrics::GetShard() {
+        thread_local Shard *shard = nullptr;
+
+        if (shard == nullptr) {
+            auto owned = std::make_unique<Shard>();
+            shard = owned.get();
+
+            std::lock_guard lock(s_ShardsMutex);
+            s_Shards.push_back(std::move(owned));
+        }
+
+        return *shard;
+    }
+} // namespace dfs
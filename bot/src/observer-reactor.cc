@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "log.hh"
+#include "observer-reactor.hh"
+#include "session.hh"
+#include "shared-ring.h"
+
+namespace dfs
+{
+    ObserverReactor::ObserverReactor(int listen_sock, const GameData &game_data, const Messages &messages)
+        : Reactor(listen_sock, game_data, messages)
+        , m_Epoll(epoll_create1(EPOLL_CLOEXEC))
+        , m_LastActivity() {
+        // Same tags as the epoll backend: null for the listening sockets, the wake fd address for itself,
+        // otherwise the control `Endpoint` of a session
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = &m_WakeFd;
+        if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_WakeFd, &ev) < 0)
+            Log::Error("Failed to watch the wake fd: {}", strerror(errno));
+    }
+
+    ObserverReactor::~ObserverReactor() {
+        for (auto &[session, shared] : m_Shared)
+            munmap(shared, sizeof(dfs_shared));
+
+        close(m_Epoll);
+    }
+
+    void ObserverReactor::Accept() {
+        for (int listen_sock : m_Listeners) {
+            while (true) {
+                int control_sock = accept4(listen_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (control_sock < 0) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                        Log::Error("Accept failed");
+
+                    break;
+                }
+
+                auto &session = AddSession(control_sock);
+
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.ptr = &session.GetClient();
+                if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, control_sock, &ev) < 0)
+                    Log::Error("epoll_ctl: {}", strerror(errno));
+            }
+        }
+    }
+
+    bool ObserverReactor::ReceiveHello(Session &session) {
+        dfs_shared_hello hello{};
+        iovec vector{&hello, sizeof(hello)};
+
+        alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int))];
+        msghdr message{};
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t received = recvmsg(session.GetClient().Fd, &message, MSG_CMSG_CLOEXEC);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return true;
+
+        int memfd = -1;
+        for (auto cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+                cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+                memcpy(&memfd, CMSG_DATA(cmsg), sizeof(int));
+        }
+
+        struct stat info{};
+        void *mapping = MAP_FAILED;
+
+        if (received == sizeof(hello) && hello.Magic == DFS_SHARED_MAGIC && hello.Version == DFS_SHARED_VERSION &&
+            memfd >= 0 && fstat(memfd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(dfs_shared))
+            mapping = mmap(nullptr, sizeof(dfs_shared), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+        // The mapping keeps the memory alive
+        if (memfd >= 0)
+            close(memfd);
+
+        if (mapping == MAP_FAILED) {
+            Log::Warning("Invalid hello from the hook, closing the session");
+            return false;
+        }
+
+        auto shared = static_cast<dfs_shared *>(mapping);
+        if (shared->Magic != DFS_SHARED_MAGIC || shared->Version != DFS_SHARED_VERSION) {
+            Log::Warning("Incompatible shared memory from the hook, closing the session");
+            munmap(mapping, sizeof(dfs_shared));
+            return false;
+        }
+
+        m_Shared.emplace(&session, shared);
+        m_Stats.Connected++;
+
+        session.Observe();
+        return true;
+    }
+
+    void ObserverReactor::HandleEvent(Endpoint &control, uint32_t events) {
+        auto &session = control.Owner;
+
+        if (session.GetState() == Session::State::Closed)
+            return;
+
+        if (session.GetState() == Session::State::Handshake) {
+            if (!ReceiveHello(session))
+                session.Close();
+
+            return;
+        }
+
+        if (!(events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+            return;
+
+        // Doorbells carry no data, the rings are drained after every wake up anyway
+        std::array<uint8_t, 64> doorbells;
+        while (true) {
+            ssize_t received = recv(control.Fd, doorbells.data(), doorbells.size(), 0);
+            if (received > 0)
+                continue;
+
+            if (received < 0 && errno == EINTR)
+                continue;
+
+            if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                // Whatever was mirrored before the hook went away is still worth decoding
+                auto it = m_Shared.find(&session);
+                bool drained = false;
+                if (it != m_Shared.end())
+                    Drain(session, *it->second, drained);
+
+                Log::Info("The game stopped being observed");
+                session.Close();
+            }
+
+            return;
+        }
+    }
+
+    bool ObserverReactor::Drain(Session &session, dfs_shared &shared, bool &drained) {
+        for (auto endpoint : {&session.GetClient(), &session.GetServer()}) {
+            // What the game sent goes to the client decoder, what it received to the server one
+            auto &ring = endpoint->IsServer ? shared.ToClient : shared.ToServer;
+
+            const uint8_t *data;
+            while (size_t length = dfs_ring_peek(&ring, &data)) {
+                if (!endpoint->Inbound.Append(data, length)) {
+                    Log::Warning("{} frame larger than {} bytes, closing the session",
+                                 endpoint->IsServer ? "Server" : "Client", endpoint->Inbound.GetCapacity());
+                    return false;
+                }
+
+                dfs_ring_consume(&ring, length);
+                drained = true;
+
+                session.OnObservedData(*endpoint, length);
+                if (session.GetState() == Session::State::Closed)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    void ObserverReactor::Inject(Session &session, dfs_shared &shared) {
+        auto &outbound = session.GetServer().Outbound;
+
+        // All or nothing: the hook may send whatever it finds in the ring, which must end on a frame boundary
+        if (outbound.IsEmpty() || outbound.GetSize() > dfs_ring_writable(&shared.Injected))
+            return;
+
+        std::vector<uint8_t> frames;
+        frames.reserve(outbound.GetSize());
+
+        std::array<iovec, OutboundQueue::MAX_BATCH> vectors;
+        while (!outbound.IsEmpty()) {
+            size_t count = outbound.Gather(vectors);
+            size_t length = 0;
+
+            for (size_t i = 0; i < count; i++) {
+                auto base = static_cast<const uint8_t *>(vectors[i].iov_base);
+                frames.insert(frames.end(), base, base + vectors[i].iov_len);
+                length += vectors[i].iov_len;
+            }
+
+            outbound.Consume(length);
+        }
+
+        dfs_ring_write(&shared.Injected, frames.data(), frames.size());
+
+        // Bot requests are rare, always wake the injector of the hook up
+        [[maybe_unused]] auto _ = send(session.GetClient().Fd, "", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    bool ObserverReactor::PrepareToSleep() {
+        bool idle = true;
+
+        for (auto &[session, shared] : m_Shared) {
+            __atomic_store_n(&shared->Sleeping, 1, __ATOMIC_SEQ_CST);
+
+            // Pairs with the fence of the hook between publishing bytes and checking the flag
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+            if (dfs_ring_readable(&shared->ToServer) > 0 || dfs_ring_readable(&shared->ToClient) > 0)
+                idle = false;
+        }
+
+        return idle;
+    }
+
+    void ObserverReactor::UnmapClosedSessions() {
+        std::erase_if(m_Shared, [](const auto &entry) {
+            if (entry.first->GetState() != Session::State::Closed)
+                return false;
+
+            munmap(entry.second, sizeof(dfs_shared));
+            return true;
+        });
+    }
+
+    void ObserverReactor::Quiesce() {
+        // The hooks cannot follow us to another process: they detach and the games go on unobserved
+        for (auto &session : m_Sessions)
+            session->Close();
+
+        UnmapClosedSessions();
+    }
+
+    void ObserverReactor::Adopt(Session &session) {
+        session.Close();
+    }
+
+    void ObserverReactor::Run() {
+        std::array<epoll_event, MAX_EVENTS> events;
+
+        for (int listen_sock : m_Listeners) {
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.ptr = nullptr;
+
+            if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, listen_sock, &ev) < 0)
+                Log::Error("Failed to watch a listening socket: {}", strerror(errno));
+        }
+
+        m_Running = true;
+
+        while (m_Running) {
+            int timeout = GetTimeout();
+
+            // Injections that did not fit are retried shortly, the hook is emptying the ring
+            for (auto &[session, shared] : m_Shared) {
+                if (!session->GetServer().Outbound.IsEmpty())
+                    timeout = timeout < 0 ? 1 : std::min(timeout, 1);
+            }
+
+            // Right after some traffic, poll instead of asking the hooks for doorbells
+            if (std::chrono::high_resolution_clock::now() - m_LastActivity < SPIN_DURATION || !PrepareToSleep())
+                timeout = 0;
+
+            int count = epoll_wait(m_Epoll, events.data(), MAX_EVENTS, timeout);
+
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                Log::Error("epoll_wait: {}", strerror(errno));
+                break;
+            }
+
+            for (auto &[session, shared] : m_Shared)
+                __atomic_store_n(&shared->Sleeping, 0, __ATOMIC_RELAXED);
+
+            for (int i = 0; i < count; i++) {
+                auto tag = events[i].data.ptr;
+
+                if (tag == nullptr) {
+                    Accept();
+                } else if (tag == &m_WakeFd) {
+                    uint64_t value;
+                    [[maybe_unused]] auto _ = read(m_WakeFd, &value, sizeof(value));
+                } else {
+                    HandleEvent(*static_cast<Endpoint *>(tag), events[i].events);
+                }
+            }
+
+            bool drained = false;
+            for (auto &[session, shared] : m_Shared) {
+                if (session->GetState() != Session::State::Closed && !Drain(*session, *shared, drained))
+                    session->Close();
+            }
+
+            const auto now = std::chrono::high_resolution_clock::now();
+            if (drained)
+                m_LastActivity = now;
+
+            UpdateBots(now);
+
+            for (auto &[session, shared] : m_Shared) {
+                if (session->GetState() != Session::State::Closed)
+                    Inject(*session, *shared);
+            }
+
+            // Closing a session closes its control socket, which also removes it from the epoll set
+            UnmapClosedSessions();
+            RemoveClosedSessions();
+        }
+
+        Log::Info("Gracefully shutting down...");
+        PrintStats();
+    }
+} // namespace dfs
@@ -0,0 +1,265 @@
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <iterator>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
+
+#include "latency-histogram.hh"
+#include "outbound-queue.hh"
+#include "snapshot.hh"
+
+namespace dfs
+{
+    static void set_cork(int fd, bool enabled) {
+        int value = enabled;
+        setsockopt(fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+    }
+
+    void OutboundQueue::Push(std::vector<uint8_t> &&frame) {
+        if (frame.empty())
+            return;
+
+        if (m_Partial) {
+            m_HeldSize += frame.size();
+            m_Held.push_back(std::move(frame));
+        } else {
+            m_Size += frame.size();
+            m_Chunks.push_back(std::move(frame));
+        }
+
+        UpdateCongestion();
+    }
+
+    void OutboundQueue::Push(const uint8_t *data, size_t length) {
+        if (length == 0)
+            return;
+
+        if (m_Partial) {
+            m_HeldSize += length;
+            m_Held.emplace_back(data, data + length);
+        } else {
+            Append(data, length);
+        }
+
+        UpdateCongestion();
+    }
+
+    void OutboundQueue::PushPartial(const uint8_t *data, size_t length, bool last) {
+        Append(data, length);
+        m_Partial = !last;
+
+        if (last) {
+            m_Size += m_HeldSize;
+            m_HeldSize = 0;
+
+            for (auto &frame : m_Held)
+                m_Chunks.push_back(std::move(frame));
+
+            m_Held.clear();
+        }
+
+        UpdateCongestion();
+    }
+
+    void OutboundQueue::Append(const uint8_t *data, size_t length) {
+        if (length == 0)
+            return;
+
+        if (!m_Chunks.empty() && m_Chunks.back().size() + length <= COALESCE_SIZE) {
+            auto &last = m_Chunks.back();
+            last.insert(last.end(), data, data + length);
+        } else {
+            m_Chunks.emplace_back(data, data + length);
+        }
+
+        m_Size += length;
+    }
+
+    void OutboundQueue::UpdateCongestion() {
+        auto size = m_Size + m_HeldSize;
+
+        if (size > HIGH_WATERMARK)
+            m_Congested = true;
+        else if (size <= LOW_WATERMARK)
+            m_Congested = false;
+
+        UpdateDrain();
+    }
+
+    void OutboundQueue::UpdateDrain() {
+        if (m_DrainHistogram == nullptr)
+            return;
+
+        if (m_Size == 0) {
+            if (m_QueuedSince != 0)
+                m_DrainHistogram->Record(monotonic_ns() - m_QueuedSince);
+
+            m_QueuedSince = 0;
+        } else if (m_QueuedSince == 0) {
+            m_QueuedSince = monotonic_ns();
+        }
+    }
+
+    size_t OutboundQueue::Gather(std::span<iovec> vectors) const {
+        size_t count = 0;
+        size_t offset = m_Offset;
+
+        for (auto &chunk : m_Chunks) {
+            if (count == vectors.size())
+                break;
+
+            vectors[count].iov_base = const_cast<uint8_t *>(chunk.data() + offset);
+            vectors[count].iov_len = chunk.size() - offset;
+
+            count++;
+            offset = 0;
+        }
+
+        return count;
+    }
+
+    void OutboundQueue::Consume(size_t length) {
+        m_Size -= length;
+
+        while (length > 0) {
+            auto remaining = m_Chunks.front().size() - m_Offset;
+
+            if (length < remaining) {
+                m_Offset += length;
+                break;
+            }
+
+            length -= remaining;
+            m_Chunks.pop_front();
+            m_Offset = 0;
+        }
+
+        UpdateCongestion();
+    }
+
+    void OutboundQueue::Swap(OutboundQueue &other) {
+        std::swap(m_Chunks, other.m_Chunks);
+        std::swap(m_Offset, other.m_Offset);
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Congested, other.m_Congested);
+        std::swap(m_QueuedSince, other.m_QueuedSince);
+
+        UpdateCongestion();
+        other.UpdateCongestion();
+    }
+
+    void OutboundQueue::Prepend(OutboundQueue &other) {
+        if (other.IsEmpty())
+            return;
+
+        // Only the front chunk can be partially written, drop what was
+        if (m_Offset > 0) {
+            m_Chunks.front().erase(m_Chunks.front().begin(), m_Chunks.front().begin() + m_Offset);
+            m_Offset = 0;
+        }
+
+        m_Chunks.insert(m_Chunks.begin(), std::make_move_iterator(other.m_Chunks.begin()),
+                        std::make_move_iterator(other.m_Chunks.end()));
+        m_Offset = other.m_Offset;
+        m_Size += other.m_Size;
+
+        // Those bytes were queued first
+        if (other.m_QueuedSince != 0)
+            m_QueuedSince = other.m_QueuedSince;
+
+        other.m_Chunks.clear();
+        other.m_Offset = 0;
+        other.m_Size = 0;
+        other.m_QueuedSince = 0;
+
+        UpdateCongestion();
+        other.UpdateCongestion();
+    }
+
+    void OutboundQueue::Save(SnapshotWriter &writer) const {
+        std::vector<uint8_t> ready;
+        ready.reserve(m_Size);
+
+        size_t offset = m_Offset;
+        for (auto &chunk : m_Chunks) {
+            ready.insert(ready.end(), chunk.begin() + offset, chunk.end());
+            offset = 0;
+        }
+
+        std::vector<uint8_t> held;
+        held.reserve(m_HeldSize);
+
+        for (auto &frame : m_Held)
+            held.insert(held.end(), frame.begin(), frame.end());
+
+        writer.WriteBytes(ready);
+        writer.Write(m_Partial);
+        writer.WriteBytes(held);
+    }
+
+    bool OutboundQueue::Restore(SnapshotReader &reader) {
+        std::span<const uint8_t> ready;
+        std::span<const uint8_t> held;
+        bool partial;
+
+        if (!reader.ReadBytes(ready) || !reader.Read(partial) || !reader.ReadBytes(held))
+            return false;
+
+        m_Chunks.clear();
+        m_Offset = 0;
+        m_Size = 0;
+        m_Held.clear();
+        m_HeldSize = 0;
+
+        Append(ready.data(), ready.size());
+
+        m_Partial = partial;
+        if (!held.empty()) {
+            m_Held.emplace_back(held.begin(), held.end());
+            m_HeldSize = held.size();
+        }
+
+        UpdateCongestion();
+        return true;
+    }
+
+    bool OutboundQueue::Flush(int fd) {
+        std::array<iovec, MAX_BATCH> vectors;
+
+        // More than one batch to write: hold the partial segments back until the last one
+        bool corked = m_Chunks.size() > MAX_BATCH;
+        if (corked)
+            set_cork(fd, true);
+
+        bool ok = true;
+
+        while (!IsEmpty()) {
+            msghdr message{};
+            message.msg_iov = vectors.data();
+            message.msg_iovlen = Gather(vectors);
+
+            // Same as writev, without SIGPIPE
+            ssize_t written = sendmsg(fd, &message, MSG_NOSIGNAL);
+
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                // The socket buffer is full, the reactor will call us again once it is writable
+                ok = errno == EAGAIN || errno == EWOULDBLOCK;
+                break;
+            }
+
+            Consume(written);
+        }
+
+        if (corked)
+            set_cork(fd, false);
+
+        return ok;
+    }
+} // namespace dfs
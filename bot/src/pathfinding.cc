@@ -3,16 +3,21 @@
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
-#include <fmt/base.h>
 #include <fmt/color.h>
+#include <fmt/format.h>
+#include <iterator>
 #include <limits>
 #include <list>
 #include <queue>
+#include <string_view>
 #include <unordered_set>
 #include <vector>
 
 #include "game.hh"
+#include "latency-histogram.hh"
+#include "log.hh"
 #include "map.hh"
+#include "metrics.hh"
 #include "utils.hh"
 
 /**
@@ -29,47 +34,38 @@ namespace dfs
     constexpr int HEURISTIC_COST = 10;
     constexpr int TOLERANCE_ELEVATION = 11;
 
-    void GameMap::PrintMap(const std::unordered_set<int> highlight) const {
+    void GameMap::PrintMap(const std::unordered_set<int> &highlight) const {
+        auto color_of = [&](int k) {
+            if (!m_Cells->at(k).Mov)
+                return fmt::color::dark_red;
+            if (m_Entities[k])
+                return fmt::color::dark_orange;
+            if (highlight.contains(k))
+                return fmt::color::cyan;
+            if (m_Cells->at(k).MapChangeData != 0)
+                return fmt::color::green_yellow;
+            if (m_Cells->at(k).FarmCell != 0)
+                return fmt::color::yellow;
+
+            return fmt::color::gray;
+        };
+
+        // Styled cell by cell, logged as a single message
+        fmt::memory_buffer grid;
+        auto out = std::back_inserter(grid);
+
         auto k = 0;
         for (auto i = 0; i < GameMap::MAP_HEIGHT; i++) {
-            for (auto j = 0; j < GameMap::MAP_WIDTH; j++) {
-                auto color = fmt::color::gray;
-
-                if (!m_Cells->at(k).Mov)
-                    color = fmt::color::dark_red;
-                else if (m_Entities[k])
-                    color = fmt::color::dark_orange;
-                else if (highlight.contains(k))
-                    color = fmt::color::cyan;
-                else if (m_Cells->at(k).MapChangeData != 0)
-                    color = fmt::color::green_yellow;
-                else if (m_Cells->at(k).FarmCell != 0)
-                    color = fmt::color::yellow;
-
-                fmt::print(fmt::fg(color), "{:3d}   ", m_Cells->at(k).CellId);
-                k++;
-            }
-            fmt::print("\n");
-
-            for (auto j = 0; j < GameMap::MAP_WIDTH; j++) {
-                auto color = fmt::color::gray;
-
-                if (!m_Cells->at(k).Mov)
-                    color = fmt::color::dark_red;
-                else if (m_Entities[k])
-                    color = fmt::color::dark_orange;
-                else if (highlight.contains(k))
-                    color = fmt::color::cyan;
-                else if (m_Cells->at(k).MapChangeData != 0)
-                    color = fmt::color::green_yellow;
-                else if (m_Cells->at(k).FarmCell != 0)
-                    color = fmt::color::yellow;
-
-                fmt::print(fmt::fg(color), "   {:3d}", m_Cells->at(k).CellId);
-                k++;
-            }
-            fmt::print("\n");
+            for (auto j = 0; j < GameMap::MAP_WIDTH; j++, k++)
+                fmt::format_to(out, fmt::fg(color_of(k)), "{:3d}   ", m_Cells->at(k).CellId);
+            grid.push_back('\n');
+
+            for (auto j = 0; j < GameMap::MAP_WIDTH; j++, k++)
+                fmt::format_to(out, fmt::fg(color_of(k)), "   {:3d}", m_Cells->at(k).CellId);
+            grid.push_back('\n');
         }
+
+        Log::Trace("Map {}:\n{}", m_MapId, std::string_view(grid.data(), grid.size()));
     }
 
     struct Node
@@ -268,6 +264,8 @@ namespace dfs
         int32_t start_cell, int32_t end_cell, bool diagonals, bool allow_through_entity, bool avoid_obstacles) const {
         using namespace map_tools;
 
+        auto started = monotonic_ns();
+
         // Build graph
         auto graph = std::vector<Node>();
         graph.reserve(m_Cells->size());
@@ -285,7 +283,7 @@ namespace dfs
         std::array<bool, MAP_WIDTH * MAP_HEIGHT * 2> in_open_list;
         in_open_list.fill(false);
 
-        fmt::println("We want to go from {} to {}", start_cell, end_cell);
+        Log::Debug("We want to go from {} to {}", start_cell, end_cell);
         open_list.push(start);
         in_open_list[start_cell] = true;
         parent_map[start_cell] = -1;
@@ -475,12 +473,14 @@ namespace dfs
             path.push_back(end_point);
         }
 
-        std::unordered_set<int> highlight;
-        for (auto &p : path) {
-            highlight.emplace(p.CellId);
-        }
+        if (Log::IsEnabled(LogLevel::Trace)) {
+            std::unordered_set<int> highlight;
+            for (auto &p : path) {
+                highlight.emplace(p.CellId);
+            }
 
-        PrintMap(highlight);
+            PrintMap(highlight);
+        }
 
         // Compress the path
         if (path.size() > 0) {
@@ -501,6 +501,9 @@ namespace dfs
             }
         }
 
+        Metrics::Add(Counter::PathSearches, 1);
+        Metrics::Add(Counter::PathSearchNanoseconds, monotonic_ns() - started);
+
         return std::vector(path.begin(), path.end());
     }
 
@@ -1,316 +1,814 @@
+#include <algorithm>
 #include <arpa/inet.h>
-#include <asm-generic/socket.h>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <csignal>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <fmt/base.h>
-#include <fmt/color.h>
+#include <fmt/format.h>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <thread>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
+#include "capture.hh"
+#include "epoll-reactor.hh"
 #include "game.hh"
+#include "handoff.hh"
+#include "latency-histogram.hh"
 #include "messages.hh"
+#include "metrics-server.hh"
+#include "metrics.hh"
 #include "network.hh"
-#include "simple-farming-bot.hh"
-
-constexpr const int BUFFER_SIZE = 2048;
+#include "observer-reactor.hh"
+#include "session.hh"
+#include "uring-reactor.hh"
 
 namespace dfs
 {
-    std::vector<int> s_Sockets;
-    bool s_Running;
-    int s_ProxySock = 0;
+    static constexpr const unsigned MAX_WORKERS = 256;
+
+    // Only touched with atomics, the signal handler may run on any thread
+    static std::atomic<bool> s_Stopping = false;
+    static std::atomic<bool> s_HandingOff = false;
+    static std::atomic<int> s_HandoffWake = -1;
+    // The workers, then the observer
+    static std::array<std::atomic<Reactor *>, MAX_WORKERS + 1> s_Reactors;
+    static std::atomic<int> s_ReportWake = -1;
+
+    // Held while a reactor is unregistered, so one is never destroyed while its sessions are enumerated
+    static std::mutex s_ReactorsMutex;
+
+    static void stop_reactors() {
+        for (auto &reactor : s_Reactors) {
+            auto r = reactor.load();
+            if (r != nullptr)
+                r->Stop();
+        }
+    }
 
     void handle_sigint(int signum) {
         (void)signum;
-        fmt::println("Gracefully shutting down...");
 
-        // Close all open sockets
-        for (int sockfd : s_Sockets) {
-            if (sockfd >= 0) {
-                shutdown(sockfd, SHUT_RD);
-                fmt::println("Closed {}", sockfd);
-            }
-        }
+        s_Stopping = true;
+
+        // The reactors close every session on their way out
+        stop_reactors();
 
-        if (s_ProxySock >= 0) {
-            close(s_ProxySock);
+        int wake = s_HandoffWake;
+        if (wake >= 0) {
+            uint64_t one = 1;
+            [[maybe_unused]] auto _ = write(wake, &one, sizeof(one));
         }
+    }
 
-        s_Running = false;
+    void handle_sigusr1(int signum) {
+        (void)signum;
+
+        int wake = s_ReportWake;
+        if (wake >= 0) {
+            uint64_t one = 1;
+            [[maybe_unused]] auto _ = write(wake, &one, sizeof(one));
+        }
     }
 
-    struct Handshake
-    {
-        uint8_t Address[16];
-        socklen_t Addrlen;
-        in_port_t Port;
-    };
-
-    static std::tuple<uint64_t, int> decode_uvarint(const uint8_t *data, size_t length) {
-        uint64_t value = 0;
-        int shift = 0;
-        int bytes_read = 0;
-
-        for (size_t i = 0; i < length; i++) {
-            value |= (static_cast<uint64_t>(data[i] & 0x7F) << shift); // Extract 7 bits and add to value
-            bytes_read++;
-            if ((data[i] & 0x80) == 0) { // MSB = 0 indicates the end
-                return {value, bytes_read};
-            }
+    static const char *state_name(Session::State state) {
+        switch (state) {
+        case Session::State::Handshake:
+            return "handshake";
+        case Session::State::Connecting:
+            return "connecting";
+        case Session::State::Relaying:
+            return "relaying";
+        case Session::State::Observing:
+            return "observing";
+        case Session::State::Closed:
+            return "closed";
+        }
 
-            shift += 7;
-            if (shift >= 64) { // Overflow error
-                return {0, -2};
-            }
+        return "unknown";
+    }
+
+    static const char *stage_name(LatencyStage stage) {
+        switch (stage) {
+        case LatencyStage::Assemble:
+            return "assemble";
+        case LatencyStage::Decode:
+            return "decode";
+        case LatencyStage::Handle:
+            return "handle";
+        case LatencyStage::Encode:
+            return "encode";
         }
 
-        // If we run out of bytes before completing the value
-        return {0, -1};
+        return "unknown";
+    }
+
+    static void unregister_reactor(size_t index) {
+        std::lock_guard lock(s_ReactorsMutex);
+        s_Reactors[index] = nullptr;
     }
 
-    Proxy::Proxy(int port, const GameData &game_data)
+    Proxy::Proxy(int port, const GameData &game_data, const Options &options)
         : m_Port(port)
-        , m_GameData(game_data) {
+        , m_GameData(game_data)
+        , m_Options(options)
+        , m_UnixListener(-1)
+        , m_ObserveListener(-1)
+        , m_WorkersDone(false)
+        , m_Successor(-1) {
     }
 
-    void Proxy::HandleConnection(int client_sock) const {
-        Handshake h{};
+    int Proxy::Listen() const {
+        int proxy_sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (proxy_sock < 0) {
+            fmt::println(stderr, "Socket creation failed");
+            return -1;
+        }
+
+        int opt = 1;
+        if (setsockopt(proxy_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+            setsockopt(proxy_sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)))
+            fmt::println("Failed to set socket opts");
 
-        fmt::println("Waiting for handshake...");
-        if (recv(client_sock, &h, sizeof(Handshake), 0) == -1) {
-            fmt::println(stderr, "Handshake failed");
-            close(client_sock);
-            return;
+        sockaddr_in proxy_addr{};
+        proxy_addr.sin_family = AF_INET;
+        proxy_addr.sin_port = htons(m_Port);
+        proxy_addr.sin_addr.s_addr = INADDR_ANY;
+
+        if (bind(proxy_sock, (struct sockaddr *)&proxy_addr, sizeof(proxy_addr)) < 0) {
+            fmt::println(stderr, "Bind failed");
+            close(proxy_sock);
+            return -1;
+        }
+
+        if (listen(proxy_sock, SOMAXCONN) < 0) {
+            fmt::println(stderr, "Listen failed");
+            close(proxy_sock);
+            return -1;
+        }
+
+        return proxy_sock;
+    }
+
+    int Proxy::ListenUnix(const std::string &name) const {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+
+        // Abstract namespace: a leading null byte, no file to clean up
+        if (name.size() + 1 > sizeof(address.sun_path)) {
+            fmt::println(stderr, "Unix socket name too long: {}", name);
+            return -1;
+        }
+
+        memcpy(address.sun_path + 1, name.data(), name.size());
+        auto length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name.size());
+
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            fmt::println(stderr, "Unix socket creation failed");
+            return -1;
+        }
+
+        if (bind(sock, reinterpret_cast<sockaddr *>(&address), length) < 0 || listen(sock, SOMAXCONN) < 0) {
+            perror("Failed to listen on the Unix socket");
+            close(sock);
+            return -1;
         }
 
-        sockaddr_in6 target_server{};
-        target_server.sin6_family = AF_INET6;
-        target_server.sin6_port = h.Port;
-        memcpy(target_server.sin6_addr.s6_addr, h.Address, 16);
+        return sock;
+    }
+
+    void Proxy::RunWorker(unsigned index, unsigned count) {
+        if (count > 1) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cpus);
 
-        char server_ip[INET6_ADDRSTRLEN];
-        inet_ntop(AF_INET6, &target_server.sin6_addr, server_ip, INET6_ADDRSTRLEN);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+                fmt::println(stderr, "Worker {}: failed to pin to a core", index);
+        }
 
-        // Socket for connecting to the target server
-        int server_sock = socket(AF_INET6, SOCK_STREAM, 0);
-        if (server_sock < 0) {
-            fmt::println(stderr, "Server socket creation failed");
-            close(client_sock);
+        // Keep the listening socket of the previous process, with the connections waiting in its backlog
+        int proxy_sock = index < m_Inherited.Listeners.size() ? std::exchange(m_Inherited.Listeners[index], -1)
+                                                               : Listen();
+        if (proxy_sock < 0)
             return;
+
+        // Per worker so nothing on the hot path is shared between cores
+        Messages messages;
+
+        // io_uring rings are single issuer: the reactor must be created by the thread that runs it
+        std::unique_ptr<Reactor> reactor;
+
+        if (m_Options.EventLoop == Backend::IoUring) {
+            auto uring = std::make_unique<UringReactor>(proxy_sock, m_GameData, messages);
+
+            if (uring->IsSupported()) {
+                if (index == 0)
+                    fmt::println("Using the io_uring backend");
+
+                if (index == 0 && m_Options.Splice)
+                    fmt::println("Splice passthrough is only available with the epoll backend, ignoring it");
+
+                reactor = std::move(uring);
+            } else if (index == 0) {
+                fmt::println("io_uring is not available, falling back to epoll");
+            }
+        }
+
+        if (reactor == nullptr) {
+            if (index == 0 && m_Options.Splice)
+                fmt::println("Relaying server traffic with splice");
+
+            reactor = std::make_unique<EpollReactor>(proxy_sock, m_GameData, messages, m_Options.Splice);
+        }
+
+        reactor->SetTimeouts(m_Options.Timeouts);
+
+        // One writer per reactor, appending whole blocks to the same file
+        if (!m_Options.CapturePath.empty())
+            reactor->SetCapture(CaptureWriter::Open(m_Options.CapturePath));
+
+        if (m_UnixListener >= 0)
+            reactor->AddListener(m_UnixListener);
+
+        // Sessions taken over from the previous process are spread over the workers
+        for (size_t i = index; i < m_Inherited.Sessions.size(); i += count) {
+            reactor->Import(m_Inherited.Sessions[i]);
+            m_Inherited.Sessions[i] = {};
         }
 
-        fmt::println("Connecting to server {}:{}...", server_ip, htons(target_server.sin6_port));
-        if (connect(server_sock, (sockaddr *)&target_server, h.Addrlen) < 0) {
-            perror("Connection to server failed");
-            close(client_sock);
-            close(server_sock);
+        s_Reactors[index] = reactor.get();
+
+        // We may have missed a stop request while setting up
+        if (s_Stopping || s_HandingOff)
+            reactor->Stop();
+
+        reactor->Run();
+        unregister_reactor(index);
+
+        if (s_HandingOff) {
+            auto sessions = reactor->Export();
+
+            std::lock_guard lock(m_OutgoingMutex);
+            m_Outgoing.Listeners[index] = proxy_sock;
+            m_Outgoing.Sessions.insert(m_Outgoing.Sessions.end(), std::make_move_iterator(sessions.begin()),
+                                       std::make_move_iterator(sessions.end()));
             return;
         }
 
-        s_Sockets.push_back(client_sock);
-        s_Sockets.push_back(server_sock);
+        close(proxy_sock);
+    }
 
-        fmt::println("Client connected to server: {}:{}", server_ip, htons(target_server.sin6_port));
+    void Proxy::RunObserver(int listen_sock) {
+        Messages messages;
+        ObserverReactor reactor(listen_sock, m_GameData, messages);
 
-        // TODO: Set real map ids
-        SimpleFarmingBot bot({69420, 42069}, m_GameData, server_sock);
+        reactor.SetTimeouts(m_Options.Timeouts);
 
-        // Directly start the bot. We may want to dynamically start it.
-        bot.Run();
+        if (!m_Options.CapturePath.empty())
+            reactor.SetCapture(CaptureWriter::Open(m_Options.CapturePath));
 
-        auto client_thread = std::thread([&]() {
-            uint8_t read_buffer[BUFFER_SIZE];
+        s_Reactors[MAX_WORKERS] = &reactor;
 
-            std::vector<uint8_t> buffer;
-            buffer.reserve(BUFFER_SIZE);
+        // The workers may be done already
+        if (s_Stopping || s_HandingOff || m_WorkersDone)
+            reactor.Stop();
 
-            while (true) {
-                ssize_t bytes_read = recv(client_sock, read_buffer, BUFFER_SIZE, 0);
+        reactor.Run();
+        unregister_reactor(MAX_WORKERS);
 
-                if (bytes_read < 0) {
-                    fmt::println("Client: read error");
-                    shutdown(server_sock, SHUT_RD);
-                    break;
-                } else if (bytes_read == 0) {
-                    fmt::println("Client: connection closed");
-                    shutdown(server_sock, SHUT_RD);
-                    break;
-                }
+        // Nothing to export, the hooks detach
+        reactor.Export();
+    }
 
-                // Append the read buffer to the current buffer
-                for (ssize_t i = 0; i < bytes_read; i++) {
-                    buffer.push_back(read_buffer[i]);
-                }
+    void Proxy::ForEachSession(const std::function<void(const Session &)> &visit) {
+        std::lock_guard lock(s_ReactorsMutex);
 
-                uint8_t *payload = buffer.data();
-                size_t buffer_length = buffer.size();
+        for (auto &reactor : s_Reactors) {
+            auto r = reactor.load();
+            if (r != nullptr)
+                r->GetSessions().ForEach(visit);
+        }
+    }
+
+    void Proxy::ReportSessions() {
+        pollfd fd{s_ReportWake, POLLIN, 0};
 
-                fmt::print(fmt::fg(fmt::color::cyan), "Client => Server: {} bytes\n", bytes_read);
+        while (!m_WorkersDone) {
+            if (poll(&fd, 1, -1) < 0 && errno != EINTR) {
+                perror("Failed to wait for SIGUSR1");
+                return;
+            }
 
-                while (true) {
-                    auto [msg_length, len_offset] = decode_uvarint(payload, buffer_length);
+            uint64_t value;
+            if (read(s_ReportWake, &value, sizeof(value)) < 0 || m_WorkersDone)
+                continue;
 
-                    if (msg_length == 0) {
-                        // We read all of the buffer
-                        buffer.clear();
-                        break;
-                    }
+            const auto now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+            size_t count = 0;
 
-                    if (msg_length > buffer_length - len_offset) {
-                        // We need to read some more to interpret this message
-                        break;
-                    }
+            ForEachSession([&](const Session &session) {
+                const auto &counters = session.GetCounters();
+                auto idle = now - counters.LastActivity.load(std::memory_order_relaxed);
 
-                    // Ignore the message length header
-                    auto to_send = m_MessageHandler.HandleMessage(payload, msg_length, len_offset, bot.GetDescriptor());
+                fmt::println("Session {} ({}): client {} bytes in {} frames, server {} bytes in {} frames, {} handled, "
+                             "idle for {:.1f}s",
+                             session.GetId(), state_name(session.GetState()), counters.ClientBytes.load(),
+                             counters.ClientFrames.load(), counters.ServerBytes.load(), counters.ServerFrames.load(),
+                             counters.Handled.load(),
+                             std::chrono::duration<double>(now_t::duration(idle)).count());
+                count++;
+            });
 
-                    // To send may be 0 if we intercept and cancel the message
-                    if (to_send.size() > 0) {
-                        // Send the packet to the server
-                        send(server_sock, to_send.data(), to_send.size(), 0);
-                    }
+            fmt::println("{} live session{}", count, count != 1 ? "s" : "");
+            ReportLatencies();
+        }
+    }
 
-                    // Advance our cursor
-                    payload += len_offset;
-                    payload += msg_length;
+    void Proxy::ReportLatencies() {
+        std::lock_guard lock(s_ReactorsMutex);
 
-                    // Update the length of the buffer
-                    buffer_length -= len_offset;
-                    buffer_length -= msg_length;
-                }
+        auto report = [](const char *direction, const char *kind, const char *stage, const auto &histogram_of) {
+            LatencySnapshot snapshot;
+            for (auto &reactor : s_Reactors) {
+                auto r = reactor.load();
+                if (r != nullptr)
+                    snapshot.Add(histogram_of(r->GetLatencies()));
             }
 
-            close(server_sock);
-        });
+            if (snapshot.GetCount() == 0)
+                return;
 
-        auto server_thread = std::thread([&]() {
-            uint8_t read_buffer[BUFFER_SIZE];
+            auto us = [](uint64_t ns) { return ns / 1000.0; };
+            fmt::println("{} {:<32} {:<8} {:>9}: p50 {:.1f}us, p99 {:.1f}us, p99.9 {:.1f}us, max {:.1f}us", direction,
+                         kind, stage, snapshot.GetCount(), us(snapshot.GetPercentile(0.5)),
+                         us(snapshot.GetPercentile(0.99)), us(snapshot.GetPercentile(0.999)), us(snapshot.GetMax()));
+        };
 
-            std::vector<uint8_t> buffer;
-            buffer.reserve(BUFFER_SIZE);
+        for (bool from_server : {false, true}) {
+            const char *direction = from_server ? "server -> client" : "client -> server";
 
-            while (true) {
-                ssize_t bytes_read = recv(server_sock, read_buffer, BUFFER_SIZE, 0);
+            for (size_t kind = 0; kind < Messages::MESSAGE_KINDS; kind++) {
+                for (size_t i = 0; i < LatencyStats::STAGES; i++) {
+                    auto stage = static_cast<LatencyStage>(i);
 
-                if (bytes_read < 0) {
-                    fmt::println("Server: read error");
-                    shutdown(client_sock, SHUT_RD);
-                    break;
-                } else if (bytes_read == 0) {
-                    fmt::println("Server: connection closed");
-                    shutdown(client_sock, SHUT_RD);
-                    break;
+                    report(direction, Messages::GetKindName(kind), stage_name(stage),
+                           [&](const LatencyStats &latencies) -> const LatencyHistogram & {
+                               return latencies.Get(stage, from_server, kind);
+                           });
                 }
+            }
 
-                send(client_sock, read_buffer, bytes_read, 0);
+            // Queues hold frames of every kind, and what the bot sends
+            report(direction, "all", "send", [&](const LatencyStats &latencies) -> const LatencyHistogram & {
+                return latencies.GetSend(from_server);
+            });
+        }
 
-                // Append the read buffer to the current buffer
-                for (ssize_t i = 0; i < bytes_read; i++) {
-                    buffer.push_back(read_buffer[i]);
-                }
+        // Round trips to the server, matched by uid
+        for (size_t kind = 0; kind < Messages::MESSAGE_KINDS; kind++) {
+            report("request -> reply", Messages::GetKindName(kind), "server",
+                   [&](const LatencyStats &latencies) -> const LatencyHistogram & {
+                       return latencies.GetRoundTrip(kind);
+                   });
+
+            uint64_t unanswered = 0;
+            for (auto &reactor : s_Reactors) {
+                auto r = reactor.load();
+                if (r != nullptr)
+                    unanswered += r->GetLatencies().GetUnanswered(kind).load(std::memory_order_relaxed);
+            }
 
-                uint8_t *payload = buffer.data();
-                size_t buffer_length = buffer.size();
+            if (unanswered > 0)
+                fmt::println("request -> reply {:<32} {:<8} {:>9}: never answered", Messages::GetKindName(kind),
+                             "server", unanswered);
+        }
+    }
 
-                fmt::print(fmt::fg(fmt::color::dark_cyan), "Server => Client: {} bytes\n", bytes_read);
+    std::string Proxy::RenderMetrics() {
+        fmt::memory_buffer buffer;
+        auto out = std::back_inserter(buffer);
+
+        auto family = [&](const char *name, const char *type, const char *help) {
+            fmt::format_to(out, "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+        };
+
+        auto seconds = [](uint64_t ns) { return ns / 1e9; };
+
+        struct SessionMetrics
+        {
+            uint64_t Id;
+            uint64_t Bytes[2];
+            uint64_t Frames[2];
+            uint64_t Handled;
+            uint64_t BotSteps;
+            uint64_t BotWait;
+        };
+
+        auto read = [](uint64_t id, const SessionCounters &counters) {
+            return SessionMetrics{id,
+                                  {counters.ClientBytes.load(), counters.ServerBytes.load()},
+                                  {counters.ClientFrames.load(), counters.ServerFrames.load()},
+                                  counters.Handled.load(),
+                                  counters.BotSteps.load(),
+                                  counters.BotWaitNanoseconds.load()};
+        };
+
+        std::vector<SessionMetrics> sessions;
+        SessionMetrics total{};
+
+        auto add = [&](const SessionMetrics &session) {
+            for (size_t from_server : {0, 1}) {
+                total.Bytes[from_server] += session.Bytes[from_server];
+                total.Frames[from_server] += session.Frames[from_server];
+            }
 
-                while (true) {
-                    auto [msg_length, uvarint_bytes_read] = decode_uvarint(payload, buffer_length);
+            total.Handled += session.Handled;
+            total.BotSteps += session.BotSteps;
+            total.BotWait += session.BotWait;
+        };
 
-                    if (msg_length == 0) {
-                        // We read all of the buffer
-                        buffer.clear();
-                        break;
-                    }
+        std::lock_guard lock(s_ReactorsMutex);
 
-                    if (msg_length > buffer_length - uvarint_bytes_read) {
-                        // We need to read some more to interpret this message
-                        break;
-                    }
+        // Those of the sessions that are gone are kept by their reactor, so the totals never go down
+        for (auto &reactor : s_Reactors) {
+            auto r = reactor.load();
+            if (r == nullptr)
+                continue;
 
-                    m_MessageHandler.HandleMessage(payload, msg_length, uvarint_bytes_read, bot.GetDescriptor());
+            add(read(0, r->GetSessions().GetRetired()));
+            r->GetSessions().ForEach([&](const Session &session) {
+                sessions.push_back(read(session.GetId(), session.GetCounters()));
+                add(sessions.back());
+            });
+        }
 
-                    // Advance our cursor
-                    payload += uvarint_bytes_read;
-                    payload += msg_length;
+        const char *const FROM[] = {"client", "server"};
 
-                    // Update the length of the buffer
-                    buffer_length -= msg_length;
-                    buffer_length -= uvarint_bytes_read;
-                }
+        family("dfs_sessions", "gauge", "Live sessions");
+        fmt::format_to(out, "dfs_sessions {}\n", sessions.size());
+
+        family("dfs_bytes_total", "counter", "Bytes received from each side");
+        for (size_t from_server : {0, 1})
+            fmt::format_to(out, "dfs_bytes_total{{from=\"{}\"}} {}\n", FROM[from_server], total.Bytes[from_server]);
+
+        family("dfs_frames_total", "counter", "Complete frames received from each side");
+        for (size_t from_server : {0, 1})
+            fmt::format_to(out, "dfs_frames_total{{from=\"{}\"}} {}\n", FROM[from_server], total.Frames[from_server]);
+
+        family("dfs_handled_total", "counter", "Frames parsed by the message handler");
+        fmt::format_to(out, "dfs_handled_total {}\n", total.Handled);
+
+        family("dfs_bot_steps_total", "counter", "Decisions taken by the bots");
+        fmt::format_to(out, "dfs_bot_steps_total {}\n", total.BotSteps);
+
+        family("dfs_bot_wait_seconds_total", "counter", "Time the decisions of the bots waited for their reactor");
+        fmt::format_to(out, "dfs_bot_wait_seconds_total {}\n", seconds(total.BotWait));
+
+        family("dfs_session_bytes_total", "counter", "Bytes received from each side, per live session");
+        for (const auto &session : sessions) {
+            for (size_t from_server : {0, 1})
+                fmt::format_to(out, "dfs_session_bytes_total{{session=\"{}\",from=\"{}\"}} {}\n", session.Id,
+                               FROM[from_server], session.Bytes[from_server]);
+        }
+
+        family("dfs_session_frames_total", "counter", "Complete frames received from each side, per live session");
+        for (const auto &session : sessions) {
+            for (size_t from_server : {0, 1})
+                fmt::format_to(out, "dfs_session_frames_total{{session=\"{}\",from=\"{}\"}} {}\n", session.Id,
+                               FROM[from_server], session.Frames[from_server]);
+        }
+
+        family("dfs_session_handled_total", "counter", "Frames parsed by the message handler, per live session");
+        for (const auto &session : sessions)
+            fmt::format_to(out, "dfs_session_handled_total{{session=\"{}\"}} {}\n", session.Id, session.Handled);
+
+        family("dfs_session_bot_steps_total", "counter", "Decisions taken by the bot of each live session");
+        for (const auto &session : sessions)
+            fmt::format_to(out, "dfs_session_bot_steps_total{{session=\"{}\"}} {}\n", session.Id, session.BotSteps);
+
+        family("dfs_session_bot_wait_seconds_total", "counter",
+               "Time the decisions of the bot of each live session waited for their reactor");
+        for (const auto &session : sessions)
+            fmt::format_to(out, "dfs_session_bot_wait_seconds_total{{session=\"{}\"}} {}\n", session.Id,
+                           seconds(session.BotWait));
+
+        // Summaries over every reactor, one per kind of message
+        auto summary = [&](const char *name, const char *labels, const auto &histogram_of) {
+            LatencySnapshot snapshot;
+            for (auto &reactor : s_Reactors) {
+                auto r = reactor.load();
+                if (r != nullptr)
+                    snapshot.Add(histogram_of(r->GetLatencies()));
+            }
+
+            if (snapshot.GetCount() == 0)
+                return;
+
+            for (double quantile : {0.5, 0.99, 0.999})
+                fmt::format_to(out, "{}{{{},quantile=\"{}\"}} {}\n", name, labels, quantile,
+                               seconds(snapshot.GetPercentile(quantile)));
+
+            fmt::format_to(out, "{}_sum{{{}}} {}\n", name, labels, seconds(snapshot.GetSum()));
+            fmt::format_to(out, "{}_count{{{}}} {}\n", name, labels, snapshot.GetCount());
+        };
+
+        family("dfs_handle_seconds", "summary", "Time spent in the message handler, per kind of message");
+        for (size_t from_server : {0, 1}) {
+            for (size_t kind = 0; kind < Messages::MESSAGE_KINDS; kind++) {
+                auto labels = fmt::format("kind=\"{}\",from=\"{}\"", Messages::GetKindName(kind), FROM[from_server]);
+                summary("dfs_handle_seconds", labels.c_str(), [&](const LatencyStats &latencies) -> const auto & {
+                    return latencies.Get(LatencyStage::Handle, from_server, kind);
+                });
+            }
+        }
+
+        family("dfs_server_round_trip_seconds", "summary", "From a request to the response of the server, per kind");
+        for (size_t kind = 0; kind < Messages::MESSAGE_KINDS; kind++) {
+            auto labels = fmt::format("kind=\"{}\"", Messages::GetKindName(kind));
+            summary("dfs_server_round_trip_seconds", labels.c_str(),
+                    [&](const LatencyStats &latencies) -> const auto & { return latencies.GetRoundTrip(kind); });
+        }
+
+        family("dfs_requests_unanswered_total", "counter", "Requests the server never answered, per kind");
+        for (size_t kind = 0; kind < Messages::MESSAGE_KINDS; kind++) {
+            uint64_t unanswered = 0;
+            for (auto &reactor : s_Reactors) {
+                auto r = reactor.load();
+                if (r != nullptr)
+                    unanswered += r->GetLatencies().GetUnanswered(kind).load(std::memory_order_relaxed);
+            }
+
+            if (unanswered > 0)
+                fmt::format_to(out, "dfs_requests_unanswered_total{{kind=\"{}\"}} {}\n", Messages::GetKindName(kind),
+                               unanswered);
+        }
+
+        family("dfs_path_searches_total", "counter", "Paths searched on a map");
+        fmt::format_to(out, "dfs_path_searches_total {}\n", Metrics::Get(Counter::PathSearches));
+
+        family("dfs_path_search_seconds_total", "counter", "Time spent searching paths");
+        fmt::format_to(out, "dfs_path_search_seconds_total {}\n",
+                       seconds(Metrics::Get(Counter::PathSearchNanoseconds)));
+
+        family("dfs_map_cache_hits_total", "counter", "Maps found in the cache of the game data");
+        fmt::format_to(out, "dfs_map_cache_hits_total {}\n", Metrics::Get(Counter::MapCacheHits));
+
+        family("dfs_map_cache_misses_total", "counter", "Maps loaded from the disk");
+        fmt::format_to(out, "dfs_map_cache_misses_total {}\n", Metrics::Get(Counter::MapCacheMisses));
+
+        family("dfs_map_cache_maps", "gauge", "Maps held by the cache of the game data");
+        fmt::format_to(out, "dfs_map_cache_maps {}\n", Metrics::Get(Counter::MapCacheMaps));
+
+        family("dfs_map_cache_bytes", "gauge", "Memory used by the cells of the cached maps");
+        fmt::format_to(out, "dfs_map_cache_bytes {}\n", Metrics::Get(Counter::MapCacheBytes));
+
+        return fmt::to_string(buffer);
+    }
+
+    bool Proxy::TakeOver() {
+        int sock = ConnectToPredecessor(m_Options.HandoffPath);
+        if (sock < 0)
+            return false;
+
+        fmt::println("Taking over from the running process...");
+
+        auto handoff = ReceiveHandoff(sock);
+        close(sock);
+
+        if (!handoff)
+            return false;
+
+        m_Inherited = std::move(*handoff);
+        Messages::SetConnected(m_Inherited.Connected);
+
+        fmt::println("Took over {} session{} and {} listening socket{}", m_Inherited.Sessions.size(),
+                     m_Inherited.Sessions.size() != 1 ? "s" : "", m_Inherited.Listeners.size(),
+                     m_Inherited.Listeners.size() != 1 ? "s" : "");
+        return true;
+    }
+
+    void Proxy::WaitForSuccessor(int listen_sock) {
+        std::array<pollfd, 2> fds{};
+        fds[0] = {listen_sock, POLLIN, 0};
+        fds[1] = {s_HandoffWake, POLLIN, 0};
+
+        while (!s_Stopping) {
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                perror("Failed to wait for the next process");
+                return;
             }
 
-            close(client_sock);
-        });
+            if (fds[1].revents != 0)
+                return;
+
+            if (fds[0].revents == 0)
+                continue;
+
+            int sock = AcceptSuccessor(listen_sock);
+            if (sock < 0)
+                continue;
 
-        // Wait for all threads to end
-        client_thread.join();
-        server_thread.join();
+            fmt::println("A new process is taking over, handing the sessions over...");
+
+            m_Successor = sock;
+            s_HandingOff = true;
+            stop_reactors();
+            return;
+        }
+    }
 
-        bot.Stop();
+    void Proxy::HandOver() {
+        // Workers that failed to listen have nothing to hand over
+        std::erase(m_Outgoing.Listeners, -1);
+        m_Outgoing.UnixListener = std::exchange(m_UnixListener, -1);
+        m_Outgoing.ObserveListener = std::exchange(m_ObserveListener, -1);
+        m_Outgoing.Connected = Messages::IsConnected();
+
+        if (SendHandoff(m_Successor, m_Outgoing))
+            fmt::println("Handed {} session{} over, exiting", m_Outgoing.Sessions.size(),
+                         m_Outgoing.Sessions.size() != 1 ? "s" : "");
+        else
+            perror("Handoff failed, the sessions are lost");
+
+        // The next process has its own copies of the descriptors
+        CloseHandoff(m_Outgoing);
+        close(m_Successor);
+        m_Successor = -1;
     }
 
     void Proxy::Run() {
         signal(SIGINT, handle_sigint);
 
-        int proxy_sock = socket(AF_INET, SOCK_STREAM, 0);
-        if (proxy_sock < 0) {
-            fmt::println(stderr, "Socket creation failed");
-            return;
+        // Prints the live sessions
+        std::thread reporter;
+        s_ReportWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (s_ReportWake >= 0) {
+            signal(SIGUSR1, handle_sigusr1);
+            reporter = std::thread(&Proxy::ReportSessions, this);
         }
 
-        int opt = 1;
-        if (setsockopt(proxy_sock, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)))
-            fmt::println("Failed to set socket opts");
+        // Serves the counters to Prometheus
+        std::unique_ptr<MetricsServer> metrics;
+        std::thread metrics_thread;
 
-        sockaddr_in proxy_addr{};
-        proxy_addr.sin_family = AF_INET;
-        proxy_addr.sin_port = htons(m_Port);
-        proxy_addr.sin_addr.s_addr = INADDR_ANY;
+        if (m_Options.MetricsPort != 0) {
+            metrics = std::make_unique<MetricsServer>(&Proxy::RenderMetrics);
 
-        if (bind(proxy_sock, (struct sockaddr *)&proxy_addr, sizeof(proxy_addr)) < 0) {
-            fmt::println(stderr, "Bind failed");
-            close(proxy_sock);
-            return;
+            if (metrics->Listen(m_Options.MetricsPort)) {
+                fmt::println("Serving metrics on http://127.0.0.1:{}/metrics", m_Options.MetricsPort);
+                metrics_thread = std::thread(&MetricsServer::Run, metrics.get());
+            }
         }
 
-        if (listen(proxy_sock, 10) < 0) {
-            fmt::println(stderr, "Listen failed");
-            close(proxy_sock);
-            return;
+        unsigned count = m_Options.Workers;
+        if (count == 0)
+            count = std::max(1u, std::thread::hardware_concurrency());
+
+        count = std::min(count, MAX_WORKERS);
+
+        const auto &handoff_path = m_Options.HandoffPath;
+        int handoff_sock = -1;
+        std::thread handoff_thread;
+
+        if (!handoff_path.empty()) {
+            if (TakeOver() && m_Inherited.Listeners.size() > count) {
+                fmt::println("The previous process had more workers, connections waiting on its extra listening "
+                             "sockets are dropped");
+
+                for (size_t i = count; i < m_Inherited.Listeners.size(); i++)
+                    close(m_Inherited.Listeners[i]);
+
+                m_Inherited.Listeners.resize(count);
+            }
+
+            // Once we took over, the path is ours
+            handoff_sock = ListenForSuccessor(handoff_path);
+            s_HandoffWake = eventfd(0, EFD_CLOEXEC);
+
+            if (handoff_sock >= 0 && s_HandoffWake >= 0)
+                handoff_thread = std::thread(&Proxy::WaitForSuccessor, this, handoff_sock);
         }
 
-        fmt::println("Proxy listening on port {}", m_Port);
+        m_Outgoing.Listeners.assign(count, -1);
+
+        // Once we know whether the previous process was past the login
+        if (!m_Options.CapturePath.empty()) {
+            if (CaptureWriter::Create(m_Options.CapturePath, Messages::IsConnected()))
+                fmt::println("Capturing the traffic to {}", m_Options.CapturePath);
+            else
+                m_Options.CapturePath.clear();
+        }
 
-        s_ProxySock = proxy_sock;
-        s_Running = true;
+        if (!m_Options.UnixSocket.empty()) {
+            // Held by the previous process, which cannot unbind it
+            m_UnixListener = std::exchange(m_Inherited.UnixListener, -1);
+            if (m_UnixListener < 0)
+                m_UnixListener = ListenUnix(m_Options.UnixSocket);
 
-        while (s_Running) {
-            sockaddr_in client_addr{};
-            socklen_t client_len = sizeof(client_addr);
-            int client_sock = accept(proxy_sock, (struct sockaddr *)&client_addr, &client_len);
-            if (client_sock < 0) {
-                fmt::println(stderr, "Accept failed");
-                continue;
+            if (m_UnixListener >= 0)
+                fmt::println("Proxy listening on the abstract Unix socket @{}", m_Options.UnixSocket);
+        }
+
+        std::thread observer;
+
+        if (!m_Options.ObserveSocket.empty()) {
+            m_ObserveListener = std::exchange(m_Inherited.ObserveListener, -1);
+            if (m_ObserveListener < 0)
+                m_ObserveListener = ListenUnix(m_Options.ObserveSocket);
+
+            if (m_ObserveListener >= 0) {
+                fmt::println("Observing in-process hooks on the abstract Unix socket @{}", m_Options.ObserveSocket);
+                observer = std::thread(&Proxy::RunObserver, this, m_ObserveListener);
             }
+        }
+
+        fmt::println("Proxy listening on port {} ({} worker{})", m_Port, count, count > 1 ? "s" : "");
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < count; i++)
+            workers.emplace_back(&Proxy::RunWorker, this, i, count);
 
-            fmt::println("Accepted connection");
-            m_Clients.push_back(std::thread(&Proxy::HandleConnection, this, client_sock));
+        RunWorker(0, count);
+
+        // One worker stopping (failing to listen for example) does not stop the others
+        for (auto &worker : workers)
+            worker.join();
+
+        m_WorkersDone = true;
+
+        if (reporter.joinable()) {
+            uint64_t one = 1;
+            [[maybe_unused]] auto _ = write(s_ReportWake, &one, sizeof(one));
+            reporter.join();
         }
 
-        close(proxy_sock);
-    }
+        if (metrics_thread.joinable()) {
+            metrics->Stop();
+            metrics_thread.join();
+        }
 
-    Proxy::~Proxy() {
-        for (auto &c : m_Clients) {
-            if (c.joinable()) {
-                c.join();
+        if (observer.joinable()) {
+            auto reactor = s_Reactors[MAX_WORKERS].load();
+            if (reactor != nullptr)
+                reactor->Stop();
+
+            observer.join();
+        }
+
+        // Everything was imported by now
+        CloseHandoff(m_Inherited);
+
+        if (handoff_thread.joinable()) {
+            if (!s_HandingOff) {
+                uint64_t one = 1;
+                [[maybe_unused]] auto _ = write(s_HandoffWake, &one, sizeof(one));
             }
+
+            handoff_thread.join();
+        }
+
+        if (s_HandingOff)
+            HandOver();
+        else if (handoff_sock >= 0)
+            unlink(handoff_path.c_str());
+
+        for (int *listener : {&m_UnixListener, &m_ObserveListener}) {
+            if (*listener >= 0)
+                close(std::exchange(*listener, -1));
+        }
+
+        if (handoff_sock >= 0)
+            close(handoff_sock);
+
+        if (s_HandoffWake >= 0)
+            close(s_HandoffWake.exchange(-1));
+
+        if (s_ReportWake >= 0) {
+            signal(SIGUSR1, SIG_IGN);
+            close(s_ReportWake.exchange(-1));
         }
     }
 } // namespace dfs
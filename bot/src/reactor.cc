@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+#include "log.hh"
+#include "messages.hh"
+#include "reactor.hh"
+#include "session.hh"
+
+namespace dfs
+{
+    Reactor::Reactor(int listen_sock, const GameData &game_data, const Messages &messages)
+        : m_Listeners{listen_sock}
+        , m_WakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        , m_Running(false)
+        , m_GameData(game_data)
+        , m_MessageHandler(messages)
+        , m_Latencies(Messages::MESSAGE_KINDS) {
+    }
+
+    Reactor::~Reactor() {
+        // Closes every socket
+        m_Sessions.Clear();
+
+        close(m_WakeFd);
+    }
+
+    void Reactor::Stop() {
+        m_Running = false;
+
+        uint64_t one = 1;
+        [[maybe_unused]] auto _ = write(m_WakeFd, &one, sizeof(one));
+    }
+
+    void Reactor::SetCapture(std::unique_ptr<CaptureWriter> capture) {
+        m_Capture = std::move(capture);
+
+        for (auto &session : m_Sessions)
+            session->SetCapture(m_Capture.get());
+    }
+
+    Session &Reactor::AddSession(int client_sock) {
+        auto &session = m_Sessions.Add(std::make_unique<Session>(client_sock, m_GameData, m_MessageHandler));
+        session.SetCapture(m_Capture.get());
+        session.SetLatencyStats(&m_Latencies);
+
+        return session;
+    }
+
+    std::vector<SessionSnapshot> Reactor::Export() {
+        Quiesce();
+
+        std::vector<SessionSnapshot> snapshots;
+        for (auto &session : m_Sessions) {
+            if (session->GetState() != Session::State::Closed)
+                snapshots.push_back(session->Detach());
+        }
+
+        m_Sessions.Clear();
+        return snapshots;
+    }
+
+    bool Reactor::Import(const SessionSnapshot &snapshot) {
+        auto &session = AddSession(snapshot.ClientFd);
+
+        if (!session.Restore(snapshot)) {
+            Log::Warning("Invalid session snapshot, dropping the session");
+            session.Close();
+            RemoveClosedSessions();
+            return false;
+        }
+
+        Adopt(session);
+        return true;
+    }
+
+    bool Reactor::OnConnected(Session &session) {
+        auto started = session.GetStateSince();
+
+        if (!session.OnConnected()) {
+            m_Stats.Failed++;
+            return false;
+        }
+
+        auto setup = std::chrono::duration_cast<std::chrono::nanoseconds>(session.GetStateSince() - started);
+
+        m_Stats.Connected++;
+        m_Stats.SetupTotal += setup;
+        m_Stats.SetupMax = std::max(m_Stats.SetupMax, setup);
+
+        Log::Info("Session set up in {:.3f}ms", setup.count() / 1e6);
+
+        return true;
+    }
+
+    now_t Reactor::GetSetupDeadline(const Session &session) const {
+        switch (session.GetState()) {
+        case Session::State::Handshake:
+            return session.GetStateSince() + m_Timeouts.Handshake;
+        case Session::State::Connecting:
+            return session.GetStateSince() + m_Timeouts.Connect;
+        default:
+            return now_t::max();
+        }
+    }
+
+    void Reactor::UpdateBots(const now_t &now) {
+        for (auto &session : m_Sessions) {
+            if (GetSetupDeadline(*session) <= now) {
+                Log::Warning("Session timed out while {}",
+                             session->GetState() == Session::State::Handshake ? "waiting for the handshake"
+                                                                              : "connecting to the server");
+
+                // Closing the sockets also cancels whatever the backend was waiting for
+                m_Stats.TimedOut++;
+                session->Close();
+                continue;
+            }
+
+            session->UpdateBot(now);
+        }
+
+        if (m_Capture != nullptr)
+            m_Capture->FlushExpired(monotonic_ns());
+    }
+
+    void Reactor::PrintStats() const {
+        auto average = m_Stats.Connected > 0 ? m_Stats.SetupTotal.count() / 1e6 / m_Stats.Connected : 0.0;
+
+        Log::Info("Sessions: {} set up (average {:.3f}ms, max {:.3f}ms), {} timed out, {} failed",
+                  m_Stats.Connected, average, m_Stats.SetupMax.count() / 1e6, m_Stats.TimedOut, m_Stats.Failed);
+    }
+
+    void Reactor::RemoveClosedSessions() {
+        m_Sessions.RemoveClosed();
+    }
+
+    int Reactor::GetTimeout() const {
+        const auto now = std::chrono::high_resolution_clock::now();
+        now_t next_wakeup = now_t::max();
+
+        for (const auto &session : m_Sessions) {
+            next_wakeup = std::min(next_wakeup, session->NextWakeup());
+            next_wakeup = std::min(next_wakeup, GetSetupDeadline(*session));
+        }
+
+        // A partial capture block must reach the file even if no session does anything
+        if (m_Capture != nullptr && m_Capture->GetFlushDeadline() != INT64_MAX) {
+            auto flush_in = std::chrono::nanoseconds(m_Capture->GetFlushDeadline() - monotonic_ns());
+            next_wakeup = std::min(next_wakeup, now + flush_in);
+        }
+
+        if (next_wakeup == now_t::max())
+            return -1;
+
+        if (next_wakeup <= now)
+            return 0;
+
+        // Round up so we never wake up before the timer
+        auto timeout = std::chrono::ceil<std::chrono::milliseconds>(next_wakeup - now).count();
+
+        // Bots that have nothing planned report a timer far away in the future
+        return static_cast<int>(std::min<int64_t>(timeout, 60 * 1000));
+    }
+} // namespace dfs
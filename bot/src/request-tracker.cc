@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "latency-histogram.hh"
+#include "log.hh"
+#include "messages.hh"
+#include "request-tracker.hh"
+
+namespace dfs
+{
+    // The hash keeps the top 6 bits
+    static_assert(RequestTracker::CAPACITY == 64);
+
+    RequestTracker::RequestTracker()
+        : m_Entries{}
+        , m_Pending(0)
+        , m_NextExpiry(INT64_MAX) {
+    }
+
+    void RequestTracker::Sent(int32_t uid, size_t kind, int64_t now, LatencyStats &stats) {
+        if (uid == 0)
+            return;
+
+        // The uid was reused before the previous request got an answer
+        auto slot = Find(uid);
+        if (slot != CAPACITY)
+            GiveUp(slot, stats);
+
+        if (m_Pending == MAX_PENDING) {
+            m_NextExpiry = 0;
+            Expire(now, stats);
+        }
+
+        if (m_Pending == MAX_PENDING) {
+            auto oldest = std::min_element(m_Entries.begin(), m_Entries.end(), [](const Entry &a, const Entry &b) {
+                return a.Used && (!b.Used || a.SentAt < b.SentAt);
+            });
+
+            GiveUp(oldest - m_Entries.begin(), stats);
+        }
+
+        slot = SlotOf(uid);
+        while (m_Entries[slot].Used)
+            slot = (slot + 1) % CAPACITY;
+
+        m_Entries[slot] = {uid, true, static_cast<uint32_t>(kind), now};
+        m_Pending++;
+        m_NextExpiry = std::min(m_NextExpiry, now + TIMEOUT);
+    }
+
+    void RequestTracker::Answered(int32_t uid, int64_t now, LatencyStats &stats) {
+        if (uid == 0)
+            return;
+
+        auto slot = Find(uid);
+        if (slot == CAPACITY)
+            return;
+
+        auto &entry = m_Entries[slot];
+        stats.GetRoundTrip(entry.Kind).Record(now - entry.SentAt);
+
+        Remove(slot);
+    }
+
+    void RequestTracker::Expire(int64_t now, LatencyStats &stats) {
+        if (now < m_NextExpiry)
+            return;
+
+        m_NextExpiry = INT64_MAX;
+
+        for (size_t slot = 0; slot < CAPACITY;) {
+            auto &entry = m_Entries[slot];
+
+            if (entry.Used && now - entry.SentAt >= TIMEOUT) {
+                // Another entry may have moved into this slot
+                GiveUp(slot, stats);
+                continue;
+            }
+
+            if (entry.Used)
+                m_NextExpiry = std::min(m_NextExpiry, entry.SentAt + TIMEOUT);
+
+            slot++;
+        }
+    }
+
+    size_t RequestTracker::Find(int32_t uid) const {
+        for (size_t slot = SlotOf(uid); m_Entries[slot].Used; slot = (slot + 1) % CAPACITY) {
+            if (m_Entries[slot].Uid == uid)
+                return slot;
+        }
+
+        return CAPACITY;
+    }
+
+    void RequestTracker::Remove(size_t slot) {
+        auto hole = slot;
+
+        for (auto next = (hole + 1) % CAPACITY; m_Entries[next].Used; next = (next + 1) % CAPACITY) {
+            // Entries whose home slot lies cyclically in (hole, next] are still found where they are
+            auto home = SlotOf(m_Entries[next].Uid);
+            if ((next - home) % CAPACITY < (next - hole) % CAPACITY)
+                continue;
+
+            m_Entries[hole] = m_Entries[next];
+            hole = next;
+        }
+
+        m_Entries[hole] = {};
+        m_Pending--;
+    }
+
+    void RequestTracker::GiveUp(size_t slot, LatencyStats &stats) {
+        auto &entry = m_Entries[slot];
+
+        auto &unanswered = stats.GetUnanswered(entry.Kind);
+        unanswered.store(unanswered.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        Log::Debug("Request {} (uid {}) was not answered", Messages::GetKindName(entry.Kind), entry.Uid);
+
+        Remove(slot);
+    }
+} // namespace dfs
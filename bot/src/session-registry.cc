@@ -0,0 +1,80 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "session-registry.hh"
+
+namespace dfs
+{
+    SessionRegistry::~SessionRegistry() {
+        Clear();
+    }
+
+    Session &SessionRegistry::Add(std::unique_ptr<Session> session) {
+        std::lock_guard lock(m_Mutex);
+
+        session->m_RegistryIndex = m_Sessions.size();
+        m_Sessions.push_back(std::move(session));
+
+        return *m_Sessions.back();
+    }
+
+    void SessionRegistry::Remove(Session &session) {
+        // Destroyed outside of the lock, closing sockets may take a while
+        std::unique_ptr<Session> removed;
+
+        {
+            std::lock_guard lock(m_Mutex);
+
+            size_t index = session.m_RegistryIndex;
+            removed = std::move(m_Sessions[index]);
+
+            if (index != m_Sessions.size() - 1) {
+                m_Sessions[index] = std::move(m_Sessions.back());
+                m_Sessions[index]->m_RegistryIndex = index;
+            }
+
+            m_Sessions.pop_back();
+        }
+
+        Retire(*removed);
+    }
+
+    void SessionRegistry::RemoveClosed() {
+        // Backwards, so the sessions moved into the freed slots were already looked at
+        for (size_t i = m_Sessions.size(); i-- > 0;) {
+            if (m_Sessions[i]->GetState() == Session::State::Closed)
+                Remove(*m_Sessions[i]);
+        }
+    }
+
+    void SessionRegistry::Clear() {
+        Sessions sessions;
+
+        {
+            std::lock_guard lock(m_Mutex);
+            sessions.swap(m_Sessions);
+        }
+
+        for (const auto &session : sessions)
+            Retire(*session);
+    }
+
+    void SessionRegistry::Retire(const Session &session) {
+        const auto &counters = session.GetCounters();
+
+        auto add = [](std::atomic<uint64_t> &total, const std::atomic<uint64_t> &value) {
+            SessionCounters::Add(total, value.load(std::memory_order_relaxed));
+        };
+
+        add(m_Retired.ClientBytes, counters.ClientBytes);
+        add(m_Retired.ServerBytes, counters.ServerBytes);
+        add(m_Retired.ClientFrames, counters.ClientFrames);
+        add(m_Retired.ServerFrames, counters.ServerFrames);
+        add(m_Retired.Handled, counters.Handled);
+        add(m_Retired.BotSteps, counters.BotSteps);
+        add(m_Retired.BotWaitNanoseconds, counters.BotWaitNanoseconds);
+    }
+} // namespace dfs
@@ -0,0 +1,391 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fmt/color.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <span>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "capture.hh"
+#include "latency-histogram.hh"
+#include "log.hh"
+#include "messages.hh"
+#include "session.hh"
+
+namespace dfs
+{
+    static std::atomic<uint64_t> s_NextSessionId = 1;
+
+    /// Frames are small and latency bound, and the outbound queues already batch what they write: without this,
+    /// a frame written while the previous one is not acknowledged waits for the delayed ACK of the peer (up to
+    /// 40ms). Fails harmlessly on Unix sockets.
+    static void disable_nagle(int sock) {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    Session::Session(int client_sock, const GameData &game_data, const Messages &messages)
+        : m_Id(s_NextSessionId++)
+        , m_State(State::Handshake)
+        , m_StateSince(std::chrono::high_resolution_clock::now())
+        , m_MessageHandler(messages)
+        , m_Client(*this, false)
+        , m_Server(*this, true)
+        // TODO: Set real map ids
+        , m_Bot({69420, 42069}, game_data, m_Server)
+        , m_CutThroughOffset(0)
+        , m_Capture(nullptr)
+        , m_Latencies(nullptr)
+        , m_RegistryIndex(0) {
+        m_Client.Fd = client_sock;
+        if (client_sock >= 0)
+            disable_nagle(client_sock);
+
+        m_Counters.LastActivity = m_StateSince.time_since_epoch().count();
+    }
+
+    Session::~Session() {
+        Close();
+    }
+
+    void Session::OnClientData(const uint8_t *data, size_t length) {
+        Log::Debug(fmt::fg(fmt::color::cyan), "Client => Server: {} bytes", length);
+        Received(m_Client, length);
+
+        if (!m_Client.Inbound.Append(data, length)) {
+            Log::Warning("Client frame larger than {} bytes, closing the session", m_Client.Inbound.GetCapacity());
+            Close();
+            return;
+        }
+
+        // Wait until we know where to connect before interpreting anything
+        if (GetState() == State::Handshake)
+            return;
+
+        DecodeFrames(m_Client, &m_Server);
+    }
+
+    void Session::OnServerData(const uint8_t *data, size_t length) {
+        Log::Debug(fmt::fg(fmt::color::dark_cyan), "Server => Client: {} bytes", length);
+        Received(m_Server, length);
+
+        // Server messages are only observed. Forward them before doing anything else.
+        m_Client.Queue(data, length);
+
+        if (!m_Server.Inbound.Append(data, length)) {
+            Log::Warning("Server frame larger than {} bytes, closing the session", m_Server.Inbound.GetCapacity());
+            Close();
+            return;
+        }
+
+        DecodeFrames(m_Server, nullptr);
+    }
+
+    void Session::OnServerDataRelayed(size_t length) {
+        Log::Debug(fmt::fg(fmt::color::dark_cyan), "Server => Client: {} bytes (spliced)", length);
+        Received(m_Server, length);
+
+        DecodeFrames(m_Server, nullptr);
+    }
+
+    void Session::OnObservedData(Endpoint &from, size_t length) {
+        Received(from, length);
+        DecodeFrames(from, nullptr);
+    }
+
+    void Session::Received(const Endpoint &from, size_t length) {
+        SessionCounters::Add(from.IsServer ? m_Counters.ServerBytes : m_Counters.ClientBytes, length);
+
+        auto now = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        m_Counters.LastActivity.store(now, std::memory_order_relaxed);
+    }
+
+    void Session::SetLatencyStats(LatencyStats *latencies) {
+        m_Latencies = latencies;
+
+        // Bytes from the server wait in the queue of the client
+        m_Client.Outbound.SetDrainHistogram(latencies != nullptr ? &latencies->GetSend(true) : nullptr);
+        m_Server.Outbound.SetDrainHistogram(latencies != nullptr ? &latencies->GetSend(false) : nullptr);
+
+        m_Client.PartialSince = 0;
+        m_Server.PartialSince = 0;
+    }
+
+    void Session::DecodeFrames(Endpoint &from, Endpoint *forward_to) {
+        auto &frames = from.IsServer ? m_Counters.ServerFrames : m_Counters.ClientFrames;
+
+        // Frames decoded together arrived together
+        int64_t received_at = 0;
+        if (m_Capture != nullptr || m_Latencies != nullptr)
+            received_at = monotonic_ns();
+
+        while (auto frame = from.Inbound.Next()) {
+            if (m_Capture != nullptr)
+                m_Capture->Record(m_Id,
+                                  from.IsServer ? CaptureDirection::ServerToClient : CaptureDirection::ClientToServer,
+                                  received_at, frame->Bytes);
+
+            bool handled = false;
+            MessageTrace trace;
+            std::vector<uint8_t> rewritten;
+            auto action = m_MessageHandler.HandleMessage(frame->Bytes.data(), frame->GetPayload().size(),
+                                                         frame->HeaderLength, m_Bot.GetDescriptor(), m_Arena.Get(),
+                                                         rewritten, &handled,
+                                                         m_Latencies != nullptr ? &trace : nullptr);
+            auto cancelled = action == FrameAction::Cancel;
+
+            SessionCounters::Add(frames, 1);
+            if (handled)
+                SessionCounters::Add(m_Counters.Handled, 1);
+
+            if (m_Latencies != nullptr) {
+                // Only the first frame may have started in an earlier read
+                auto assembled = from.PartialSince != 0 ? received_at - from.PartialSince : 0;
+                from.PartialSince = 0;
+
+                RecordLatencies(from, trace, assembled, handled, !cancelled);
+
+                // Cancelled requests never reach the server, observed ones always do
+                if (from.IsServer)
+                    m_Requests.Answered(trace.Uid, received_at, *m_Latencies);
+                else if (forward_to == nullptr || !cancelled)
+                    m_Requests.Sent(trace.Uid, trace.Kind, received_at, *m_Latencies);
+            }
+
+            if (forward_to == nullptr)
+                continue;
+
+            if (m_CutThroughOffset > 0) {
+                // The frame was only observed, most of it already left: send the rest
+                forward_to->Outbound.PushPartial(frame->Bytes.data() + m_CutThroughOffset,
+                                                 frame->Bytes.size() - m_CutThroughOffset, true);
+                m_CutThroughOffset = 0;
+            } else if (action == FrameAction::Forward) {
+                forward_to->Queue(frame->Bytes.data(), frame->Bytes.size());
+            } else if (action == FrameAction::Rewrite) {
+                forward_to->Queue(std::move(rewritten));
+            }
+        }
+
+        m_Arena.Reset();
+
+        if (from.Inbound.IsCorrupted()) {
+            Log::Warning("{}: invalid frame length, closing the session", from.IsServer ? "Server" : "Client");
+            Close();
+            return;
+        }
+
+        if (m_Latencies != nullptr) {
+            if (from.PartialSince == 0 && !from.Inbound.GetBuffered().empty())
+                from.PartialSince = received_at;
+
+            m_Requests.Expire(received_at, *m_Latencies);
+        }
+
+        if (forward_to != nullptr)
+            CutThrough();
+    }
+
+    void Session::RecordLatencies(const Endpoint &from, const MessageTrace &trace, int64_t assembled, bool handled,
+                                  bool forwarded) {
+        m_Latencies->Get(LatencyStage::Assemble, from.IsServer, trace.Kind).Record(assembled);
+        m_Latencies->Get(LatencyStage::Decode, from.IsServer, trace.Kind).Record(trace.Decode);
+
+        if (handled)
+            m_Latencies->Get(LatencyStage::Handle, from.IsServer, trace.Kind).Record(trace.Handle);
+
+        if (forwarded)
+            m_Latencies->Get(LatencyStage::Encode, from.IsServer, trace.Kind).Record(trace.Encode);
+    }
+
+    void Session::CutThrough() {
+        auto frame = m_Client.Inbound.PeekPartial();
+        if (!frame)
+            return;
+
+        if (m_CutThroughOffset == 0) {
+            auto payload = frame->GetPayload();
+
+            // Hold the frame until we know it cannot be cancelled or rewritten
+            if (payload.empty() || !m_MessageHandler.CanCutThrough(payload.data(), payload.size()))
+                return;
+        }
+
+        m_Server.Outbound.PushPartial(frame->Bytes.data() + m_CutThroughOffset,
+                                      frame->Bytes.size() - m_CutThroughOffset, false);
+        m_CutThroughOffset = frame->Bytes.size();
+    }
+
+    bool Session::Connect() {
+        auto &inbound = m_Client.Inbound;
+
+        if (inbound.GetBuffered().size() < sizeof(Handshake))
+            return true;
+
+        Handshake h{};
+        memcpy(&h, inbound.GetBuffered().data(), sizeof(Handshake));
+        inbound.Consume(sizeof(Handshake));
+
+        sockaddr_in6 target_server{};
+        target_server.sin6_family = AF_INET6;
+        target_server.sin6_port = h.Port;
+        memcpy(target_server.sin6_addr.s6_addr, h.Address, 16);
+
+        char server_ip[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, &target_server.sin6_addr, server_ip, INET6_ADDRSTRLEN);
+
+        // Socket for connecting to the target server
+        int server_sock = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (server_sock < 0) {
+            Log::Error("Server socket creation failed");
+            return false;
+        }
+
+        m_Server.Fd = server_sock;
+        disable_nagle(server_sock);
+        SetState(State::Connecting);
+
+        Log::Info("Connecting to server {}:{}...", server_ip, htons(target_server.sin6_port));
+        if (connect(server_sock, (sockaddr *)&target_server, h.Addrlen) < 0 && errno != EINPROGRESS) {
+            Log::Error("Connection to server failed: {}", strerror(errno));
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Session::OnConnected() {
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+
+        if (getsockopt(m_Server.Fd, SOL_SOCKET, SO_ERROR, &error, &error_len) < 0 || error != 0) {
+            Log::Error("Connection to server failed: {}", strerror(error));
+            return false;
+        }
+
+        SetState(State::Relaying);
+        Log::Info("Client connected to server");
+
+        // Directly start the bot. We may want to dynamically start it.
+        m_Bot.Run();
+
+        // The client may have sent some frames while we were connecting
+        DecodeFrames(m_Client, &m_Server);
+
+        return true;
+    }
+
+    void Session::Observe() {
+        SetState(State::Observing);
+        Log::Info("Observing the game through shared memory");
+
+        m_Bot.Run();
+    }
+
+    void Session::UpdateBot(const now_t &now) {
+        if (GetState() != State::Relaying && GetState() != State::Observing)
+            return;
+
+        std::chrono::nanoseconds waited;
+        if (m_Bot.Update(now, waited)) {
+            SessionCounters::Add(m_Counters.BotSteps, 1);
+            SessionCounters::Add(m_Counters.BotWaitNanoseconds, std::max<int64_t>(0, waited.count()));
+        }
+    }
+
+    now_t Session::NextWakeup() const {
+        return m_Bot.GetDescriptor()->NextWakeup();
+    }
+
+    void Session::SetState(State state) {
+        m_State.store(state, std::memory_order_relaxed);
+        m_StateSince = std::chrono::high_resolution_clock::now();
+    }
+
+    SessionSnapshot Session::Detach() {
+        SessionSnapshot snapshot;
+        SnapshotWriter writer;
+
+        writer.Write(GetState());
+        writer.Write(m_StateSince);
+        writer.Write<uint64_t>(m_CutThroughOffset);
+
+        writer.WriteBytes(m_Client.Inbound.GetBuffered());
+        writer.WriteBytes(m_Server.Inbound.GetBuffered());
+        m_Client.Outbound.Save(writer);
+        m_Server.Outbound.Save(writer);
+
+        m_Bot.Save(writer);
+
+        snapshot.ClientFd = std::exchange(m_Client.Fd, -1);
+        snapshot.ServerFd = std::exchange(m_Server.Fd, -1);
+        snapshot.State = std::move(writer.GetData());
+
+        // No shutdown: the connections live on in the other process
+        m_State.store(State::Closed, std::memory_order_relaxed);
+
+        return snapshot;
+    }
+
+    bool Session::Restore(const SessionSnapshot &snapshot) {
+        SnapshotReader reader(snapshot.State);
+
+        // Owned from now on, even if the snapshot turns out to be invalid
+        m_Server.Fd = snapshot.ServerFd;
+
+        State state;
+        now_t state_since;
+        uint64_t cut_through_offset;
+        std::span<const uint8_t> client_inbound;
+        std::span<const uint8_t> server_inbound;
+
+        if (!reader.Read(state) || !reader.Read(state_since) || !reader.Read(cut_through_offset) ||
+            !reader.ReadBytes(client_inbound) || !reader.ReadBytes(server_inbound))
+            return false;
+
+        if (!m_Client.Inbound.Append(client_inbound.data(), client_inbound.size()) ||
+            !m_Server.Inbound.Append(server_inbound.data(), server_inbound.size()))
+            return false;
+
+        if (!m_Client.Outbound.Restore(reader) || !m_Server.Outbound.Restore(reader) || !m_Bot.Restore(reader))
+            return false;
+
+        // The shared memory of observed sessions is not handed over
+        if (state == State::Closed || state == State::Observing || (state != State::Handshake && m_Server.Fd < 0))
+            return false;
+
+        m_State.store(state, std::memory_order_relaxed);
+        m_StateSince = state_since;
+        m_CutThroughOffset = cut_through_offset;
+
+        return true;
+    }
+
+    void Session::Close() {
+        if (GetState() == State::Closed)
+            return;
+
+        SetState(State::Closed);
+        m_Bot.Stop();
+
+        // Shutting down first makes sure the peers see the connection end even if a backend still holds a
+        // reference to the socket (pending io_uring operations for example)
+        for (auto endpoint : {&m_Client, &m_Server}) {
+            if (endpoint->Fd < 0)
+                continue;
+
+            shutdown(endpoint->Fd, SHUT_RDWR);
+            close(endpoint->Fd);
+            endpoint->Fd = -1;
+        }
+    }
+} // namespace dfs
@@ -0,0 +1,610 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "log.hh"
+#include "session.hh"
+#include "uring-reactor.hh"
+
+namespace dfs
+{
+    static int io_uring_setup(unsigned entries, io_uring_params *params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    static int io_uring_enter(int ring, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg,
+                              size_t arg_size) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, ring, to_submit, min_complete, flags, arg, arg_size));
+    }
+
+    static int io_uring_register(int ring, unsigned opcode, void *arg, unsigned nr_args) {
+        return static_cast<int>(syscall(__NR_io_uring_register, ring, opcode, arg, nr_args));
+    }
+
+    // The low bits of the user data hold the operation, the rest is the address of the connection (if any), or
+    // the index of the listening socket for accepts
+    static constexpr const uint64_t OPERATION_MASK = 0x7;
+    static constexpr const int OPERATION_BITS = 3;
+
+    UringReactor::UringReactor(int listen_sock, const GameData &game_data, const Messages &messages)
+        : Reactor(listen_sock, game_data, messages)
+        , m_Supported(false)
+        , m_Ring(-1)
+        , m_SqRing(MAP_FAILED)
+        , m_SqRingSize(0)
+        , m_Sqes(static_cast<io_uring_sqe *>(MAP_FAILED))
+        , m_SqLocalTail(0)
+        , m_ToSubmit(0)
+        , m_CqRing(MAP_FAILED)
+        , m_CqRingSize(0)
+        , m_BufferRing(static_cast<io_uring_buf_ring *>(MAP_FAILED))
+        , m_Buffers(static_cast<uint8_t *>(MAP_FAILED))
+        , m_BufferTail(0)
+        , m_WakeValue(0) {
+        m_Supported = Setup();
+    }
+
+    UringReactor::~UringReactor() {
+        // Shut the sockets down before tearing the ring down so in-flight operations complete
+        m_Sessions.Clear();
+
+        if (m_Ring >= 0)
+            close(m_Ring);
+
+        if (m_Buffers != MAP_FAILED)
+            munmap(m_Buffers, BUFFER_COUNT * BUFFER_SIZE);
+
+        if (m_BufferRing != MAP_FAILED)
+            munmap(m_BufferRing, BUFFER_COUNT * sizeof(io_uring_buf));
+
+        if (m_Sqes != MAP_FAILED)
+            munmap(m_Sqes, m_SqEntries * sizeof(io_uring_sqe));
+
+        if (m_CqRing != MAP_FAILED && m_CqRing != m_SqRing)
+            munmap(m_CqRing, m_CqRingSize);
+
+        if (m_SqRing != MAP_FAILED)
+            munmap(m_SqRing, m_SqRingSize);
+    }
+
+    bool UringReactor::Setup() {
+        io_uring_params params{};
+
+        // A single issuer ring requires Linux 6.0, which is also when multishot recv landed. Use it as a probe.
+        params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+
+        m_Ring = io_uring_setup(RING_ENTRIES, &params);
+        if (m_Ring < 0) {
+            perror("io_uring_setup");
+            return false;
+        }
+
+        const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+        if ((params.features & required) != required) {
+            Log::Error("io_uring: missing required features");
+            return false;
+        }
+
+        m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+
+        m_SqRing = mmap(nullptr, m_SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Ring,
+                        IORING_OFF_SQ_RING);
+        if (m_SqRing == MAP_FAILED) {
+            perror("io_uring: mmap");
+            return false;
+        }
+
+        // Both rings share the same mapping
+        m_CqRing = m_SqRing;
+
+        m_SqEntries = params.sq_entries;
+        m_Sqes = static_cast<io_uring_sqe *>(mmap(nullptr, m_SqEntries * sizeof(io_uring_sqe),
+                                                  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_Ring,
+                                                  IORING_OFF_SQES));
+        if (m_Sqes == MAP_FAILED) {
+            perror("io_uring: mmap");
+            return false;
+        }
+
+        auto sq = static_cast<uint8_t *>(m_SqRing);
+        m_SqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        m_SqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        m_SqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        m_SqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        m_SqLocalTail = *m_SqTail;
+
+        auto cq = static_cast<uint8_t *>(m_CqRing);
+        m_CqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        m_CqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        m_CqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        m_Cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        // Buffers the kernel picks from when data arrives on any socket of this reactor
+        m_BufferRing = static_cast<io_uring_buf_ring *>(mmap(nullptr, BUFFER_COUNT * sizeof(io_uring_buf),
+                                                             PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                                                             -1, 0));
+        m_Buffers = static_cast<uint8_t *>(mmap(nullptr, BUFFER_COUNT * BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (m_BufferRing == MAP_FAILED || m_Buffers == MAP_FAILED) {
+            perror("io_uring: mmap");
+            return false;
+        }
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(m_BufferRing);
+        reg.ring_entries = BUFFER_COUNT;
+        reg.bgid = BUFFER_GROUP;
+
+        if (io_uring_register(m_Ring, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            perror("io_uring: register buffer ring");
+            return false;
+        }
+
+        for (unsigned i = 0; i < BUFFER_COUNT; i++)
+            RecycleBuffer(i);
+
+        return true;
+    }
+
+    void UringReactor::RecycleBuffer(uint16_t buffer_id) {
+        auto &buffer = reinterpret_cast<io_uring_buf *>(m_BufferRing)[m_BufferTail & (BUFFER_COUNT - 1)];
+        buffer.addr = reinterpret_cast<uint64_t>(m_Buffers + buffer_id * BUFFER_SIZE);
+        buffer.len = BUFFER_SIZE;
+        buffer.bid = buffer_id;
+
+        m_BufferTail++;
+        std::atomic_ref(m_BufferRing->tail).store(m_BufferTail, std::memory_order_release);
+    }
+
+    io_uring_sqe *UringReactor::GetSqe() {
+        auto head = std::atomic_ref(*m_SqHead).load(std::memory_order_acquire);
+
+        // The submission queue is full, hand what we have to the kernel
+        if (m_SqLocalTail - head >= m_SqEntries) {
+            Enter(0, 0);
+            head = std::atomic_ref(*m_SqHead).load(std::memory_order_acquire);
+        }
+
+        auto index = m_SqLocalTail & m_SqMask;
+        auto sqe = &m_Sqes[index];
+        memset(sqe, 0, sizeof(io_uring_sqe));
+
+        m_SqArray[index] = index;
+        m_SqLocalTail++;
+        m_ToSubmit++;
+
+        return sqe;
+    }
+
+    int UringReactor::Enter(unsigned wait_nr, int timeout_ms) {
+        std::atomic_ref(*m_SqTail).store(m_SqLocalTail, std::memory_order_release);
+
+        __kernel_timespec ts{};
+        io_uring_getevents_arg arg{};
+        arg.sigmask_sz = _NSIG / 8;
+
+        unsigned flags = IORING_ENTER_EXT_ARG;
+        if (wait_nr > 0)
+            flags |= IORING_ENTER_GETEVENTS;
+
+        if (timeout_ms >= 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+
+        int submitted = io_uring_enter(m_Ring, m_ToSubmit, wait_nr, flags, &arg, sizeof(arg));
+        if (submitted >= 0)
+            m_ToSubmit -= submitted;
+
+        return submitted;
+    }
+
+    void UringReactor::Prepare(io_uring_sqe *sqe, uint8_t opcode, int fd, Connection *connection, Operation op) {
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->user_data = reinterpret_cast<uint64_t>(connection) | op;
+
+        if (connection != nullptr)
+            connection->Pending++;
+    }
+
+    void UringReactor::ArmAccept(size_t listener) {
+        auto sqe = GetSqe();
+        Prepare(sqe, IORING_OP_ACCEPT, m_Listeners[listener], nullptr, Accept);
+        sqe->user_data |= listener << OPERATION_BITS;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+    }
+
+    void UringReactor::ArmWake() {
+        auto sqe = GetSqe();
+        Prepare(sqe, IORING_OP_READ, m_WakeFd, nullptr, Wake);
+        sqe->addr = reinterpret_cast<uint64_t>(&m_WakeValue);
+        sqe->len = sizeof(m_WakeValue);
+    }
+
+    void UringReactor::ArmRecv(Connection &connection, bool server) {
+        auto &endpoint = server ? connection.Owner->GetServer() : connection.Owner->GetClient();
+        auto &side = server ? connection.Server : connection.Client;
+
+        auto sqe = GetSqe();
+        Prepare(sqe, IORING_OP_RECV, endpoint.Fd, &connection, server ? RecvServer : RecvClient);
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+
+        side.Receiving = true;
+    }
+
+    void UringReactor::Send(Connection &connection, bool server) {
+        auto &endpoint = server ? connection.Owner->GetServer() : connection.Owner->GetClient();
+        auto &side = server ? connection.Server : connection.Client;
+
+        if (side.InFlight.IsEmpty()) {
+            // Take everything the session queued so far. It may keep queueing while the kernel sends this.
+            if (!endpoint.HasPending())
+                return;
+
+            side.InFlight.Swap(endpoint.Outbound);
+        }
+
+        side.Message = {};
+        side.Message.msg_iov = side.Vectors.data();
+        side.Message.msg_iovlen = side.InFlight.Gather(side.Vectors);
+
+        auto sqe = GetSqe();
+        Prepare(sqe, IORING_OP_SENDMSG, endpoint.Fd, &connection, server ? SendServer : SendClient);
+        sqe->addr = reinterpret_cast<uint64_t>(&side.Message);
+        sqe->msg_flags = MSG_NOSIGNAL;
+
+        side.Sending = true;
+    }
+
+    void UringReactor::UpdateBackpressure(Connection &connection, bool server) {
+        auto &side = server ? connection.Server : connection.Client;
+        auto &other = server ? connection.Client : connection.Server;
+        auto &destination = server ? connection.Owner->GetClient() : connection.Owner->GetServer();
+
+        bool congested = destination.Outbound.IsCongested() || other.InFlight.IsCongested();
+
+        if (congested && side.Receiving && !side.Cancelling) {
+            // Stop reading until the other side drained what we already queued
+            CancelOperation(&connection, server ? RecvServer : RecvClient);
+            side.Cancelling = true;
+        } else if (!congested && !side.Receiving && !side.Cancelling) {
+            ArmRecv(connection, server);
+        }
+    }
+
+    void UringReactor::CancelOperation(Connection *connection, Operation op) {
+        auto sqe = GetSqe();
+        Prepare(sqe, IORING_OP_ASYNC_CANCEL, -1, connection, Cancel);
+        sqe->addr = reinterpret_cast<uint64_t>(connection) | op;
+    }
+
+    void UringReactor::HandleRecv(Connection &connection, bool server, const io_uring_cqe &cqe) {
+        auto &side = server ? connection.Server : connection.Client;
+        auto session = connection.Owner;
+
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            side.Receiving = false;
+            side.Cancelling = false;
+        }
+
+        if (cqe.res > 0) {
+            uint16_t buffer_id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+            if (session != nullptr && session->GetState() != Session::State::Closed) {
+                auto data = m_Buffers + buffer_id * BUFFER_SIZE;
+
+                if (server) {
+                    session->OnServerData(data, cqe.res);
+                } else {
+                    session->OnClientData(data, cqe.res);
+
+                    if (session->GetState() == Session::State::Handshake) {
+                        if (!session->Connect()) {
+                            session->Close();
+                        } else if (session->GetState() == Session::State::Connecting && !connection.Detaching) {
+                            // Wait for the upstream socket to become writable, which means it is connected
+                            auto sqe = GetSqe();
+                            Prepare(sqe, IORING_OP_POLL_ADD, session->GetServer().Fd, &connection, ConnectPoll);
+                            sqe->poll32_events = POLLOUT;
+                        }
+                    }
+                }
+            }
+
+            RecycleBuffer(buffer_id);
+        }
+
+        if (session == nullptr || session->GetState() == Session::State::Closed)
+            return;
+
+        if (cqe.res == 0) {
+            Log::Info("{}: connection closed", server ? "Server" : "Client");
+            session->Close();
+        } else if (cqe.res == -ECANCELED) {
+            // Paused because of backpressure, the run loop arms it again
+        } else if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+            Log::Warning("{}: read error", server ? "Server" : "Client");
+            session->Close();
+        } else if (!side.Receiving && !connection.Detaching) {
+            // The kernel ended the multishot recv (no buffer was left for example): arm a new one
+            ArmRecv(connection, server);
+        }
+    }
+
+    void UringReactor::HandleSend(Connection &connection, bool server, const io_uring_cqe &cqe) {
+        auto &side = server ? connection.Server : connection.Client;
+        auto session = connection.Owner;
+
+        side.Sending = false;
+
+        if (session == nullptr || session->GetState() == Session::State::Closed)
+            return;
+
+        // Cancelled to hand the session over, the bytes stay in flight until `Quiesce` takes them back
+        if (cqe.res == -ECANCELED)
+            return;
+
+        if (cqe.res < 0) {
+            Log::Warning("{}: write error", server ? "Server" : "Client");
+            session->Close();
+            return;
+        }
+
+        side.InFlight.Consume(cqe.res);
+
+        // Partial write (or more chunks than one batch): send the remainder right away to keep the bytes in order
+        if (!side.InFlight.IsEmpty() && !connection.Detaching)
+            Send(connection, server);
+    }
+
+    void UringReactor::HandleCompletion(const io_uring_cqe &cqe) {
+        auto op = static_cast<Operation>(cqe.user_data & OPERATION_MASK);
+        auto connection = op != Accept ? reinterpret_cast<Connection *>(cqe.user_data & ~OPERATION_MASK) : nullptr;
+
+        // Multishot operations keep the connection referenced until their last completion
+        if (connection != nullptr && !(cqe.flags & IORING_CQE_F_MORE))
+            connection->Pending--;
+
+        switch (op) {
+        case Accept: {
+            if (cqe.res >= 0) {
+                Log::Info("Accepted connection");
+
+                auto &session = AddSession(cqe.res);
+                auto accepted = std::make_unique<Connection>();
+                accepted->Owner = &session;
+
+                // What is handed to the kernel is still waiting to be written
+                accepted->Client.InFlight.SetDrainHistogram(session.GetClient().Outbound.GetDrainHistogram());
+                accepted->Server.InFlight.SetDrainHistogram(session.GetServer().Outbound.GetDrainHistogram());
+
+                ArmRecv(*accepted, false);
+                m_Connections.emplace(accepted.get(), std::move(accepted));
+            } else if (cqe.res != -ECANCELED) {
+                Log::Error("Accept failed");
+            }
+
+            if (!(cqe.flags & IORING_CQE_F_MORE) && m_Running)
+                ArmAccept(cqe.user_data >> OPERATION_BITS);
+        } break;
+        case Wake:
+            if (m_Running)
+                ArmWake();
+            break;
+        case RecvClient:
+        case RecvServer:
+            HandleRecv(*connection, op == RecvServer, cqe);
+            break;
+        case SendClient:
+        case SendServer:
+            HandleSend(*connection, op == SendServer, cqe);
+            break;
+        case ConnectPoll: {
+            auto session = connection->Owner;
+            if (session == nullptr || session->GetState() != Session::State::Connecting || cqe.res == -ECANCELED)
+                break;
+
+            if (cqe.res < 0 || !OnConnected(*session)) {
+                session->Close();
+                break;
+            }
+
+            if (!connection->Detaching)
+                ArmRecv(*connection, true);
+        } break;
+        case Cancel:
+            // The cancelled operation reports its own completion
+            break;
+        }
+    }
+
+    void UringReactor::ReapCompletions() {
+        unsigned head = *m_CqHead;
+        unsigned tail = std::atomic_ref(*m_CqTail).load(std::memory_order_acquire);
+
+        for (; head != tail; head++)
+            HandleCompletion(m_Cqes[head & m_CqMask]);
+
+        std::atomic_ref(*m_CqHead).store(head, std::memory_order_release);
+    }
+
+    void UringReactor::Quiesce() {
+        // New connections wait in the backlog of the listening socket, which is handed over too
+        for (size_t i = 0; i < m_Listeners.size(); i++) {
+            auto sqe = GetSqe();
+            Prepare(sqe, IORING_OP_ASYNC_CANCEL, -1, nullptr, Cancel);
+            sqe->addr = (i << OPERATION_BITS) | Accept;
+        }
+
+        CancelOperation(nullptr, Wake);
+
+        const auto deadline = std::chrono::steady_clock::now() + QUIESCE_TIMEOUT;
+
+        while (true) {
+            bool pending = false;
+
+            for (auto &[_, connection] : m_Connections) {
+                auto session = connection->Owner;
+                if (session == nullptr || session->GetState() == Session::State::Closed)
+                    continue;
+
+                // Sessions accepted meanwhile are cancelled on the next pass
+                if (!connection->Detaching) {
+                    connection->Detaching = true;
+
+                    for (bool server : {false, true}) {
+                        auto &side = server ? connection->Server : connection->Client;
+
+                        if (side.Receiving && !side.Cancelling) {
+                            CancelOperation(connection.get(), server ? RecvServer : RecvClient);
+                            side.Cancelling = true;
+                        }
+
+                        if (side.Sending)
+                            CancelOperation(connection.get(), server ? SendServer : SendClient);
+                    }
+
+                    if (session->GetState() == Session::State::Connecting)
+                        CancelOperation(connection.get(), ConnectPoll);
+                }
+
+                pending |= connection->Pending > 0;
+            }
+
+            if (!pending)
+                break;
+
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) {
+                // The kernel may still write their bytes: they cannot be handed over safely
+                for (auto &[_, connection] : m_Connections) {
+                    if (connection->Owner != nullptr && connection->Pending > 0) {
+                        Log::Warning("Session still busy after {}ms, dropping it", QUIESCE_TIMEOUT.count());
+                        connection->Owner->Close();
+                    }
+                }
+
+                break;
+            }
+
+            int result = Enter(1, static_cast<int>(remaining.count()));
+            if (result < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+                Log::Error("io_uring_enter: {}", strerror(errno));
+                break;
+            }
+
+            ReapCompletions();
+        }
+
+        for (auto &[_, connection] : m_Connections) {
+            auto session = connection->Owner;
+
+            // The sessions are about to be detached, the connections must not point to them anymore
+            connection->Owner = nullptr;
+
+            if (session == nullptr || session->GetState() == Session::State::Closed)
+                continue;
+
+            // Give back what the kernel did not send, in front of what was queued since
+            session->GetClient().Outbound.Prepend(connection->Client.InFlight);
+            session->GetServer().Outbound.Prepend(connection->Server.InFlight);
+        }
+    }
+
+    void UringReactor::Adopt(Session &session) {
+        auto adopted = std::make_unique<Connection>();
+        adopted->Owner = &session;
+        adopted->Client.InFlight.SetDrainHistogram(session.GetClient().Outbound.GetDrainHistogram());
+        adopted->Server.InFlight.SetDrainHistogram(session.GetServer().Outbound.GetDrainHistogram());
+
+        ArmRecv(*adopted, false);
+
+        if (session.GetState() == Session::State::Connecting) {
+            auto sqe = GetSqe();
+            Prepare(sqe, IORING_OP_POLL_ADD, session.GetServer().Fd, adopted.get(), ConnectPoll);
+            sqe->poll32_events = POLLOUT;
+        } else if (session.GetState() == Session::State::Relaying) {
+            ArmRecv(*adopted, true);
+
+            // What the previous process could not write yet
+            Send(*adopted, false);
+            Send(*adopted, true);
+        }
+
+        m_Connections.emplace(adopted.get(), std::move(adopted));
+    }
+
+    void UringReactor::Run() {
+        m_Running = true;
+
+        for (size_t i = 0; i < m_Listeners.size(); i++)
+            ArmAccept(i);
+
+        ArmWake();
+
+        while (m_Running) {
+            int result = Enter(1, GetTimeout());
+
+            if (result < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+                Log::Error("io_uring_enter: {}", strerror(errno));
+                break;
+            }
+
+            ReapCompletions();
+
+            // Let the bots react to what happened (or to their timers)
+            UpdateBots(std::chrono::high_resolution_clock::now());
+
+            for (auto it = m_Connections.begin(); it != m_Connections.end();) {
+                auto &connection = *it->second;
+
+                if (connection.Owner != nullptr && connection.Owner->GetState() == Session::State::Closed)
+                    connection.Owner = nullptr;
+
+                if (connection.Owner == nullptr) {
+                    // Only forget the connection once the kernel is done with its buffers
+                    if (connection.Pending == 0) {
+                        it = m_Connections.erase(it);
+                        continue;
+                    }
+                } else if (connection.Owner->GetState() == Session::State::Relaying) {
+                    // Queue everything the session produced. The submission happens on the next enter.
+                    if (!connection.Client.Sending)
+                        Send(connection, false);
+
+                    if (!connection.Server.Sending)
+                        Send(connection, true);
+
+                    UpdateBackpressure(connection, false);
+                    UpdateBackpressure(connection, true);
+                }
+
+                it++;
+            }
+
+            RemoveClosedSessions();
+        }
+
+        Log::Info("Gracefully shutting down...");
+        PrintStats();
+    }
+} // namespace dfs
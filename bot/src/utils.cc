@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <fmt/base.h>
+#include <span>
 
 #include "map.hh"
 #include "utils.hh"
@@ -28,7 +29,7 @@ namespace dfs
         return ((int)Dir & 7) << 12 | (CellId & 0xfff);
     }
 
-    std::chrono::duration<int64_t, std::milli> GetMovementDuration(const std::vector<int32_t> cells, bool cautious) {
+    std::chrono::duration<int64_t, std::milli> GetMovementDuration(std::span<const int32_t> cells, bool cautious) {
         auto x_speed = RUNNING_HORIZONTAL_TIMING;
         auto y_speed = RUNNING_VERTICAL_TIMING;
         auto speed = RUNNING_STRAIGHT_TIMING;
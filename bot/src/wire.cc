@@ -0,0 +1,208 @@
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "wire.hh"
+
+namespace dfs
+{
+    // Field numbers from game_message.proto and google/protobuf/any.proto
+    static constexpr const uint32_t GAME_MESSAGE_REQUEST_FIELD = 1;
+    static constexpr const uint32_t GAME_MESSAGE_RESPONSE_FIELD = 2;
+    static constexpr const uint32_t GAME_MESSAGE_EVENT_FIELD = 3;
+    static constexpr const uint32_t REQUEST_UID_FIELD = 1;
+    static constexpr const uint32_t REQUEST_CONTENT_FIELD = 2;
+    static constexpr const uint32_t RESPONSE_UID_FIELD = 1;
+    static constexpr const uint32_t RESPONSE_CONTENT_FIELD = 2;
+    static constexpr const uint32_t EVENT_CONTENT_FIELD = 1;
+    static constexpr const uint32_t ANY_TYPE_URL_FIELD = 1;
+    static constexpr const uint32_t ANY_VALUE_FIELD = 2;
+
+    /// Returns the last occurrence of a length delimited field, like a parser would keep.
+    static std::optional<std::string_view> find_bytes_field(std::string_view message, uint32_t wanted) {
+        WireReader reader(message);
+        std::string_view found;
+
+        uint32_t field;
+        WireReader::WireType type;
+
+        while (reader.Next(field, type)) {
+            if (field == wanted && type == WireReader::LENGTH_DELIMITED) {
+                if (!reader.ReadBytes(found))
+                    break;
+            } else if (!reader.Skip(type)) {
+                break;
+            }
+        }
+
+        if (reader.HasFailed())
+            return std::nullopt;
+
+        return found;
+    }
+
+    /// Returns the last occurrence of a varint field, zero if there is none (the default value of a scalar).
+    static std::optional<uint64_t> find_varint_field(std::string_view message, uint32_t wanted) {
+        WireReader reader(message);
+        uint64_t found = 0;
+
+        uint32_t field;
+        WireReader::WireType type;
+
+        while (reader.Next(field, type)) {
+            if (field == wanted && type == WireReader::VARINT) {
+                if (!reader.ReadVarint(found))
+                    break;
+            } else if (!reader.Skip(type)) {
+                break;
+            }
+        }
+
+        if (reader.HasFailed())
+            return std::nullopt;
+
+        return found;
+    }
+
+    /// Looks for a length delimited field at the beginning of a truncated message. Returns what was received of
+    /// its value, or `std::nullopt` if the field was not reached yet (or the message is malformed).
+    static std::optional<std::string_view> find_truncated_field(std::string_view message, uint32_t wanted) {
+        WireReader reader(message);
+        std::string_view value;
+
+        uint32_t field;
+        WireReader::WireType type;
+
+        while (reader.Next(field, type)) {
+            if (field == wanted && type == WireReader::LENGTH_DELIMITED) {
+                if (!reader.ReadTruncatedBytes(value))
+                    break;
+
+                return value;
+            }
+
+            if (!reader.Skip(type))
+                break;
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<GameMessagePeek> PeekGameMessageHeader(const uint8_t *data, size_t available) {
+        GameMessagePeek peek;
+        std::string_view content;
+
+        WireReader reader(data, available);
+        uint32_t field;
+        WireReader::WireType type;
+
+        // The member of the oneof is the only field of a game message
+        if (!reader.Next(field, type) || type != WireReader::LENGTH_DELIMITED || !reader.ReadTruncatedBytes(content))
+            return std::nullopt;
+
+        uint32_t content_field;
+
+        switch (field) {
+        case GAME_MESSAGE_REQUEST_FIELD:
+            peek.Content = GameMessagePeek::Kind::Request;
+            content_field = REQUEST_CONTENT_FIELD;
+            break;
+        case GAME_MESSAGE_RESPONSE_FIELD:
+            peek.Content = GameMessagePeek::Kind::Response;
+            content_field = RESPONSE_CONTENT_FIELD;
+            break;
+        case GAME_MESSAGE_EVENT_FIELD:
+            peek.Content = GameMessagePeek::Kind::Event;
+            content_field = EVENT_CONTENT_FIELD;
+            break;
+        default:
+            return std::nullopt;
+        }
+
+        auto any = find_truncated_field(content, content_field);
+        if (!any)
+            return std::nullopt;
+
+        // The type url must be complete, unlike the messages around it
+        WireReader any_reader(*any);
+        std::string_view type_url;
+
+        if (!any_reader.Next(field, type) || field != ANY_TYPE_URL_FIELD || type != WireReader::LENGTH_DELIMITED ||
+            !any_reader.ReadBytes(type_url))
+            return std::nullopt;
+
+        peek.TypeUrl = type_url;
+        return peek;
+    }
+
+    std::optional<GameMessagePeek> PeekGameMessage(const uint8_t *data, size_t length) {
+        GameMessagePeek peek;
+        std::string_view content;
+
+        WireReader reader(data, length);
+        uint32_t field;
+        WireReader::WireType type;
+
+        while (reader.Next(field, type)) {
+            auto kind = GameMessagePeek::Kind::None;
+
+            switch (field) {
+            case GAME_MESSAGE_REQUEST_FIELD:
+                kind = GameMessagePeek::Kind::Request;
+                break;
+            case GAME_MESSAGE_RESPONSE_FIELD:
+                kind = GameMessagePeek::Kind::Response;
+                break;
+            case GAME_MESSAGE_EVENT_FIELD:
+                kind = GameMessagePeek::Kind::Event;
+                break;
+            }
+
+            if (kind == GameMessagePeek::Kind::None || type != WireReader::LENGTH_DELIMITED) {
+                if (!reader.Skip(type))
+                    break;
+
+                continue;
+            }
+
+            // Oneof semantics: the last member wins
+            if (!reader.ReadBytes(content))
+                break;
+
+            peek.Content = kind;
+        }
+
+        if (reader.HasFailed())
+            return std::nullopt;
+
+        if (peek.Content == GameMessagePeek::Kind::None)
+            return peek;
+
+        auto any = find_bytes_field(content, peek.Content == GameMessagePeek::Kind::Event    ? EVENT_CONTENT_FIELD
+                                             : peek.Content == GameMessagePeek::Kind::Request ? REQUEST_CONTENT_FIELD
+                                                                                               : RESPONSE_CONTENT_FIELD);
+        if (!any)
+            return std::nullopt;
+
+        auto type_url = find_bytes_field(*any, ANY_TYPE_URL_FIELD);
+        auto value = find_bytes_field(*any, ANY_VALUE_FIELD);
+        if (!type_url || !value)
+            return std::nullopt;
+
+        peek.TypeUrl = *type_url;
+        peek.Value = *value;
+
+        // Events have no uid
+        if (peek.Content != GameMessagePeek::Kind::Event) {
+            auto uid = find_varint_field(content, peek.Content == GameMessagePeek::Kind::Request ? REQUEST_UID_FIELD
+                                                                                                : RESPONSE_UID_FIELD);
+            if (!uid)
+                return std::nullopt;
+
+            // Negative int32 values are sign extended to 64 bits
+            peek.Uid = static_cast<int32_t>(*uid);
+        }
+
+        return peek;
+    }
+} // namespace dfs
@@ -0,0 +1,113 @@
+#include <cstdint>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "capture.hh"
+
+namespace dfs
+{
+    class CaptureTest : public testing::Test {
+      protected:
+        CaptureTest() {
+            char path[] = "/tmp/dfs-capture-XXXXXX";
+            close(mkstemp(path));
+            m_Path = path;
+        }
+
+        ~CaptureTest() override {
+            unlink(m_Path.c_str());
+        }
+
+        size_t GetFileSize() const {
+            struct stat st{};
+            stat(m_Path.c_str(), &st);
+            return st.st_size;
+        }
+
+        std::string m_Path;
+    };
+
+    TEST_F(CaptureTest, ReadsBackInOrder) {
+        ASSERT_TRUE(CaptureWriter::Create(m_Path, true));
+
+        // Enough to fill a few blocks, and a frame larger than a block
+        std::vector<std::vector<uint8_t>> frames;
+        for (size_t i = 0; i < 2000; i++)
+            frames.emplace_back(1 + i % 97, static_cast<uint8_t>(i));
+        frames.insert(frames.begin() + 1000, std::vector<uint8_t>(3 * CAPTURE_BLOCK_SIZE, 0xAB));
+
+        {
+            auto writer = CaptureWriter::Open(m_Path);
+            ASSERT_NE(writer, nullptr);
+
+            for (size_t i = 0; i < frames.size(); i++)
+                writer->Record(i % 3, i % 2 ? CaptureDirection::ServerToClient : CaptureDirection::ClientToServer,
+                               static_cast<int64_t>(i), frames[i]);
+        }
+
+        // Whole blocks only
+        EXPECT_EQ((GetFileSize() - CAPTURE_HEADER_SIZE) % CAPTURE_BLOCK_SIZE, 0u);
+
+        auto reader = CaptureReader::Open(m_Path);
+        ASSERT_NE(reader, nullptr);
+        EXPECT_TRUE(reader->GetHeader().Connected);
+
+        size_t count = 0;
+        while (auto entry = reader->Next()) {
+            ASSERT_LT(count, frames.size());
+            EXPECT_EQ(entry->Record->SessionId & 0xFFFFFFFF, count % 3);
+            EXPECT_EQ(entry->Record->SessionId >> 32, static_cast<uint64_t>(getpid()));
+            EXPECT_EQ(entry->Record->Direction,
+                      count % 2 ? CaptureDirection::ServerToClient : CaptureDirection::ClientToServer);
+            EXPECT_EQ(entry->Record->Timestamp, static_cast<int64_t>(count));
+            EXPECT_EQ(std::vector<uint8_t>(entry->Frame.begin(), entry->Frame.end()), frames[count]);
+            count++;
+        }
+
+        EXPECT_EQ(count, frames.size());
+        EXPECT_FALSE(reader->IsTruncated());
+    }
+
+    TEST_F(CaptureTest, WritersShareTheFile) {
+        ASSERT_TRUE(CaptureWriter::Create(m_Path, false));
+
+        auto first = CaptureWriter::Open(m_Path);
+        auto second = CaptureWriter::Open(m_Path);
+        const std::vector<uint8_t> frame(100, 1);
+
+        // Interleaved blocks, each one whole
+        for (int i = 0; i < 2000; i++) {
+            first->Record(1, CaptureDirection::ClientToServer, i, frame);
+            second->Record(2, CaptureDirection::ServerToClient, i, frame);
+        }
+
+        first.reset();
+        second.reset();
+
+        // Appending again keeps what is there
+        ASSERT_TRUE(CaptureWriter::Create(m_Path, true));
+
+        auto reader = CaptureReader::Open(m_Path);
+        ASSERT_NE(reader, nullptr);
+        EXPECT_FALSE(reader->GetHeader().Connected);
+
+        int counts[3] = {};
+        while (auto entry = reader->Next())
+            counts[entry->Record->SessionId & 0xFFFFFFFF]++;
+
+        EXPECT_EQ(counts[1], 2000);
+        EXPECT_EQ(counts[2], 2000);
+    }
+
+    TEST_F(CaptureTest, RejectsOtherFiles) {
+        // Neither empty nor a capture
+        ASSERT_EQ(truncate(m_Path.c_str(), 10), 0);
+
+        EXPECT_FALSE(CaptureWriter::Create(m_Path, false));
+        EXPECT_EQ(CaptureReader::Open(m_Path), nullptr);
+    }
+} // namespace dfs
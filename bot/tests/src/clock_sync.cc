@@ -0,0 +1,62 @@
+#include <chrono>
+#include <gtest/gtest.h>
+
+#include "clock-sync.hh"
+
+namespace dfs
+{
+    using namespace std::chrono_literals;
+
+    static const now_t START = now_t(1'700'000'000s);
+
+    TEST(ClockSyncTest, KeepsTheShortestRoundTrip) {
+        ClockSync clock;
+        EXPECT_EQ(clock.GetOneWayDelay(), 0ns);
+        EXPECT_EQ(clock.GetSendTime(START), START);
+
+        // A pong without a ping is ignored
+        clock.OnPong(START);
+        EXPECT_EQ(clock.GetOneWayDelay(), 0ns);
+
+        clock.OnPingSent(START);
+        clock.OnPong(START + 80ms);
+        EXPECT_EQ(clock.GetOneWayDelay(), 40ms);
+
+        // Two pings in flight are answered in order
+        clock.OnPingSent(START + 1s);
+        clock.OnPingSent(START + 1s + 10ms);
+        clock.OnPong(START + 1s + 60ms);
+        clock.OnPong(START + 1s + 200ms);
+        EXPECT_EQ(clock.GetOneWayDelay(), 30ms);
+
+        EXPECT_EQ(clock.GetSentAt(START + 1s), START + 1s - 30ms);
+        EXPECT_EQ(clock.GetSendTime(START + 1s), START + 1s - 30ms);
+
+        // The shortest one eventually leaves the window
+        for (size_t i = 0; i < ClockSync::WINDOW; i++) {
+            clock.OnPingSent(START + 2s);
+            clock.OnPong(START + 2s + 100ms);
+        }
+
+        EXPECT_EQ(clock.GetOneWayDelay(), 50ms);
+    }
+
+    TEST(ClockSyncTest, KeepsTheLeastDelayedOffset) {
+        ClockSync clock;
+        EXPECT_FALSE(clock.HasOffset());
+
+        clock.OnPingSent(START);
+        clock.OnPong(START + 20ms);
+
+        // The server is 5s ahead, one message was queued for 200ms on the way
+        auto server_ms = [](now_t at) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(at.time_since_epoch() + 5s).count();
+        };
+
+        clock.OnServerTime(server_ms(START), START + 10ms + 200ms);
+        clock.OnServerTime(server_ms(START + 1s), START + 1s + 10ms);
+
+        ASSERT_TRUE(clock.HasOffset());
+        EXPECT_EQ(clock.GetOffset(), 5s);
+    }
+} // namespace dfs
@@ -0,0 +1,160 @@
+#include <array>
+#include <cstdint>
+#include <game/common.pb.h>
+#include <game/gamemap.pb.h>
+#include <game/interactive_element.pb.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "event-views.hh"
+
+namespace dfs
+{
+    using namespace com::ankama::dofus::server::game::protocol;
+
+    TEST(EventViewsTest, ReadsMapMovements) {
+        gamemap::MapMovementEvent evt;
+        evt.set_character_id(-123456789012);
+        evt.set_cautious(true);
+        evt.set_direction(3);
+
+        for (int32_t cell : {12, 26, 127, 128, 559})
+            evt.add_cells(cell);
+
+        auto serialized = evt.SerializeAsString();
+        auto view = MapMovementEventView::Read(serialized);
+        ASSERT_TRUE(view);
+
+        EXPECT_EQ(view->GetCharacterId(), -123456789012);
+        EXPECT_TRUE(view->IsCautious());
+        ASSERT_EQ(view->GetCellCount(), 5u);
+
+        std::array<int32_t, 8> buffer{};
+        auto cells = view->GetCells(buffer);
+        EXPECT_EQ(std::vector<int32_t>(cells.begin(), cells.end()), std::vector<int32_t>({12, 26, 127, 128, 559}));
+
+        // Too small a buffer gets the beginning of the path
+        EXPECT_EQ(view->GetCells(std::span(buffer).first(2)).size(), 2u);
+
+        // Not moving
+        gamemap::MapMovementEvent still;
+        still.set_character_id(1);
+        serialized = still.SerializeAsString();
+        view = MapMovementEventView::Read(serialized);
+        ASSERT_TRUE(view);
+        EXPECT_EQ(view->GetCellCount(), 0u);
+    }
+
+    TEST(EventViewsTest, LeavesOddMapMovementsToTheFullParse) {
+        // Unpacked cells: field 1 as varints
+        std::string unpacked("\x08\x0c\x08\x1a\x18\x01", 6);
+        EXPECT_FALSE(MapMovementEventView::Read(unpacked));
+
+        // Cells ending within a varint
+        std::string truncated("\x0a\x02\x0c\x80", 4);
+        EXPECT_FALSE(MapMovementEventView::Read(truncated));
+
+        // Malformed
+        EXPECT_FALSE(MapMovementEventView::Read("\xff\xff\xff"));
+    }
+
+    TEST(EventViewsTest, ReadsElementEvents) {
+        interactive::element::StatedElementUpdatedEvent updated;
+        updated.mutable_stated_element()->set_element_id(500012);
+        updated.mutable_stated_element()->set_cell_id(-1);
+        updated.mutable_stated_element()->set_state(2);
+        updated.mutable_stated_element()->set_on_current_map(true);
+
+        auto stated = StatedElementUpdatedEventView::Read(updated.SerializeAsString());
+        ASSERT_TRUE(stated);
+        EXPECT_EQ(stated->ElementId, 500012);
+        EXPECT_EQ(stated->CellId, -1);
+        EXPECT_EQ(stated->State, 2);
+        EXPECT_TRUE(stated->OnCurrentMap);
+
+        EXPECT_FALSE(StatedElementUpdatedEventView::Read("\x0a\x05\x08"));
+    }
+
+    TEST(EventViewsTest, SummarizesActors) {
+        gamemap::GameRolePlayShowActorsEvent evt;
+
+        auto player = evt.add_actors();
+        player->set_actor_id(1000);
+        player->mutable_disposition()->set_cell_id(300);
+        auto named = player->mutable_actor_information()->mutable_role_play_actor()->mutable_named_actor();
+        named->set_name("Player-1");
+        named->mutable_humanoid_information()->set_account_id(2000);
+
+        auto monsters = evt.add_actors();
+        monsters->set_actor_id(-100);
+        monsters->mutable_disposition()->set_cell_id(42);
+        auto group = monsters->mutable_actor_information()
+                         ->mutable_role_play_actor()
+                         ->mutable_monster_group_actor()
+                         ->mutable_identification();
+        group->mutable_main_creature()->set_level(20);
+        group->add_underlings()->set_level(10);
+        group->add_underlings()->set_level(11);
+
+        auto tax_collector = evt.add_actors();
+        tax_collector->set_actor_id(-200);
+        tax_collector->mutable_disposition()->set_cell_id(43);
+        tax_collector->mutable_actor_information()->mutable_role_play_actor()->mutable_tax_collector_actor();
+
+        auto npc = evt.add_actors();
+        npc->set_actor_id(-300);
+        npc->mutable_actor_information()->mutable_role_play_actor()->mutable_npc_actor();
+
+        auto mount = evt.add_actors();
+        mount->set_actor_id(-400);
+        mount->mutable_disposition()->set_cell_id(0);
+        mount->mutable_actor_information()
+            ->mutable_role_play_actor()
+            ->mutable_named_actor()
+            ->mutable_mount_information();
+
+        // Without actor information
+        evt.add_actors()->set_actor_id(-500);
+
+        auto serialized = evt.SerializeAsString();
+        GameRolePlayShowActorsEventView view(serialized);
+        std::vector<ActorSummary> actors;
+
+        ActorSummary actor;
+        while (view.Next(actor))
+            actors.push_back(actor);
+
+        EXPECT_FALSE(view.HasFailed());
+        ASSERT_EQ(actors.size(), 6u);
+
+        EXPECT_EQ(actors[0].Id, 1000);
+        EXPECT_EQ(actors[0].Type, ActorSummary::Kind::Player);
+        EXPECT_EQ(actors[0].CellId, 300);
+        EXPECT_EQ(actors[0].Name, "Player-1");
+
+        EXPECT_EQ(actors[1].Id, -100);
+        EXPECT_EQ(actors[1].Type, ActorSummary::Kind::Monster);
+        EXPECT_EQ(actors[1].CellId, 42);
+        EXPECT_EQ(actors[1].EnnemyCount, 3);
+        EXPECT_EQ(actors[1].TotalLevel, 41);
+
+        EXPECT_EQ(actors[2].Type, ActorSummary::Kind::Monster);
+        EXPECT_EQ(actors[2].EnnemyCount, 1);
+        EXPECT_EQ(actors[2].TotalLevel, 0);
+
+        EXPECT_EQ(actors[3].Type, ActorSummary::Kind::Npc);
+        EXPECT_FALSE(actors[3].CellId);
+
+        EXPECT_EQ(actors[4].Type, ActorSummary::Kind::Other);
+        EXPECT_EQ(actors[4].CellId, 0);
+
+        EXPECT_EQ(actors[5].Id, -500);
+        EXPECT_EQ(actors[5].Type, ActorSummary::Kind::None);
+
+        // A malformed actor stops the reading
+        GameRolePlayShowActorsEventView malformed(std::string_view("\x0a\x02\x08\xff", 4));
+        EXPECT_FALSE(malformed.Next(actor));
+        EXPECT_TRUE(malformed.HasFailed());
+    }
+} // namespace dfs
@@ -0,0 +1,98 @@
+#include <array>
+#include <cstdint>
+#include <game/game_message.pb.h>
+#include <game/gamemap.pb.h>
+#include <game/interactive_element.pb.h>
+#include <google/protobuf/any.pb.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "messages.hh"
+#include "utils.hh"
+
+namespace dfs
+{
+    using namespace com::ankama::dofus::server::game::protocol;
+
+    /// The frame protobuf encodes for `request`: wrapped in an `Any`, a `Request` and a `GameMessage`, behind its
+    /// length.
+    static std::vector<uint8_t> frame_of(const char *type_url, const google::protobuf::Message &request) {
+        GameMessage message;
+        auto content = message.mutable_request()->mutable_content();
+        content->set_type_url(type_url);
+        content->set_value(request.SerializeAsString());
+
+        auto payload = message.SerializeAsString();
+
+        std::vector<uint8_t> frame;
+        for (auto length = payload.size(); ; length >>= 7) {
+            frame.push_back(static_cast<uint8_t>(length & 0x7f) | (length >= 0x80 ? 0x80 : 0));
+            if (length < 0x80)
+                break;
+        }
+
+        frame.insert(frame.end(), payload.begin(), payload.end());
+        return frame;
+    }
+
+    static std::vector<uint8_t> forged(const std::array<uint8_t, Messages::MAX_FORGED_FRAME_SIZE> &frame,
+                                       size_t length) {
+        return {frame.begin(), frame.begin() + length};
+    }
+
+    TEST(ForgeRequestsTest, EncodesLikeProtobuf) {
+        std::array<uint8_t, Messages::MAX_FORGED_FRAME_SIZE> frame;
+
+        std::vector<PathElement> path{{12, DIRECTION_SOUTH_EAST}, {40, DIRECTION_SOUTH}, {555, DIRECTION_NORTH_WEST}};
+
+        for (auto map_id : {189793795, -20000, 0}) {
+            for (auto cautious : {false, true}) {
+                gamemap::MapMovementRequest movement;
+                for (auto step : path)
+                    movement.add_key_cells(step.ToCompressed());
+                movement.set_map_id(map_id);
+                movement.set_cautious(cautious);
+
+                auto length = Messages::ForgeMapMovementRequest(path, map_id, cautious, frame);
+                EXPECT_EQ(forged(frame, length), frame_of("type.ankama.com/ifv", movement));
+
+                gamemap::MapChangeRequest change;
+                change.set_map_id(map_id);
+                change.set_auto_pilot(cautious);
+
+                length = Messages::ForgeMapChangeRequest(map_id, cautious, frame);
+                EXPECT_EQ(forged(frame, length), frame_of("type.ankama.com/iga", change));
+            }
+        }
+
+        // Standing still
+        gamemap::MapMovementRequest still;
+        still.set_map_id(1);
+        auto length = Messages::ForgeMapMovementRequest({}, 1, false, frame);
+        EXPECT_EQ(forged(frame, length), frame_of("type.ankama.com/ifv", still));
+
+        interactive::element::InteractiveUseRequest use;
+        use.set_element_id(500012);
+        use.set_skill_instance_uid(-7);
+        length = Messages::ForgeInteractiveUseRequest(500012, -7, frame);
+        EXPECT_EQ(forged(frame, length), frame_of("type.ankama.com/hzk", use));
+
+        auto confirm = Messages::ForgeMapMovementConfirmRequest();
+        EXPECT_EQ(std::vector<uint8_t>(confirm.begin(), confirm.end()),
+                  frame_of("type.ankama.com/ifx", gamemap::MapMovementConfirmRequest()));
+    }
+
+    TEST(ForgeRequestsTest, RejectsSmallBuffers) {
+        std::array<uint8_t, 8> small;
+        EXPECT_EQ(Messages::ForgeMapChangeRequest(189793795, false, small), 0u);
+
+        // A path through every cell of a map fits
+        std::vector<PathElement> path;
+        for (int32_t cell = 0; cell < 560; cell++)
+            path.push_back({cell, DIRECTION_NORTH_EAST});
+
+        std::array<uint8_t, Messages::MAX_FORGED_FRAME_SIZE> frame;
+        EXPECT_GT(Messages::ForgeMapMovementRequest(path, 189793795, true, frame), 0u);
+    }
+} // namespace dfs
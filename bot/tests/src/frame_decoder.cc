@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "frame-decoder.hh"
+
+namespace dfs
+{
+    class FrameDecoderTest : public testing::Test {
+      protected:
+        /// Appends a frame whose payload is `length` times `fill`.
+        static void AddFrame(std::vector<uint8_t> &stream, size_t length, uint8_t fill) {
+            size_t value = length;
+            while (value >= 0x80) {
+                stream.push_back(static_cast<uint8_t>(value) | 0x80);
+                value >>= 7;
+            }
+
+            stream.push_back(static_cast<uint8_t>(value));
+            stream.insert(stream.end(), length, fill);
+        }
+
+        /// Feeds the stream in chunks of `chunk_size` bytes and returns the payloads of every decoded frame.
+        static std::vector<std::vector<uint8_t>> Decode(FrameDecoder &decoder, const std::vector<uint8_t> &stream,
+                                                        size_t chunk_size) {
+            std::vector<std::vector<uint8_t>> payloads;
+
+            for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+                size_t length = std::min(chunk_size, stream.size() - offset);
+                EXPECT_TRUE(decoder.Append(stream.data() + offset, length));
+
+                while (auto frame = decoder.Next()) {
+                    auto payload = frame->GetPayload();
+                    payloads.emplace_back(payload.begin(), payload.end());
+                }
+            }
+
+            return payloads;
+        }
+    };
+
+    TEST_F(FrameDecoderTest, SingleFrame) {
+        std::vector<uint8_t> stream;
+        AddFrame(stream, 10, 'a');
+
+        FrameDecoder decoder(64);
+        ASSERT_TRUE(decoder.Append(stream.data(), stream.size()));
+
+        auto frame = decoder.Next();
+        ASSERT_TRUE(frame.has_value());
+        ASSERT_EQ(frame->HeaderLength, 1);
+        ASSERT_EQ(frame->Bytes.size(), 11);
+        ASSERT_EQ(frame->GetPayload()[0], 'a');
+
+        ASSERT_FALSE(decoder.Next().has_value());
+        ASSERT_TRUE(decoder.GetBuffered().empty());
+    }
+
+    TEST_F(FrameDecoderTest, FramesSpanningReads) {
+        // Two byte length prefixes, so some chunk boundaries also split the header
+        std::vector<uint8_t> stream;
+        AddFrame(stream, 200, 'a');
+        AddFrame(stream, 0, 0);
+        AddFrame(stream, 3, 'b');
+        AddFrame(stream, 300, 'c');
+
+        for (size_t chunk_size : {1, 2, 3, 7, 64, 201, 1000}) {
+            FrameDecoder decoder(512);
+            auto payloads = Decode(decoder, stream, chunk_size);
+
+            ASSERT_EQ(payloads.size(), 4) << "chunk size " << chunk_size;
+            ASSERT_EQ(payloads[0], std::vector<uint8_t>(200, 'a'));
+            ASSERT_TRUE(payloads[1].empty());
+            ASSERT_EQ(payloads[2], std::vector<uint8_t>(3, 'b'));
+            ASSERT_EQ(payloads[3], std::vector<uint8_t>(300, 'c'));
+            ASSERT_TRUE(decoder.GetBuffered().empty());
+        }
+    }
+
+    TEST_F(FrameDecoderTest, ReusesStorage) {
+        // Much more data than the capacity goes through, frames never being consumed on a boundary
+        std::vector<uint8_t> stream;
+        for (int i = 0; i < 100; i++)
+            AddFrame(stream, 40, static_cast<uint8_t>(i));
+
+        // Room for a partial frame plus one read
+        FrameDecoder decoder(80);
+        auto payloads = Decode(decoder, stream, 30);
+
+        ASSERT_EQ(payloads.size(), 100);
+        for (int i = 0; i < 100; i++)
+            ASSERT_EQ(payloads[i], std::vector<uint8_t>(40, static_cast<uint8_t>(i)));
+    }
+
+    TEST_F(FrameDecoderTest, FrameLargerThanCapacity) {
+        std::vector<uint8_t> stream;
+        AddFrame(stream, 100, 'a');
+
+        FrameDecoder decoder(64);
+        ASSERT_TRUE(decoder.Append(stream.data(), 50));
+        ASSERT_FALSE(decoder.Next().has_value());
+        ASSERT_FALSE(decoder.Append(stream.data() + 50, 51));
+    }
+
+    TEST_F(FrameDecoderTest, PrepareAndConsume) {
+        FrameDecoder decoder(64);
+
+        auto room = decoder.Prepare(4);
+        ASSERT_EQ(room.size(), 4);
+        room[0] = 'h';
+        room[1] = 'i';
+        room[2] = 2;
+        room[3] = 'o';
+        decoder.Commit(4);
+
+        ASSERT_EQ(decoder.GetBuffered().size(), 4);
+        decoder.Consume(2);
+
+        // The frame is not complete yet
+        ASSERT_FALSE(decoder.Next().has_value());
+
+        ASSERT_TRUE(decoder.Append(reinterpret_cast<const uint8_t *>("k"), 1));
+        auto frame = decoder.Next();
+        ASSERT_TRUE(frame.has_value());
+        ASSERT_EQ(frame->GetPayload()[0], 'o');
+        ASSERT_EQ(frame->GetPayload()[1], 'k');
+    }
+
+    TEST_F(FrameDecoderTest, PeekPartial) {
+        std::vector<uint8_t> stream;
+        AddFrame(stream, 200, 'a');
+
+        FrameDecoder decoder(512);
+        ASSERT_TRUE(decoder.Append(stream.data(), 1));
+        ASSERT_FALSE(decoder.PeekPartial().has_value());
+
+        ASSERT_TRUE(decoder.Append(stream.data() + 1, 50));
+        auto partial = decoder.PeekPartial();
+        ASSERT_TRUE(partial.has_value());
+        ASSERT_EQ(partial->HeaderLength, 2);
+        ASSERT_EQ(partial->Length, 202);
+        ASSERT_EQ(partial->Bytes.size(), 51);
+
+        // Peeking does not consume anything
+        ASSERT_FALSE(decoder.Next().has_value());
+        ASSERT_TRUE(decoder.Append(stream.data() + 51, stream.size() - 51));
+        ASSERT_TRUE(decoder.Next().has_value());
+    }
+
+    TEST_F(FrameDecoderTest, InvalidLength) {
+        std::vector<uint8_t> stream(11, 0xFF);
+
+        FrameDecoder decoder(64);
+        ASSERT_TRUE(decoder.Append(stream.data(), stream.size()));
+        ASSERT_FALSE(decoder.Next().has_value());
+        ASSERT_TRUE(decoder.IsCorrupted());
+    }
+} // namespace dfs
@@ -0,0 +1,66 @@
+#include <connection/login_message.pb.h>
+#include <cstdint>
+#include <game/game_message.pb.h>
+#include <google/protobuf/any.pb.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "messages.hh"
+
+namespace dfs
+{
+    /// `message` behind a one byte length prefix
+    static std::vector<uint8_t> frame_of(const std::string &message) {
+        std::vector<uint8_t> frame{static_cast<uint8_t>(message.size())};
+        frame.insert(frame.end(), message.begin(), message.end());
+        return frame;
+    }
+
+    static FrameAction handle(const Messages &messages, const std::vector<uint8_t> &frame, bool &handled,
+                              std::vector<uint8_t> &rewritten) {
+        return messages.HandleMessage(frame.data(), frame.size() - 1, 1, nullptr, nullptr, rewritten, &handled);
+    }
+
+    TEST(HandleMessageTest, ForwardsGameMessagesUntouched) {
+        using namespace com::ankama::dofus::server::game::protocol;
+
+        Messages messages;
+        Messages::SetConnected(true);
+
+        GameMessage m;
+        m.mutable_event()->mutable_content()->set_type_url("type.ankama.com/zzz");
+        m.mutable_event()->mutable_content()->set_value("payload");
+
+        bool handled = true;
+        std::vector<uint8_t> rewritten;
+        EXPECT_EQ(handle(messages, frame_of(m.SerializeAsString()), handled, rewritten), FrameAction::Forward);
+        EXPECT_FALSE(handled);
+        EXPECT_TRUE(rewritten.empty());
+
+        // Malformed messages are forwarded as well
+        EXPECT_EQ(handle(messages, frame_of("\xff\xff\xff"), handled, rewritten), FrameAction::Forward);
+        EXPECT_FALSE(handled);
+        EXPECT_TRUE(rewritten.empty());
+
+        Messages::SetConnected(false);
+    }
+
+    TEST(HandleMessageTest, ForwardsLoginMessagesUntouched) {
+        using namespace com::ankama::dofus::server::connection::protocol;
+
+        Messages messages;
+        Messages::SetConnected(false);
+
+        LoginMessage m;
+        m.mutable_request()->set_uuid("uuid");
+        m.mutable_request()->mutable_ping();
+
+        bool handled = false;
+        std::vector<uint8_t> rewritten;
+        EXPECT_EQ(handle(messages, frame_of(m.SerializeAsString()), handled, rewritten), FrameAction::Forward);
+        EXPECT_TRUE(handled);
+        EXPECT_TRUE(rewritten.empty());
+        EXPECT_FALSE(Messages::IsConnected());
+    }
+} // namespace dfs
@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "handoff.hh"
+
+namespace dfs
+{
+    static ino_t get_inode(int fd) {
+        struct stat st{};
+        fstat(fd, &st);
+        return st.st_ino;
+    }
+
+    TEST(HandoffTest, SocketsAndStateGoThrough) {
+        int channel[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+
+        int listener[2], client[2], server[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, listener), 0);
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, client), 0);
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, server), 0);
+
+        Handoff sent;
+        sent.Listeners.push_back(listener[0]);
+        sent.Connected = true;
+
+        // Larger than a socket buffer, the receiver must be reading meanwhile
+        SessionSnapshot relaying{client[0], server[0], std::vector<uint8_t>(1024 * 1024, 42)};
+        SessionSnapshot handshake{client[1], -1, {1, 2, 3}};
+        sent.Sessions.push_back(relaying);
+        sent.Sessions.push_back(handshake);
+
+        bool send_result = false;
+        std::thread sender([&] { send_result = SendHandoff(channel[0], sent); });
+
+        auto received = ReceiveHandoff(channel[1]);
+        sender.join();
+
+        ASSERT_TRUE(send_result);
+        ASSERT_TRUE(received.has_value());
+        ASSERT_TRUE(received->Connected);
+
+        ASSERT_EQ(received->Listeners.size(), 1);
+        ASSERT_EQ(get_inode(received->Listeners[0]), get_inode(listener[0]));
+
+        ASSERT_EQ(received->Sessions.size(), 2);
+        ASSERT_EQ(get_inode(received->Sessions[0].ClientFd), get_inode(client[0]));
+        ASSERT_EQ(get_inode(received->Sessions[0].ServerFd), get_inode(server[0]));
+        ASSERT_EQ(received->Sessions[0].State, relaying.State);
+        ASSERT_EQ(received->Sessions[1].ServerFd, -1);
+        ASSERT_EQ(received->Sessions[1].State, handshake.State);
+
+        // The received descriptors are new ones referring to the same sockets
+        ASSERT_NE(received->Sessions[0].ClientFd, client[0]);
+
+        CloseHandoff(*received);
+        CloseHandoff(sent);
+
+        for (int fd : {channel[0], channel[1], listener[1], server[1]})
+            close(fd);
+    }
+
+    TEST(HandoffTest, InterruptedHandoffYieldsNothing) {
+        int channel[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+
+        // The previous process goes away in the middle of a record
+        const uint8_t truncated[] = {1, 0, 0};
+        ASSERT_EQ(write(channel[0], truncated, sizeof(truncated)), sizeof(truncated));
+        close(channel[0]);
+
+        ASSERT_FALSE(ReceiveHandoff(channel[1]).has_value());
+        close(channel[1]);
+    }
+} // namespace dfs
@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <gtest/gtest.h>
+
+#include "latency-histogram.hh"
+
+namespace dfs
+{
+    TEST(LatencyHistogramTest, BucketsKeepRelativePrecision) {
+        // Exact for small values
+        for (uint64_t value = 0; value < LatencyHistogram::SUB_BUCKETS; value++)
+            EXPECT_EQ(LatencyHistogram::ValueOf(LatencyHistogram::IndexOf(value)), value);
+
+        size_t previous = 0;
+        for (uint64_t value = 1; value < (uint64_t{1} << 37); value = value * 5 / 4 + 1) {
+            auto index = LatencyHistogram::IndexOf(value);
+            ASSERT_LT(index, LatencyHistogram::BUCKETS);
+            EXPECT_GE(index, previous);
+            previous = index;
+
+            auto bucket_value = static_cast<double>(LatencyHistogram::ValueOf(index));
+            EXPECT_NEAR(bucket_value, value, value / 32.0 + 1) << value;
+        }
+
+        // Saturates past a couple of minutes
+        EXPECT_EQ(LatencyHistogram::IndexOf(UINT64_MAX), LatencyHistogram::BUCKETS - 1);
+    }
+
+    TEST(LatencyHistogramTest, Percentiles) {
+        LatencyHistogram first;
+        LatencyHistogram second;
+
+        // 1 to 1000us, uniformly, over two histograms
+        for (int64_t us = 1; us <= 1000; us++)
+            (us % 2 ? first : second).Record(us * 1000);
+
+        // Negative durations (clock adjustments) count as zero
+        second.Record(-5);
+
+        LatencySnapshot snapshot;
+        EXPECT_EQ(snapshot.GetPercentile(0.5), 0u);
+
+        snapshot.Add(first);
+        snapshot.Add(second);
+
+        EXPECT_EQ(snapshot.GetCount(), 1001u);
+        EXPECT_NEAR(snapshot.GetPercentile(0.5), 500'000.0, 500'000.0 / 32);
+        EXPECT_NEAR(snapshot.GetPercentile(0.99), 990'000.0, 990'000.0 / 32);
+        EXPECT_NEAR(snapshot.GetMax(), 1'000'000.0, 1'000'000.0 / 32);
+        EXPECT_EQ(snapshot.GetPercentile(0), 0u);
+    }
+} // namespace dfs
@@ -0,0 +1,115 @@
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "log.hh"
+
+namespace dfs
+{
+    /// Publishes a record of `size` bytes (header included) holding `value` after its header.
+    static bool push(LogRing &ring, size_t size, uint64_t value) {
+        auto bytes = ring.Reserve(size);
+        if (bytes == nullptr)
+            return false;
+
+        LogRecord record{};
+        record.Size = static_cast<uint32_t>(size);
+        memcpy(bytes, &record, sizeof(record));
+        LogArgument<uint64_t>::Write(bytes + sizeof(record), value);
+
+        ring.Commit();
+        return true;
+    }
+
+    TEST(LogTest, ArgumentsRoundTrip) {
+        uint8_t buffer[64];
+        std::string text = "hello";
+
+        auto out = LogArgument<int>::Write(buffer, -42);
+        out = LogArgument<std::string>::Write(out, text);
+        out = LogArgument<double>::Write(out, 0.5);
+        EXPECT_EQ(static_cast<size_t>(out - buffer), sizeof(int) + sizeof(uint32_t) + text.size() + sizeof(double));
+
+        // The string is a copy
+        text = "world";
+
+        const uint8_t *in = buffer;
+        EXPECT_EQ(LogArgument<int>::Read(in), -42);
+        EXPECT_EQ(LogArgument<std::string>::Read(in), "hello");
+        EXPECT_EQ(LogArgument<double>::Read(in), 0.5);
+        EXPECT_EQ(in, out);
+    }
+
+    TEST(LogTest, RingWrapsAndDrops) {
+        auto ring = std::make_unique<LogRing>();
+        constexpr size_t SIZE = LogRing::CAPACITY / 8 + 24;
+
+        // Fills the ring until it is full, which only counts a drop
+        uint64_t pushed = 0;
+        while (push(*ring, SIZE, pushed))
+            pushed++;
+
+        EXPECT_EQ(pushed, 7u);
+        EXPECT_EQ(ring->GetDropped(), 1u);
+
+        uint64_t drained = 0;
+        ring->Drain([&](const LogRecord &record, const uint8_t *arguments) {
+            EXPECT_EQ(record.Size, SIZE);
+            EXPECT_EQ(LogArgument<uint64_t>::Read(arguments), drained);
+            drained++;
+        });
+        EXPECT_EQ(drained, pushed);
+        EXPECT_TRUE(ring->IsEmpty());
+
+        // Those do not fit before the end of the storage anymore and start over at its beginning
+        for (uint64_t i = 0; i < 3; i++)
+            ASSERT_TRUE(push(*ring, SIZE, pushed + i));
+
+        ring->Drain([&](const LogRecord &, const uint8_t *arguments) {
+            EXPECT_EQ(LogArgument<uint64_t>::Read(arguments), drained);
+            drained++;
+        });
+        EXPECT_EQ(drained, pushed + 3);
+
+        // Too large to ever fit
+        EXPECT_FALSE(push(*ring, LogRing::MAX_RECORD_SIZE + 8, 0));
+        EXPECT_EQ(ring->GetDropped(), 2u);
+    }
+
+    TEST(LogTest, RateLimitPerCallSite) {
+        constexpr int64_t SECOND = 1'000'000'000;
+        static constexpr const char FIRST[] = "first {}";
+        static constexpr const char SECOND_SITE[] = "second {}";
+
+        auto ring = std::make_unique<LogRing>();
+        uint32_t suppressed = 0;
+
+        for (uint32_t i = 0; i < LogRing::RATE_LIMIT; i++)
+            ASSERT_TRUE(ring->Admit(FIRST, 0, suppressed));
+
+        for (int i = 0; i < 5; i++)
+            EXPECT_FALSE(ring->Admit(FIRST, SECOND / 2, suppressed));
+
+        // Other call sites have their own budget
+        EXPECT_TRUE(ring->Admit(SECOND_SITE, SECOND / 2, suppressed));
+        EXPECT_EQ(suppressed, 0u);
+
+        // The next window reports what was dropped
+        EXPECT_TRUE(ring->Admit(FIRST, SECOND, suppressed));
+        EXPECT_EQ(suppressed, 5u);
+        EXPECT_TRUE(ring->Admit(FIRST, SECOND, suppressed));
+        EXPECT_EQ(suppressed, 0u);
+    }
+
+    TEST(LogTest, LevelNames) {
+        LogLevel level;
+        EXPECT_TRUE(Log::ParseLevel("warning", level));
+        EXPECT_EQ(level, LogLevel::Warning);
+        EXPECT_TRUE(Log::ParseLevel("trace", level));
+        EXPECT_EQ(level, LogLevel::Trace);
+        EXPECT_FALSE(Log::ParseLevel("verbose", level));
+    }
+} // namespace dfs
@@ -0,0 +1,67 @@
+#include <game/common.pb.h>
+#include <game/gamemap.pb.h>
+#include <google/protobuf/arena.h>
+#include <gtest/gtest.h>
+
+#include "message-arena.hh"
+
+namespace dfs
+{
+    using namespace com::ankama::dofus::server::game::protocol::gamemap;
+    using DofusActor = com::ankama::dofus::server::game::protocol::common::ActorPositionInformation;
+
+    /// Decodes a map with a few dozen actors, like the game sends on a map change.
+    static void decode_map(google::protobuf::Arena *arena) {
+        MapComplementaryInformationEvent evt;
+        for (int i = 0; i < 40; i++) {
+            auto *actor = evt.add_actors();
+            actor->set_actor_id(i);
+            actor->mutable_disposition()->set_cell_id(i * 7);
+        }
+
+        auto serialized = evt.SerializeAsString();
+        auto used = arena->SpaceUsed();
+
+        auto &decoded = *google::protobuf::Arena::CreateMessage<MapComplementaryInformationEvent>(arena);
+        ASSERT_TRUE(decoded.ParseFromString(serialized));
+        ASSERT_EQ(decoded.actors_size(), 40);
+
+        // The actors went in the arena along with the event
+        ASSERT_GT(arena->SpaceUsed(), used + 40 * sizeof(DofusActor));
+    }
+
+    TEST(MessageArenaTest, GrowsToTheLargestBatch) {
+        MessageArena arena;
+        EXPECT_EQ(arena.GetBlockSize(), 0u);
+
+        // Nothing decoded, nothing to grow
+        arena.Reset();
+        EXPECT_EQ(arena.GetBlockSize(), 0u);
+
+        for (int i = 0; i < 4; i++)
+            decode_map(arena.Get());
+
+        arena.Reset();
+        auto block_size = arena.GetBlockSize();
+        EXPECT_GE(block_size, MessageArena::MIN_BLOCK_SIZE);
+        EXPECT_GE(block_size, arena.GetHighWaterMark());
+
+        // The same batch now fits in the first block
+        for (int i = 0; i < 4; i++)
+            decode_map(arena.Get());
+
+        EXPECT_EQ(arena.Get()->SpaceAllocated(), block_size);
+
+        arena.Reset();
+        EXPECT_EQ(arena.GetBlockSize(), block_size);
+        EXPECT_EQ(arena.Get()->SpaceUsed(), 0u);
+
+        // A larger one grows it again
+        for (int i = 0; i < 64; i++)
+            decode_map(arena.Get());
+
+        arena.Reset();
+        EXPECT_GT(arena.GetBlockSize(), block_size);
+        EXPECT_LE(arena.GetBlockSize(), MessageArena::MAX_BLOCK_SIZE);
+    }
+} // namespace dfs
@@ -0,0 +1,29 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "metrics.hh"
+
+namespace dfs
+{
+    TEST(MetricsTest, SumsEveryThread) {
+        auto before = Metrics::Get(Counter::PathSearches);
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([] {
+                for (int j = 0; j < 1000; j++)
+                    Metrics::Add(Counter::PathSearches, 1);
+            });
+        }
+
+        for (auto &thread : threads)
+            thread.join();
+
+        // The threads exited, what they counted stays
+        EXPECT_EQ(Metrics::Get(Counter::PathSearches) - before, 4000u);
+
+        Metrics::Add(Counter::PathSearches, 2);
+        EXPECT_EQ(Metrics::Get(Counter::PathSearches) - before, 4002u);
+    }
+} // namespace dfs
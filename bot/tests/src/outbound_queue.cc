@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "outbound-queue.hh"
+#include "snapshot.hh"
+
+namespace dfs
+{
+    class OutboundQueueTest : public testing::Test {
+      protected:
+        OutboundQueueTest() {
+            socketpair(AF_UNIX, SOCK_STREAM, 0, m_Sockets);
+            fcntl(m_Sockets[0], F_SETFL, O_NONBLOCK);
+        }
+
+        ~OutboundQueueTest() override {
+            close(m_Sockets[0]);
+            close(m_Sockets[1]);
+        }
+
+        std::vector<uint8_t> ReadAll() {
+            std::vector<uint8_t> data;
+            uint8_t buffer[4096];
+
+            fcntl(m_Sockets[1], F_SETFL, O_NONBLOCK);
+            while (true) {
+                auto bytes_read = read(m_Sockets[1], buffer, sizeof(buffer));
+                if (bytes_read <= 0)
+                    break;
+
+                data.insert(data.end(), buffer, buffer + bytes_read);
+            }
+
+            return data;
+        }
+
+        int m_Sockets[2];
+    };
+
+    TEST_F(OutboundQueueTest, KeepsOrder) {
+        OutboundQueue queue;
+
+        const uint8_t raw[] = {1, 2, 3};
+        queue.Push(raw, sizeof(raw));
+        queue.Push(std::vector<uint8_t>{4, 5});
+        queue.Push(raw, 1);
+
+        ASSERT_EQ(queue.GetSize(), 6);
+        ASSERT_TRUE(queue.Flush(m_Sockets[0]));
+        ASSERT_TRUE(queue.IsEmpty());
+
+        ASSERT_EQ(ReadAll(), (std::vector<uint8_t>{1, 2, 3, 4, 5, 1}));
+    }
+
+    TEST_F(OutboundQueueTest, HoldsFramesDuringPartialOne) {
+        OutboundQueue queue;
+
+        const uint8_t partial[] = {1, 2, 3, 4};
+        queue.PushPartial(partial, 2, false);
+        queue.Push(std::vector<uint8_t>{9, 9});
+        ASSERT_TRUE(queue.Flush(m_Sockets[0]));
+
+        queue.PushPartial(partial + 2, 2, true);
+        ASSERT_TRUE(queue.Flush(m_Sockets[0]));
+
+        ASSERT_EQ(ReadAll(), (std::vector<uint8_t>{1, 2, 3, 4, 9, 9}));
+    }
+
+    TEST_F(OutboundQueueTest, MoreChunksThanOneBatch) {
+        OutboundQueue queue;
+        std::vector<uint8_t> expected;
+
+        for (size_t i = 0; i < OutboundQueue::MAX_BATCH * 3; i++) {
+            queue.Push(std::vector<uint8_t>(1, static_cast<uint8_t>(i)));
+            expected.push_back(static_cast<uint8_t>(i));
+        }
+
+        ASSERT_TRUE(queue.Flush(m_Sockets[0]));
+        ASSERT_EQ(ReadAll(), expected);
+    }
+
+    TEST_F(OutboundQueueTest, PartialWritesAndBackpressure) {
+        OutboundQueue queue;
+        std::vector<uint8_t> expected;
+
+        // Much more than the socket buffer
+        for (int i = 0; i < 64; i++) {
+            std::vector<uint8_t> frame(32 * 1024, static_cast<uint8_t>(i));
+            expected.insert(expected.end(), frame.begin(), frame.end());
+            queue.Push(std::move(frame));
+        }
+
+        ASSERT_TRUE(queue.IsCongested());
+
+        std::vector<uint8_t> received;
+        uint8_t buffer[64 * 1024];
+
+        while (!queue.IsEmpty()) {
+            ASSERT_TRUE(queue.Flush(m_Sockets[0]));
+
+            auto bytes_read = read(m_Sockets[1], buffer, sizeof(buffer));
+            ASSERT_GT(bytes_read, 0);
+            received.insert(received.end(), buffer, buffer + bytes_read);
+
+            if (queue.GetSize() <= OutboundQueue::LOW_WATERMARK) {
+                ASSERT_FALSE(queue.IsCongested());
+            }
+        }
+
+        auto rest = ReadAll();
+        received.insert(received.end(), rest.begin(), rest.end());
+        ASSERT_EQ(received, expected);
+    }
+
+    TEST_F(OutboundQueueTest, PrependTakesBackInFlightBytes) {
+        OutboundQueue queue;
+        OutboundQueue in_flight;
+
+        queue.Push(std::vector<uint8_t>{1, 2, 3});
+        in_flight.Swap(queue);
+        in_flight.Consume(1);
+
+        queue.Push(std::vector<uint8_t>{4, 5});
+        queue.Prepend(in_flight);
+
+        ASSERT_TRUE(in_flight.IsEmpty());
+        ASSERT_EQ(queue.GetSize(), 4);
+        ASSERT_TRUE(queue.Flush(m_Sockets[0]));
+
+        ASSERT_EQ(ReadAll(), (std::vector<uint8_t>{2, 3, 4, 5}));
+    }
+
+    TEST_F(OutboundQueueTest, SaveAndRestore) {
+        OutboundQueue queue;
+
+        const uint8_t partial[] = {1, 2, 3, 4};
+        queue.Push(std::vector<uint8_t>{7, 8});
+        queue.Consume(1);
+        queue.PushPartial(partial, 2, false);
+        queue.Push(std::vector<uint8_t>{9, 9});
+
+        SnapshotWriter writer;
+        queue.Save(writer);
+
+        OutboundQueue restored;
+        SnapshotReader reader(writer.GetData());
+        ASSERT_TRUE(restored.Restore(reader));
+
+        // The held frame still waits for the end of the partial one
+        restored.PushPartial(partial + 2, 2, true);
+        ASSERT_TRUE(restored.Flush(m_Sockets[0]));
+
+        ASSERT_EQ(ReadAll(), (std::vector<uint8_t>{8, 1, 2, 3, 4, 9, 9}));
+    }
+} // namespace dfs
@@ -0,0 +1,82 @@
+#include <cstdint>
+#include <gtest/gtest.h>
+
+#include "latency-histogram.hh"
+#include "request-tracker.hh"
+
+namespace dfs
+{
+    static uint64_t round_trips(const LatencyStats &stats, size_t kind) {
+        LatencySnapshot snapshot;
+        snapshot.Add(stats.GetRoundTrip(kind));
+        return snapshot.GetCount();
+    }
+
+    TEST(RequestTrackerTest, MatchesResponses) {
+        LatencyStats stats(4);
+        RequestTracker tracker;
+
+        tracker.Sent(1, 2, 1000, stats);
+        tracker.Sent(2, 3, 2000, stats);
+
+        // Without a uid, nothing to match
+        tracker.Sent(0, 3, 2000, stats);
+        EXPECT_EQ(tracker.GetPending(), 2u);
+
+        tracker.Answered(2, 2000 + 50'000, stats);
+        tracker.Answered(7, 3000, stats);
+        EXPECT_EQ(tracker.GetPending(), 1u);
+
+        LatencySnapshot snapshot;
+        snapshot.Add(stats.GetRoundTrip(3));
+        EXPECT_EQ(snapshot.GetCount(), 1u);
+        EXPECT_NEAR(snapshot.GetMax(), 50'000.0, 50'000.0 / 32);
+
+        // Answered once only
+        tracker.Answered(2, 4000, stats);
+        EXPECT_EQ(round_trips(stats, 3), 1u);
+
+        tracker.Expire(1000 + RequestTracker::TIMEOUT - 1, stats);
+        EXPECT_EQ(tracker.GetPending(), 1u);
+
+        tracker.Expire(1000 + RequestTracker::TIMEOUT, stats);
+        EXPECT_EQ(tracker.GetPending(), 0u);
+        EXPECT_EQ(stats.GetUnanswered(2).load(), 1u);
+        EXPECT_EQ(round_trips(stats, 2), 0u);
+    }
+
+    TEST(RequestTrackerTest, CollisionsAndEviction) {
+        LatencyStats stats(1);
+        RequestTracker tracker;
+
+        // Uids a multiple of 64 apart share a few home slots, which exercises the probing and the removals
+        for (int32_t i = 1; i <= static_cast<int32_t>(RequestTracker::MAX_PENDING); i++)
+            tracker.Sent(i * 64, 0, i, stats);
+
+        EXPECT_EQ(tracker.GetPending(), RequestTracker::MAX_PENDING);
+
+        for (int32_t i = 1; i <= static_cast<int32_t>(RequestTracker::MAX_PENDING); i += 2)
+            tracker.Answered(i * 64, 100, stats);
+
+        EXPECT_EQ(round_trips(stats, 0), RequestTracker::MAX_PENDING / 2);
+
+        for (int32_t i = 2; i <= static_cast<int32_t>(RequestTracker::MAX_PENDING); i += 2)
+            tracker.Answered(i * 64, 100, stats);
+
+        EXPECT_EQ(round_trips(stats, 0), RequestTracker::MAX_PENDING);
+        EXPECT_EQ(tracker.GetPending(), 0u);
+
+        // Past the limit, the oldest request is given up on
+        for (int32_t i = 1; i <= static_cast<int32_t>(RequestTracker::MAX_PENDING) + 1; i++)
+            tracker.Sent(-i, 0, i, stats);
+
+        EXPECT_EQ(tracker.GetPending(), RequestTracker::MAX_PENDING);
+        EXPECT_EQ(stats.GetUnanswered(0).load(), 1u);
+
+        tracker.Answered(-1, 1000, stats);
+        EXPECT_EQ(round_trips(stats, 0), RequestTracker::MAX_PENDING);
+
+        tracker.Answered(-2, 1000, stats);
+        EXPECT_EQ(round_trips(stats, 0), RequestTracker::MAX_PENDING + 1);
+    }
+} // namespace dfs
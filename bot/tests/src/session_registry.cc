@@ -0,0 +1,79 @@
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "game.hh"
+#include "messages.hh"
+#include "session-registry.hh"
+
+namespace dfs
+{
+    class SessionRegistryTest : public testing::Test {
+      protected:
+        std::unique_ptr<Session> MakeSession() {
+            int sockets[2];
+            socketpair(AF_UNIX, SOCK_STREAM, 0, sockets);
+            m_Peers.push_back(sockets[1]);
+
+            return std::make_unique<Session>(sockets[0], m_GameData, m_Messages);
+        }
+
+        ~SessionRegistryTest() override {
+            for (int peer : m_Peers)
+                close(peer);
+        }
+
+        GameData m_GameData{};
+        Messages m_Messages;
+        std::vector<int> m_Peers;
+    };
+
+    TEST_F(SessionRegistryTest, RemovesInAnyOrder) {
+        SessionRegistry registry;
+
+        auto &first = registry.Add(MakeSession());
+        auto &second = registry.Add(MakeSession());
+        auto &third = registry.Add(MakeSession());
+        auto third_id = third.GetId();
+
+        EXPECT_NE(first.GetId(), second.GetId());
+        EXPECT_EQ(registry.GetSize(), 3u);
+
+        // The last one takes the freed slot, and can still be removed after that
+        registry.Remove(first);
+        EXPECT_EQ(registry.GetSize(), 2u);
+
+        second.Close();
+        registry.RemoveClosed();
+        ASSERT_EQ(registry.GetSize(), 1u);
+
+        std::vector<uint64_t> ids;
+        registry.ForEach([&](const Session &session) { ids.push_back(session.GetId()); });
+        EXPECT_EQ(ids, std::vector<uint64_t>{third_id});
+
+        registry.Remove(third);
+        EXPECT_EQ(registry.GetSize(), 0u);
+    }
+
+    TEST_F(SessionRegistryTest, CountsTraffic) {
+        SessionRegistry registry;
+        auto &session = registry.Add(MakeSession());
+
+        // Waiting for the handshake: counted, not decoded yet
+        const uint8_t bytes[] = {0, 0, 0};
+        session.OnClientData(bytes, sizeof(bytes));
+
+        registry.ForEach([&](const Session &session) {
+            const auto &counters = session.GetCounters();
+
+            EXPECT_EQ(session.GetState(), Session::State::Handshake);
+            EXPECT_EQ(counters.ClientBytes.load(), sizeof(bytes));
+            EXPECT_EQ(counters.ServerBytes.load(), 0u);
+            EXPECT_EQ(counters.ClientFrames.load(), 0u);
+            EXPECT_GT(counters.LastActivity.load(), 0);
+        });
+    }
+} // namespace dfs
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "shared-ring.h"
+
+namespace dfs
+{
+    static std::vector<uint8_t> read_all(dfs_ring &ring) {
+        std::vector<uint8_t> data;
+        const uint8_t *chunk;
+
+        while (size_t length = dfs_ring_peek(&ring, &chunk)) {
+            data.insert(data.end(), chunk, chunk + length);
+            dfs_ring_consume(&ring, length);
+        }
+
+        return data;
+    }
+
+    TEST(SharedRingTest, WrapsAround) {
+        auto ring = std::make_unique<dfs_ring>();
+
+        // Leave the positions right before the end of the ring
+        ring->Head = ring->Tail = DFS_RING_SIZE - 3;
+
+        const uint8_t bytes[] = {1, 2, 3, 4, 5, 6, 7};
+        EXPECT_EQ(dfs_ring_write(ring.get(), bytes, sizeof(bytes)), sizeof(bytes));
+        EXPECT_EQ(dfs_ring_readable(ring.get()), sizeof(bytes));
+
+        // Contiguous up to the end, then from the start
+        const uint8_t *chunk;
+        EXPECT_EQ(dfs_ring_peek(ring.get(), &chunk), 3u);
+        EXPECT_EQ(read_all(*ring), std::vector<uint8_t>(bytes, bytes + sizeof(bytes)));
+    }
+
+    TEST(SharedRingTest, WritesWhatFits) {
+        auto ring = std::make_unique<dfs_ring>();
+
+        std::vector<uint8_t> bytes(DFS_RING_SIZE - 10, 0xAB);
+        EXPECT_EQ(dfs_ring_write(ring.get(), bytes.data(), bytes.size()), bytes.size());
+        EXPECT_EQ(dfs_ring_write(ring.get(), bytes.data(), 32), 10u);
+        EXPECT_EQ(dfs_ring_writable(ring.get()), 0u);
+
+        EXPECT_EQ(read_all(*ring).size(), DFS_RING_SIZE);
+        EXPECT_EQ(dfs_ring_writable(ring.get()), DFS_RING_SIZE);
+    }
+
+    TEST(SharedRingTest, TransfersAcrossThreads) {
+        auto ring = std::make_unique<dfs_ring>();
+        constexpr size_t TOTAL = 8 * DFS_RING_SIZE + 12345;
+
+        auto producer = std::thread([&]() {
+            std::vector<uint8_t> chunk(4099);
+            size_t sent = 0;
+
+            while (sent < TOTAL) {
+                size_t length = std::min(chunk.size(), TOTAL - sent);
+                for (size_t i = 0; i < length; i++)
+                    chunk[i] = static_cast<uint8_t>((sent + i) % 251);
+
+                size_t written = 0;
+                while (written < length)
+                    written += dfs_ring_write(ring.get(), chunk.data() + written, length - written);
+
+                sent += length;
+            }
+        });
+
+        size_t received = 0;
+        bool intact = true;
+
+        while (received < TOTAL) {
+            const uint8_t *chunk;
+            size_t length = dfs_ring_peek(ring.get(), &chunk);
+
+            for (size_t i = 0; i < length; i++)
+                intact &= chunk[i] == static_cast<uint8_t>((received + i) % 251);
+
+            dfs_ring_consume(ring.get(), length);
+            received += length;
+        }
+
+        producer.join();
+        EXPECT_TRUE(intact);
+    }
+} // namespace dfs
@@ -0,0 +1,59 @@
+#include <array>
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+
+#include "messages.hh"
+#include "type-url-table.hh"
+#include "wire.hh"
+
+namespace dfs
+{
+    using Content = GameMessagePeek::Kind;
+
+    static constexpr const TypeUrlTable TABLE(std::to_array<TypeUrlBinding>({
+                                                  {Content::Request, "type.ankama.com/abc", 1},
+                                                  {Content::Event, "type.ankama.com/abc", 2},
+                                                  {Content::Event, "type.ankama.com/abd", 3},
+                                              }),
+                                              7);
+
+    // Looked up at compile time as well
+    static_assert(TABLE.Find(Content::Event, "type.ankama.com/abd") == 3);
+
+    TEST(TypeUrlTableTest, FindsBindings) {
+        EXPECT_EQ(TABLE.Find(Content::Request, "type.ankama.com/abc"), 1u);
+        EXPECT_EQ(TABLE.Find(Content::Event, "type.ankama.com/abc"), 2u);
+        EXPECT_EQ(TABLE.Find(Content::Event, "type.ankama.com/abd"), 3u);
+
+        // Same suffix in another member of the oneof
+        EXPECT_EQ(TABLE.Find(Content::Response, "type.ankama.com/abc"), 7u);
+        EXPECT_EQ(TABLE.Find(Content::None, "type.ankama.com/abc"), 7u);
+
+        // Lookalikes
+        EXPECT_EQ(TABLE.Find(Content::Event, "type.ankama.com/abe"), 7u);
+        EXPECT_EQ(TABLE.Find(Content::Event, "type.ankama.org/abd"), 7u);
+        EXPECT_EQ(TABLE.Find(Content::Event, "type.ankama.com/abdd"), 7u);
+        EXPECT_EQ(TABLE.Find(Content::Event, "abd"), 7u);
+        EXPECT_EQ(TABLE.Find(Content::Event, ""), 7u);
+        EXPECT_EQ(TABLE.Find(Content::Event, std::string_view("type.ankama.com/\0\0\0", 19)), 7u);
+    }
+
+    TEST(TypeUrlTableTest, MessageKinds) {
+        auto name = [](Content content, std::string_view type_url) {
+            return std::string(Messages::GetKindName(Messages::GetKind(content, type_url)));
+        };
+
+        EXPECT_EQ(name(Content::Request, "type.ankama.com/ifv"), "MapMovementRequest");
+        EXPECT_EQ(name(Content::Request, "type.ankama.com/iwu"), "PingRequest");
+        EXPECT_EQ(name(Content::Response, "type.ankama.com/egj"), "MapMovementConfirmResponse");
+        EXPECT_EQ(name(Content::Event, "type.ankama.com/igg"), "MapMovementEvent");
+        EXPECT_EQ(name(Content::Event, "type.ankama.com/hzr"), "StatedElementUpdatedEvent");
+        EXPECT_EQ(name(Content::Event, "type.ankama.com/jaz"), "combat");
+
+        EXPECT_EQ(name(Content::Event, "type.ankama.com/ifv"), "other");
+        EXPECT_EQ(name(Content::Request, "type.ankama.com/jaz"), "other");
+        EXPECT_EQ(name(Content::Event, "type.ankama.com/zzz"), "other");
+        EXPECT_EQ(name(Content::None, ""), "other");
+    }
+} // namespace dfs
@@ -0,0 +1,92 @@
+#include <game/game_message.pb.h>
+#include <google/protobuf/any.pb.h>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "wire.hh"
+
+namespace dfs
+{
+    using namespace com::ankama::dofus::server::game::protocol;
+
+    static std::optional<GameMessagePeek> peek(const std::string &serialized) {
+        return PeekGameMessage(reinterpret_cast<const uint8_t *>(serialized.data()), serialized.size());
+    }
+
+    TEST(WireTest, PeekRequest) {
+        GameMessage m;
+        m.mutable_request()->set_uid(42);
+        m.mutable_request()->mutable_content()->set_type_url("type.ankama.com/ifv");
+        m.mutable_request()->mutable_content()->set_value("payload");
+
+        auto serialized = m.SerializeAsString();
+        auto result = peek(serialized);
+
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(result->Content, GameMessagePeek::Kind::Request);
+        ASSERT_EQ(result->TypeUrl, "type.ankama.com/ifv");
+        ASSERT_EQ(result->Value, "payload");
+        ASSERT_EQ(result->Uid, 42);
+    }
+
+    TEST(WireTest, PeekResponseUid) {
+        GameMessage m;
+        m.mutable_response()->set_uid(-3);
+        m.mutable_response()->mutable_content()->set_type_url("type.ankama.com/iwk");
+
+        auto serialized = m.SerializeAsString();
+        auto result = peek(serialized);
+
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(result->Content, GameMessagePeek::Kind::Response);
+        ASSERT_EQ(result->Uid, -3);
+    }
+
+    TEST(WireTest, PeekEvent) {
+        GameMessage m;
+        m.mutable_event()->mutable_content()->set_type_url("type.ankama.com/igr");
+
+        auto serialized = m.SerializeAsString();
+        auto result = peek(serialized);
+
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(result->Content, GameMessagePeek::Kind::Event);
+        ASSERT_EQ(result->TypeUrl, "type.ankama.com/igr");
+        ASSERT_TRUE(result->Value.empty());
+    }
+
+    TEST(WireTest, PeekEmpty) {
+        auto result = peek("");
+
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(result->Content, GameMessagePeek::Kind::None);
+    }
+
+    TEST(WireTest, PeekTruncated) {
+        GameMessage m;
+        m.mutable_response()->mutable_content()->set_type_url("type.ankama.com/egj");
+
+        auto serialized = m.SerializeAsString();
+        serialized.pop_back();
+
+        ASSERT_FALSE(peek(serialized).has_value());
+    }
+
+    TEST(WireTest, PeekHeaderOfIncompleteMessage) {
+        GameMessage m;
+        m.mutable_request()->set_uid(7);
+        m.mutable_request()->mutable_content()->set_type_url("type.ankama.com/hzk");
+        m.mutable_request()->mutable_content()->set_value(std::string(500, 'x'));
+
+        auto serialized = m.SerializeAsString();
+        auto data = reinterpret_cast<const uint8_t *>(serialized.data());
+
+        // Not even the whole type url
+        ASSERT_FALSE(PeekGameMessageHeader(data, 12).has_value());
+
+        auto result = PeekGameMessageHeader(data, 40);
+        ASSERT_TRUE(result.has_value());
+        ASSERT_EQ(result->Content, GameMessagePeek::Kind::Request);
+        ASSERT_EQ(result->TypeUrl, "type.ankama.com/hzk");
+    }
+} // namespace dfs
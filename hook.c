@@ -1,22 +1,435 @@
+#define _GNU_SOURCE
+
 #include <arpa/inet.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#include "include/shared-ring.h"
+
 typedef int (*connect_t)(int, const struct sockaddr *, socklen_t);
+typedef ssize_t (*send_t)(int, const void *, size_t, int);
+typedef ssize_t (*recv_t)(int, void *, size_t, int);
+typedef ssize_t (*write_t)(int, const void *, size_t);
+typedef ssize_t (*read_t)(int, void *, size_t);
+typedef int (*close_t)(int);
 
-int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
-    struct Handshake
-    {
-        uint8_t Address[16];
-        socklen_t Addrlen;
-        in_port_t Port;
-    };
+static send_t original_send;
+static recv_t original_recv;
+static write_t original_write;
+static read_t original_read;
+static close_t original_close;
+
+__attribute__((constructor)) static void resolve_originals(void) {
+    original_send = (send_t)dlsym(RTLD_NEXT, "send");
+    original_recv = (recv_t)dlsym(RTLD_NEXT, "recv");
+    original_write = (write_t)dlsym(RTLD_NEXT, "write");
+    original_read = (read_t)dlsym(RTLD_NEXT, "read");
+    original_close = (close_t)dlsym(RTLD_NEXT, "close");
+}
+
+struct Handshake
+{
+    uint8_t Address[16];
+    socklen_t Addrlen;
+    in_port_t Port;
+};
+
+// Connects a new socket to the abstract Unix socket `name`. Returns -1 if nobody listens there.
+static int connect_abstract(connect_t original_connect, const char *name) {
+    size_t length = strlen(name);
+
+    struct sockaddr_un proxy;
+    memset(&proxy, 0, sizeof(proxy));
+    proxy.sun_family = AF_UNIX;
+
+    if (length == 0 || length + 1 > sizeof(proxy.sun_path))
+        return -1;
+
+    // Abstract namespace: a leading null byte
+    memcpy(proxy.sun_path + 1, name, length);
+
+    int unix_sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (unix_sock < 0)
+        return -1;
+
+    socklen_t proxy_len = offsetof(struct sockaddr_un, sun_path) + 1 + length;
+    if (original_connect(unix_sock, (struct sockaddr *)&proxy, proxy_len) < 0) {
+        original_close(unix_sock);
+        return -1;
+    }
+
+    return unix_sock;
+}
+
+// Connects the game socket to the proxy through its abstract Unix socket (DFS_PROXY_SOCKET, "dfs-proxy" by
+// default, empty to disable) instead of the loopback. The handshake goes first, like over TCP. Returns -1 if the
+// proxy does not listen there, the game socket is left untouched in that case.
+static int connect_unix(connect_t original_connect, int sockfd, const struct Handshake *h) {
+    const char *name = getenv("DFS_PROXY_SOCKET");
+    if (name == NULL)
+        name = "dfs-proxy";
+
+    int unix_sock = connect_abstract(original_connect, name);
+    if (unix_sock < 0)
+        return -1;
+
+    if (original_write(unix_sock, h, sizeof(struct Handshake)) != sizeof(struct Handshake)) {
+        original_close(unix_sock);
+        return -1;
+    }
+
+    // Take the place of the game socket, with the same flags (non-blocking, close-on-exec)
+    int status_flags = fcntl(sockfd, F_GETFL);
+    int fd_flags = fcntl(sockfd, F_GETFD);
+
+    if (status_flags < 0 || fd_flags < 0 || fcntl(unix_sock, F_SETFL, status_flags) < 0
+        || dup2(unix_sock, sockfd) < 0) {
+        original_close(unix_sock);
+        return -1;
+    }
+
+    fcntl(sockfd, F_SETFD, fd_flags);
+    original_close(unix_sock);
+
+    printf("Connected to the proxy through @%s\n", name);
+    return 0;
+}
+
+// In-process observation (DFS_OBSERVE_SOCKET set to the name the proxy listens on): the game connects to the
+// server itself and every byte it sends or receives on that socket is mirrored into shared memory for the proxy.
+// Frames the proxy injects are written to the server between two frames of the game. If the proxy goes away or
+// falls too far behind, the game simply goes on unobserved.
+
+// How long the game may be held back by a full ring before we stop observing it
+#define MIRROR_PATIENCE_MS 1000
+
+// A single socket is observed at a time: the game only talks to one server
+static struct
+{
+    // The observed game socket, -1 if none
+    int Fd;
+
+    // Connection to the proxy: the shared memory is sent along the hello, then it only carries doorbells
+    int Control;
+    int Attached;
+    struct dfs_shared *Shared;
+    pthread_t Injector;
+
+    // Game writes and injected frames never interleave
+    pthread_mutex_t WriteLock;
+
+    // Where the game is in its stream of frames: bytes left of the current one, or the length prefix being read
+    uint64_t FrameLeft;
+    uint64_t Length;
+    unsigned Shift;
+} s_observed = {.Fd = -1, .Control = -1, .WriteLock = PTHREAD_MUTEX_INITIALIZER};
+
+static int is_observed(int fd) {
+    return fd >= 0 && fd == __atomic_load_n(&s_observed.Fd, __ATOMIC_ACQUIRE);
+}
+
+static int is_attached(void) {
+    return __atomic_load_n(&s_observed.Attached, __ATOMIC_ACQUIRE);
+}
 
+static void stop_observing(void) {
+    if (!__atomic_exchange_n(&s_observed.Attached, 0, __ATOMIC_ACQ_REL))
+        return;
+
+    // Wakes the injector up, the proxy sees the end of the session
+    shutdown(s_observed.Control, SHUT_RDWR);
+    printf("Stopped mirroring the game traffic\n");
+}
+
+static void track_frames(const uint8_t *data, size_t length) {
+    while (length > 0) {
+        if (s_observed.FrameLeft > 0) {
+            size_t skipped = length < s_observed.FrameLeft ? length : s_observed.FrameLeft;
+            s_observed.FrameLeft -= skipped;
+            data += skipped;
+            length -= skipped;
+            continue;
+        }
+
+        uint8_t byte = *data++;
+        length--;
+
+        s_observed.Length |= (uint64_t)(byte & 0x7F) << s_observed.Shift;
+        s_observed.Shift += 7;
+
+        if (byte & 0x80) {
+            // Not a stream of frames after all, we could inject in the middle of one
+            if (s_observed.Shift >= 64)
+                stop_observing();
+
+            continue;
+        }
+
+        s_observed.FrameLeft = s_observed.Length;
+        s_observed.Length = 0;
+        s_observed.Shift = 0;
+    }
+}
+
+// Tells the proxy there is something to read, if it is waiting for it
+static void ring_doorbell(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_exchange_n(&s_observed.Shared->Sleeping, 0, __ATOMIC_SEQ_CST))
+        original_send(s_observed.Control, "", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+static void mirror(struct dfs_ring *ring, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    unsigned waited_us = 0;
+
+    while (is_attached()) {
+        size_t written = dfs_ring_write(ring, bytes, length);
+        bytes += written;
+        length -= written;
+
+        ring_doorbell();
+
+        if (length == 0)
+            return;
+
+        // The proxy is behind: hold the game back a little
+        if (waited_us >= MIRROR_PATIENCE_MS * 1000) {
+            stop_observing();
+            return;
+        }
+
+        usleep(100);
+        waited_us += 100;
+    }
+}
+
+// Sends what the proxy injected, only between two game frames. Must be called with the write lock held.
+static void flush_injected(void) {
+    if (!is_attached() || s_observed.FrameLeft > 0 || s_observed.Shift > 0)
+        return;
+
+    struct dfs_ring *ring = &s_observed.Shared->Injected;
+    const uint8_t *data;
+    size_t length;
+
+    // The proxy only publishes whole frames, so emptying the ring ends on a frame boundary
+    while ((length = dfs_ring_peek(ring, &data)) > 0) {
+        ssize_t sent = original_send(s_observed.Fd, data, length, MSG_NOSIGNAL);
+
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd writable = {s_observed.Fd, POLLOUT, 0};
+                poll(&writable, 1, -1);
+                continue;
+            }
+
+            // The game sees the error on its next call
+            return;
+        }
+
+        dfs_ring_consume(ring, sent);
+    }
+}
+
+static void *run_injector(void *arg) {
+    (void)arg;
+
+    char doorbells[64];
+
+    while (1) {
+        ssize_t received = original_read(s_observed.Control, doorbells, sizeof(doorbells));
+
+        if (received < 0 && errno == EINTR)
+            continue;
+
+        if (received <= 0)
+            break;
+
+        pthread_mutex_lock(&s_observed.WriteLock);
+        flush_injected();
+        pthread_mutex_unlock(&s_observed.WriteLock);
+    }
+
+    stop_observing();
+    return NULL;
+}
+
+static void observe(connect_t original_connect, int sockfd, const char *name) {
+    if (__atomic_load_n(&s_observed.Fd, __ATOMIC_ACQUIRE) >= 0)
+        return;
+
+    int control = connect_abstract(original_connect, name);
+    if (control < 0)
+        return;
+
+    int memfd = memfd_create("dfs-shared", MFD_CLOEXEC);
+    struct dfs_shared *shared = MAP_FAILED;
+
+    if (memfd >= 0 && ftruncate(memfd, sizeof(struct dfs_shared)) == 0)
+        shared = mmap(NULL, sizeof(struct dfs_shared), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+    if (shared == MAP_FAILED) {
+        if (memfd >= 0)
+            original_close(memfd);
+
+        original_close(control);
+        return;
+    }
+
+    shared->Magic = DFS_SHARED_MAGIC;
+    shared->Version = DFS_SHARED_VERSION;
+
+    // The shared memory goes along the hello
+    struct dfs_shared_hello hello = {DFS_SHARED_MAGIC, DFS_SHARED_VERSION};
+    struct iovec vector = {&hello, sizeof(hello)};
+
+    union {
+        struct cmsghdr Header;
+        char Buffer[CMSG_SPACE(sizeof(int))];
+    } control_message;
+    memset(&control_message, 0, sizeof(control_message));
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control_message.Buffer;
+    message.msg_controllen = sizeof(control_message.Buffer);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+
+    ssize_t sent = sendmsg(control, &message, MSG_NOSIGNAL);
+    original_close(memfd);
+
+    if (sent != sizeof(hello)) {
+        munmap(shared, sizeof(struct dfs_shared));
+        original_close(control);
+        return;
+    }
+
+    s_observed.Control = control;
+    s_observed.Shared = shared;
+    s_observed.FrameLeft = 0;
+    s_observed.Length = 0;
+    s_observed.Shift = 0;
+    s_observed.Attached = 1;
+    __atomic_store_n(&s_observed.Fd, sockfd, __ATOMIC_RELEASE);
+
+    if (pthread_create(&s_observed.Injector, NULL, run_injector, NULL) != 0) {
+        __atomic_store_n(&s_observed.Fd, -1, __ATOMIC_RELEASE);
+        s_observed.Attached = 0;
+        munmap(shared, sizeof(struct dfs_shared));
+        original_close(control);
+        return;
+    }
+
+    printf("Mirroring the game traffic to the proxy through @%s\n", name);
+}
+
+static void release_observed(void) {
+    __atomic_store_n(&s_observed.Fd, -1, __ATOMIC_RELEASE);
+
+    stop_observing();
+    pthread_join(s_observed.Injector, NULL);
+
+    original_close(s_observed.Control);
+    munmap(s_observed.Shared, sizeof(struct dfs_shared));
+
+    s_observed.Control = -1;
+    s_observed.Shared = NULL;
+}
+
+static ssize_t observed_write(int fd, const void *data, size_t length, int flags, int is_send) {
+    pthread_mutex_lock(&s_observed.WriteLock);
+
+    flush_injected();
+
+    ssize_t result = is_send ? original_send(fd, data, length, flags) : original_write(fd, data, length);
+    int saved_errno = errno;
+
+    if (result > 0 && is_attached()) {
+        mirror(&s_observed.Shared->ToServer, data, result);
+        track_frames(data, result);
+        flush_injected();
+    }
+
+    pthread_mutex_unlock(&s_observed.WriteLock);
+
+    errno = saved_errno;
+    return result;
+}
+
+static void observed_read(const void *data, ssize_t result) {
+    if (result <= 0 || !is_attached())
+        return;
+
+    int saved_errno = errno;
+    mirror(&s_observed.Shared->ToClient, data, result);
+    errno = saved_errno;
+}
+
+ssize_t send(int fd, const void *data, size_t length, int flags) {
+    if (!is_observed(fd))
+        return original_send(fd, data, length, flags);
+
+    return observed_write(fd, data, length, flags, 1);
+}
+
+ssize_t write(int fd, const void *data, size_t length) {
+    if (!is_observed(fd))
+        return original_write(fd, data, length);
+
+    return observed_write(fd, data, length, 0, 0);
+}
+
+ssize_t recv(int fd, void *data, size_t length, int flags) {
+    ssize_t result = original_recv(fd, data, length, flags);
+
+    if (is_observed(fd) && !(flags & MSG_PEEK))
+        observed_read(data, result);
+
+    return result;
+}
+
+ssize_t read(int fd, void *data, size_t length) {
+    ssize_t result = original_read(fd, data, length);
+
+    if (is_observed(fd))
+        observed_read(data, result);
+
+    return result;
+}
+
+int close(int fd) {
+    if (is_observed(fd))
+        release_observed();
+
+    return original_close(fd);
+}
+
+int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
     connect_t original_connect = (connect_t)dlsym(RTLD_NEXT, "connect");
+    const char *observe_socket = getenv("DFS_OBSERVE_SOCKET");
 
     if (addr->sa_family == AF_INET6) {
         // It looks like Dofus uses IPV6 address space with the first bytes set to 0.
@@ -31,11 +444,27 @@ int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
             && (target->sin6_addr.s6_addr[9] == 0) && (target->sin6_addr.s6_addr[10] == 0xFF)
             && (target->sin6_addr.s6_addr[11] == 0xFF)) {
 
+            // Talk to the server directly, the proxy only watches
+            if (observe_socket != NULL && observe_socket[0] != '\0') {
+                int result = original_connect(sockfd, addr, addrlen);
+                int saved_errno = errno;
+
+                if (result == 0 || errno == EINPROGRESS)
+                    observe(original_connect, sockfd, observe_socket);
+
+                errno = saved_errno;
+                return result;
+            }
+
             struct Handshake h;
             memcpy(&h.Address, target->sin6_addr.s6_addr, 16);
             h.Addrlen = addrlen;
             h.Port = target->sin6_port;
 
+            // Connected right away, there is nothing in progress
+            if (connect_unix(original_connect, sockfd, &h) == 0)
+                return 0;
+
             // Reset the IP
             memset(&target->sin6_addr, 0, sizeof(target->sin6_addr));
             target->sin6_addr.s6_addr[10] = 0xFF;
@@ -3,22 +3,25 @@
 #include <chrono>
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
+
+#include "clock-sync.hh"
 
 namespace dfs
 {
-    using now_t =
-        std::chrono::time_point<std::chrono::system_clock, std::chrono::duration<long, std::ratio<1, 1000000000>>>;
-
     class GameMap;
     class GameData;
+    class SnapshotReader;
+    class SnapshotWriter;
 
     struct GenericActor
     {
-        int64_t Id;
-        int32_t CurrentCell;
-        int32_t TargetCell;
-        bool Moving;
+        int64_t Id = 0;
+        int32_t CurrentCell = 0;
+        int32_t TargetCell = 0;
+        bool Moving = false;
         std::chrono::time_point<std::chrono::system_clock, std::chrono::nanoseconds> ArrivalTime;
 
         virtual void UpdateState(const now_t &now);
@@ -27,16 +30,16 @@ namespace dfs
     struct Player : public GenericActor
     {
         std::string Name;
-        bool Collecting;
-        int CollectingId;
+        bool Collecting = false;
+        int CollectingId = 0;
 
         virtual void UpdateState(const now_t &now) override;
     };
 
     struct Monster : public GenericActor
     {
-        uint16_t EnnemyCount;
-        uint16_t TotalLevel;
+        uint16_t EnnemyCount = 0;
+        uint16_t TotalLevel = 0;
     };
 
     enum CollectibleState
@@ -81,11 +84,17 @@ namespace dfs
     {
         BotState(const GameData &);
 
-        bool Active;
+        /// Writes everything but the game data to a session snapshot (hot restart).
+        void Save(SnapshotWriter &writer) const;
+
+        /// Reads back what `Save` wrote. Returns false if the snapshot is truncated.
+        bool Restore(SnapshotReader &reader);
+
+        bool Active = false;
         Player CurrentPlayer;
         std::unique_ptr<GameMap> CurrentMap;
-        bool InCombat;
-        bool ChangingMaps;
+        bool InCombat = false;
+        bool ChangingMaps = false;
         const GameData &Data;
 
         std::unordered_map<int64_t, Player> OtherPlayers;
@@ -93,5 +102,8 @@ namespace dfs
         std::unordered_map<int64_t, GenericActor> NPCs;
         std::unordered_map<int64_t, GenericActor> Actors;
         std::unordered_map<int64_t, Collectible> Collectibles;
+
+        /// Delay and clock offset of the server, to time our requests
+        ClockSync Clock;
     };
 } // namespace dfs
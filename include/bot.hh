@@ -1,9 +1,7 @@
 #pragma once
 
 #include <chrono>
-#include <condition_variable>
 #include <list>
-#include <mutex>
 
 namespace dfs
 {
@@ -11,20 +9,24 @@ namespace dfs
         std::chrono::time_point<std::chrono::system_clock, std::chrono::duration<long, std::ratio<1, 1000000000>>>;
 
     struct BotState;
+    struct Endpoint;
+    class SnapshotReader;
+    class SnapshotWriter;
 
     class BotDescriptor {
       public:
-        BotDescriptor(BotState &state, int server_socket);
+        BotDescriptor(BotState &state, Endpoint &server);
         BotDescriptor(const BotDescriptor &) = delete;
         BotDescriptor operator=(const BotDescriptor &) = delete;
 
-        /// Wait for an event or the end of the timer (must be called from the bot logic)
-        std::unique_lock<std::mutex> WaitForStateUpdate();
+        /// Returns true if the state was updated or a timer expired since the last call, meaning the bot logic
+        /// should run, and sets `waited` to the time since the first of those. Expired timers are consumed.
+        bool PollStateUpdate(const now_t &now, std::chrono::nanoseconds &waited);
 
-        /// Prevents the bot from making progress. Call this from the message handler.
-        std::unique_lock<std::mutex> Lock();
+        /// Returns the expiry of the closest timer, so the reactor knows when to wake the bot up.
+        now_t NextWakeup() const;
 
-        /// Sends a signal to wake the waiters for the `WaitForStateUpdate` function.
+        /// Flags the state as updated. `PollStateUpdate` will return true on its next call.
         void MarkUpdated(const now_t &wake_at = now_t{});
 
         /// Resets the state of the bot (actors, collectibles, ...) you may want to call this when
@@ -44,14 +46,20 @@ namespace dfs
             return m_State;
         }
 
+        /// Writes the timers to a session snapshot. The state is saved by its owner.
+        void Save(SnapshotWriter &writer) const;
+        bool Restore(SnapshotReader &reader);
+
       private:
         void ConfirmMovement();
 
       private:
         BotState &m_State;
-        int m_ServerSock;
+        Endpoint &m_Server;
         std::list<now_t> m_Timers;
-        std::condition_variable m_Condvar;
-        std::mutex m_Mutex;
+        bool m_Updated;
+
+        /// When `m_Updated` was set
+        now_t m_UpdatedAt;
     };
 } // namespace dfs
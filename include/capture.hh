@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace dfs
+{
+    /// Traffic capture, to replay real sessions offline (`dfs-replay`).
+    ///
+    /// A capture file starts with a `CaptureHeader` padded to `CAPTURE_HEADER_SIZE`, followed by blocks of
+    /// `CAPTURE_BLOCK_SIZE` bytes. Each block holds 8-byte aligned records, a `CaptureRecord` followed by the frame
+    /// (length prefix included), and is padded with zeroes. A frame too large for a block gets a run of blocks of its
+    /// own. Every writer appends whole blocks with a single `write` on an `O_APPEND` descriptor, so the reactors
+    /// (and the processes of a hot restart) share the same file without any locking.
+    static constexpr const uint64_t CAPTURE_MAGIC = 0x3130504143534644; // "DFSCAP01"
+    static constexpr const uint32_t CAPTURE_VERSION = 1;
+    static constexpr const size_t CAPTURE_HEADER_SIZE = 4096;
+    static constexpr const size_t CAPTURE_BLOCK_SIZE = 64 * 1024;
+
+    struct CaptureHeader
+    {
+        uint64_t Magic;
+        uint32_t Version;
+        uint32_t BlockSize;
+
+        /// `Messages::IsConnected` when the capture was created: whether the first frames are login or game ones
+        uint8_t Connected;
+    };
+
+    enum class CaptureDirection : uint8_t
+    {
+        ClientToServer,
+        ServerToClient,
+    };
+
+    struct CaptureRecord
+    {
+        /// Bytes of the frame following the record. Zero marks the padding at the end of a block.
+        uint32_t Length;
+        CaptureDirection Direction;
+        uint8_t Reserved[3];
+
+        /// Process id in the upper half, `Session::GetId` in the lower one: unique across the processes writing to
+        /// the same capture
+        uint64_t SessionId;
+
+        /// Steady clock, in nanoseconds
+        int64_t Timestamp;
+    };
+
+    static_assert(sizeof(CaptureRecord) == 24);
+
+    /// Appends the frames decoded by one reactor to a capture file.
+    class CaptureWriter {
+      public:
+        ~CaptureWriter();
+
+        CaptureWriter(const CaptureWriter &) = delete;
+        CaptureWriter operator=(const CaptureWriter &) = delete;
+
+        /// Creates the capture file if needed, or checks the one already there can be appended to. Must be done
+        /// once, before the writers are opened.
+        static bool Create(const std::string &path, bool connected);
+
+        /// Returns `nullptr` if the file cannot be opened.
+        static std::unique_ptr<CaptureWriter> Open(const std::string &path);
+
+        /// Queues a frame (length prefix included). Blocks are written once full, or once they have been waiting for a
+        /// second (see `FlushExpired`).
+        void Record(uint64_t session_id, CaptureDirection direction, int64_t timestamp,
+                    std::span<const uint8_t> frame);
+
+        /// Writes the block being filled, padded, if it holds anything.
+        void Flush();
+
+        /// Writes the block being filled if it has been waiting for a second at `now` (see `monotonic_ns`). Called
+        /// by the reactors on every wake up, so that quiet sessions still show up in a capture read while the proxy
+        /// runs.
+        void FlushExpired(int64_t now);
+
+        /// When the block being filled must be written (see `monotonic_ns`), `INT64_MAX` while it is empty
+        int64_t GetFlushDeadline() const {
+            return m_Used > 0 ? m_BlockStarted + MAX_BLOCK_AGE_NS : INT64_MAX;
+        }
+
+      private:
+        explicit CaptureWriter(int fd);
+
+        void Write(const uint8_t *data, size_t length);
+
+      private:
+        /// Older blocks are flushed even if not full
+        static constexpr const int64_t MAX_BLOCK_AGE_NS = 1000 * 1000 * 1000;
+
+        int m_Fd;
+        const uint64_t m_Process;
+        std::unique_ptr<uint8_t[]> m_Block;
+        size_t m_Used;
+        int64_t m_BlockStarted;
+    };
+
+    /// Reads a capture file through a read-only mapping. Frames are returned as spans into it.
+    class CaptureReader {
+      public:
+        struct Entry
+        {
+            const CaptureRecord *Record;
+            std::span<const uint8_t> Frame;
+        };
+
+        ~CaptureReader();
+
+        CaptureReader(const CaptureReader &) = delete;
+        CaptureReader operator=(const CaptureReader &) = delete;
+
+        /// Returns `nullptr` if the file cannot be mapped or is not a capture.
+        static std::unique_ptr<CaptureReader> Open(const std::string &path);
+
+        const CaptureHeader &GetHeader() const {
+            return *reinterpret_cast<const CaptureHeader *>(m_Data);
+        }
+
+        /// Returns the next frame, in the order they were written.
+        std::optional<Entry> Next();
+
+        /// Set once `Next` met a record running past the end of the file or of its block: the end of the capture
+        /// is missing or damaged
+        bool IsTruncated() const {
+            return m_Truncated;
+        }
+
+        /// Goes back to the first frame.
+        void Rewind();
+
+      private:
+        CaptureReader(const uint8_t *data, size_t size);
+
+      private:
+        const uint8_t *m_Data;
+        size_t m_Size;
+
+        /// Current position, and end of the block (or run of blocks) it is in
+        size_t m_Offset;
+        size_t m_BlockEnd;
+        bool m_Truncated;
+    };
+} // namespace dfs
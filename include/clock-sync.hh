@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace dfs
+{
+    using now_t =
+        std::chrono::time_point<std::chrono::system_clock, std::chrono::duration<long, std::ratio<1, 1000000000>>>;
+
+    /// Estimates how far the game server is from us in time: the one-way delay of the link, from the pings of the
+    /// game (a `PingRequest` answered by a `PongEvent`), and the offset of its clock, from its `TimeEvent`s.
+    ///
+    /// Like the clock filter of NTP, both keep the last few samples and trust the one queuing delayed the least:
+    /// the shortest round trip, and the largest offset (a `TimeEvent` that arrives late makes the server look
+    /// behind). The one-way delay is half the round trip: both legs are assumed to take as long.
+    class ClockSync {
+      public:
+        /// Samples kept of each kind
+        static constexpr const size_t WINDOW = 8;
+
+        /// Pings waiting for their pong, older ones are forgotten
+        static constexpr const size_t MAX_PINGS = 4;
+
+        /// The game sent a ping at `now`.
+        void OnPingSent(const now_t &now);
+
+        /// The server answered the oldest ping waiting for it at `now`.
+        void OnPong(const now_t &now);
+
+        /// The server said its clock was at `timestamp`, in milliseconds since the Unix epoch, and we received it at
+        /// `now`.
+        void OnServerTime(int64_t timestamp, const now_t &now);
+
+        /// Zero until the first round trip
+        std::chrono::nanoseconds GetOneWayDelay() const;
+
+        /// Clock of the server minus ours, zero until the first `TimeEvent`
+        std::chrono::nanoseconds GetOffset() const;
+
+        bool HasOffset() const {
+            return m_OffsetCount > 0;
+        }
+
+        /// When the server sent what we received at `received_at`, on our clock
+        now_t GetSentAt(const now_t &received_at) const {
+            return received_at - GetOneWayDelay();
+        }
+
+        /// When to send a request for it to reach the server at `due_at`, on our clock
+        now_t GetSendTime(const now_t &due_at) const {
+            return due_at - GetOneWayDelay();
+        }
+
+      private:
+        /// In nanoseconds, oldest first
+        std::array<int64_t, MAX_PINGS> m_Pings{};
+        size_t m_PingCount = 0;
+
+        /// Circular, `m_*Count` samples were taken in total
+        std::array<int64_t, WINDOW> m_RoundTrips{};
+        size_t m_RoundTripCount = 0;
+        std::array<int64_t, WINDOW> m_Offsets{};
+        size_t m_OffsetCount = 0;
+    };
+} // namespace dfs
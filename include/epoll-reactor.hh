@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "reactor.hh"
+
+namespace dfs
+{
+    struct Endpoint;
+
+    /// Default backend: a single-threaded, level-triggered epoll loop.
+    ///
+    /// In splice mode, server to client traffic never goes through user space: it is spliced from the server
+    /// socket into a pipe, then from that pipe into the client socket. Only a tee'd copy of it is read for the
+    /// frame decoder.
+    class EpollReactor : public Reactor {
+      public:
+        EpollReactor(int listen_sock, const GameData &game_data, const Messages &messages, bool splice = false);
+        ~EpollReactor() override;
+
+        void Run() override;
+
+      protected:
+        void Quiesce() override;
+        void Adopt(Session &session) override;
+
+      private:
+        /// Pipes relaying the server side of a session to its client side
+        struct Passthrough
+        {
+            /// Bytes spliced from the server, waiting to be spliced to the client
+            int Relay[2] = {-1, -1};
+
+            /// Copy of the same bytes for the decoder
+            int Tap[2] = {-1, -1};
+
+            /// Bytes still in `Relay`. The server is not read again before the client took all of them.
+            size_t Pending = 0;
+        };
+
+        void Accept();
+        void Accept(int listen_sock);
+        void HandleEvent(Endpoint &endpoint, uint32_t events);
+        void Read(Endpoint &endpoint, uint32_t events);
+        bool Flush(Session &session);
+        void Watch(Endpoint &endpoint, bool add);
+
+        bool OpenPassthrough(Session &session);
+        Passthrough *FindPassthrough(Session &session);
+        bool TapPassthrough(Endpoint &server, Passthrough &pipes, size_t length);
+        bool DrainPassthrough(Endpoint &client, Passthrough &pipes);
+        bool ReclaimPassthrough(Endpoint &client, Passthrough &pipes);
+        void ClosePassthroughs(bool all);
+
+      private:
+        static constexpr const int MAX_EVENTS = 64;
+        static constexpr const size_t READ_BUFFER_SIZE = 64 * 1024;
+        static constexpr const int PIPE_SIZE = 64 * 1024;
+
+        int m_Epoll;
+        bool m_Splice;
+        std::array<uint8_t, READ_BUFFER_SIZE> m_ReadBuffer;
+        std::unordered_map<Session *, Passthrough> m_Passthroughs;
+    };
+} // namespace dfs
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "wire.hh"
+
+namespace dfs
+{
+    /// The busiest events read straight from the bytes of the frame, without building protobuf messages. Each view
+    /// keeps what the bot needs of its event, and points into the bytes it was read from for the rest: those must
+    /// outlive it.
+    ///
+    /// `Read` returns `std::nullopt` for a malformed event, and for encodings the views do not bother with (repeated
+    /// scalars that are not packed, which encoders of proto3 do not write): the event is parsed in full instead.
+
+    /// `MapMovementEvent`
+    class MapMovementEventView {
+      public:
+        static std::optional<MapMovementEventView> Read(std::string_view event);
+
+        int64_t GetCharacterId() const {
+            return m_CharacterId;
+        }
+
+        bool IsCautious() const {
+            return m_Cautious;
+        }
+
+        size_t GetCellCount() const {
+            return m_CellCount;
+        }
+
+        /// Decodes the cells of the path into `cells`, which holds at least `GetCellCount()` of them. Returns those
+        /// that were written.
+        std::span<int32_t> GetCells(std::span<int32_t> cells) const;
+
+      private:
+        MapMovementEventView() = default;
+
+        int64_t m_CharacterId = 0;
+        bool m_Cautious = false;
+
+        /// Packed varints
+        std::string_view m_Cells;
+        size_t m_CellCount = 0;
+    };
+
+    /// `StatedElementUpdatedEvent`
+    struct StatedElementUpdatedEventView
+    {
+        int32_t ElementId = 0;
+        int32_t CellId = 0;
+        int32_t State = 0;
+        bool OnCurrentMap = false;
+
+        static std::optional<StatedElementUpdatedEventView> Read(std::string_view event);
+    };
+
+    /// What the bot keeps of an actor of the map (`ActorPositionInformation`), read from the protobuf message or
+    /// straight from its bytes.
+    struct ActorSummary
+    {
+        enum class Kind
+        {
+            /// No `actor_information`
+            None,
+
+            Player,
+
+            /// Monster groups, and tax collectors
+            Monster,
+            Npc,
+
+            /// Whatever else: mounts, prisms, fighters...
+            Other,
+        };
+
+        int64_t Id = 0;
+        Kind Type = Kind::None;
+        std::optional<int32_t> CellId;
+
+        /// Of a player
+        std::string_view Name;
+
+        /// Of a monster group
+        uint16_t EnnemyCount = 0;
+        uint16_t TotalLevel = 0;
+    };
+
+    /// The actors of a `GameRolePlayShowActorsEvent`, read one at a time.
+    class GameRolePlayShowActorsEventView {
+      public:
+        explicit GameRolePlayShowActorsEventView(std::string_view event)
+            : m_Reader(event)
+            , m_Failed(false) {
+        }
+
+        /// Reads the next actor. Returns false once they were all read, or if the event is malformed (see
+        /// `HasFailed`).
+        bool Next(ActorSummary &actor);
+
+        bool HasFailed() const {
+            return m_Failed || m_Reader.HasFailed();
+        }
+
+      private:
+        WireReader m_Reader;
+
+        /// Whether an actor was malformed
+        bool m_Failed;
+    };
+} // namespace dfs
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+
+namespace dfs
+{
+    /// A complete frame, pointing into the decoder storage.
+    struct Frame
+    {
+        /// The whole frame: uvarint length followed by the payload
+        std::span<const uint8_t> Bytes;
+
+        /// Size of the uvarint length prefix
+        size_t HeaderLength;
+
+        std::span<const uint8_t> GetPayload() const {
+            return Bytes.subspan(HeaderLength);
+        }
+    };
+
+    /// The frame at the front of the decoder, which may not be complete yet.
+    struct PartialFrame
+    {
+        /// What was received so far of the frame, length prefix included
+        std::span<const uint8_t> Bytes;
+
+        size_t HeaderLength;
+
+        /// Size of the whole frame once complete, length prefix included
+        size_t Length;
+
+        /// What was received so far of the payload
+        std::span<const uint8_t> GetPayload() const {
+            return Bytes.subspan(HeaderLength);
+        }
+    };
+
+    /// Splits a stream of uvarint length-prefixed frames.
+    ///
+    /// Bytes live in a fixed-capacity buffer between a consumed offset and a write offset. Frames are handed out as
+    /// spans into that buffer and are never looked at again once returned. The storage is reused in a ring
+    /// fashion: when the end is reached, the unconsumed bytes (at most one partial frame once the caller drained
+    /// `Next`) are moved back to the front, so frames are always contiguous.
+    class FrameDecoder {
+      public:
+        static constexpr const size_t DEFAULT_CAPACITY = 1024 * 1024;
+
+        explicit FrameDecoder(size_t capacity = DEFAULT_CAPACITY);
+        ~FrameDecoder() = default;
+
+        FrameDecoder(const FrameDecoder &) = delete;
+        FrameDecoder operator=(const FrameDecoder &) = delete;
+
+        /// Copies bytes at the end of the buffer. Returns false if they do not fit, which means a single frame is
+        /// larger than the capacity. Invalidates the spans previously returned.
+        bool Append(const uint8_t *data, size_t length);
+
+        /// Returns room for exactly `length` bytes at the end of the buffer, to be filled in place (by a read
+        /// syscall for example) and then made visible with `Commit`. Returns an empty span if they do not fit.
+        /// Invalidates the spans previously returned.
+        std::span<uint8_t> Prepare(size_t length);
+        void Commit(size_t length);
+
+        /// Returns the next complete frame, if any. The span stays valid until the next `Append` or `Prepare`.
+        std::optional<Frame> Next();
+
+        /// Returns the next frame even if it is incomplete, as soon as its length prefix was received. It is not
+        /// consumed: it is returned by `Next` once complete.
+        std::optional<PartialFrame> PeekPartial() const;
+
+        /// Bytes received but not consumed yet
+        std::span<const uint8_t> GetBuffered() const {
+            return {m_Storage.get() + m_ReadOffset, m_WriteOffset - m_ReadOffset};
+        }
+
+        /// Drops bytes at the front without interpreting them as frames (the proxy handshake for example).
+        void Consume(size_t length);
+
+        /// Set when a frame length cannot be decoded. The stream cannot be resynchronized after that.
+        bool IsCorrupted() const {
+            return m_Corrupted;
+        }
+
+        size_t GetCapacity() const {
+            return m_Capacity;
+        }
+
+      private:
+        /// Makes room for `length` more bytes, moving the unconsumed ones to the front if needed.
+        bool Reserve(size_t length);
+
+      private:
+        std::unique_ptr<uint8_t[]> m_Storage;
+        size_t m_Capacity;
+        size_t m_ReadOffset;
+        size_t m_WriteOffset;
+        bool m_Corrupted;
+    };
+} // namespace dfs
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include "utils.hh"
@@ -32,6 +33,9 @@ namespace dfs
       private:
         MapCoordinates m_MapCoordinates;
         std::unordered_map<int, std::vector<WorldGraphEdge>> m_WorldGraph;
+
+        // Shared by every worker of the proxy
+        mutable std::mutex m_MapCellsMutex;
         mutable std::unordered_map<uint32_t, std::shared_ptr<std::vector<GameMapCell>>> m_MapCells;
     };
 } // namespace dfs
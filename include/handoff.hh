@@ -0,0 +1,52 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "snapshot.hh"
+
+namespace dfs
+{
+    /// Everything a process hands over to the one replacing it (hot restart). The file descriptors travel over a
+    /// Unix socket with SCM_RIGHTS, the connections they refer to are never interrupted.
+    struct Handoff
+    {
+        /// Listening sockets, one per worker. Connections waiting in their backlog are handed over as well.
+        std::vector<int> Listeners;
+
+        /// Listening socket of the hook, shared by every worker. -1 if none.
+        int UnixListener = -1;
+
+        /// Listening socket of the hooks observing their game in process. -1 if none. Observed sessions are not
+        /// handed over.
+        int ObserveListener = -1;
+
+        std::vector<SessionSnapshot> Sessions;
+
+        /// See `Messages::IsConnected`
+        bool Connected = false;
+    };
+
+    /// Creates the Unix socket the next process connects to, replacing whatever was left at `path`. Returns -1 on
+    /// failure.
+    int ListenForSuccessor(const std::string &path);
+
+    /// Waits for the next process on a socket created by `ListenForSuccessor`. Returns the connection once it
+    /// introduced itself, or -1 if it is not compatible with us.
+    int AcceptSuccessor(int listen_sock);
+
+    /// Connects to the process currently running at `path` and asks it to hand everything over. Returns -1 if
+    /// there is none.
+    int ConnectToPredecessor(const std::string &path);
+
+    /// Sends everything over, blocking. The file descriptors are still ours afterwards.
+    bool SendHandoff(int sock, const Handoff &handoff);
+
+    /// Receives what the previous process sent, blocking. Returns `std::nullopt` if it went away midway, in which
+    /// case nothing was received.
+    std::optional<Handoff> ReceiveHandoff(int sock);
+
+    /// Closes every socket of a handoff that was not taken (set to -1).
+    void CloseHandoff(Handoff &handoff);
+} // namespace dfs
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace dfs
+{
+    /// Nanoseconds on the steady clock, the time base of every latency
+    inline int64_t monotonic_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /// Latency histogram with log-linear buckets (HDR style): every power of two is split in `SUB_BUCKETS`, so a
+    /// value is known within 1/32 of itself from a nanosecond to minutes, in a fixed 8 KiB.
+    ///
+    /// Recording takes no lock and allocates nothing: a single thread (the reactor owning it) records, with a plain
+    /// load and store of one counter. Any other thread may read it meanwhile through a `LatencySnapshot`.
+    class LatencyHistogram {
+      public:
+        static constexpr const unsigned SUB_BUCKET_BITS = 5;
+        static constexpr const size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+
+        /// Values from 2^(MAX_EXPONENT + 1) nanoseconds on (over two minutes) go to the last bucket
+        static constexpr const unsigned MAX_EXPONENT = 36;
+        static constexpr const size_t BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+        LatencyHistogram() = default;
+        ~LatencyHistogram() = default;
+
+        LatencyHistogram(const LatencyHistogram &) = delete;
+        LatencyHistogram operator=(const LatencyHistogram &) = delete;
+
+        void Record(int64_t nanoseconds) {
+            auto &bucket = m_Counts[IndexOf(nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        static size_t IndexOf(uint64_t value);
+
+        /// Middle of the values counted in a bucket
+        static uint64_t ValueOf(size_t index);
+
+      private:
+        friend class LatencySnapshot;
+
+        std::array<std::atomic<uint64_t>, BUCKETS> m_Counts{};
+    };
+
+    /// Counts of one or more histograms at some point, to compute percentiles from.
+    class LatencySnapshot {
+      public:
+        /// Adds the counts of `histogram`, which may be recording meanwhile.
+        void Add(const LatencyHistogram &histogram);
+
+        uint64_t GetCount() const {
+            return m_Count;
+        }
+
+        /// Value `quantile` of the samples are at most, in nanoseconds. Zero without samples.
+        uint64_t GetPercentile(double quantile) const;
+
+        uint64_t GetMax() const;
+
+        /// Approximate, every sample counts as the middle of its bucket
+        uint64_t GetSum() const;
+
+      private:
+        std::array<uint64_t, LatencyHistogram::BUCKETS> m_Counts{};
+        uint64_t m_Count = 0;
+    };
+
+    /// Steps of the life of a frame in the proxy
+    enum class LatencyStage
+    {
+        /// From the read that received its first byte to the one that completed it
+        Assemble,
+
+        /// Telling what the message is, parsing it if it is handled
+        Decode,
+
+        /// Updating the bot state (and cancelling the request) from the message
+        Handle,
+
+        /// Serializing what is forwarded
+        Encode,
+    };
+
+    /// Latencies of the frames relayed by one reactor, for each stage, direction and kind of message (see
+    /// `Messages::GetKindName`), and the time the bytes of each direction wait in the outbound queues until they
+    /// are written.
+    class LatencyStats {
+      public:
+        static constexpr const size_t STAGES = 4;
+
+        explicit LatencyStats(size_t kinds);
+        ~LatencyStats() = default;
+
+        LatencyStats(const LatencyStats &) = delete;
+        LatencyStats operator=(const LatencyStats &) = delete;
+
+        LatencyHistogram &Get(LatencyStage stage, bool from_server, size_t kind) {
+            return m_Frames[Index(stage, from_server, kind)];
+        }
+
+        const LatencyHistogram &Get(LatencyStage stage, bool from_server, size_t kind) const {
+            return m_Frames[Index(stage, from_server, kind)];
+        }
+
+        /// Bytes received from the server wait in the queue of the client, and the other way around
+        LatencyHistogram &GetSend(bool from_server) {
+            return m_Send[from_server];
+        }
+
+        const LatencyHistogram &GetSend(bool from_server) const {
+            return m_Send[from_server];
+        }
+
+        /// From a request of this kind to the response of the server, see `RequestTracker`
+        LatencyHistogram &GetRoundTrip(size_t kind) {
+            return m_RoundTrips[kind];
+        }
+
+        const LatencyHistogram &GetRoundTrip(size_t kind) const {
+            return m_RoundTrips[kind];
+        }
+
+        /// Requests of this kind the server never answered, single writer
+        std::atomic<uint64_t> &GetUnanswered(size_t kind) {
+            return m_Unanswered[kind];
+        }
+
+        const std::atomic<uint64_t> &GetUnanswered(size_t kind) const {
+            return m_Unanswered[kind];
+        }
+
+        size_t GetKinds() const {
+            return m_Kinds;
+        }
+
+      private:
+        size_t Index(LatencyStage stage, bool from_server, size_t kind) const {
+            return (static_cast<size_t>(stage) * 2 + from_server) * m_Kinds + kind;
+        }
+
+      private:
+        size_t m_Kinds;
+        std::unique_ptr<LatencyHistogram[]> m_Frames;
+        std::array<LatencyHistogram, 2> m_Send;
+        std::unique_ptr<LatencyHistogram[]> m_RoundTrips;
+        std::unique_ptr<std::atomic<uint64_t>[]> m_Unanswered;
+    };
+} // namespace dfs
@@ -0,0 +1,395 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fmt/base.h>
+#include <fmt/color.h>
+#include <fmt/format.h>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+/// Lowest level compiled in, see `LogLevel`: calls below it vanish, the evaluation of their arguments included
+#ifndef DFS_LOG_LEVEL
+#define DFS_LOG_LEVEL 1
+#endif
+
+namespace dfs
+{
+    enum class LogLevel : uint8_t
+    {
+        Trace,
+        Debug,
+        Info,
+        Warning,
+        Error,
+    };
+
+    /// How an argument is kept in a log ring until it is formatted: values are copied as they are.
+    template <typename T>
+    struct LogArgument
+    {
+        static_assert(std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>,
+                      "Only values and strings can be logged, format the others first");
+
+        using Stored = T;
+
+        static size_t GetSize(const T &) {
+            return sizeof(T);
+        }
+
+        static uint8_t *Write(uint8_t *out, const T &value) {
+            memcpy(out, &value, sizeof(T));
+            return out + sizeof(T);
+        }
+
+        static T Read(const uint8_t *&in) {
+            T value;
+            memcpy(&value, in, sizeof(T));
+            in += sizeof(T);
+            return value;
+        }
+    };
+
+    /// Strings are copied along with their length: they rarely outlive the call.
+    struct LogStringArgument
+    {
+        using Stored = std::string_view;
+
+        static size_t GetSize(std::string_view value) {
+            return sizeof(uint32_t) + value.size();
+        }
+
+        static uint8_t *Write(uint8_t *out, std::string_view value) {
+            auto length = static_cast<uint32_t>(value.size());
+            memcpy(out, &length, sizeof(length));
+            memcpy(out + sizeof(length), value.data(), length);
+            return out + sizeof(length) + length;
+        }
+
+        static std::string_view Read(const uint8_t *&in) {
+            uint32_t length;
+            memcpy(&length, in, sizeof(length));
+
+            std::string_view value(reinterpret_cast<const char *>(in + sizeof(length)), length);
+            in += sizeof(length) + length;
+            return value;
+        }
+    };
+
+    template <>
+    struct LogArgument<std::string> : LogStringArgument
+    {};
+
+    template <>
+    struct LogArgument<std::string_view> : LogStringArgument
+    {};
+
+    template <>
+    struct LogArgument<const char *> : LogStringArgument
+    {};
+
+    template <>
+    struct LogArgument<char *> : LogStringArgument
+    {};
+
+    /// Formats the arguments of a record, written after it in the ring
+    using LogFormatter = void (*)(const uint8_t *arguments, fmt::string_view format, fmt::memory_buffer &out);
+
+    /// Header of a message in a log ring, followed by its arguments.
+    struct LogRecord
+    {
+        /// Of the whole record, arguments included, rounded up to 8 bytes. Zero marks the unused end of the ring:
+        /// the next record is at its start.
+        uint32_t Size;
+
+        /// Messages of the same call site the rate limit dropped right before this one
+        uint32_t Suppressed;
+
+        LogLevel Level;
+        bool Styled;
+
+        /// Nanoseconds since the Unix epoch
+        int64_t Timestamp;
+
+        LogFormatter Formatter;
+
+        /// A literal, which outlives the record
+        const char *Format;
+        size_t FormatLength;
+
+        fmt::text_style Style;
+    };
+
+    static_assert(std::is_trivially_copyable_v<LogRecord>);
+
+    /// Messages of one thread, waiting to be formatted by the logging thread (single producer, single consumer).
+    ///
+    /// Records are contiguous: one that would not fit before the end of the storage starts over at its beginning.
+    /// When the logging thread lags behind, what does not fit is dropped rather than blocking the producer.
+    class LogRing {
+      public:
+        static constexpr const size_t CAPACITY = 1024 * 1024;
+
+        /// Larger records are dropped
+        static constexpr const size_t MAX_RECORD_SIZE = CAPACITY / 4;
+
+        /// Rate limited messages a call site may log per second on one thread
+        static constexpr const uint32_t RATE_LIMIT = 100;
+
+        LogRing();
+        ~LogRing() = default;
+
+        LogRing(const LogRing &) = delete;
+        LogRing operator=(const LogRing &) = delete;
+
+        /// Producer: returns room for a record of `size` bytes, rounded up, to be published with `Commit`. Returns
+        /// `nullptr` (and counts the message as dropped) if the ring is full.
+        uint8_t *Reserve(size_t &size);
+
+        void Commit() {
+            m_Head.store(m_Reserved, std::memory_order_release);
+        }
+
+        /// Producer: whether a message of `call_site` (its format string) may be logged now. Sets `suppressed` to
+        /// the number of messages it dropped since the last one it let through.
+        bool Admit(const char *call_site, int64_t now, uint32_t &suppressed);
+
+        /// Consumer: calls `visit` with every published record and its arguments, then frees their room.
+        template <typename Visitor>
+        void Drain(Visitor &&visit) {
+            auto tail = m_Tail.load(std::memory_order_relaxed);
+            const auto head = m_Head.load(std::memory_order_acquire);
+
+            while (tail < head) {
+                auto offset = tail % CAPACITY;
+
+                uint32_t size;
+                memcpy(&size, m_Storage.get() + offset, sizeof(size));
+
+                if (size == 0) {
+                    tail += CAPACITY - offset;
+                    continue;
+                }
+
+                LogRecord record;
+                memcpy(&record, m_Storage.get() + offset, sizeof(record));
+                visit(record, m_Storage.get() + offset + sizeof(LogRecord));
+
+                tail += size;
+            }
+
+            m_Tail.store(tail, std::memory_order_release);
+        }
+
+        bool IsEmpty() const {
+            return m_Tail.load(std::memory_order_relaxed) == m_Head.load(std::memory_order_acquire);
+        }
+
+        /// Messages dropped because the ring was full
+        uint64_t GetDropped() const {
+            return m_Dropped.load(std::memory_order_relaxed);
+        }
+
+        /// Set once its thread exited, nothing is logged to the ring anymore
+        void Close() {
+            m_Closed.store(true, std::memory_order_release);
+        }
+
+        bool IsClosed() const {
+            return m_Closed.load(std::memory_order_acquire);
+        }
+
+      private:
+        static constexpr const size_t RATE_LIMIT_SLOTS = 64;
+
+        struct RateLimit
+        {
+            const char *CallSite = nullptr;
+            int64_t WindowStart = 0;
+            uint32_t Count = 0;
+            uint32_t Suppressed = 0;
+        };
+
+        std::unique_ptr<uint8_t[]> m_Storage;
+
+        /// Bytes published and consumed since the start, the offsets in the storage are modulo its capacity
+        alignas(64) std::atomic<size_t> m_Head;
+        alignas(64) std::atomic<size_t> m_Tail;
+
+        /// Producer side
+        alignas(64) size_t m_Reserved;
+        std::atomic<uint64_t> m_Dropped;
+        std::array<RateLimit, RATE_LIMIT_SLOTS> m_Limits;
+
+        std::atomic<bool> m_Closed;
+    };
+
+    /// Process wide logger. Once started, messages are not formatted nor written by the thread that logs them: it
+    /// copies the format string and the arguments to a ring of its own and a background thread does the rest,
+    /// so logging on the relay path costs a few stores instead of a write syscall. Before `Start` and after `Stop`,
+    /// messages are written right away.
+    ///
+    /// Messages below `DFS_LOG_LEVEL` are compiled out, those below the level set at runtime are dropped right
+    /// away. Trace and debug messages, which may be logged for every frame, are rate limited per call site.
+    /// Warnings and errors go to stderr, the rest to stdout.
+    class Log {
+      public:
+        static constexpr const LogLevel COMPILED_LEVEL = static_cast<LogLevel>(DFS_LOG_LEVEL);
+
+        static void Start();
+
+        /// Writes what is left and stops the logging thread. What other threads log meanwhile may be lost.
+        static void Stop();
+
+        static void SetLevel(LogLevel level) {
+            s_Level.store(level, std::memory_order_relaxed);
+        }
+
+        /// Parses a level name (`trace`, `debug`, `info`, `warning` or `error`).
+        static bool ParseLevel(std::string_view name, LogLevel &level);
+
+        /// Whether messages of this level are written, to skip preparing those that are not
+        static bool IsEnabled(LogLevel level) {
+            return level >= COMPILED_LEVEL && level >= s_Level.load(std::memory_order_relaxed);
+        }
+
+        template <typename... Args>
+        static void Trace(fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Trace>(nullptr, format, args...);
+        }
+
+        template <typename... Args>
+        static void Trace(const fmt::text_style &style, fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Trace>(&style, format, args...);
+        }
+
+        template <typename... Args>
+        static void Debug(fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Debug>(nullptr, format, args...);
+        }
+
+        template <typename... Args>
+        static void Debug(const fmt::text_style &style, fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Debug>(&style, format, args...);
+        }
+
+        template <typename... Args>
+        static void Info(fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Info>(nullptr, format, args...);
+        }
+
+        template <typename... Args>
+        static void Info(const fmt::text_style &style, fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Info>(&style, format, args...);
+        }
+
+        template <typename... Args>
+        static void Warning(fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Warning>(nullptr, format, args...);
+        }
+
+        template <typename... Args>
+        static void Warning(const fmt::text_style &style, fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Warning>(&style, format, args...);
+        }
+
+        template <typename... Args>
+        static void Error(fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Error>(nullptr, format, args...);
+        }
+
+        template <typename... Args>
+        static void Error(const fmt::text_style &style, fmt::format_string<Args...> format, Args &&...args) {
+            Write<LogLevel::Error>(&style, format, args...);
+        }
+
+      private:
+        /// `format` was checked against the arguments by the caller
+        template <LogLevel LEVEL, typename... Args>
+        static void Write(const fmt::text_style *style, fmt::string_view format, Args &...args) {
+            if constexpr (LEVEL >= COMPILED_LEVEL) {
+                if (LEVEL < s_Level.load(std::memory_order_relaxed))
+                    return;
+
+                if (s_Running.load(std::memory_order_acquire))
+                    Defer<std::decay_t<Args>...>(LEVEL, style, format, args...);
+                else
+                    WriteNow(LEVEL, style, fmt::vformat(format, fmt::make_format_args(args...)));
+            }
+        }
+
+        template <typename... Types>
+        static void Defer(LogLevel level, const fmt::text_style *style, fmt::string_view format,
+                          const Types &...args) {
+            auto &ring = GetRing();
+
+            // A coarse clock is enough to rate limit, and much cheaper
+            uint32_t suppressed = 0;
+            if (level < LogLevel::Info && !ring.Admit(format.data(), GetCoarseTime(), suppressed))
+                return;
+
+            auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+
+            auto size = sizeof(LogRecord) + (LogArgument<Types>::GetSize(args) + ... + 0);
+            auto bytes = ring.Reserve(size);
+            if (bytes == nullptr)
+                return;
+
+            LogRecord record{};
+            record.Size = static_cast<uint32_t>(size);
+            record.Suppressed = suppressed;
+            record.Level = level;
+            record.Styled = style != nullptr;
+            record.Timestamp = now;
+            record.Formatter = &FormatRecord<Types...>;
+            record.Format = format.data();
+            record.FormatLength = format.size();
+            if (style != nullptr)
+                record.Style = *style;
+
+            memcpy(bytes, &record, sizeof(record));
+
+            [[maybe_unused]] auto out = bytes + sizeof(LogRecord);
+            ((out = LogArgument<Types>::Write(out, args)), ...);
+
+            ring.Commit();
+        }
+
+        template <typename... Types>
+        static void FormatRecord([[maybe_unused]] const uint8_t *arguments, fmt::string_view format,
+                                 fmt::memory_buffer &out) {
+            // Braced: the arguments are read in order
+            std::tuple<typename LogArgument<Types>::Stored...> values{LogArgument<Types>::Read(arguments)...};
+
+            std::apply(
+                [&](const auto &...value) {
+                    fmt::vformat_to(std::back_inserter(out), format, fmt::make_format_args(value...));
+                },
+                values);
+        }
+
+        /// The ring of the calling thread, created on its first message
+        static LogRing &GetRing();
+
+        /// Monotonic nanoseconds, within a few milliseconds
+        static int64_t GetCoarseTime();
+
+        static void WriteNow(LogLevel level, const fmt::text_style *style, std::string_view text);
+
+        static void Run();
+
+      private:
+        static inline std::atomic<LogLevel> s_Level = LogLevel::Debug;
+        static inline std::atomic<bool> s_Running = false;
+    };
+} // namespace dfs
@@ -62,7 +62,9 @@ namespace dfs
         bool PointMov(int x, int y, bool allow_through_entity, int previous, int end,
                       bool avoid_obstacles = true) const;
         bool IsChangeZone(int cell_a, int cell_b) const;
-        void PrintMap(const std::unordered_set<int> highlight) const;
+
+        /// Logs the grid of the map at the trace level, `highlight`ed cells in cyan.
+        void PrintMap(const std::unordered_set<int> &highlight) const;
 
       private:
         int32_t m_MapId;
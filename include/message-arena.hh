@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+// clang-format off
+namespace google {
+namespace protobuf {
+    class Arena;
+} // namespace protobuf
+} // namespace google
+// clang-format on
+
+namespace dfs
+{
+    /// Memory the messages of a session are decoded in, freed all at once after each batch of frames instead of
+    /// message by message, nested submessages and repeated fields included.
+    ///
+    /// The first block of the arena is ours, and grows to the most a batch needed (a map load with its dozens of
+    /// actors and interactive elements), so that later batches fit in it without allocating. It never shrinks.
+    class MessageArena {
+      public:
+        /// Bounds of the first block
+        static constexpr const size_t MIN_BLOCK_SIZE = 4 * 1024;
+        static constexpr const size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+        MessageArena();
+        ~MessageArena();
+
+        MessageArena(const MessageArena &) = delete;
+        MessageArena operator=(const MessageArena &) = delete;
+
+        google::protobuf::Arena *Get() {
+            return m_Arena.get();
+        }
+
+        /// Frees every message decoded since the last reset, and grows the first block if they did not fit in it.
+        void Reset();
+
+        /// Zero until the first batch that decoded anything
+        size_t GetBlockSize() const {
+            return m_BlockSize;
+        }
+
+        /// Most bytes a batch took, blocks included
+        size_t GetHighWaterMark() const {
+            return m_HighWaterMark;
+        }
+
+      private:
+        std::unique_ptr<char[]> m_Block;
+        size_t m_BlockSize;
+        size_t m_HighWaterMark;
+
+        /// Uses `m_Block`, destroyed before it
+        std::unique_ptr<google::protobuf::Arena> m_Arena;
+    };
+} // namespace dfs
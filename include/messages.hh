@@ -1,13 +1,21 @@
 #pragma once
 
 #include "utils.hh"
+#include "wire.hh"
 #include <cstdint>
 #include <optional>
+#include <span>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 // clang-format off
+namespace google {
+namespace protobuf {
+    class Arena;
+} // namespace protobuf
+} // namespace google
+
 namespace com {
 namespace ankama {
 namespace dofus {
@@ -29,6 +37,37 @@ namespace dfs
 {
     class BotDescriptor;
 
+    /// What becomes of a frame once `Messages::HandleMessage` is done with it
+    enum class FrameAction
+    {
+        /// Forwarded as it was received, most frames are
+        Forward,
+
+        /// A handler changed the message: the frame was encoded again
+        Rewrite,
+
+        /// Dropped, the other side never sees it
+        Cancel,
+    };
+
+    /// Where the time handling a message went, filled by `Messages::HandleMessage` when asked for.
+    struct MessageTrace
+    {
+        /// See `Messages::GetKindName`
+        size_t Kind = 0;
+
+        /// Of a request or response, zero if it has none. See `RequestTracker`.
+        int32_t Uid = 0;
+
+        /// Nanoseconds spent in each stage, see `LatencyStage`
+        int64_t Decode = 0;
+        int64_t Handle = 0;
+        int64_t Encode = 0;
+
+        /// When the stage being timed started
+        int64_t LapStart = 0;
+    };
+
     class Messages {
       private:
         enum Request
@@ -67,36 +106,78 @@ namespace dfs
             CharacterCharacteristicsEvent,
         };
 
+        /// Kinds of messages told apart by the latency statistics: those we do not handle, the login ones, the
+        /// combat events, then every bound request, response and event
+        static constexpr const size_t UNBOUND_KIND = 0;
+        static constexpr const size_t LOGIN_KIND = 1;
+        static constexpr const size_t COMBAT_KIND = 2;
+        static constexpr const size_t FIRST_REQUEST_KIND = 3;
+        static constexpr const size_t FIRST_RESPONSE_KIND = FIRST_REQUEST_KIND + PingRequest + 1;
+        static constexpr const size_t FIRST_EVENT_KIND = FIRST_RESPONSE_KIND + MapMovementConfirmResponse + 1;
+
       public:
-        Messages();
+        static constexpr const size_t MESSAGE_KINDS = FIRST_EVENT_KIND + CharacterCharacteristicsEvent + 1;
+
+        Messages() = default;
         ~Messages() = default;
 
         Messages(const Messages &) = delete;
         Messages operator=(const Messages &) = delete;
 
-        std::vector<uint8_t> HandleMessage(const uint8_t *payload, size_t length, int len_offset,
-                                           BotDescriptor *bot) const;
+        /// Returns what to do with the frame: only when a handler changed the message is it encoded again, into
+        /// `rewritten`, other frames are forwarded from the bytes they arrived in. The message is decoded in `arena`,
+        /// which the caller frees (see `MessageArena`), or in one of its own if `nullptr`. `handled` (if given) tells
+        /// whether the message was parsed, as opposed to forwarded without being looked at. `trace` (if given) is
+        /// filled with the kind of the message and the time spent on it, nothing is timed otherwise.
+        FrameAction HandleMessage(const uint8_t *payload, size_t length, int len_offset, BotDescriptor *bot,
+                                  google::protobuf::Arena *arena, std::vector<uint8_t> &rewritten,
+                                  bool *handled = nullptr, MessageTrace *trace = nullptr) const;
+
+        /// Returns the kind of a message given the member of the `content` oneof it comes in and its `type_url`,
+        /// `UNBOUND_KIND` if we do not handle this type of message at all. Those are forwarded without being parsed.
+        static size_t GetKind(GameMessagePeek::Kind content, std::string_view type_url);
+
+        /// Name of a kind of message, below `MESSAGE_KINDS`
+        static const char *GetKindName(size_t kind);
+
+        /// Whether a client frame may be forwarded before it is fully received, given the beginning of its
+        /// payload. Only requests we never cancel nor rewrite qualify.
+        bool CanCutThrough(const uint8_t *payload, size_t available) const;
 
-        static std::vector<uint8_t> ForgeMapMovementRequest(const std::vector<PathElement> &path, int map_id,
-                                                            bool cautious);
-        static std::vector<uint8_t> ForgeMapChangeRequest(int map_id, bool autopilot);
-        static std::vector<uint8_t> ForgeMapMovementConfirmRequest();
-        static std::vector<uint8_t> ForgeInteractiveUseRequest(int element_id, int skill_instance_uid);
+        /// Whether the game server was selected, after which game messages replace the login ones. This is
+        /// process wide: it is handed over along with the sessions on a hot restart.
+        static bool IsConnected();
+        static void SetConnected(bool connected);
+
+        /// Large enough for a forged request, even a movement through every cell of a map
+        static constexpr const size_t MAX_FORGED_FRAME_SIZE = 4096;
+
+        /// Forged requests are written in one pass to `frame`, behind their length prefix, ready to be queued. They
+        /// return the length of the frame, zero if it does not fit.
+        static size_t ForgeMapMovementRequest(const std::vector<PathElement> &path, int map_id, bool cautious,
+                                              std::span<uint8_t> frame);
+        static size_t ForgeMapChangeRequest(int map_id, bool autopilot, std::span<uint8_t> frame);
+        static size_t ForgeInteractiveUseRequest(int element_id, int skill_instance_uid, std::span<uint8_t> frame);
+
+        /// Encoded once: the request is always the same
+        static std::span<const uint8_t> ForgeMapMovementConfirmRequest();
 
       private:
-        void ReadBindings();
-        bool ParseRequest(const com::ankama::dofus::server::game::protocol::Request &request, BotDescriptor *bot) const;
+        /// Handlers that change the request return `FrameAction::Rewrite`, those that cancel it `FrameAction::Cancel`.
+        FrameAction ParseRequest(com::ankama::dofus::server::game::protocol::Request &request, BotDescriptor *bot,
+                                 google::protobuf::Arena *arena) const;
         void ParseResponse(const com::ankama::dofus::server::game::protocol::Response &response,
                            BotDescriptor *bot) const;
-        void ParseEvent(const com::ankama::dofus::server::game::protocol::Event &event, BotDescriptor *bot) const;
-        std::optional<std::string> HandleGameMessage(const uint8_t *payload, size_t length, int len_offset,
-                                                     BotDescriptor *bot) const;
-        std::string HandleConnectionMessage(const uint8_t *payload, size_t length, int len_offset,
-                                            BotDescriptor *bot) const;
+        void ParseEvent(const com::ankama::dofus::server::game::protocol::Event &event, BotDescriptor *bot,
+                        google::protobuf::Arena *arena) const;
 
-      private:
-        std::unordered_map<std::string, Request> m_RequestBindings;
-        std::unordered_map<std::string, Response> m_ResponseBindings;
-        std::unordered_map<std::string, Event> m_EventBindings;
+        /// Handles the busiest events straight from their bytes (see `event-views.hh`). Returns false if the event
+        /// must be parsed in full instead.
+        static bool HandleEventView(size_t kind, std::string_view event, BotDescriptor *bot);
+        FrameAction HandleGameMessage(const uint8_t *payload, size_t length, int len_offset, BotDescriptor *bot,
+                                      google::protobuf::Arena *arena, std::vector<uint8_t> &rewritten, bool &handled,
+                                      MessageTrace *trace) const;
+        FrameAction HandleConnectionMessage(const uint8_t *payload, size_t length, int len_offset, BotDescriptor *bot,
+                                            bool &handled, MessageTrace *trace) const;
     };
 } // namespace dfs
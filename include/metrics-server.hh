@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace dfs
+{
+    /// Minimal HTTP server on the loopback interface, serving the metrics of the proxy in the Prometheus text
+    /// format. It runs on a thread of its own and only reads what the reactors count, so a scrape never holds
+    /// back the relay.
+    class MetricsServer {
+      public:
+        /// Returns the body of a scrape
+        using Renderer = std::function<std::string()>;
+
+        explicit MetricsServer(Renderer render);
+        ~MetricsServer();
+
+        MetricsServer(const MetricsServer &) = delete;
+        MetricsServer operator=(const MetricsServer &) = delete;
+
+        /// Listens on 127.0.0.1. Returns false on failure.
+        bool Listen(uint16_t port);
+
+        /// Serves scrapes, one at a time, until `Stop` is called.
+        void Run();
+
+        /// Makes `Run` return, from any thread.
+        void Stop();
+
+      private:
+        /// Answers the request of a client, then closes the connection.
+        void Serve(int client);
+
+      private:
+        Renderer m_Render;
+        int m_Listener;
+        int m_WakeFd;
+    };
+} // namespace dfs
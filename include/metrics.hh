@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dfs
+{
+    /// Process wide counters, see `Metrics`
+    enum class Counter : size_t
+    {
+        PathSearches,
+        PathSearchNanoseconds,
+        MapCacheHits,
+        MapCacheMisses,
+
+        /// Maps held by the cache of the game data, and the size of their cells
+        MapCacheMaps,
+        MapCacheBytes,
+
+        COUNT,
+    };
+
+    /// Counters any thread may bump without a locked instruction nor a shared cache line: every thread has a
+    /// shard of its own, which only it writes. Reading them sums the shards, it never waits for the writers.
+    class Metrics {
+      public:
+        static void Add(Counter counter, uint64_t value) {
+            auto &slot = GetShard().Values[static_cast<size_t>(counter)];
+            slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        /// Sum over every thread, including those that exited
+        static uint64_t Get(Counter counter);
+
+      private:
+        struct alignas(64) Shard
+        {
+            std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::COUNT)> Values{};
+        };
+
+        /// The shard of the calling thread, registered on its first use. Shards outlive their thread so that
+        /// nothing it counted is lost.
+        static Shard &GetShard();
+
+      private:
+        /// Only locked when a thread counts something for the first time, and while reading
+        static std::mutex s_ShardsMutex;
+        static std::vector<std::unique_ptr<Shard>> s_Shards;
+    };
+} // namespace dfs
@@ -1,31 +1,126 @@
 #pragma once
 
-#include <thread>
-#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
 
-#include "messages.hh"
+#include "handoff.hh"
+#include "reactor.hh"
 
 namespace dfs
 {
     class GameData;
+    class Session;
 
     class Proxy {
       public:
-        Proxy(int port, const GameData &game_data);
-        ~Proxy();
+        enum class Backend
+        {
+            /// Readiness based event loop, works everywhere
+            Epoll,
+
+            /// Completion based event loop. Falls back to epoll if the kernel does not support it.
+            IoUring,
+        };
+
+        struct Options
+        {
+            Backend EventLoop = Backend::Epoll;
+
+            /// Relay server to client traffic kernel-side (epoll backend only)
+            bool Splice = false;
+
+            /// Number of reactors, each with its own listening socket, sessions and message handler, pinned to
+            /// its own core. Zero means one per core.
+            unsigned Workers = 1;
+
+            /// Sessions not set up within these are dropped
+            SessionTimeouts Timeouts;
+
+            /// Abstract Unix socket the hook connects to when it can, which spares the game leg a loopback TCP
+            /// stack. Shared by every worker, alongside their TCP socket. Empty to disable.
+            std::string UnixSocket = "dfs-proxy";
+
+            /// Abstract Unix socket of the hooks that let the game talk to the server itself and mirror its
+            /// traffic through shared memory (in-process mode). Served by a reactor of its own. Empty to disable.
+            std::string ObserveSocket = "dfs-observe";
+
+            /// Unix socket for hot restarts. A new process started with the same path takes the listening
+            /// sockets and every live session over from the running one, which then exits. Empty to disable.
+            std::string HandoffPath;
+
+            /// File every decoded frame is recorded to, for `dfs-replay`. Appended to if it already exists. Empty
+            /// to disable.
+            std::string CapturePath;
+
+            /// Port of the Prometheus endpoint, on the loopback interface. Zero to disable.
+            uint16_t MetricsPort = 0;
+        };
+
+        Proxy(int port, const GameData &game_data, const Options &options);
+        ~Proxy() = default;
 
         Proxy(const Proxy &) = delete;
         Proxy operator=(const Proxy &) = delete;
 
         void Run();
 
+        /// Calls `visit` with every live session of every reactor, from any thread. The reactors keep relaying
+        /// meanwhile: only their state and counters may be read.
+        static void ForEachSession(const std::function<void(const Session &)> &visit);
+
       private:
-        void HandleConnection(int client_sock) const;
+        /// Opens a listening socket on our port. Every worker has its own, the kernel spreads the incoming
+        /// connections between them (SO_REUSEPORT).
+        int Listen() const;
+
+        /// Opens a listening Unix socket in the abstract namespace.
+        int ListenUnix(const std::string &name) const;
+
+        /// Runs the reactor of the observed sessions until the workers stop.
+        void RunObserver(int listen_sock);
+
+        void RunWorker(unsigned index, unsigned count);
+
+        /// Receives the sockets and sessions of the process running at the handoff path, if any.
+        bool TakeOver();
+
+        /// Waits for the next process on the handoff socket, then stops the workers so they export their
+        /// sessions.
+        void WaitForSuccessor(int listen_sock);
+
+        /// Sends what the workers exported to the next process.
+        void HandOver();
+
+        /// Prints the live sessions whenever SIGUSR1 is received, until the workers stop.
+        void ReportSessions();
+
+        /// Prints the latency percentiles of every stage, direction and kind of message, over every reactor.
+        static void ReportLatencies();
+
+        /// Returns the counters of every reactor, session and bot in the Prometheus text format.
+        static std::string RenderMetrics();
 
       private:
         int m_Port;
         const GameData &m_GameData;
-        std::vector<std::thread> m_Clients;
-        Messages m_MessageHandler;
+        Options m_Options;
+
+        /// -1 if disabled
+        int m_UnixListener;
+        int m_ObserveListener;
+
+        /// Stops the observer along with the workers
+        std::atomic<bool> m_WorkersDone;
+
+        /// Taken over from the previous process, consumed by the workers
+        Handoff m_Inherited;
+
+        /// Filled by the workers when handing over to the next process
+        Handoff m_Outgoing;
+        std::mutex m_OutgoingMutex;
+        int m_Successor;
     };
 } // namespace dfs
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+#include "reactor.hh"
+
+struct dfs_shared;
+
+namespace dfs
+{
+    struct Endpoint;
+
+    /// Event loop of the sessions observed in process: the game talks to the server on its own and the hook
+    /// mirrors both directions into shared memory rings (see `shared-ring.h`). There is no extra hop, the proxy only
+    /// decodes what it sees and injects what the bot sends through another ring.
+    ///
+    /// The hook connects to the listening socket, sends its shared memory along a hello, and then only uses the
+    /// connection as a doorbell: a byte is sent whenever the other side has something to read and went to sleep.
+    /// Observed sessions are not handed over on hot restarts, the hooks detach and the games go on unobserved.
+    class ObserverReactor : public Reactor {
+      public:
+        ObserverReactor(int listen_sock, const GameData &game_data, const Messages &messages);
+        ~ObserverReactor() override;
+
+        void Run() override;
+
+      protected:
+        void Quiesce() override;
+        void Adopt(Session &session) override;
+
+      private:
+        void Accept();
+
+        /// Maps the shared memory the hook sent along its hello. Returns false if the hello is invalid.
+        bool ReceiveHello(Session &session);
+
+        void HandleEvent(Endpoint &control, uint32_t events);
+
+        /// Decodes everything the hook mirrored. Returns false if the session must be closed.
+        bool Drain(Session &session, dfs_shared &shared, bool &drained);
+
+        /// Moves the frames the bot queued to the injection ring, if they all fit.
+        void Inject(Session &session, dfs_shared &shared);
+
+        /// Tells the hooks to ring the doorbell when they mirror something, unless there is already something to
+        /// read. Returns false if a session must be drained again instead of sleeping.
+        bool PrepareToSleep();
+
+        /// Releases the shared memory of the sessions that were closed.
+        void UnmapClosedSessions();
+
+      private:
+        static constexpr const int MAX_EVENTS = 64;
+
+        /// Keep polling the rings for this long after the last mirrored byte before going to sleep: traffic comes
+        /// in bursts (a request, then its response), which then costs no doorbell.
+        static constexpr const std::chrono::microseconds SPIN_DURATION{100};
+
+        int m_Epoll;
+        now_t m_LastActivity;
+        std::unordered_map<Session *, dfs_shared *> m_Shared;
+    };
+} // namespace dfs
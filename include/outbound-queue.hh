@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+struct iovec;
+
+namespace dfs
+{
+    class LatencyHistogram;
+    class SnapshotReader;
+    class SnapshotWriter;
+
+    /// Bytes waiting to be written to one socket, kept in the order they were queued.
+    ///
+    /// Every producer of a socket (the relay and the bot) pushes whole frames here and a single writer drains it
+    /// with `writev`, so frames never interleave and a batch of frames costs one syscall. Frames handed over as
+    /// vectors are moved in without copying, raw bytes are coalesced into chunks.
+    class OutboundQueue {
+      public:
+        /// Number of chunks written by a single `writev`
+        static constexpr const size_t MAX_BATCH = 64;
+
+        /// Past `HIGH_WATERMARK` queued bytes the queue is congested and producers should stop reading from their
+        /// source, until it drains back to `LOW_WATERMARK`.
+        static constexpr const size_t HIGH_WATERMARK = 1024 * 1024;
+        static constexpr const size_t LOW_WATERMARK = 256 * 1024;
+
+        OutboundQueue() = default;
+        ~OutboundQueue() = default;
+
+        OutboundQueue(const OutboundQueue &) = delete;
+        OutboundQueue operator=(const OutboundQueue &) = delete;
+
+        void Push(std::vector<uint8_t> &&frame);
+        void Push(const uint8_t *data, size_t length);
+
+        /// Queues a piece of a frame that is forwarded before being fully received. Until its `last` piece is
+        /// queued, whatever else is pushed is held back so it does not end up in the middle of that frame.
+        void PushPartial(const uint8_t *data, size_t length, bool last);
+
+        /// Writes as much as the socket accepts. Returns false on a fatal error.
+        bool Flush(int fd);
+
+        /// Fills `vectors` with the next chunks to write, returns how many were filled.
+        size_t Gather(std::span<iovec> vectors) const;
+
+        /// Drops `length` bytes that were written.
+        void Consume(size_t length);
+
+        /// Exchanges the bytes ready to be written of both queues (to hand them over to an asynchronous writer).
+        /// Frames held back by a partial one stay where they are.
+        void Swap(OutboundQueue &other);
+
+        /// Moves the bytes ready to be written of `other` in front of ours: takes back what an asynchronous writer
+        /// was handed but did not write.
+        void Prepend(OutboundQueue &other);
+
+        /// Writes everything that was not written yet, held frames included, to a session snapshot.
+        void Save(SnapshotWriter &writer) const;
+
+        /// Replaces the content of the queue with what `Save` wrote. Returns false if the snapshot is truncated.
+        bool Restore(SnapshotReader &reader);
+
+        bool IsEmpty() const {
+            return m_Size == 0;
+        }
+
+        size_t GetSize() const {
+            return m_Size;
+        }
+
+        bool IsCongested() const {
+            return m_Congested;
+        }
+
+        /// Records how long the queue stays non-empty, from the first byte queued to the last one written, in
+        /// `histogram`. `nullptr` stops recording. Queues handing bytes over with `Swap` should share it.
+        void SetDrainHistogram(LatencyHistogram *histogram) {
+            m_DrainHistogram = histogram;
+        }
+
+        LatencyHistogram *GetDrainHistogram() const {
+            return m_DrainHistogram;
+        }
+
+      private:
+        void Append(const uint8_t *data, size_t length);
+        void UpdateCongestion();
+
+        /// Starts timing the queue once it gets bytes to write, records the time it took once it has none.
+        void UpdateDrain();
+
+      private:
+        /// Raw bytes are appended to the last chunk as long as it stays under this size
+        static constexpr const size_t COALESCE_SIZE = 16 * 1024;
+
+        std::deque<std::vector<uint8_t>> m_Chunks;
+
+        /// Bytes of the first chunk that were already written
+        size_t m_Offset = 0;
+
+        /// Bytes ready to be written
+        size_t m_Size = 0;
+        bool m_Congested = false;
+
+        /// Set while a frame is partially queued, what is pushed meanwhile waits in `m_Held`
+        bool m_Partial = false;
+        std::deque<std::vector<uint8_t>> m_Held;
+        size_t m_HeldSize = 0;
+
+        /// See `monotonic_ns`, zero while empty or not recording
+        int64_t m_QueuedSince = 0;
+        LatencyHistogram *m_DrainHistogram = nullptr;
+    };
+} // namespace dfs
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bot.hh"
+#include "capture.hh"
+#include "latency-histogram.hh"
+#include "session-registry.hh"
+#include "snapshot.hh"
+
+namespace dfs
+{
+    class GameData;
+    class Messages;
+    class Session;
+
+    /// How long a session may take to be set up before it is dropped.
+    struct SessionTimeouts
+    {
+        /// From the client connection to the reception of the handshake
+        std::chrono::milliseconds Handshake{5000};
+
+        /// For the connection to the upstream server
+        std::chrono::milliseconds Connect{10000};
+    };
+
+    struct SessionStats
+    {
+        uint64_t Connected = 0;
+        uint64_t TimedOut = 0;
+        uint64_t Failed = 0;
+
+        /// Time from the reception of the handshake to the upstream connection being established
+        std::chrono::nanoseconds SetupTotal{0};
+        std::chrono::nanoseconds SetupMax{0};
+    };
+
+    /// Event loop owning its listening sockets and every session accepted on it (both sockets, their decoders and
+    /// their bot). Backends only differ in how they wait for and perform I/O: frame decoding, message handling
+    /// and bot updates all go through `Session`.
+    class Reactor {
+      public:
+        Reactor(int listen_sock, const GameData &game_data, const Messages &messages);
+        virtual ~Reactor();
+
+        Reactor(const Reactor &) = delete;
+        Reactor operator=(const Reactor &) = delete;
+
+        /// Runs the event loop until `Stop` is called.
+        virtual void Run() = 0;
+
+        /// Makes `Run` return. This is async-signal-safe.
+        void Stop();
+
+        /// Accepts sessions on another listening socket as well, which may be shared with other reactors (the
+        /// Unix socket of the hook for example). Must be called before `Run`.
+        void AddListener(int listen_sock) {
+            m_Listeners.push_back(listen_sock);
+        }
+
+        void SetTimeouts(const SessionTimeouts &timeouts) {
+            m_Timeouts = timeouts;
+        }
+
+        /// Records the frames of every session, from now on. Must be called from the thread that runs the reactor,
+        /// or before `Run`.
+        void SetCapture(std::unique_ptr<CaptureWriter> capture);
+
+        const SessionStats &GetStats() const {
+            return m_Stats;
+        }
+
+        /// Readable from any thread while the reactor records
+        const LatencyStats &GetLatencies() const {
+            return m_Latencies;
+        }
+
+        /// Enumerable from any thread, see `SessionRegistry::ForEach`
+        const SessionRegistry &GetSessions() const {
+            return m_Sessions;
+        }
+
+        /// Hands every live session over to another process, once `Run` returned. The backend first gives back
+        /// whatever it still holds for them, nothing buffered is lost. Must be called from the thread that ran the
+        /// reactor.
+        std::vector<SessionSnapshot> Export();
+
+        /// Takes over a session exported by another process, before `Run`. Returns false (and closes its sockets)
+        /// if the snapshot is invalid.
+        bool Import(const SessionSnapshot &snapshot);
+
+      protected:
+        Session &AddSession(int client_sock);
+
+        /// Brings every live session to a point where nothing is pending in the backend: no operation in flight,
+        /// no byte held outside of the session queues. Called by `Export`.
+        virtual void Quiesce() = 0;
+
+        /// Starts watching the sockets of an imported session, according to its state.
+        virtual void Adopt(Session &session) = 0;
+
+        /// Must be called once the upstream socket of a connecting session becomes writable. Returns false if the
+        /// connection failed, in which case the session must be closed.
+        bool OnConnected(Session &session);
+
+        /// Lets the bots react to what happened since the last call (or to their timers), drops the sessions that
+        /// did not get set up in time and writes the capture block that waited long enough.
+        void UpdateBots(const now_t &now);
+
+        /// Prints the session statistics, when shutting down.
+        void PrintStats() const;
+
+        /// Destroys the sessions that were closed.
+        void RemoveClosedSessions();
+
+        /// Returns the time until the next bot timer, setup deadline or capture flush expires, in milliseconds, or -1
+        /// if there is none.
+        int GetTimeout() const;
+
+      private:
+        /// Returns when a session that is still being set up must be dropped, or `now_t::max()`.
+        now_t GetSetupDeadline(const Session &session) const;
+
+      protected:
+        std::vector<int> m_Listeners;
+        int m_WakeFd;
+        std::atomic<bool> m_Running;
+
+        const GameData &m_GameData;
+        const Messages &m_MessageHandler;
+
+        /// Outlives the sessions, which write to it
+        std::unique_ptr<CaptureWriter> m_Capture;
+        LatencyStats m_Latencies;
+
+        SessionRegistry m_Sessions;
+
+        SessionTimeouts m_Timeouts;
+        SessionStats m_Stats;
+    };
+} // namespace dfs
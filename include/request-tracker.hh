@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace dfs
+{
+    class LatencyStats;
+
+    /// Matches the responses of the server with the requests of a session, by uid, to time the round trip to the
+    /// server apart from the time the frames spend in the proxy. Requests still unanswered after `TIMEOUT` (many are
+    /// answered by events, which carry no uid) are counted as such and forgotten.
+    ///
+    /// Requests are kept in a small open addressing table: a session rarely has more than a few in flight.
+    class RequestTracker {
+      public:
+        static constexpr const size_t CAPACITY = 64;
+
+        /// Requests beyond that evict the oldest one, which counts as unanswered
+        static constexpr const size_t MAX_PENDING = CAPACITY * 3 / 4;
+
+        static constexpr const int64_t TIMEOUT = std::chrono::nanoseconds(std::chrono::seconds(10)).count();
+
+        RequestTracker();
+        ~RequestTracker() = default;
+
+        RequestTracker(const RequestTracker &) = delete;
+        RequestTracker operator=(const RequestTracker &) = delete;
+
+        /// Remembers a request of the given kind (see `Messages::GetKindName`) sent at `now` (see `monotonic_ns`).
+        /// Requests without a uid cannot be matched and are ignored.
+        void Sent(int32_t uid, size_t kind, int64_t now, LatencyStats &stats);
+
+        /// Records the round trip of the request a response answers, if it was tracked.
+        void Answered(int32_t uid, int64_t now, LatencyStats &stats);
+
+        /// Gives up on the requests older than `TIMEOUT`. Cheap when none may be.
+        void Expire(int64_t now, LatencyStats &stats);
+
+        size_t GetPending() const {
+            return m_Pending;
+        }
+
+      private:
+        struct Entry
+        {
+            int32_t Uid = 0;
+            bool Used = false;
+            uint32_t Kind = 0;
+            int64_t SentAt = 0;
+        };
+
+        static size_t SlotOf(int32_t uid) {
+            return (static_cast<uint32_t>(uid) * 0x9E3779B1u) >> 26;
+        }
+
+        /// Returns the slot holding `uid`, or `CAPACITY`.
+        size_t Find(int32_t uid) const;
+
+        /// Frees a slot, moving back the entries that probed past it so that lookups keep finding them.
+        void Remove(size_t slot);
+
+        void GiveUp(size_t slot, LatencyStats &stats);
+
+      private:
+        std::array<Entry, CAPACITY> m_Entries;
+        size_t m_Pending;
+
+        /// No request expires before that
+        int64_t m_NextExpiry;
+    };
+} // namespace dfs
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "session.hh"
+
+namespace dfs
+{
+    /// Sessions owned by a reactor. Adding and removing one are O(1): the last session takes the place of the
+    /// removed one, so the order is not kept.
+    ///
+    /// Only the owning reactor adds, removes and iterates over the sessions, without locking. Other threads may
+    /// enumerate them with `ForEach` at any time and read their state and counters: they only ever wait for an
+    /// addition or a removal, never for the relay.
+    class SessionRegistry {
+      public:
+        using Sessions = std::vector<std::unique_ptr<Session>>;
+
+        SessionRegistry() = default;
+        ~SessionRegistry();
+
+        SessionRegistry(const SessionRegistry &) = delete;
+        SessionRegistry operator=(const SessionRegistry &) = delete;
+
+        Session &Add(std::unique_ptr<Session> session);
+        void Remove(Session &session);
+
+        /// Destroys the sessions that were closed.
+        void RemoveClosed();
+
+        /// Destroys every session, closing their sockets.
+        void Clear();
+
+        /// Calls `visit` with every session, from any thread. Only the state and the counters of a session may be
+        /// read from another thread than the one of its reactor.
+        template <typename F>
+        void ForEach(F &&visit) const {
+            std::lock_guard lock(m_Mutex);
+
+            for (const auto &session : m_Sessions)
+                visit(static_cast<const Session &>(*session));
+        }
+
+        size_t GetSize() const {
+            return m_Sessions.size();
+        }
+
+        /// Counters of every session removed so far, added up (`LastActivity` aside). Readable from any thread.
+        const SessionCounters &GetRetired() const {
+            return m_Retired;
+        }
+
+        Sessions::iterator begin() {
+            return m_Sessions.begin();
+        }
+
+        Sessions::iterator end() {
+            return m_Sessions.end();
+        }
+
+        Sessions::const_iterator begin() const {
+            return m_Sessions.begin();
+        }
+
+        Sessions::const_iterator end() const {
+            return m_Sessions.end();
+        }
+
+      private:
+        /// Adds the counters of a session that goes away to `m_Retired`.
+        void Retire(const Session &session);
+
+      private:
+        Sessions m_Sessions;
+        SessionCounters m_Retired;
+
+        /// Held while the vector changes and while another thread enumerates it
+        mutable std::mutex m_Mutex;
+    };
+} // namespace dfs
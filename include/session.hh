@@ -0,0 +1,263 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+#include "frame-decoder.hh"
+#include "message-arena.hh"
+#include "outbound-queue.hh"
+#include "request-tracker.hh"
+#include "simple-farming-bot.hh"
+#include "snapshot.hh"
+
+namespace dfs
+{
+    class CaptureWriter;
+    class GameData;
+    class LatencyStats;
+    class Messages;
+    class Session;
+    struct MessageTrace;
+
+    /// Sent by the hook right after connecting to the proxy: where the game wanted to connect to.
+    struct Handshake
+    {
+        uint8_t Address[16];
+        socklen_t Addrlen;
+        in_port_t Port;
+    };
+
+    /// One side of a proxied session: either the game client or the upstream server.
+    struct Endpoint
+    {
+        Endpoint(Session &owner, bool is_server)
+            : Owner(owner)
+            , IsServer(is_server) {
+        }
+
+        Endpoint(const Endpoint &) = delete;
+        Endpoint operator=(const Endpoint &) = delete;
+
+        /// Appends bytes to the outbound queue. Nothing is written until `Flush` is called.
+        void Queue(const uint8_t *data, size_t length) {
+            Outbound.Push(data, length);
+        }
+
+        /// Appends a whole frame to the outbound queue, without copying it.
+        void Queue(std::vector<uint8_t> &&frame) {
+            Outbound.Push(std::move(frame));
+        }
+
+        /// Writes as much of the outbound queue as the socket accepts. Returns false on a fatal error.
+        bool Flush() {
+            return Outbound.Flush(Fd);
+        }
+
+        bool HasPending() const {
+            return !Outbound.IsEmpty();
+        }
+
+        Session &Owner;
+        const bool IsServer;
+
+        int Fd = -1;
+
+        /// Whether the reactor currently watches this fd for readability and writability
+        bool WantsRead = true;
+        bool WantsWrite = false;
+
+        /// Bytes received but not yet decoded into complete frames
+        FrameDecoder Inbound;
+
+        /// When the bytes of the incomplete frame at the front of `Inbound` started arriving (see `monotonic_ns`).
+        /// Only kept while recording latencies, zero otherwise.
+        int64_t PartialSince = 0;
+
+        /// Frames waiting to be written, from the relay and the bot alike
+        OutboundQueue Outbound;
+    };
+
+    /// Live counters of a session. Only the reactor owning the session writes them, any thread may read them while
+    /// it keeps relaying.
+    struct SessionCounters
+    {
+        /// Single writer: a plain load and store, no locked instruction on the relay path
+        static void Add(std::atomic<uint64_t> &counter, uint64_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        /// Bytes and complete frames received from each side
+        std::atomic<uint64_t> ClientBytes = 0;
+        std::atomic<uint64_t> ServerBytes = 0;
+        std::atomic<uint64_t> ClientFrames = 0;
+        std::atomic<uint64_t> ServerFrames = 0;
+
+        /// Frames the message handler parsed, the others were forwarded without being looked at
+        std::atomic<uint64_t> Handled = 0;
+
+        /// Decisions the bot took, and how long they waited for the reactor in total: from the state update or the
+        /// timer that called for them to the moment they were taken
+        std::atomic<uint64_t> BotSteps = 0;
+        std::atomic<uint64_t> BotWaitNanoseconds = 0;
+
+        /// When something was last received from either side (`now_t` ticks since its epoch)
+        std::atomic<now_t::rep> LastActivity = 0;
+    };
+
+    class Session {
+      public:
+        enum class State
+        {
+            /// Waiting for the hook to send the address of the real server
+            Handshake,
+
+            /// Non-blocking connect to the upstream server in progress
+            Connecting,
+
+            /// Both sides are connected and frames are being relayed
+            Relaying,
+
+            /// The game talks to the server on its own, the hook mirrors both directions through shared memory.
+            /// Frames are only observed, what the bot queues on the server side is injected by the hook.
+            Observing,
+
+            /// The session is done and will be destroyed by the reactor
+            Closed,
+        };
+
+        Session(int client_sock, const GameData &game_data, const Messages &messages);
+        ~Session();
+
+        Session(const Session &) = delete;
+        Session operator=(const Session &) = delete;
+
+        /// Consumes bytes received from the game client.
+        void OnClientData(const uint8_t *data, size_t length);
+
+        /// Consumes bytes received from the upstream server. They are forwarded to the client untouched.
+        void OnServerData(const uint8_t *data, size_t length);
+
+        /// Same as `OnServerData` when the backend already relayed the bytes to the client on its own: they were
+        /// appended to the server inbound buffer and only need to be decoded.
+        void OnServerDataRelayed(size_t length);
+
+        /// Creates the upstream socket and starts a non-blocking connect to the server sent in the handshake.
+        /// Returns false if the connection could not be initiated.
+        bool Connect();
+
+        /// Must be called once the upstream socket becomes writable while connecting. Returns false if the
+        /// connection failed.
+        bool OnConnected();
+
+        /// Starts observing a game connected to the server by itself, once the hook shared its traffic with us.
+        /// The client socket is the control connection of the hook.
+        void Observe();
+
+        /// Decodes `length` bytes the hook mirrored, already appended to the inbound buffer of `from`. Nothing is
+        /// forwarded.
+        void OnObservedData(Endpoint &from, size_t length);
+
+        /// Records every frame decoded from now on, before it is handled. `nullptr` stops recording.
+        void SetCapture(CaptureWriter *capture) {
+            m_Capture = capture;
+        }
+
+        /// Records the latency of every frame from now on, and the time both outbound queues take to drain.
+        /// `nullptr` stops recording.
+        void SetLatencyStats(LatencyStats *latencies);
+
+        /// Runs the bot logic if its state was updated or one of its timers expired.
+        void UpdateBot(const now_t &now);
+
+        /// Returns the next point in time the bot wants to be woken up at.
+        now_t NextWakeup() const;
+
+        void Close();
+
+        /// Hands the session over to another process: returns its sockets and everything buffered for them,
+        /// and forgets about them without closing the connections. The session is closed afterwards.
+        SessionSnapshot Detach();
+
+        /// Takes over a session detached by another process. Must be called right after construction, with the
+        /// client socket of the snapshot. Returns false if the snapshot is invalid.
+        bool Restore(const SessionSnapshot &snapshot);
+
+        /// May be called from any thread
+        State GetState() const {
+            return m_State.load(std::memory_order_relaxed);
+        }
+
+        /// Unique within the process
+        uint64_t GetId() const {
+            return m_Id;
+        }
+
+        /// May be read from any thread
+        const SessionCounters &GetCounters() const {
+            return m_Counters;
+        }
+
+        /// When the session entered its current state
+        now_t GetStateSince() const {
+            return m_StateSince;
+        }
+
+        Endpoint &GetClient() {
+            return m_Client;
+        }
+
+        Endpoint &GetServer() {
+            return m_Server;
+        }
+
+      private:
+        void DecodeFrames(Endpoint &from, Endpoint *forward_to);
+
+        void RecordLatencies(const Endpoint &from, const MessageTrace &trace, int64_t assembled, bool handled,
+                             bool forwarded);
+
+        /// Starts or continues forwarding the incomplete frame at the front of the client decoder.
+        void CutThrough();
+
+        void SetState(State state);
+
+        /// Counts bytes received from one side.
+        void Received(const Endpoint &from, size_t length);
+
+      private:
+        friend class SessionRegistry;
+
+        const uint64_t m_Id;
+        std::atomic<State> m_State;
+        now_t m_StateSince;
+        const Messages &m_MessageHandler;
+        Endpoint m_Client;
+        Endpoint m_Server;
+        SimpleFarmingBot m_Bot;
+
+        /// What the frames of a batch were decoded in, reset once they are all handled
+        MessageArena m_Arena;
+
+        /// Bytes of the incomplete client frame that were already forwarded. Zero while it is held back.
+        size_t m_CutThroughOffset;
+
+        SessionCounters m_Counters;
+
+        /// Owned by the reactor, `nullptr` when not capturing
+        CaptureWriter *m_Capture;
+
+        /// Owned by the reactor, `nullptr` when not recording
+        LatencyStats *m_Latencies;
+
+        /// Requests sent to the server, waiting for their response. Only fed while recording latencies.
+        RequestTracker m_Requests;
+
+        /// Position in the registry of the reactor
+        size_t m_RegistryIndex;
+    };
+} // namespace dfs
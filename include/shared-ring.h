@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+ * Shared memory between the hook and the proxy when the game is observed in process: the game talks to the server
+ * on its own and the hook mirrors both directions into lock-free single producer, single consumer rings that the
+ * proxy maps. The proxy sends what the bot wants to inject through a third ring, the hook writes it to the server
+ * between two game frames.
+ *
+ * Plain C so hook.c can include it. Positions are free running 64-bit counters, only the producer moves `Head` and
+ * only the consumer moves `Tail`.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DFS_SHARED_MAGIC 0x64667372u
+#define DFS_SHARED_VERSION 1u
+
+/* Power of two, a single frame always fits */
+#define DFS_RING_SIZE (1024u * 1024u)
+
+struct dfs_ring
+{
+    uint64_t Head __attribute__((aligned(64)));
+    uint64_t Tail __attribute__((aligned(64)));
+    uint8_t Data[DFS_RING_SIZE] __attribute__((aligned(64)));
+};
+
+struct dfs_shared
+{
+    uint32_t Magic;
+    uint32_t Version;
+
+    /* Set by the proxy before it goes to sleep: the next producer must ring the doorbell (one byte on the control
+     * socket) and clear it */
+    uint32_t Sleeping __attribute__((aligned(64)));
+
+    /* Mirrored by the hook: what the game sent to the server, and what it received from it */
+    struct dfs_ring ToServer;
+    struct dfs_ring ToClient;
+
+    /* Written by the proxy, whole frames only: sent to the server by the hook */
+    struct dfs_ring Injected;
+};
+
+/* Sent by the hook on the control socket right after connecting, with the shared memory fd attached */
+struct dfs_shared_hello
+{
+    uint32_t Magic;
+    uint32_t Version;
+};
+
+static inline size_t dfs_ring_readable(const struct dfs_ring *ring) {
+    return __atomic_load_n(&ring->Head, __ATOMIC_ACQUIRE) - ring->Tail;
+}
+
+static inline size_t dfs_ring_writable(const struct dfs_ring *ring) {
+    return DFS_RING_SIZE - (ring->Head - __atomic_load_n(&ring->Tail, __ATOMIC_ACQUIRE));
+}
+
+/* Producer side: copies as much as fits, returns how many bytes were written */
+static inline size_t dfs_ring_write(struct dfs_ring *ring, const void *data, size_t length) {
+    size_t writable = dfs_ring_writable(ring);
+    if (length > writable)
+        length = writable;
+
+    size_t offset = ring->Head & (DFS_RING_SIZE - 1);
+    size_t first = length < DFS_RING_SIZE - offset ? length : DFS_RING_SIZE - offset;
+
+    memcpy(ring->Data + offset, data, first);
+    memcpy(ring->Data, (const uint8_t *)data + first, length - first);
+
+    __atomic_store_n(&ring->Head, ring->Head + length, __ATOMIC_RELEASE);
+    return length;
+}
+
+/* Consumer side: returns the readable bytes that are contiguous in the ring, to be released with
+ * `dfs_ring_consume` */
+static inline size_t dfs_ring_peek(const struct dfs_ring *ring, const uint8_t **data) {
+    size_t readable = dfs_ring_readable(ring);
+    size_t offset = ring->Tail & (DFS_RING_SIZE - 1);
+
+    *data = ring->Data + offset;
+    return readable < DFS_RING_SIZE - offset ? readable : DFS_RING_SIZE - offset;
+}
+
+static inline void dfs_ring_consume(struct dfs_ring *ring, size_t length) {
+    __atomic_store_n(&ring->Tail, ring->Tail + length, __ATOMIC_RELEASE);
+}
@@ -1,9 +1,7 @@
 #pragma once
 
-#include <atomic>
 #include <cstdint>
 #include <memory>
-#include <thread>
 #include <vector>
 
 #include "bot-state.hh"
@@ -12,10 +10,13 @@
 namespace dfs
 {
     class GameData;
+    class SnapshotReader;
+    class SnapshotWriter;
+    struct Endpoint;
 
     class SimpleFarmingBot {
       public:
-        SimpleFarmingBot(std::vector<int> &&tour, const GameData &game_data, int server_sock);
+        SimpleFarmingBot(std::vector<int> &&tour, const GameData &game_data, Endpoint &server);
         ~SimpleFarmingBot();
 
         SimpleFarmingBot(const SimpleFarmingBot &) = delete;
@@ -24,18 +25,28 @@ namespace dfs
         void Run();
         void Stop();
 
+        /// Makes the bot take its next decision if its state changed or one of its timers expired. This is
+        /// driven by the reactor owning the session, right after the messages are handled. Returns whether it did,
+        /// and sets `waited` to how long the decision waited for this call.
+        bool Update(const now_t &now, std::chrono::nanoseconds &waited);
+
         BotDescriptor *GetDescriptor() const;
 
+        /// Writes the bot, its state and its timers to a session snapshot (hot restart).
+        void Save(SnapshotWriter &writer) const;
+
+        /// Takes over a bot saved by another process. Returns false if the snapshot is truncated.
+        bool Restore(SnapshotReader &reader);
+
       private:
-        void RunBot();
+        void Step();
 
       private:
-        std::atomic<bool> m_Running;
+        bool m_Running;
         std::vector<int> m_Tour;
         BotState m_BotState;
         std::unique_ptr<BotDescriptor> m_BotDescriptor;
 
         int32_t m_CurrentMapId;
-        std::thread m_BotThread;
     };
 } // namespace dfs
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace dfs
+{
+    /// Serializes the state of a session so another process can take it over. Values are written in the host
+    /// representation: snapshots never leave the machine they were taken on.
+    class SnapshotWriter {
+      public:
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void Write(const T &value) {
+            auto bytes = reinterpret_cast<const uint8_t *>(&value);
+            m_Data.insert(m_Data.end(), bytes, bytes + sizeof(T));
+        }
+
+        /// Writes a length-prefixed byte string.
+        void WriteBytes(std::span<const uint8_t> bytes) {
+            Write<uint64_t>(bytes.size());
+            m_Data.insert(m_Data.end(), bytes.begin(), bytes.end());
+        }
+
+        void WriteString(std::string_view string) {
+            WriteBytes({reinterpret_cast<const uint8_t *>(string.data()), string.size()});
+        }
+
+        std::vector<uint8_t> &GetData() {
+            return m_Data;
+        }
+
+      private:
+        std::vector<uint8_t> m_Data;
+    };
+
+    /// Reads back what a `SnapshotWriter` wrote. Once a read fails (truncated snapshot), every following read
+    /// fails too.
+    class SnapshotReader {
+      public:
+        SnapshotReader(std::span<const uint8_t> data)
+            : m_Data(data)
+            , m_Failed(false) {
+        }
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        bool Read(T &value) {
+            if (m_Failed || m_Data.size() < sizeof(T))
+                return Fail();
+
+            memcpy(&value, m_Data.data(), sizeof(T));
+            m_Data = m_Data.subspan(sizeof(T));
+            return true;
+        }
+
+        /// Reads a length-prefixed byte string. The span points into the snapshot.
+        bool ReadBytes(std::span<const uint8_t> &bytes) {
+            uint64_t length;
+            if (!Read(length) || length > m_Data.size())
+                return Fail();
+
+            bytes = m_Data.subspan(0, length);
+            m_Data = m_Data.subspan(length);
+            return true;
+        }
+
+        bool ReadString(std::string &string) {
+            std::span<const uint8_t> bytes;
+            if (!ReadBytes(bytes))
+                return false;
+
+            string.assign(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+            return true;
+        }
+
+        bool HasFailed() const {
+            return m_Failed;
+        }
+
+      private:
+        bool Fail() {
+            m_Failed = true;
+            return false;
+        }
+
+      private:
+        std::span<const uint8_t> m_Data;
+        bool m_Failed;
+    };
+
+    /// A live session handed over to another process: its sockets and everything that was buffered for them.
+    struct SessionSnapshot
+    {
+        int ClientFd = -1;
+
+        /// -1 while the session is waiting for its handshake
+        int ServerFd = -1;
+
+        /// Written by `Session::Detach`, read by `Session::Restore`
+        std::vector<uint8_t> State;
+    };
+} // namespace dfs
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "wire.hh"
+
+namespace dfs
+{
+    /// A message of the game we bind, see `TypeUrlTable`
+    struct TypeUrlBinding
+    {
+        /// Which member of the `content` oneof of the `GameMessage` it comes in
+        GameMessagePeek::Kind Content;
+        std::string_view TypeUrl;
+        uint32_t Value;
+    };
+
+    /// Maps the messages we bind to a value, built at compile time from a list of bindings and looked up without
+    /// allocating nor hashing the whole `type_url`.
+    ///
+    /// Every `type_url` of the game is `type.ankama.com/` followed by three characters: those and the member of the
+    /// oneof are packed in a 32 bit key, which a multiplicative hash sends to a slot of its own. The multiplier is
+    /// searched for when the table is built so that no two bindings share a slot, and a lookup is a length and prefix
+    /// check, a multiplication and a compare. A list that cannot be built (a malformed `type_url`, a message bound
+    /// twice) does not compile.
+    template <size_t N>
+    class TypeUrlTable {
+      public:
+        static constexpr const std::string_view PREFIX = "type.ankama.com/";
+        static constexpr const size_t TYPE_URL_LENGTH = PREFIX.size() + 3;
+
+        /// At least two slots per binding, for a multiplier to be found in a few tries
+        static constexpr const int SLOT_BITS = std::bit_width(N * 2 - 1);
+        static constexpr const size_t SLOTS = size_t(1) << SLOT_BITS;
+
+        /// Lookups of messages that are not bound return `missing`.
+        consteval TypeUrlTable(const std::array<TypeUrlBinding, N> &bindings, uint32_t missing)
+            : m_Slots{}
+            , m_Multiplier(0)
+            , m_Missing(missing) {
+            for (size_t i = 0; i < N; i++) {
+                auto key = Pack(bindings[i].Content, bindings[i].TypeUrl);
+                if (key == 0 || bindings[i].Content == GameMessagePeek::Kind::None)
+                    throw "malformed binding";
+
+                for (size_t j = 0; j < i; j++) {
+                    if (key == Pack(bindings[j].Content, bindings[j].TypeUrl))
+                        throw "message bound twice";
+                }
+            }
+
+            for (uint32_t multiplier = 0x9E3779B1u; multiplier != 0x9E3779B1u + 2 * MAX_TRIES; multiplier += 2) {
+                if (Fill(bindings, multiplier))
+                    return;
+            }
+
+            throw "no perfect hash found";
+        }
+
+        constexpr uint32_t Find(GameMessagePeek::Kind content, std::string_view type_url) const {
+            // Malformed messages pack to zero, which only matches free slots: those hold `missing` too
+            auto key = Pack(content, type_url);
+            const auto &slot = m_Slots[SlotOf(key, m_Multiplier)];
+            return slot.Key == key ? slot.Value : m_Missing;
+        }
+
+        /// Zero if the `type_url` is not of the form above
+        static constexpr uint32_t Pack(GameMessagePeek::Kind content, std::string_view type_url) {
+            if (type_url.size() != TYPE_URL_LENGTH || !type_url.starts_with(PREFIX))
+                return 0;
+
+            auto suffix = [&](size_t i) {
+                return static_cast<uint32_t>(static_cast<uint8_t>(type_url[PREFIX.size() + i]));
+            };
+
+            return static_cast<uint32_t>(content) << 24 | suffix(0) << 16 | suffix(1) << 8 | suffix(2);
+        }
+
+      private:
+        static constexpr const uint32_t MAX_TRIES = 1 << 16;
+
+        struct Slot
+        {
+            uint32_t Key = 0;
+            uint32_t Value = 0;
+        };
+
+        static constexpr size_t SlotOf(uint32_t key, uint32_t multiplier) {
+            return (key * multiplier) >> (32 - SLOT_BITS);
+        }
+
+        /// Returns false if two bindings fall in the same slot with that multiplier.
+        constexpr bool Fill(const std::array<TypeUrlBinding, N> &bindings, uint32_t multiplier) {
+            for (auto &slot : m_Slots)
+                slot = {0, m_Missing};
+
+            for (const auto &binding : bindings) {
+                auto key = Pack(binding.Content, binding.TypeUrl);
+                auto &slot = m_Slots[SlotOf(key, multiplier)];
+                if (slot.Key != 0)
+                    return false;
+
+                slot = {key, binding.Value};
+            }
+
+            m_Multiplier = multiplier;
+            return true;
+        }
+
+      private:
+        std::array<Slot, SLOTS> m_Slots;
+        uint32_t m_Multiplier;
+        uint32_t m_Missing;
+    };
+} // namespace dfs
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unordered_map>
+#include <vector>
+
+#include "outbound-queue.hh"
+#include "reactor.hh"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace dfs
+{
+    struct Endpoint;
+
+    /// Optional io_uring backend. Sockets are read with multishot recvs that pick their buffers from a ring
+    /// registered with the kernel, so a busy session keeps receiving without re-arming anything. All the
+    /// submissions and completions of one loop iteration go through a single `io_uring_enter` call.
+    class UringReactor : public Reactor {
+      public:
+        UringReactor(int listen_sock, const GameData &game_data, const Messages &messages);
+        ~UringReactor() override;
+
+        /// Returns false if io_uring is disabled or the kernel lacks the features we rely on (multishot recv and
+        /// provided buffer rings, Linux 6.0+). The reactor must not be run in that case.
+        bool IsSupported() const {
+            return m_Supported;
+        }
+
+        void Run() override;
+
+      protected:
+        void Quiesce() override;
+        void Adopt(Session &session) override;
+
+      private:
+        enum Operation : uint64_t
+        {
+            Accept,
+            Wake,
+            RecvClient,
+            RecvServer,
+            SendClient,
+            SendServer,
+            ConnectPoll,
+            Cancel,
+        };
+
+        /// Per-session state the kernel may still reference after the session itself was destroyed
+        struct Connection
+        {
+            struct Side
+            {
+                bool Receiving = false;
+                bool Sending = false;
+
+                /// Set from the moment the multishot recv is cancelled because the other side is congested, until
+                /// its last completion
+                bool Cancelling = false;
+
+                /// Frames handed to the kernel. The session keeps queueing in its own queue meanwhile.
+                OutboundQueue InFlight;
+                msghdr Message;
+                std::array<iovec, OutboundQueue::MAX_BATCH> Vectors;
+            };
+
+            /// Null once the session was closed
+            Session *Owner;
+
+            /// Number of operations the kernel still has to complete for this connection
+            int Pending = 0;
+
+            /// Set once everything was cancelled to hand the session over. Nothing is armed again after that.
+            bool Detaching = false;
+
+            Side Client;
+            Side Server;
+        };
+
+        bool Setup();
+        io_uring_sqe *GetSqe();
+        int Enter(unsigned wait_nr, int timeout_ms);
+        void Prepare(io_uring_sqe *sqe, uint8_t opcode, int fd, Connection *connection, Operation op);
+
+        void ArmAccept(size_t listener);
+        void ArmWake();
+        void ArmRecv(Connection &connection, bool server);
+        void Send(Connection &connection, bool server);
+        void UpdateBackpressure(Connection &connection, bool server);
+        void CancelOperation(Connection *connection, Operation op);
+
+        void ReapCompletions();
+        void HandleCompletion(const io_uring_cqe &cqe);
+        void HandleRecv(Connection &connection, bool server, const io_uring_cqe &cqe);
+        void HandleSend(Connection &connection, bool server, const io_uring_cqe &cqe);
+        void RecycleBuffer(uint16_t buffer_id);
+
+      private:
+        static constexpr const unsigned RING_ENTRIES = 256;
+        static constexpr const unsigned BUFFER_COUNT = 256;
+        static constexpr const size_t BUFFER_SIZE = 16 * 1024;
+        static constexpr const uint16_t BUFFER_GROUP = 0;
+
+        /// How long `Quiesce` waits for the cancelled operations to complete
+        static constexpr const std::chrono::milliseconds QUIESCE_TIMEOUT{1000};
+
+        bool m_Supported;
+        int m_Ring;
+
+        // Submission queue
+        void *m_SqRing;
+        size_t m_SqRingSize;
+        unsigned *m_SqHead;
+        unsigned *m_SqTail;
+        unsigned m_SqMask;
+        unsigned m_SqEntries;
+        unsigned *m_SqArray;
+        io_uring_sqe *m_Sqes;
+        unsigned m_SqLocalTail;
+        unsigned m_ToSubmit;
+
+        // Completion queue
+        void *m_CqRing;
+        size_t m_CqRingSize;
+        unsigned *m_CqHead;
+        unsigned *m_CqTail;
+        unsigned m_CqMask;
+        io_uring_cqe *m_Cqes;
+
+        // Provided buffers for the multishot recvs
+        io_uring_buf_ring *m_BufferRing;
+        uint8_t *m_Buffers;
+        uint16_t m_BufferTail;
+
+        uint64_t m_WakeValue;
+        std::unordered_map<Connection *, std::unique_ptr<Connection>> m_Connections;
+    };
+} // namespace dfs
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <ratio>
+#include <span>
 
 namespace dfs
 {
@@ -61,5 +62,5 @@ namespace dfs
         int32_t ToCompressed() const;
     };
 
-    std::chrono::duration<int64_t, std::milli> GetMovementDuration(const std::vector<int32_t> cells, bool cautious);
+    std::chrono::duration<int64_t, std::milli> GetMovementDuration(std::span<const int32_t> cells, bool cautious);
 } // namespace dfs
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace dfs
+{
+    /// Minimal protobuf wire format reader. It walks the fields of an encoded message without allocating or
+    /// copying anything, for the cases where a full parse would be wasted.
+    class WireReader {
+      public:
+        enum WireType : uint8_t
+        {
+            VARINT = 0,
+            FIXED64 = 1,
+            LENGTH_DELIMITED = 2,
+            START_GROUP = 3,
+            END_GROUP = 4,
+            FIXED32 = 5,
+        };
+
+        WireReader(const uint8_t *data, size_t length)
+            : m_Current(data)
+            , m_End(data + length)
+            , m_Failed(false) {
+        }
+
+        WireReader(std::string_view data)
+            : WireReader(reinterpret_cast<const uint8_t *>(data.data()), data.size()) {
+        }
+
+        /// Reads the next field key. Returns false at the end of the message or if it is malformed.
+        bool Next(uint32_t &field, WireType &type) {
+            if (m_Current == m_End)
+                return false;
+
+            uint64_t key;
+            if (!ReadVarint(key) || (key >> 3) == 0 || (key >> 3) > UINT32_MAX)
+                return Fail();
+
+            field = static_cast<uint32_t>(key >> 3);
+            type = static_cast<WireType>(key & 7);
+            return true;
+        }
+
+        bool ReadVarint(uint64_t &value) {
+            value = 0;
+
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (m_Current == m_End)
+                    return Fail();
+
+                uint8_t byte = *m_Current++;
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+                if ((byte & 0x80) == 0)
+                    return true;
+            }
+
+            return Fail();
+        }
+
+        /// Reads the payload of a length delimited field (string, bytes, nested message, packed values).
+        bool ReadBytes(std::string_view &value) {
+            uint64_t length;
+            if (!ReadVarint(length) || length > static_cast<size_t>(m_End - m_Current))
+                return Fail();
+
+            value = {reinterpret_cast<const char *>(m_Current), static_cast<size_t>(length)};
+            m_Current += length;
+            return true;
+        }
+
+        /// Same as `ReadBytes` for a buffer that may end before the value does: returns what is available of it.
+        bool ReadTruncatedBytes(std::string_view &value) {
+            uint64_t length;
+            if (!ReadVarint(length))
+                return false;
+
+            length = std::min<uint64_t>(length, m_End - m_Current);
+            value = {reinterpret_cast<const char *>(m_Current), static_cast<size_t>(length)};
+            m_Current += length;
+            return true;
+        }
+
+        /// Skips the value of a field of the given type. Groups are deprecated and not supported.
+        bool Skip(WireType type) {
+            uint64_t ignored;
+            std::string_view bytes;
+
+            switch (type) {
+            case VARINT:
+                return ReadVarint(ignored);
+            case FIXED64:
+                return Advance(8);
+            case LENGTH_DELIMITED:
+                return ReadBytes(bytes);
+            case FIXED32:
+                return Advance(4);
+            default:
+                return Fail();
+            }
+        }
+
+        /// Whether the message was malformed. Once failed, the reader stays at the end.
+        bool HasFailed() const {
+            return m_Failed;
+        }
+
+      private:
+        bool Advance(size_t length) {
+            if (length > static_cast<size_t>(m_End - m_Current))
+                return Fail();
+
+            m_Current += length;
+            return true;
+        }
+
+        bool Fail() {
+            m_Current = m_End;
+            m_Failed = true;
+            return false;
+        }
+
+      private:
+        const uint8_t *m_Current;
+        const uint8_t *m_End;
+        bool m_Failed;
+    };
+
+    /// Minimal protobuf wire format writer, the counterpart of `WireReader`. Nested messages are written behind their
+    /// length, so the buffer is sized beforehand with `VarintSize` and the `*FieldSize` helpers. Usable in constant
+    /// expressions, to encode messages that never change at compile time.
+    ///
+    /// Signed integers (`int32`, `int64`) are written sign extended to 64 bits, like protobuf does.
+    class WireWriter {
+      public:
+        constexpr WireWriter(std::span<uint8_t> data)
+            : m_Begin(data.data())
+            , m_Current(data.data())
+            , m_End(data.data() + data.size())
+            , m_Failed(false) {
+        }
+
+        static constexpr size_t VarintSize(uint64_t value) {
+            size_t size = 1;
+
+            while (value >= 0x80) {
+                value >>= 7;
+                size++;
+            }
+
+            return size;
+        }
+
+        static constexpr size_t VarintFieldSize(uint32_t field, uint64_t value) {
+            return VarintSize(static_cast<uint64_t>(field) << 3) + VarintSize(value);
+        }
+
+        /// Size of a length delimited field of `length` bytes
+        static constexpr size_t BytesFieldSize(uint32_t field, size_t length) {
+            return VarintSize(static_cast<uint64_t>(field) << 3) + VarintSize(length) + length;
+        }
+
+        constexpr bool WriteVarint(uint64_t value) {
+            while (value >= 0x80) {
+                if (!WriteByte(static_cast<uint8_t>(value) | 0x80))
+                    return false;
+
+                value >>= 7;
+            }
+
+            return WriteByte(static_cast<uint8_t>(value));
+        }
+
+        constexpr bool WriteVarintField(uint32_t field, uint64_t value) {
+            return WriteKey(field, WireReader::VARINT) && WriteVarint(value);
+        }
+
+        /// Writes the key and the length of a length delimited field, whose `length` bytes are to be written next.
+        constexpr bool WriteLength(uint32_t field, size_t length) {
+            return WriteKey(field, WireReader::LENGTH_DELIMITED) && WriteVarint(length);
+        }
+
+        constexpr bool WriteBytesField(uint32_t field, std::string_view bytes) {
+            if (!WriteLength(field, bytes.size()))
+                return false;
+
+            for (auto byte : bytes) {
+                if (!WriteByte(static_cast<uint8_t>(byte)))
+                    return false;
+            }
+
+            return true;
+        }
+
+        /// Bytes written so far
+        constexpr size_t GetSize() const {
+            return static_cast<size_t>(m_Current - m_Begin);
+        }
+
+        /// Whether the buffer was too small. Once failed, nothing more is written.
+        constexpr bool HasFailed() const {
+            return m_Failed;
+        }
+
+      private:
+        constexpr bool WriteKey(uint32_t field, WireReader::WireType type) {
+            return WriteVarint(static_cast<uint64_t>(field) << 3 | type);
+        }
+
+        constexpr bool WriteByte(uint8_t byte) {
+            if (m_Failed || m_Current == m_End) {
+                m_Failed = true;
+                return false;
+            }
+
+            *m_Current++ = byte;
+            return true;
+        }
+
+      private:
+        uint8_t *m_Begin;
+        uint8_t *m_Current;
+        uint8_t *m_End;
+        bool m_Failed;
+    };
+
+    /// What a `GameMessage` frame carries, read straight from its bytes.
+    struct GameMessagePeek
+    {
+        enum class Kind
+        {
+            None,
+            Request,
+            Response,
+            Event,
+        };
+
+        /// Which member of the `content` oneof is set
+        Kind Content = Kind::None;
+
+        /// `type_url` of the `Any` inside the request, response or event
+        std::string_view TypeUrl;
+
+        /// Serialized inner message (`Any.value`)
+        std::string_view Value;
+
+        /// `uid` of a request or response, which ties them together. Zero if unset, and for events.
+        int32_t Uid = 0;
+    };
+
+    /// Extracts the oneof case and the `Any` of a serialized `GameMessage` without parsing it. Returns
+    /// `std::nullopt` if the message is malformed.
+    std::optional<GameMessagePeek> PeekGameMessage(const uint8_t *data, size_t length);
+
+    /// Same as `PeekGameMessage` on the beginning of a message that was not fully received yet: returns as soon as
+    /// the oneof case and the `type_url` are known, or `std::nullopt` if more bytes are needed. `Value` and `Uid`
+    /// are left empty. Assumes the members of the oneof and of the `Any` are written in field order, as encoders do.
+    std::optional<GameMessagePeek> PeekGameMessageHeader(const uint8_t *data, size_t available);
+} // namespace dfs
@@ -1,21 +1,72 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fmt/base.h>
 
 #include "game.hh"
 #include "injector.hh"
+#include "log.hh"
 #include "network.hh"
 
-int main(int, char *[]) {
+int main(int argc, char *argv[]) {
     std::srand(std::time(NULL));
 
+    dfs::Proxy::Options options{};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--io-uring") == 0) {
+            options.EventLoop = dfs::Proxy::Backend::IoUring;
+        } else if (strcmp(argv[i], "--splice") == 0) {
+            options.Splice = true;
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.Workers = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--handshake-timeout") == 0 && i + 1 < argc) {
+            options.Timeouts.Handshake = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--connect-timeout") == 0 && i + 1 < argc) {
+            options.Timeouts.Connect = std::chrono::milliseconds(std::atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--handoff") == 0 && i + 1 < argc) {
+            options.HandoffPath = argv[++i];
+        } else if (strcmp(argv[i], "--unix-socket") == 0 && i + 1 < argc) {
+            options.UnixSocket = argv[++i];
+        } else if (strcmp(argv[i], "--observe-socket") == 0 && i + 1 < argc) {
+            options.ObserveSocket = argv[++i];
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            options.CapturePath = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-port") == 0 && i + 1 < argc) {
+            options.MetricsPort = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            dfs::LogLevel level;
+            if (!dfs::Log::ParseLevel(argv[++i], level)) {
+                fmt::println(stderr, "Unknown log level: {}", argv[i]);
+                return 1;
+            }
+
+            dfs::Log::SetLevel(level);
+        } else {
+            fmt::println(stderr,
+                         "Usage: {} [--io-uring] [--splice] [--workers <count, 0 for one per core>] "
+                         "[--handshake-timeout <ms>] [--connect-timeout <ms>] [--handoff <socket path>] "
+                         "[--unix-socket <abstract name, empty to disable>] "
+                         "[--observe-socket <abstract name, empty to disable>] [--capture <file>] "
+                         "[--metrics-port <port>] [--log-level <trace|debug|info|warning|error>]",
+                         argv[0]);
+            return 1;
+        }
+    }
+
     dfs::GameData game_data{};
     if (!game_data.Initialize())
         return 1;
 
     dfs::Attach();
 
-    dfs::Proxy proxy(5555, game_data);
+    dfs::Log::Start();
+
+    dfs::Proxy proxy(5555, game_data, options);
 
     proxy.Run();
 
+    dfs::Log::Stop();
+
     return 0;
 }
@@ -0,0 +1,338 @@
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <game/common.pb.h>
+#include <game/game_message.pb.h>
+#include <game/gamemap.pb.h>
+#include <game/interactive_element.pb.h>
+#include <google/protobuf/any.pb.h>
+#include <google/protobuf/arena.h>
+#include <new>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "capture.hh"
+#include "event-views.hh"
+#include "frame-decoder.hh"
+#include "message-arena.hh"
+#include "wire.hh"
+
+/**
+ * Counts the allocations made decoding a map load, the burst of events the server sends on a map change: the map,
+ * the actors and interactive elements of a busy one, then the actors showing up, moving around and harvesting.
+ * Frames are decoded like the message handlers do (the `GameMessage`, then the event it holds), first message by
+ * message on the heap, then in a `MessageArena` reset after each burst like a session does after each read, then
+ * like the bot does: movements, actors and stated elements read straight from the frame through their views, the
+ * other events in the arena.
+ *
+ * Given a capture (`dfs --capture <file>`), the frames the server sent are decoded as a single burst instead.
+ *
+ * Usage: dfs-decode-bench [bursts] [capture]
+ */
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    namespace game = com::ankama::dofus::server::game::protocol;
+
+    constexpr const int32_t MAP_CELLS = 560;
+
+    constexpr const char *MAP_MOVEMENT_EVENT_TYPE_URL = "type.ankama.com/igg";
+    constexpr const char *MAP_CURRENT_EVENT_TYPE_URL = "type.ankama.com/igi";
+    constexpr const char *MAP_COMPLEMENTARY_INFORMATION_EVENT_TYPE_URL = "type.ankama.com/igr";
+    constexpr const char *GAME_ROLE_PLAY_SHOW_ACTORS_EVENT_TYPE_URL = "type.ankama.com/igs";
+    constexpr const char *STATED_ELEMENT_UPDATED_EVENT_TYPE_URL = "type.ankama.com/hzr";
+
+    /// Counted by the replacements of `operator new` below
+    uint64_t s_Allocations = 0;
+    uint64_t s_AllocatedBytes = 0;
+
+    struct Result
+    {
+        uint64_t Allocations = 0;
+        uint64_t Bytes = 0;
+        double Seconds = 0;
+    };
+
+    /// Decodes `value` as a `T`, in `arena` or on the heap if `nullptr`.
+    template <typename T>
+    bool decode(const std::string &value, google::protobuf::Arena *arena) {
+        T on_heap;
+        auto &message = arena != nullptr ? *google::protobuf::Arena::CreateMessage<T>(arena) : on_heap;
+        return message.ParseFromString(value);
+    }
+
+    /// Decodes a frame and the event it holds, if it is one of a map load.
+    bool decode_frame(std::span<const uint8_t> payload, google::protobuf::Arena *arena) {
+        game::GameMessage on_heap;
+        auto &message = arena != nullptr ? *google::protobuf::Arena::CreateMessage<game::GameMessage>(arena) : on_heap;
+        if (!message.ParseFromArray(payload.data(), static_cast<int>(payload.size())))
+            return false;
+
+        if (!message.has_event())
+            return true;
+
+        const auto &content = message.event().content();
+        const std::string_view type_url = content.type_url();
+
+        if (type_url == MAP_MOVEMENT_EVENT_TYPE_URL)
+            return decode<game::gamemap::MapMovementEvent>(content.value(), arena);
+        if (type_url == MAP_CURRENT_EVENT_TYPE_URL)
+            return decode<game::gamemap::MapCurrentEvent>(content.value(), arena);
+        if (type_url == MAP_COMPLEMENTARY_INFORMATION_EVENT_TYPE_URL)
+            return decode<game::gamemap::MapComplementaryInformationEvent>(content.value(), arena);
+        if (type_url == GAME_ROLE_PLAY_SHOW_ACTORS_EVENT_TYPE_URL)
+            return decode<game::gamemap::GameRolePlayShowActorsEvent>(content.value(), arena);
+        if (type_url == STATED_ELEMENT_UPDATED_EVENT_TYPE_URL)
+            return decode<game::interactive::element::StatedElementUpdatedEvent>(content.value(), arena);
+
+        return true;
+    }
+
+    /// Decodes a frame like the bot does, through the views of the events that have one.
+    bool read_frame(std::span<const uint8_t> payload, google::protobuf::Arena *arena) {
+        auto peek = dfs::PeekGameMessage(payload.data(), payload.size());
+        if (!peek)
+            return false;
+
+        if (peek->TypeUrl == MAP_MOVEMENT_EVENT_TYPE_URL) {
+            std::array<int32_t, MAP_CELLS> cells;
+            auto view = dfs::MapMovementEventView::Read(peek->Value);
+            return view && view->GetCellCount() <= cells.size() &&
+                   view->GetCells(cells).size() == view->GetCellCount();
+        }
+
+        if (peek->TypeUrl == GAME_ROLE_PLAY_SHOW_ACTORS_EVENT_TYPE_URL) {
+            dfs::GameRolePlayShowActorsEventView view(peek->Value);
+            dfs::ActorSummary actor;
+            while (view.Next(actor)) {
+            }
+
+            return !view.HasFailed();
+        }
+
+        if (peek->TypeUrl == STATED_ELEMENT_UPDATED_EVENT_TYPE_URL)
+            return dfs::StatedElementUpdatedEventView::Read(peek->Value).has_value();
+
+        return decode_frame(payload, arena);
+    }
+
+    std::vector<uint8_t> make_event(const char *type_url, const google::protobuf::Message &event) {
+        game::GameMessage message;
+        auto content = message.mutable_event()->mutable_content();
+        content->set_type_url(type_url);
+        content->set_value(event.SerializeAsString());
+
+        auto payload = message.SerializeAsString();
+        return {payload.begin(), payload.end()};
+    }
+
+    void add_player(game::common::ActorPositionInformation &actor, int i) {
+        actor.set_actor_id(1000 + i);
+        actor.mutable_disposition()->set_cell_id((i * 37) % MAP_CELLS);
+
+        auto information = actor.mutable_actor_information();
+        auto look = information->mutable_look();
+        look->set_bones_id(1);
+        for (int j = 0; j < 6; j++) {
+            look->add_skins(100 + j);
+            look->add_indexed_colors(0x1000000 * j + i);
+        }
+
+        auto named = information->mutable_role_play_actor()->mutable_named_actor();
+        named->set_name(fmt::format("Player-{}", i));
+        named->mutable_humanoid_information()->set_account_id(2000 + i);
+    }
+
+    /// The payloads of the frames of a map load
+    std::vector<std::vector<uint8_t>> make_burst() {
+        std::vector<std::vector<uint8_t>> burst;
+
+        game::gamemap::MapCurrentEvent current;
+        current.set_map_id(189793795);
+        burst.push_back(make_event(MAP_CURRENT_EVENT_TYPE_URL, current));
+
+        game::gamemap::MapComplementaryInformationEvent map;
+        map.set_map_id(189793795);
+        map.set_subarea_id(1);
+
+        for (int i = 0; i < 24; i++) {
+            auto actor = map.add_actors();
+            actor->set_actor_id(-100 - i);
+            actor->mutable_disposition()->set_cell_id((i * 23) % MAP_CELLS);
+            actor->mutable_actor_information()->mutable_look()->set_bones_id(1000 + i);
+
+            auto group = actor->mutable_actor_information()
+                             ->mutable_role_play_actor()
+                             ->mutable_monster_group_actor()
+                             ->mutable_identification();
+            group->mutable_main_creature()->set_gid(100 + i);
+            group->mutable_main_creature()->set_level(20 + i);
+
+            for (int j = 0; j < 3; j++)
+                group->add_underlings()->set_level(10 + j);
+        }
+
+        for (int i = 0; i < 16; i++)
+            add_player(*map.add_actors(), i);
+
+        for (int i = 0; i < 40; i++) {
+            auto element = map.add_interactive_elements();
+            element->set_element_id(500000 + i);
+            element->set_element_type_id(38);
+            element->set_on_current_map(true);
+
+            auto skill = element->add_enabled_skills();
+            skill->set_skill_id(45);
+            skill->set_skill_instance_uid(700000 + i);
+
+            auto stated = map.add_stated_elements();
+            stated->set_element_id(500000 + i);
+            stated->set_cell_id((i * 13) % MAP_CELLS);
+            stated->set_state(i % 3 == 0 ? 2 : 1);
+            stated->set_on_current_map(true);
+        }
+
+        burst.push_back(make_event(MAP_COMPLEMENTARY_INFORMATION_EVENT_TYPE_URL, map));
+
+        for (int i = 0; i < 8; i++) {
+            game::gamemap::GameRolePlayShowActorsEvent show;
+            add_player(*show.add_actors(), 16 + i);
+            burst.push_back(make_event(GAME_ROLE_PLAY_SHOW_ACTORS_EVENT_TYPE_URL, show));
+        }
+
+        for (int i = 0; i < 32; i++) {
+            game::gamemap::MapMovementEvent movement;
+            movement.set_character_id(1000 + i % 24);
+            for (int j = 0; j < 6; j++)
+                movement.add_cells((i * 17 + j * 29) % MAP_CELLS);
+
+            burst.push_back(make_event(MAP_MOVEMENT_EVENT_TYPE_URL, movement));
+        }
+
+        for (int i = 0; i < 8; i++) {
+            game::interactive::element::StatedElementUpdatedEvent updated;
+            updated.mutable_stated_element()->set_element_id(500000 + i);
+            updated.mutable_stated_element()->set_state(2);
+            burst.push_back(make_event(STATED_ELEMENT_UPDATED_EVENT_TYPE_URL, updated));
+        }
+
+        return burst;
+    }
+
+    /// The payloads of the frames the server sent in a capture
+    std::vector<std::vector<uint8_t>> read_burst(const std::string &path) {
+        std::vector<std::vector<uint8_t>> burst;
+
+        auto capture = dfs::CaptureReader::Open(path);
+        if (capture == nullptr)
+            return burst;
+
+        dfs::FrameDecoder decoder;
+
+        while (auto entry = capture->Next()) {
+            if (entry->Record->Direction != dfs::CaptureDirection::ServerToClient)
+                continue;
+
+            if (!decoder.Append(entry->Frame.data(), entry->Frame.size()))
+                continue;
+
+            while (auto frame = decoder.Next()) {
+                auto payload = frame->GetPayload();
+                burst.emplace_back(payload.begin(), payload.end());
+            }
+        }
+
+        return burst;
+    }
+
+    Result run(const std::vector<std::vector<uint8_t>> &burst, int bursts, dfs::MessageArena *arena,
+               bool views = false) {
+        auto allocations = s_Allocations;
+        auto bytes = s_AllocatedBytes;
+        auto start = Clock::now();
+
+        for (int i = 0; i < bursts; i++) {
+            for (const auto &payload : burst) {
+                if (views)
+                    read_frame(payload, arena->Get());
+                else
+                    decode_frame(payload, arena != nullptr ? arena->Get() : nullptr);
+            }
+
+            if (arena != nullptr)
+                arena->Reset();
+        }
+
+        Result result;
+        result.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.Allocations = s_Allocations - allocations;
+        result.Bytes = s_AllocatedBytes - bytes;
+        return result;
+    }
+
+    void report(const char *name, const Result &result, int bursts) {
+        fmt::println("{:>6}: {:8.1f} allocations ({:7.1f} KiB) per burst, {:8.2f} us per burst", name,
+                     static_cast<double>(result.Allocations) / bursts, result.Bytes / 1024.0 / bursts,
+                     result.Seconds * 1e6 / bursts);
+    }
+} // namespace
+
+void *operator new(size_t size) {
+    s_Allocations++;
+    s_AllocatedBytes += size;
+
+    if (auto *p = malloc(size != 0 ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+int main(int argc, char *argv[]) {
+    int bursts = argc > 1 ? atoi(argv[1]) : 10000;
+    if (bursts <= 0) {
+        fmt::println(stderr, "Usage: {} [bursts] [capture]", argv[0]);
+        return 1;
+    }
+
+    auto burst = argc > 2 ? read_burst(argv[2]) : make_burst();
+    if (burst.empty()) {
+        fmt::println(stderr, "No frame from the server to decode");
+        return 1;
+    }
+
+    size_t burst_bytes = 0;
+    for (const auto &payload : burst)
+        burst_bytes += payload.size();
+
+    fmt::println("Burst of {} frames ({:.1f} KiB), decoded {} times", burst.size(), burst_bytes / 1024.0, bursts);
+
+    dfs::MessageArena arena;
+
+    // Warm up, and let the arena grow its first block
+    run(burst, 1, nullptr);
+    run(burst, 1, &arena);
+
+    report("heap", run(burst, bursts, nullptr), bursts);
+    report("arena", run(burst, bursts, &arena), bursts);
+    report("views", run(burst, bursts, &arena, true), bursts);
+
+    fmt::println("First block of the arena: {} KiB, high-water mark {:.1f} KiB", arena.GetBlockSize() / 1024,
+                 arena.GetHighWaterMark() / 1024.0);
+
+    return 0;
+}
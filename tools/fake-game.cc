@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/base.h>
+#include <netinet/in.h>
+#include <optional>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Stands in for the game client: connects to a fake game server the way the game does (IPv4-mapped IPv6 address,
+ * port 5555), then plays ping-pong with frames and reports the round trip times. Run it without the hook for the
+ * direct baseline, with the hook to go through the proxy, and with the hook and DFS_OBSERVE_SOCKET set to be
+ * observed in process:
+ *
+ *   dfs-fake-game
+ *   LD_PRELOAD=./hook.so dfs-fake-game
+ *   LD_PRELOAD=./hook.so DFS_OBSERVE_SOCKET=dfs-observe dfs-fake-game
+ *
+ * The server listens on 127.0.0.2 next to the proxy. It echoes the frames of the game and counts the ones it did
+ * not expect: the requests injected by the proxy.
+ *
+ * Usage: dfs-fake-game [round trips] [frame size]
+ */
+namespace
+{
+    constexpr const uint16_t GAME_PORT = 5555;
+    constexpr const char *SERVER_ADDRESS = "127.0.0.2";
+
+    struct Options
+    {
+        int RoundTrips = 10000;
+        size_t FrameSize = 64;
+    };
+
+    struct ServerStats
+    {
+        uint64_t Echoed = 0;
+        uint64_t Injected = 0;
+        bool Corrupted = false;
+    };
+
+    void append_uvarint(std::vector<uint8_t> &out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    /// A frame holding a single unknown bytes field: it parses as a valid message.
+    std::vector<uint8_t> make_frame(size_t size) {
+        std::vector<uint8_t> body;
+        body.push_back((15 << 3) | 2);
+        append_uvarint(body, size);
+        body.resize(body.size() + size, 'G');
+
+        std::vector<uint8_t> frame;
+        append_uvarint(frame, body.size());
+        frame.insert(frame.end(), body.begin(), body.end());
+        return frame;
+    }
+
+    /// Returns the length of the frame at the front of `buffer` (prefix included) once it is complete.
+    std::optional<size_t> complete_frame(const std::vector<uint8_t> &buffer) {
+        uint64_t length = 0;
+
+        for (size_t i = 0; i < buffer.size() && i < 10; i++) {
+            length |= static_cast<uint64_t>(buffer[i] & 0x7F) << (7 * i);
+
+            if (!(buffer[i] & 0x80)) {
+                if (buffer.size() - i - 1 < length)
+                    return std::nullopt;
+
+                return i + 1 + length;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    int listen_server() {
+        int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        // The proxy listens on every address of the same port
+        int opt = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(GAME_PORT);
+        inet_pton(AF_INET, SERVER_ADDRESS, &addr.sin_addr);
+
+        if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 1) < 0) {
+            perror("Fake server");
+            close(sock);
+            return -1;
+        }
+
+        return sock;
+    }
+
+    /// Echoes the frames of the game back, counts the others.
+    void run_server(int listen_sock, const std::vector<uint8_t> &expected, ServerStats &stats) {
+        int sock = accept(listen_sock, nullptr, nullptr);
+        if (sock < 0)
+            return;
+
+        std::vector<uint8_t> buffer;
+        std::vector<uint8_t> chunk(64 * 1024);
+
+        while (true) {
+            auto received = recv(sock, chunk.data(), chunk.size(), 0);
+            if (received <= 0)
+                break;
+
+            buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + received);
+
+            while (auto length = complete_frame(buffer)) {
+                if (*length == expected.size() && std::equal(expected.begin(), expected.end(), buffer.begin())) {
+                    send(sock, expected.data(), expected.size(), MSG_NOSIGNAL);
+                    stats.Echoed++;
+                } else {
+                    stats.Injected++;
+                }
+
+                buffer.erase(buffer.begin(), buffer.begin() + *length);
+            }
+
+            // Way past any frame we would send
+            if (buffer.size() > 1024 * 1024) {
+                stats.Corrupted = true;
+                break;
+            }
+        }
+
+        close(sock);
+    }
+
+    /// Connects like the game does, so the hook recognizes the connection.
+    int connect_game() {
+        int sock = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        sockaddr_in6 addr{};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_port = htons(GAME_PORT);
+        addr.sin6_addr.s6_addr[10] = 0xFF;
+        addr.sin6_addr.s6_addr[11] = 0xFF;
+        inet_pton(AF_INET, SERVER_ADDRESS, &addr.sin6_addr.s6_addr[12]);
+
+        if (connect(sock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("connect");
+            close(sock);
+            return -1;
+        }
+
+        return sock;
+    }
+
+    /// Reads exactly `length` bytes, alternating between `recv` and `read` like different parts of a client would.
+    bool receive_frame(int sock, uint8_t *data, size_t length, bool use_read) {
+        while (length > 0) {
+            auto received = use_read ? read(sock, data, length) : recv(sock, data, length, 0);
+            if (received <= 0)
+                return false;
+
+            data += received;
+            length -= received;
+        }
+
+        return true;
+    }
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+
+    if (argc > 1)
+        options.RoundTrips = std::atoi(argv[1]);
+    if (argc > 2)
+        options.FrameSize = std::strtoull(argv[2], nullptr, 10);
+
+    auto frame = make_frame(options.FrameSize);
+
+    int server_sock = listen_server();
+    if (server_sock < 0)
+        return 1;
+
+    ServerStats stats;
+    auto server = std::thread(run_server, server_sock, std::cref(frame), std::ref(stats));
+
+    int sock = connect_game();
+    if (sock < 0) {
+        shutdown(server_sock, SHUT_RDWR);
+        server.join();
+        close(server_sock);
+        return 1;
+    }
+
+    std::vector<uint8_t> echo(frame.size());
+    std::vector<double> round_trips;
+    round_trips.reserve(options.RoundTrips);
+
+    bool intact = true;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < options.RoundTrips; i++) {
+        bool odd = i % 2 == 1;
+        const auto sent_at = std::chrono::steady_clock::now();
+
+        auto sent = odd ? write(sock, frame.data(), frame.size()) : send(sock, frame.data(), frame.size(), 0);
+        if (sent != static_cast<ssize_t>(frame.size()) || !receive_frame(sock, echo.data(), echo.size(), odd)) {
+            intact = false;
+            break;
+        }
+
+        round_trips.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent_at)
+                                  .count());
+        intact &= echo == frame;
+    }
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    close(sock);
+    server.join();
+    close(server_sock);
+
+    if (round_trips.empty()) {
+        fmt::println(stderr, "No round trip completed");
+        return 1;
+    }
+
+    std::sort(round_trips.begin(), round_trips.end());
+    auto percentile = [&](double p) { return round_trips[static_cast<size_t>(p * (round_trips.size() - 1))]; };
+
+    fmt::println("{} round trips of {} byte frames in {:.3f}s ({:.0f}/s)", round_trips.size(), frame.size(), elapsed,
+                 round_trips.size() / elapsed);
+    fmt::println("Round trip: p50 {:.1f}us, p99 {:.1f}us, max {:.1f}us", percentile(0.5), percentile(0.99),
+                 round_trips.back());
+    fmt::println("Server: {} frames echoed, {} injected by the proxy{}", stats.Echoed, stats.Injected,
+                 stats.Corrupted ? ", stream corrupted" : "");
+
+    if (!intact || stats.Corrupted) {
+        fmt::println(stderr, "The game stream was altered");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,775 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <connection/login_message.pb.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <game/common.pb.h>
+#include <game/connection.pb.h>
+#include <game/game_message.pb.h>
+#include <game/gamemap.pb.h>
+#include <google/protobuf/any.pb.h>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <span>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "frame-decoder.hh"
+#include "outbound-queue.hh"
+#include "session.hh"
+
+/**
+ * Load generator for a running proxy. A fake game server streams what a map looks like to the game (a
+ * `MapCurrentEvent` and a `MapComplementaryInformationEvent` on every map change, `MapMovementEvent`s of the actors
+ * around in between) while fake clients send the pings of the game. Clients go through the proxy with the
+ * handshake of the hook, over TCP or the abstract Unix socket, or straight to the server for a baseline.
+ *
+ * The number of sessions doubles at every step, up to the maximum. Each step reports the frames relayed per second
+ * and the relay latency of each direction: from the time a frame was due to be sent to the time it was received,
+ * so a late generator does not hide a slow proxy. Frames the server did not expect were sent by the bots of the
+ * proxy.
+ *
+ * Start the proxy first, from the directory holding the game data, with its output out of the way:
+ *
+ *   dfs --workers 4 > /dev/null
+ *   dfs-loadgen 256 5 100 tcp
+ *
+ * Usage: dfs-loadgen [max sessions] [seconds per step] [events per second and session] [tcp|unix|direct]
+ */
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    namespace game = com::ankama::dofus::server::game::protocol;
+    namespace login = com::ankama::dofus::server::connection::protocol;
+
+    constexpr const uint16_t PROXY_PORT = 5555;
+    constexpr const char *PROXY_SOCKET = "dfs-proxy";
+
+    /// Shipped with the game data, the proxy loads it on every map change
+    constexpr const int64_t MAP_ID = 189793795;
+    constexpr const int32_t MAP_CELLS = 560;
+
+    constexpr const char *MAP_MOVEMENT_EVENT_TYPE_URL = "type.ankama.com/igg";
+    constexpr const char *MAP_CURRENT_EVENT_TYPE_URL = "type.ankama.com/igi";
+    constexpr const char *MAP_COMPLEMENTARY_INFORMATION_EVENT_TYPE_URL = "type.ankama.com/igr";
+    constexpr const char *MAP_INFORMATION_REQUEST_TYPE_URL = "type.ankama.com/ige";
+    constexpr const char *PING_REQUEST_TYPE_URL = "type.ankama.com/iwu";
+
+    /// The client pings once every this many events, the map changes once every this many events
+    constexpr const uint64_t PING_INTERVAL = 10;
+    constexpr const uint64_t MAP_CHANGE_INTERVAL = 100;
+
+    /// Per direction and session, frames are small
+    constexpr const size_t DECODER_CAPACITY = 256 * 1024;
+
+    enum class Target
+    {
+        Tcp,
+        Unix,
+        Direct,
+    };
+
+    struct Options
+    {
+        unsigned MaxSessions = 64;
+        double StepSeconds = 5;
+        double Rate = 100;
+        Target Via = Target::Tcp;
+    };
+
+    /// A frame in flight, to match it on the other side
+    struct Pending
+    {
+        Clock::time_point DueAt;
+        std::vector<uint8_t> Bytes;
+    };
+
+    struct Session;
+
+    /// One socket of a session: the client one, or the one the fake server accepted
+    struct Leg
+    {
+        Leg(int fd, bool is_server)
+            : Fd(fd)
+            , IsServer(is_server)
+            , Inbound(DECODER_CAPACITY) {
+        }
+
+        int Fd;
+        const bool IsServer;
+
+        /// `nullptr` for a server leg until the hello of its client arrives
+        Session *Owner = nullptr;
+
+        dfs::FrameDecoder Inbound;
+        dfs::OutboundQueue Outbound;
+    };
+
+    struct Session
+    {
+        uint32_t Index = 0;
+        Leg *Client = nullptr;
+        Leg *Server = nullptr;
+
+        /// Sent by the server, then by the client, in order
+        std::deque<Pending> ToClient;
+        std::deque<Pending> ToServer;
+
+        Clock::time_point NextEvent;
+        uint64_t Events = 0;
+        std::vector<int64_t> Actors;
+    };
+
+    struct StepStats
+    {
+        uint64_t Frames = 0;
+        uint64_t Unexpected = 0;
+        uint64_t Mismatched = 0;
+        unsigned Paired = 0;
+        std::vector<uint32_t> ToClientLatencies;
+        std::vector<uint32_t> ToServerLatencies;
+    };
+
+    void append_uvarint(std::vector<uint8_t> &out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    std::vector<uint8_t> frame_of(const google::protobuf::Message &message) {
+        auto payload = message.SerializeAsString();
+
+        std::vector<uint8_t> frame;
+        append_uvarint(frame, payload.size());
+        frame.insert(frame.end(), payload.begin(), payload.end());
+        return frame;
+    }
+
+    std::vector<uint8_t> make_event(const char *type_url, const google::protobuf::Message &event) {
+        game::GameMessage message;
+        auto content = message.mutable_event()->mutable_content();
+        content->set_type_url(type_url);
+        content->set_value(event.SerializeAsString());
+
+        return frame_of(message);
+    }
+
+    std::vector<uint8_t> make_request(int32_t uid, const char *type_url, const google::protobuf::Message &request) {
+        game::GameMessage message;
+        message.mutable_request()->set_uid(uid);
+        auto content = message.mutable_request()->mutable_content();
+        content->set_type_url(type_url);
+        content->set_value(request.SerializeAsString());
+
+        return frame_of(message);
+    }
+
+    /// What the login server answers once a game server is picked: the proxy handles game messages from then on.
+    std::vector<uint8_t> make_select_server() {
+        login::LoginMessage message;
+        auto success = message.mutable_response()->mutable_selectserver()->mutable_success();
+        success->set_host("127.0.0.1");
+        success->add_ports(PROXY_PORT);
+
+        return frame_of(message);
+    }
+
+    /// The actors, collectibles and their states of a busy map. Returns the ids of the actors that move around.
+    std::vector<uint8_t> make_complementary_information(std::mt19937 &rng, std::vector<int64_t> &actors) {
+        std::uniform_int_distribution<int32_t> cell(0, MAP_CELLS - 1);
+        game::gamemap::MapComplementaryInformationEvent event;
+        event.set_map_id(MAP_ID);
+        event.set_subarea_id(1);
+        actors.clear();
+
+        for (int i = 0; i < 8; i++) {
+            auto actor = event.add_actors();
+            actor->set_actor_id(-100 - i);
+            actor->mutable_disposition()->set_cell_id(cell(rng));
+
+            auto group = actor->mutable_actor_information()
+                             ->mutable_role_play_actor()
+                             ->mutable_monster_group_actor()
+                             ->mutable_identification();
+            group->mutable_main_creature()->set_gid(100 + i);
+            group->mutable_main_creature()->set_level(20 + i);
+
+            for (int j = 0; j < 3; j++)
+                group->add_underlings()->set_level(10 + j);
+
+            actors.push_back(actor->actor_id());
+        }
+
+        for (int i = 0; i < 4; i++) {
+            auto actor = event.add_actors();
+            actor->set_actor_id(1000 + i);
+            actor->mutable_disposition()->set_cell_id(cell(rng));
+
+            auto named = actor->mutable_actor_information()->mutable_role_play_actor()->mutable_named_actor();
+            named->set_name(fmt::format("Player-{}", i));
+            named->mutable_humanoid_information()->set_account_id(2000 + i);
+
+            actors.push_back(actor->actor_id());
+        }
+
+        for (int i = 0; i < 12; i++) {
+            auto element = event.add_interactive_elements();
+            element->set_element_id(500000 + i);
+            element->set_element_type_id(38);
+            element->set_on_current_map(true);
+
+            auto skill = element->add_enabled_skills();
+            skill->set_skill_id(45);
+            skill->set_skill_instance_uid(700000 + i);
+
+            auto stated = event.add_stated_elements();
+            stated->set_element_id(500000 + i);
+            stated->set_cell_id(cell(rng));
+            stated->set_state(i % 3 == 0 ? 2 : 1);
+            stated->set_on_current_map(true);
+        }
+
+        return make_event(MAP_COMPLEMENTARY_INFORMATION_EVENT_TYPE_URL, event);
+    }
+
+    std::vector<uint8_t> make_movement(std::mt19937 &rng, int64_t actor) {
+        std::uniform_int_distribution<int32_t> cell(0, MAP_CELLS - 1);
+        std::uniform_int_distribution<int> steps(2, 8);
+
+        game::gamemap::MapMovementEvent event;
+        event.set_character_id(actor);
+
+        for (int i = steps(rng); i > 0; i--)
+            event.add_cells(cell(rng));
+
+        return make_event(MAP_MOVEMENT_EVENT_TYPE_URL, event);
+    }
+
+    /// Abstract Unix socket address of `name`, returns its length.
+    socklen_t unix_address(const std::string &name, sockaddr_un &addr) {
+        addr = {};
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path + 1, name.data(), name.size());
+
+        return offsetof(sockaddr_un, sun_path) + 1 + name.size();
+    }
+
+    int listen_server() {
+        int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, SOMAXCONN) < 0) {
+            perror("Fake server");
+            close(sock);
+            return -1;
+        }
+
+        return sock;
+    }
+
+    int port_of(int sock) {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(sock, (sockaddr *)&addr, &len);
+
+        return ntohs(addr.sin_port);
+    }
+
+    /// Connects a client, through the proxy unless `via` is direct, and sends the handshake of the hook. The socket
+    /// is non-blocking once connected.
+    int connect_client(Target via, int server_port) {
+        int sock;
+
+        if (via == Target::Unix) {
+            sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+            sockaddr_un addr;
+            if (connect(sock, (sockaddr *)&addr, unix_address(PROXY_SOCKET, addr)) < 0) {
+                perror("Failed to connect to the proxy Unix socket");
+                close(sock);
+                return -1;
+            }
+        } else {
+            sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+            int one = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(via == Target::Direct ? server_port : PROXY_PORT);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            if (connect(sock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+                perror(via == Target::Direct ? "Failed to connect to the fake server"
+                                             : "Failed to connect to the proxy");
+                close(sock);
+                return -1;
+            }
+        }
+
+        if (via != Target::Direct) {
+            // Where the hook would tell the proxy to connect to
+            dfs::Handshake handshake{};
+            handshake.Address[10] = 0xFF;
+            handshake.Address[11] = 0xFF;
+            in_addr_t localhost = htonl(INADDR_LOOPBACK);
+            memcpy(&handshake.Address[12], &localhost, 4);
+            handshake.Addrlen = sizeof(sockaddr_in6);
+            handshake.Port = htons(server_port);
+
+            if (send(sock, &handshake, sizeof(handshake), MSG_NOSIGNAL) != sizeof(handshake)) {
+                perror("Failed to send the handshake");
+                close(sock);
+                return -1;
+            }
+        }
+
+        fcntl(sock, F_SETFL, O_NONBLOCK);
+        return sock;
+    }
+
+    /// Plays the login server once, so the proxy handles the game messages that follow.
+    bool log_in(Target via) {
+        int listen_sock = listen_server();
+        if (listen_sock < 0)
+            return false;
+
+        int client = connect_client(via, port_of(listen_sock));
+        if (client < 0) {
+            close(listen_sock);
+            return false;
+        }
+
+        pollfd fd{listen_sock, POLLIN, 0};
+        int server = poll(&fd, 1, 5000) > 0 ? accept(listen_sock, nullptr, nullptr) : -1;
+        close(listen_sock);
+
+        bool done = false;
+
+        if (server >= 0) {
+            auto frame = make_select_server();
+            send(server, frame.data(), frame.size(), MSG_NOSIGNAL);
+
+            // Once it came back, the proxy saw it
+            std::vector<uint8_t> received(frame.size());
+            pollfd client_fd{client, POLLIN, 0};
+            size_t length = 0;
+
+            while (length < received.size() && poll(&client_fd, 1, 5000) > 0) {
+                auto bytes = recv(client, received.data() + length, received.size() - length, 0);
+                if (bytes <= 0)
+                    break;
+
+                length += bytes;
+            }
+
+            done = received == frame;
+            close(server);
+        }
+
+        close(client);
+
+        if (!done)
+            fmt::println(stderr, "The proxy did not relay the login of the fake server");
+
+        return done;
+    }
+
+    /// Drives a share of the sessions of a step, both their client and server side, on one thread: the time a
+    /// frame was sent is known wherever it is received.
+    class Driver {
+      public:
+        Driver(unsigned first_index, unsigned count, const Options &options, uint32_t seed)
+            : m_Epoll(epoll_create1(EPOLL_CLOEXEC))
+            , m_Listener(listen_server())
+            , m_Options(options)
+            , m_Rng(seed)
+            , m_Sessions(count) {
+            for (unsigned i = 0; i < count; i++)
+                m_Sessions[i].Index = first_index + i;
+
+            if (m_Listener >= 0) {
+                epoll_event event{EPOLLIN, {.ptr = nullptr}};
+                epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Listener, &event);
+            }
+        }
+
+        ~Driver() {
+            for (auto &leg : m_Legs)
+                close(leg->Fd);
+
+            if (m_Listener >= 0)
+                close(m_Listener);
+
+            close(m_Epoll);
+        }
+
+        Driver(const Driver &) = delete;
+        Driver operator=(const Driver &) = delete;
+
+        /// Connects the sessions, then runs them until `until`. Only what happens after `measure_from` counts.
+        void Run(Clock::time_point measure_from, Clock::time_point until) {
+            if (m_Listener < 0)
+                return;
+
+            auto now = Clock::now();
+            std::uniform_int_distribution<int64_t> offset(0, static_cast<int64_t>(1e9 / m_Options.Rate));
+
+            for (auto &session : m_Sessions) {
+                int sock = connect_client(m_Options.Via, port_of(m_Listener));
+                if (sock < 0)
+                    continue;
+
+                session.Client = AddLeg(sock, false);
+                session.Client->Owner = &session;
+
+                // Tells the server which session the connection it accepts belongs to
+                game::gamemap::MapInformationRequest hello;
+                hello.set_map_id(MAP_ID);
+                auto frame = make_request(static_cast<int32_t>(session.Index), MAP_INFORMATION_REQUEST_TYPE_URL,
+                                          hello);
+                session.Client->Outbound.Push(frame.data(), frame.size());
+
+                // Spread over the first period, so the sessions do not all send at once
+                session.NextEvent = now + std::chrono::nanoseconds(offset(m_Rng));
+            }
+
+            m_MeasureFrom = measure_from;
+            std::array<epoll_event, 64> events;
+
+            while ((now = Clock::now()) < until) {
+                // Wake up right when the next event is due, a millisecond granularity would be the whole latency
+                auto next = std::min(now + std::chrono::milliseconds(1), until);
+                for (auto &session : m_Sessions) {
+                    if (session.Server != nullptr)
+                        next = std::min(next, session.NextEvent);
+                }
+
+                auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(std::max(next - now, Clock::duration(0)));
+                timespec timeout{0, static_cast<long>(wait.count())};
+
+                int count = epoll_pwait2(m_Epoll, events.data(), events.size(), &timeout, nullptr);
+                now = Clock::now();
+
+                for (int i = 0; i < count; i++) {
+                    if (events[i].data.ptr == nullptr)
+                        Accept();
+                    else
+                        Receive(*static_cast<Leg *>(events[i].data.ptr), now);
+                }
+
+                for (auto &session : m_Sessions)
+                    Tick(session, now);
+
+                for (auto &leg : m_Legs) {
+                    if (leg->Fd >= 0 && !leg->Outbound.IsEmpty() && !leg->Outbound.Flush(leg->Fd))
+                        Drop(*leg);
+                }
+            }
+        }
+
+        StepStats &GetStats() {
+            return m_Stats;
+        }
+
+      private:
+        Leg *AddLeg(int fd, bool is_server) {
+            m_Legs.push_back(std::make_unique<Leg>(fd, is_server));
+            auto leg = m_Legs.back().get();
+
+            epoll_event event{EPOLLIN, {.ptr = leg}};
+            epoll_ctl(m_Epoll, EPOLL_CTL_ADD, fd, &event);
+            return leg;
+        }
+
+        void Drop(Leg &leg) {
+            epoll_ctl(m_Epoll, EPOLL_CTL_DEL, leg.Fd, nullptr);
+            close(leg.Fd);
+            leg.Fd = -1;
+        }
+
+        void Accept() {
+            while (true) {
+                int sock = accept4(m_Listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (sock < 0)
+                    return;
+
+                int one = 1;
+                setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                AddLeg(sock, true);
+            }
+        }
+
+        void Receive(Leg &leg, Clock::time_point now) {
+            while (leg.Fd >= 0) {
+                auto room = leg.Inbound.Prepare(64 * 1024);
+                auto bytes = room.empty() ? -1 : recv(leg.Fd, room.data(), room.size(), 0);
+
+                if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return;
+
+                if (bytes <= 0) {
+                    Drop(leg);
+                    return;
+                }
+
+                leg.Inbound.Commit(bytes);
+
+                while (auto frame = leg.Inbound.Next()) {
+                    if (leg.IsServer)
+                        OnServerFrame(leg, *frame, now);
+                    else
+                        OnClientFrame(*leg.Owner, frame->Bytes, now);
+                }
+            }
+        }
+
+        void OnClientFrame(Session &session, std::span<const uint8_t> frame, Clock::time_point now) {
+            if (session.ToClient.empty()) {
+                m_Stats.Unexpected++;
+                return;
+            }
+
+            auto &pending = session.ToClient.front();
+            if (!std::equal(frame.begin(), frame.end(), pending.Bytes.begin(), pending.Bytes.end()))
+                m_Stats.Mismatched++;
+
+            Record(m_Stats.ToClientLatencies, pending.DueAt, now);
+            session.ToClient.pop_front();
+        }
+
+        void OnServerFrame(Leg &leg, const dfs::Frame &frame, Clock::time_point now) {
+            if (leg.Owner == nullptr) {
+                Pair(leg, frame.GetPayload(), now);
+                return;
+            }
+
+            auto &session = *leg.Owner;
+            auto bytes = frame.Bytes;
+
+            // Anything else comes from the bot of the proxy
+            if (session.ToServer.empty() || !std::equal(bytes.begin(), bytes.end(), session.ToServer.front().Bytes.begin(),
+                                                        session.ToServer.front().Bytes.end())) {
+                m_Stats.Unexpected++;
+                return;
+            }
+
+            Record(m_Stats.ToServerLatencies, session.ToServer.front().DueAt, now);
+            session.ToServer.pop_front();
+        }
+
+        /// Attaches a connection accepted by the server to its session, once the hello of the client arrived.
+        void Pair(Leg &leg, std::span<const uint8_t> payload, Clock::time_point now) {
+            game::GameMessage message;
+            uint32_t index = 0;
+
+            if (!message.ParseFromArray(payload.data(), payload.size()) || !message.has_request() ||
+                (index = message.request().uid()) < m_Sessions.front().Index ||
+                index - m_Sessions.front().Index >= m_Sessions.size()) {
+                m_Stats.Unexpected++;
+                return;
+            }
+
+            auto &session = m_Sessions[index - m_Sessions.front().Index];
+            session.Server = &leg;
+            leg.Owner = &session;
+            m_Stats.Paired++;
+
+            ChangeMap(session, now);
+        }
+
+        /// The server sends the new map, then who is on it.
+        void ChangeMap(Session &session, Clock::time_point due_at) {
+            game::gamemap::MapCurrentEvent current;
+            current.set_map_id(MAP_ID);
+
+            SendToClient(session, make_event(MAP_CURRENT_EVENT_TYPE_URL, current), due_at);
+            SendToClient(session, make_complementary_information(m_Rng, session.Actors), due_at);
+        }
+
+        void Tick(Session &session, Clock::time_point now) {
+            if (session.Server == nullptr || session.Server->Fd < 0 || session.Client->Fd < 0)
+                return;
+
+            const auto period = std::chrono::nanoseconds(static_cast<int64_t>(1e9 / m_Options.Rate));
+
+            // Catch up on the events that were due, stamped with when they were due
+            while (session.NextEvent <= now) {
+                auto due_at = session.NextEvent;
+                session.Events++;
+
+                if (session.Events % MAP_CHANGE_INTERVAL == 0) {
+                    ChangeMap(session, due_at);
+                } else {
+                    std::uniform_int_distribution<size_t> actor(0, session.Actors.size() - 1);
+                    SendToClient(session, make_movement(m_Rng, session.Actors[actor(m_Rng)]), due_at);
+                }
+
+                if (session.Events % PING_INTERVAL == 0) {
+                    game::connection::PingRequest ping;
+                    ping.set_quiet(true);
+
+                    auto frame = make_request(static_cast<int32_t>(session.Events), PING_REQUEST_TYPE_URL, ping);
+                    session.Client->Outbound.Push(frame.data(), frame.size());
+                    session.ToServer.push_back({due_at, std::move(frame)});
+                }
+
+                session.NextEvent += period;
+            }
+        }
+
+        void SendToClient(Session &session, std::vector<uint8_t> &&frame, Clock::time_point due_at) {
+            session.Server->Outbound.Push(frame.data(), frame.size());
+            session.ToClient.push_back({due_at, std::move(frame)});
+        }
+
+        void Record(std::vector<uint32_t> &latencies, Clock::time_point due_at, Clock::time_point now) {
+            if (due_at < m_MeasureFrom)
+                return;
+
+            m_Stats.Frames++;
+            latencies.push_back(static_cast<uint32_t>(
+                std::min<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - due_at).count(),
+                                  UINT32_MAX)));
+        }
+
+      private:
+        int m_Epoll;
+        int m_Listener;
+        const Options &m_Options;
+        std::mt19937 m_Rng;
+        std::vector<Session> m_Sessions;
+        std::vector<std::unique_ptr<Leg>> m_Legs;
+        Clock::time_point m_MeasureFrom;
+        StepStats m_Stats;
+    };
+
+    /// In microseconds
+    double percentile(std::vector<uint32_t> &latencies, double p) {
+        if (latencies.empty())
+            return 0;
+
+        auto index = static_cast<size_t>(p * (latencies.size() - 1));
+        std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+        return latencies[index] / 1000.0;
+    }
+
+    void run_step(unsigned sessions, const Options &options) {
+        // The generator must not be what saturates: a driver per core left to the proxy, at most
+        unsigned drivers = std::min(sessions, std::max(1u, std::thread::hardware_concurrency() / 2));
+
+        std::vector<std::unique_ptr<Driver>> instances;
+        for (unsigned i = 0; i < drivers; i++) {
+            unsigned first = sessions * i / drivers;
+            unsigned last = sessions * (i + 1) / drivers;
+            instances.push_back(std::make_unique<Driver>(first, last - first, options, 42 + i));
+        }
+
+        // The first fifth is a warm up: connections and first maps
+        auto start = Clock::now();
+        auto step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.StepSeconds));
+        auto measure_from = start + step / 5;
+        auto until = start + step;
+
+        std::vector<std::thread> threads;
+        for (auto &driver : instances)
+            threads.emplace_back(&Driver::Run, driver.get(), measure_from, until);
+
+        for (auto &thread : threads)
+            thread.join();
+
+        StepStats total;
+        for (auto &driver : instances) {
+            auto &stats = driver->GetStats();
+
+            total.Frames += stats.Frames;
+            total.Unexpected += stats.Unexpected;
+            total.Mismatched += stats.Mismatched;
+            total.Paired += stats.Paired;
+            total.ToClientLatencies.insert(total.ToClientLatencies.end(), stats.ToClientLatencies.begin(),
+                                           stats.ToClientLatencies.end());
+            total.ToServerLatencies.insert(total.ToServerLatencies.end(), stats.ToServerLatencies.begin(),
+                                           stats.ToServerLatencies.end());
+        }
+
+        auto measured = std::chrono::duration<double>(until - measure_from).count();
+
+        fmt::println("{:>8} {:>6} {:>10.0f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9.1f} {:>9}", sessions,
+                     total.Paired, total.Frames / measured, percentile(total.ToClientLatencies, 0.5),
+                     percentile(total.ToClientLatencies, 0.99), percentile(total.ToClientLatencies, 0.999),
+                     percentile(total.ToServerLatencies, 0.5), percentile(total.ToServerLatencies, 0.99),
+                     percentile(total.ToServerLatencies, 0.999), total.Unexpected);
+
+        if (total.Mismatched > 0)
+            fmt::println(stderr, "{} frames were altered on their way to the client", total.Mismatched);
+    }
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+
+    if (argc > 1)
+        options.MaxSessions = std::max(1, std::atoi(argv[1]));
+    if (argc > 2)
+        options.StepSeconds = std::max(0.5, std::strtod(argv[2], nullptr));
+    if (argc > 3)
+        options.Rate = std::max(1.0, std::strtod(argv[3], nullptr));
+    if (argc > 4) {
+        if (strcmp(argv[4], "unix") == 0) {
+            options.Via = Target::Unix;
+        } else if (strcmp(argv[4], "direct") == 0) {
+            options.Via = Target::Direct;
+        } else if (strcmp(argv[4], "tcp") != 0) {
+            fmt::println(stderr,
+                         "Usage: {} [max sessions] [seconds per step] [events per second and session] "
+                         "[tcp|unix|direct]",
+                         argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.Via != Target::Direct && !log_in(options.Via))
+        return 1;
+
+    fmt::println("{:.0f} events per second and session, {:.1f}s per step", options.Rate, options.StepSeconds);
+    fmt::println("{:>8} {:>6} {:>10} {:>29} {:>29} {:>9}", "", "", "", "server -> client (us)",
+                 "client -> server (us)", "");
+    fmt::println("{:>8} {:>6} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9} {:>9}", "sessions", "up", "frames/s", "p50",
+                 "p99", "p999", "p50", "p99", "p999", "from bots");
+
+    for (unsigned sessions = 1;; sessions = std::min(sessions * 2, options.MaxSessions)) {
+        run_step(sessions, options);
+
+        if (sessions == options.MaxSessions)
+            break;
+    }
+
+    return 0;
+}
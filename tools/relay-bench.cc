@@ -0,0 +1,345 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "epoll-reactor.hh"
+#include "game.hh"
+#include "messages.hh"
+#include "session.hh"
+#include "uring-reactor.hh"
+
+/**
+ * Relays full-duplex traffic between fake game clients and a fake upstream server on the loopback, through each
+ * proxy backend, and reports the throughput. A direct run (no proxy) gives the ceiling of the machine. The `/unix`
+ * runs connect the clients through the abstract Unix socket like the hook does, instead of the loopback TCP stack.
+ *
+ * Usage: dfs-relay-bench [sessions] [megabytes per direction and session] [frame size]
+ */
+namespace
+{
+    struct Options
+    {
+        int Sessions = 4;
+        size_t Bytes = 32 * 1024 * 1024;
+        size_t FrameSize = 512;
+    };
+
+    void append_uvarint(std::vector<uint8_t> &out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    /// A block of frames holding a single unknown bytes field: they parse as valid messages and are forwarded as is.
+    std::vector<uint8_t> make_frames(size_t frame_size) {
+        std::vector<uint8_t> frame_body;
+        frame_body.push_back((15 << 3) | 2);
+        append_uvarint(frame_body, frame_size);
+        frame_body.resize(frame_body.size() + frame_size, 'A');
+
+        std::vector<uint8_t> block;
+        while (block.size() < 64 * 1024) {
+            append_uvarint(block, frame_body.size());
+            block.insert(block.end(), frame_body.begin(), frame_body.end());
+        }
+
+        return block;
+    }
+
+    int listen_on(int family) {
+        int sock = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        int opt = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+        if (family == AF_INET6) {
+            int v6only = 0;
+            setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+
+            sockaddr_in6 addr{};
+            addr.sin6_family = AF_INET6;
+            addr.sin6_addr = in6addr_any;
+            bind(sock, (sockaddr *)&addr, sizeof(addr));
+        } else {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            bind(sock, (sockaddr *)&addr, sizeof(addr));
+        }
+
+        listen(sock, 128);
+        return sock;
+    }
+
+    /// Abstract Unix socket address of `name`, returns its length.
+    socklen_t unix_address(const std::string &name, sockaddr_un &addr) {
+        addr = {};
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path + 1, name.data(), name.size());
+
+        return offsetof(sockaddr_un, sun_path) + 1 + name.size();
+    }
+
+    int listen_unix(const std::string &name) {
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        sockaddr_un addr;
+        bind(sock, (sockaddr *)&addr, unix_address(name, addr));
+
+        listen(sock, 128);
+        return sock;
+    }
+
+    int port_of(int sock) {
+        sockaddr_storage addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(sock, (sockaddr *)&addr, &len);
+
+        if (addr.ss_family == AF_INET6)
+            return ntohs(reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_port);
+
+        return ntohs(reinterpret_cast<sockaddr_in *>(&addr)->sin_port);
+    }
+
+    /// Sends `total` bytes of frames while reading `total` bytes back, then closes the socket.
+    void pump(int sock, const std::vector<uint8_t> &block, size_t total) {
+        auto writer = std::thread([&]() {
+            size_t sent = 0;
+            while (sent < total) {
+                auto chunk = std::min(block.size(), total - sent);
+                auto written = send(sock, block.data(), chunk, MSG_NOSIGNAL);
+                if (written <= 0)
+                    return;
+
+                sent += written;
+            }
+        });
+
+        std::vector<uint8_t> buffer(64 * 1024);
+        size_t received = 0;
+        while (received < total) {
+            auto bytes_read = recv(sock, buffer.data(), buffer.size(), 0);
+            if (bytes_read <= 0)
+                break;
+
+            received += bytes_read;
+        }
+
+        writer.join();
+        close(sock);
+    }
+
+    /// Runs the fake upstream server: every accepted connection gets `sessions` connections worth of traffic.
+    void run_server(int listen_sock, int sessions, const std::vector<uint8_t> &block, size_t total) {
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < sessions; i++) {
+            int sock = accept(listen_sock, nullptr, nullptr);
+            if (sock < 0)
+                break;
+
+            threads.emplace_back(pump, sock, std::cref(block), total);
+        }
+
+        for (auto &t : threads)
+            t.join();
+    }
+
+    int connect_to(int port, const dfs::Handshake *handshake) {
+        int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (connect(sock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("connect");
+            close(sock);
+            return -1;
+        }
+
+        if (handshake != nullptr)
+            send(sock, handshake, sizeof(dfs::Handshake), MSG_NOSIGNAL);
+
+        return sock;
+    }
+
+    int connect_unix(const std::string &name, const dfs::Handshake &handshake) {
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        sockaddr_un addr;
+        if (connect(sock, (sockaddr *)&addr, unix_address(name, addr)) < 0) {
+            perror("connect");
+            close(sock);
+            return -1;
+        }
+
+        send(sock, &handshake, sizeof(dfs::Handshake), MSG_NOSIGNAL);
+        return sock;
+    }
+
+    /// Returns the aggregated throughput in MiB/s (both directions), or a negative value on failure. The clients
+    /// reach the proxy through an abstract Unix socket with `over_unix`.
+    double run(const char *backend, bool over_unix, const Options &options, const std::vector<uint8_t> &block) {
+        int server_sock = listen_on(AF_INET6);
+        int server_port = port_of(server_sock);
+
+        auto server = std::thread(run_server, server_sock, options.Sessions, std::cref(block), options.Bytes);
+
+        // Where the hook would tell the proxy to connect to
+        dfs::Handshake handshake{};
+        handshake.Address[10] = 0xFF;
+        handshake.Address[11] = 0xFF;
+        in_addr_t localhost = htonl(INADDR_LOOPBACK);
+        memcpy(&handshake.Address[12], &localhost, 4);
+        handshake.Addrlen = sizeof(sockaddr_in6);
+        handshake.Port = htons(server_port);
+
+        dfs::GameData game_data{};
+        dfs::Messages messages{};
+        std::atomic<dfs::Reactor *> reactor = nullptr;
+        std::atomic<bool> ready = false;
+        std::thread proxy;
+        int proxy_sock = -1;
+        int unix_sock = -1;
+        int target_port = server_port;
+        const auto unix_name = fmt::format("dfs-relay-bench-{}", getpid());
+
+        if (strcmp(backend, "direct") != 0) {
+            proxy_sock = listen_on(AF_INET);
+            fcntl(proxy_sock, F_SETFL, O_NONBLOCK);
+            target_port = port_of(proxy_sock);
+
+            if (over_unix)
+                unix_sock = listen_unix(unix_name);
+
+            // io_uring rings are single issuer: create the reactor on the thread that runs it
+            proxy = std::thread([&]() {
+                std::unique_ptr<dfs::Reactor> instance;
+
+                if (strcmp(backend, "io_uring") == 0) {
+                    auto uring = std::make_unique<dfs::UringReactor>(proxy_sock, game_data, messages);
+                    if (uring->IsSupported())
+                        instance = std::move(uring);
+                } else {
+                    bool splice = strcmp(backend, "splice") == 0;
+                    instance = std::make_unique<dfs::EpollReactor>(proxy_sock, game_data, messages, splice);
+                }
+
+                if (instance != nullptr && unix_sock >= 0)
+                    instance->AddListener(unix_sock);
+
+                reactor = instance.get();
+                ready = true;
+
+                if (instance != nullptr)
+                    instance->Run();
+            });
+
+            while (!ready)
+                std::this_thread::yield();
+
+            if (reactor == nullptr) {
+                proxy.join();
+                close(proxy_sock);
+                if (unix_sock >= 0)
+                    close(unix_sock);
+                close(server_sock);
+                // Unblock the fake server
+                for (int i = 0; i < options.Sessions; i++)
+                    close(connect_to(server_port, nullptr));
+                server.join();
+                return -1;
+            }
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> clients;
+        for (int i = 0; i < options.Sessions; i++) {
+            clients.emplace_back([&]() {
+                int sock = unix_sock >= 0 ? connect_unix(unix_name, handshake)
+                                          : connect_to(target_port, proxy.joinable() ? &handshake : nullptr);
+                if (sock >= 0)
+                    pump(sock, block, options.Bytes);
+            });
+        }
+
+        for (auto &c : clients)
+            c.join();
+
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        server.join();
+        close(server_sock);
+
+        if (proxy.joinable()) {
+            reactor.load()->Stop();
+            proxy.join();
+            close(proxy_sock);
+            if (unix_sock >= 0)
+                close(unix_sock);
+        }
+
+        auto total_mib = 2.0 * options.Sessions * options.Bytes / (1024.0 * 1024.0);
+        return total_mib / elapsed;
+    }
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+
+    if (argc > 1)
+        options.Sessions = std::atoi(argv[1]);
+    if (argc > 2)
+        options.Bytes = std::strtoull(argv[2], nullptr, 10) * 1024 * 1024;
+    if (argc > 3)
+        options.FrameSize = std::strtoull(argv[3], nullptr, 10);
+
+    // The proxy logs every chunk it relays, keep the terminal for the results
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+
+    auto block = make_frames(options.FrameSize);
+
+    fmt::println(stderr, "{} sessions, {} MiB per direction and session, {} bytes frames", options.Sessions,
+                 options.Bytes / (1024 * 1024), options.FrameSize);
+
+    for (auto backend : {"direct", "epoll", "splice", "io_uring"}) {
+        for (bool over_unix : {false, true}) {
+            // Nothing to compare without a proxy
+            if (over_unix && strcmp(backend, "direct") == 0)
+                continue;
+
+            auto throughput = run(backend, over_unix, options, block);
+            auto name = fmt::format("{}{}", backend, over_unix ? "/unix" : "");
+
+            if (throughput < 0)
+                fmt::println(stderr, "{:>15}: not available", name);
+            else
+                fmt::println(stderr, "{:>15}: {:8.1f} MiB/s", name, throughput);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/base.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "capture.hh"
+#include "game.hh"
+#include "messages.hh"
+#include "session.hh"
+
+/**
+ * Replays a capture recorded by the proxy (`dfs --capture <file>`) without a game client: every frame goes through
+ * the same path as in the proxy (frame decoding, `Messages::HandleMessage`, the bot state and its pathfinding),
+ * one session per captured session. Frames are replayed at the pace they were captured at, some times faster, or
+ * as fast as possible to profile the handlers. What the bots send is dropped.
+ *
+ * Needs the game data, like the proxy: run it from the directory holding `data/`.
+ *
+ * Usage: dfs-replay <capture> [--speed <factor> | --fast]
+ */
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        std::string Path;
+
+        /// Zero for as fast as possible
+        double Speed = 1.0;
+    };
+
+    struct Totals
+    {
+        uint64_t Frames = 0;
+        uint64_t Bytes = 0;
+        uint64_t Handled = 0;
+        uint64_t Skipped = 0;
+        size_t Sessions = 0;
+    };
+
+    bool parse_options(int argc, char *argv[], Options &options) {
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+                options.Speed = std::strtod(argv[++i], nullptr);
+                if (options.Speed <= 0)
+                    return false;
+            } else if (strcmp(argv[i], "--fast") == 0) {
+                options.Speed = 0;
+            } else if (argv[i][0] != '-' && options.Path.empty()) {
+                options.Path = argv[i];
+            } else {
+                return false;
+            }
+        }
+
+        return !options.Path.empty();
+    }
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Options options;
+
+    if (!parse_options(argc, argv, options)) {
+        fmt::println(stderr, "Usage: {} <capture> [--speed <factor> | --fast]", argv[0]);
+        return 1;
+    }
+
+    auto capture = dfs::CaptureReader::Open(options.Path);
+    if (capture == nullptr)
+        return 1;
+
+    // The handlers and bots log every message, keep the terminal for the results
+    int devnull = open("/dev/null", O_WRONLY);
+    int terminal = dup(STDOUT_FILENO);
+    dup2(devnull, STDOUT_FILENO);
+
+    dfs::GameData game_data{};
+    if (!game_data.Initialize()) {
+        dup2(terminal, STDOUT_FILENO);
+        fmt::println(stderr, "Failed to load the game data, run from the directory holding data/");
+        return 1;
+    }
+
+    dfs::Messages::SetConnected(capture->GetHeader().Connected);
+    dfs::Messages messages;
+
+    std::unordered_map<uint64_t, std::unique_ptr<dfs::Session>> sessions;
+    Totals totals;
+
+    int64_t first_timestamp = 0;
+    const auto start = Clock::now();
+    const auto bot_epoch = std::chrono::high_resolution_clock::now();
+
+    while (auto entry = capture->Next()) {
+        const auto &record = *entry->Record;
+
+        if (totals.Frames == 0)
+            first_timestamp = record.Timestamp;
+
+        auto captured_after = std::chrono::nanoseconds(record.Timestamp - first_timestamp);
+
+        if (options.Speed > 0) {
+            auto due = start + std::chrono::duration_cast<Clock::duration>(captured_after / options.Speed);
+            if (Clock::now() < due)
+                std::this_thread::sleep_until(due);
+        }
+
+        auto &session = sessions[record.SessionId];
+        if (session == nullptr) {
+            // No sockets: observed like the in-process mode, nothing is forwarded
+            session = std::make_unique<dfs::Session>(-1, game_data, messages);
+            session->Observe();
+        }
+
+        auto &from = record.Direction == dfs::CaptureDirection::ServerToClient ? session->GetServer()
+                                                                                : session->GetClient();
+
+        if (!from.Inbound.Append(entry->Frame.data(), entry->Frame.size())) {
+            totals.Skipped++;
+            continue;
+        }
+
+        session->OnObservedData(from, entry->Frame.size());
+
+        // The bots live in the time of the capture, whatever the speed
+        session->UpdateBot(bot_epoch + std::chrono::duration_cast<dfs::now_t::duration>(captured_after));
+
+        auto &server = session->GetServer();
+        server.Outbound.Consume(server.Outbound.GetSize());
+
+        totals.Frames++;
+        totals.Bytes += entry->Frame.size();
+    }
+
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (auto &[id, session] : sessions) {
+        totals.Handled += session->GetCounters().Handled.load();
+        session->Close();
+    }
+
+    totals.Sessions = sessions.size();
+    sessions.clear();
+
+    // What the handlers logged is still buffered
+    fflush(stdout);
+    dup2(terminal, STDOUT_FILENO);
+    close(terminal);
+    close(devnull);
+
+    if (capture->IsTruncated())
+        fmt::println(stderr, "The capture is truncated, replayed up to the damaged record");
+
+    fmt::println("{} frames ({:.1f} MiB) of {} session{} in {:.3f}s: {:.0f} messages/s, {:.1f} MiB/s", totals.Frames,
+                 totals.Bytes / (1024.0 * 1024.0), totals.Sessions, totals.Sessions != 1 ? "s" : "", elapsed,
+                 totals.Frames / elapsed, totals.Bytes / (1024.0 * 1024.0) / elapsed);
+    fmt::println("{} handled, {} skipped (larger than the decoder)", totals.Handled, totals.Skipped);
+
+    return 0;
+}